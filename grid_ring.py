@@ -0,0 +1,131 @@
+#!/usr/bin/env python3
+"""
+grid_ring.py
+
+7seg-displayd の共有メモリリング（include/grid_ring.h）へ grid を書き込む ctypes ラッパー。
+I2C や TCA9548A の切り替えは 7seg-displayd が行うので、Python 側は表示内容を作るだけでよい。
+
+    from grid_ring import GridRing
+    with GridRing() as ring:                    # SEG_GRID_RING（既定 /7seg-grid）に接続
+        ring.submit_text("12:34".ljust(ring.width * ring.height))
+        ring.submit(bytes(ring.width * ring.height))   # bit0=a ... bit6=g, bit7=dp の生 grid
+
+共有ライブラリは SEG_GRID_RING_LIB、なければ bin/*/lib7seg-grid-ring.so（make displayd で生成）を探す。
+"""
+from __future__ import annotations
+
+import ctypes
+import glob
+import os
+
+# 各桁のセグメントビット（C++ 側の grid と同じ）
+SEGMENT_BITS = {"a": 0, "b": 1, "c": 2, "d": 3, "e": 4, "f": 5, "g": 6, "dp": 7}
+
+_lib = None
+
+
+def _load_library() -> ctypes.CDLL:
+    global _lib
+    if _lib is not None:
+        return _lib
+    candidates = []
+    if os.environ.get("SEG_GRID_RING_LIB"):
+        candidates.append(os.environ["SEG_GRID_RING_LIB"])
+    here = os.path.dirname(os.path.abspath(__file__))
+    candidates += sorted(glob.glob(os.path.join(here, "bin", "*", "lib7seg-grid-ring.so")))
+    candidates.append("lib7seg-grid-ring.so")
+    last_error = None
+    for path in candidates:
+        try:
+            lib = ctypes.CDLL(path)
+            break
+        except OSError as e:
+            last_error = e
+    else:
+        raise OSError(f"lib7seg-grid-ring.so not found (run `make displayd` or set SEG_GRID_RING_LIB): {last_error}")
+
+    lib.grid_ring_attach.argtypes = [ctypes.c_char_p]
+    lib.grid_ring_attach.restype = ctypes.c_void_p
+    lib.grid_ring_detach.argtypes = [ctypes.c_void_p]
+    lib.grid_ring_detach.restype = None
+    lib.grid_ring_width.argtypes = [ctypes.c_void_p]
+    lib.grid_ring_width.restype = ctypes.c_int
+    lib.grid_ring_height.argtypes = [ctypes.c_void_p]
+    lib.grid_ring_height.restype = ctypes.c_int
+    lib.grid_ring_submit.argtypes = [ctypes.c_void_p, ctypes.c_char_p, ctypes.c_size_t]
+    lib.grid_ring_submit.restype = ctypes.c_int
+    _lib = lib
+    return lib
+
+
+def text_to_grid(text: str, digit_map: dict, size: int) -> bytes:
+    """tetris.py などの digit_map（文字 → {'a':1, ...}）で文字列を grid に変換する"""
+    blank = digit_map.get(" ", {})
+    cache: dict[str, int] = {}
+    out = bytearray(size)
+    for i, ch in enumerate(text[:size]):
+        bits = cache.get(ch)
+        if bits is None:
+            bits = 0
+            for seg, on in digit_map.get(ch, blank).items():
+                if on and seg in SEGMENT_BITS:
+                    bits |= 1 << SEGMENT_BITS[seg]
+            cache[ch] = bits
+        out[i] = bits
+    return bytes(out)
+
+
+class GridRing:
+    def __init__(self, name: str | None = None):
+        self._lib = _load_library()
+        self._ring = self._lib.grid_ring_attach(name.encode() if name else None)
+        if not self._ring:
+            raise ConnectionError("7seg-displayd grid ring is not available (is 7seg-displayd running?)")
+
+    @property
+    def width(self) -> int:
+        return self._lib.grid_ring_width(self._ring)
+
+    @property
+    def height(self) -> int:
+        return self._lib.grid_ring_height(self._ring)
+
+    def submit(self, grid) -> bool:
+        """width*height バイトの grid を書き込む。大きさが違う / デーモンがいなければ False"""
+        data = bytes(grid)
+        return self._lib.grid_ring_submit(self._ring, data, len(data)) == 0
+
+    def submit_text(self, text: str, digit_map: dict | None = None) -> bool:
+        if digit_map is None:
+            digit_map = DEFAULT_DIGIT_MAP
+        return self.submit(text_to_grid(text, digit_map, self.width * self.height))
+
+    def close(self) -> None:
+        if self._ring:
+            self._lib.grid_ring_detach(self._ring)
+            self._ring = None
+
+    def __enter__(self) -> "GridRing":
+        return self
+
+    def __exit__(self, *exc) -> None:
+        self.close()
+
+    def __del__(self):
+        try:
+            self.close()
+        except Exception:
+            pass
+
+
+def _segs(s: str) -> dict:
+    return {seg: 1 for seg in s.split()}
+
+
+# 数字と、よく使う記号だけの既定の変換表
+DEFAULT_DIGIT_MAP = {
+    "0": _segs("a b c d e f"), "1": _segs("b c"), "2": _segs("a b d e g"), "3": _segs("a b c d g"),
+    "4": _segs("b c f g"), "5": _segs("a c d f g"), "6": _segs("a c d e f g"), "7": _segs("a b c"),
+    "8": _segs("a b c d e f g"), "9": _segs("a b c d f g"), "-": _segs("g"), "_": _segs("d"),
+    " ": {}, ".": _segs("dp"), ":": _segs("dp"),
+}
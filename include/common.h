@@ -4,6 +4,7 @@
 #include "config.h"
 
 #include <atomic>
+#include <chrono>
 #include <deque>
 #include <mutex>
 #include <vector>
@@ -13,9 +14,14 @@
 
 #include <cstdint>
 #include <csignal>
+#include <map>
+#include <tuple>
+#include <utility>
 
 // Ctrl+C / SIGTERM で立つ終了フラグ
 extern std::atomic<bool> g_should_exit;
+// SIGHUP で立つ設定再読み込みの要求（live_config.cpp の監視スレッドが拾って下ろす）
+extern std::atomic<bool> g_reload_requested;
 
 // シグナルハンドラ設定用
 void setup_signal_handlers();
@@ -23,6 +29,8 @@ void setup_signal_handlers();
 
 // I2Cバスをconfig.jsonから選択する
 int open_i2c_auto(const DisplayConfig& config);
+// 全モジュールを初期化する（チャンネルごと・同じアドレスのチャンネルをまとめて送る）
+// 応答しないモジュールは隔離して続行し、1つも初期化できなかった場合だけ false
 bool initialize_displays(int i2c_fd, const DisplayConfig& config);
 
 #endif
@@ -46,6 +54,10 @@ extern std::deque<std::vector<char>> audio_buf;
 extern std::mutex frame_mtx;
 extern std::vector<uint8_t> latest_frame;
 extern std::atomic<int> last_pts_ms;
+// latest_frame を更新するたびに +1 する（frame_mtx 保持中に更新。表示側で取りこぼし数を数える）
+extern uint64_t latest_frame_seq;
+// latest_frame を受け取った時刻（frame_mtx 保持中に更新。遅れの計測 latency_probe.h 用）
+extern std::chrono::steady_clock::time_point latest_frame_received_at;
 extern double start_time;
 extern int audio_bytes_received;
 
@@ -64,6 +76,16 @@ bool attempt_i2c_recovery(int& i2c_fd, const DisplayConfig& config);
 // 成功時はファイルディスクリプタ、失敗時は -1 を返す
 int open_i2c_auto();
 
+// I2C エラーの集計: (バス, TCA のアドレス, チャンネル, モジュールのアドレス) → 回数
+// 直結のモジュールは TCA とチャンネルが -1、TCA のチャンネル切り替えの失敗はモジュールのアドレスが -1
+// （module_health.h・metrics と同じく場所で区別し、別の TCA の同じチャンネル・アドレスを混ぜない）
+// led.cpp がモジュール / チャンネルの失敗ごとに record_i2c_error で加算する
+extern std::map<std::tuple<int, int, int, int>, int> g_error_counts;
+extern std::mutex g_error_counts_mtx;
+void record_i2c_error(int bus, int tca_address, int channel, int address);
+// 集計結果を標準出力へ（シグナルハンドラからも呼ばれるので、ロックが取れなければ諦める）
+void print_i2c_error_summary();
+
 struct I2CErrorInfo {
     int channel = -1; // エラーが発生したTCAのチャンネル番号
     int address = -1; // エラーが発生したI2Cデバイスのアドレス
@@ -0,0 +1,52 @@
+// src/compositor.h
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// frame_to_grid の後段で、複数の grid レイヤを1枚の grid に重ねる
+// 最下層（映像など）の上に、z の小さい順にレイヤを重ねる。各レイヤは
+//   - パネル上の矩形 (x, y, width, height)。はみ出した部分は切り捨てる
+//   - REPLACE: segment_mask（と桁ごとの cell_mask）のセグメントを置き換える
+//     OR     : segment_mask のうち、レイヤで点灯しているセグメントを足す
+// 1桁 = 1バイト (bit0=a ... bit7=dp) なので、1行を8桁ずつ uint64_t でまとめて処理する。
+enum class GridBlend : uint8_t {
+    REPLACE = 0,
+    OR = 1,
+};
+
+struct GridLayer {
+    int z = 0;               // 大きいほど上
+    int x = 0;               // パネル上の左上（桁）
+    int y = 0;
+    int width = 0;
+    int height = 0;
+    GridBlend mode = GridBlend::REPLACE;
+    uint8_t segment_mask = 0xFF;    // このレイヤが触るセグメント
+    std::vector<uint8_t> cells;     // width * height
+    std::vector<uint8_t> cell_mask; // 空でなければ width * height。segment_mask と AND して桁ごとに使う
+};
+
+class GridCompositor {
+public:
+    // name のレイヤを追加または置き換える（大きさの合わないレイヤは false）
+    bool set_layer(const std::string& name, GridLayer layer);
+    void remove_layer(const std::string& name);
+    void clear() { layers_.clear(); }
+    bool empty() const { return layers_.empty(); }
+    size_t size() const { return layers_.size(); }
+
+    // base（panel_width x panel_height）にレイヤを重ねて out に書く。base と out は同じでもよい
+    void compose(const std::vector<uint8_t>& base, int panel_width, int panel_height, std::vector<uint8_t>& out) const;
+
+private:
+    struct Entry {
+        std::string name;
+        GridLayer layer;
+    };
+    std::vector<Entry> layers_;  // z の昇順（同じ z は追加順）
+};
+
+// 1枚のレイヤを grid（panel_width x panel_height）に重ねる
+void blend_grid_layer(std::vector<uint8_t>& grid, int panel_width, int panel_height, const GridLayer& layer);
@@ -6,6 +6,8 @@
 #include <numeric>
 #include <map>
 #include <algorithm> // for std::sort, std::unique
+#include <memory>
+#include <tuple>
 
 extern double CHAR_WIDTH_MM;
 extern double CHAR_HEIGHT_MM;
@@ -14,7 +16,10 @@ extern double CHAR_HEIGHT_MM;
 struct TCA9548AConfig {
     int address; // TCA9548A のアドレス (-1 で直接接続)
     std::map<int, std::vector<std::vector<int>>> channels; // channel -> slave address grid
-    std::map<int, std::tuple<int, int, int>> rows; // row -> (channel, row_offset, col_offset)
+    // channel -> (row, col): チャンネルのモジュール格子の左上を置くパネル上の位置（桁単位の絶対座標）
+    // 指定のないチャンネルは、従来どおり左から右・上から下へ順に詰めて配置する
+    // （config.json の旧形式 "rows": {"n": {"channel", "row_offset", "col_offset"}} はここに読み替える）
+    std::map<int, std::pair<int, int>> origins;
 };
 
 // Bus の構成を定義する構造体
@@ -22,6 +27,8 @@ struct BusConfig {
     std::vector<TCA9548AConfig> tca9548as;
 };
 
+class RoutingTable; // routing_table.h
+
 // パネルの物理構成を定義する構造体
 struct DisplayConfig {
     std::string name;
@@ -43,6 +50,10 @@ struct DisplayConfig {
     // mapping[logical_index] = physical_index
     std::map<int,std::vector<int>> module_index_map;
 
+    // load_config_from_json がコンパイル（またはキャッシュから mmap）した経路表
+    // update_flexible_display はこれを引いてモジュールごとのバッファを作る
+    std::shared_ptr<const RoutingTable> routing;
+
     int total_digits() const { return total_width * total_height; }
 
     // Get module digit width/height for a specific module address.
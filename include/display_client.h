@@ -0,0 +1,126 @@
+// src/display_client.h
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "compositor.h"
+
+// 7seg-displayd（I2C バスとコンパイル済みレイアウトを持ち続ける常駐プロセス）との通信
+// 映像ソースはプロセスごとにバスを開く代わりに、Unix ドメインソケットでフレームを送る。
+// デーモンは毎フレーム、新しいフレームを持つソースのうち priority が最も高いものを表示する。
+// ソースの切り替え（接続・切断・RELEASE）は次のフレームで反映され、モジュールの再初期化は起きない。
+// LAYER を送るソースは優先度で選ばれる代わりに、選ばれたソースの上に重ねられる（時計やテロップ。compositor.h）。
+//
+// ソケット上には [DisplaydHeader][本体] を並べる（SOCK_STREAM、ネイティブエンディアン）。
+constexpr uint32_t DISPLAYD_MAGIC = 0x44375331;         // "1S7D"
+constexpr uint16_t DISPLAYD_VERSION = 1;
+constexpr uint32_t DISPLAYD_MAX_PAYLOAD = 4 * 1024 * 1024;
+
+enum DisplaydMessageType : uint16_t {
+    DISPLAYD_HELLO = 1,    // ソース → デーモン: DisplaydHello（接続直後に1回）
+    DISPLAYD_GRID = 2,     // ソース → デーモン: DisplaydFrame + width*height バイトのセグメントビット (bit0=a ... bit7=dp)
+    DISPLAYD_GRAY = 3,     // ソース → デーモン: DisplaydFrame + width*height バイトの8bitグレー画像（デーモンが frame_to_grid する）
+    DISPLAYD_RELEASE = 4,  // ソース → デーモン: 表示を手放す（接続は保つ。次のフレームを送れば戻る）
+    DISPLAYD_WELCOME = 5,  // デーモン → ソース: DisplaydWelcome（HELLO の応答と、構成が変わったとき）
+    DISPLAYD_LAYER = 6,    // ソース → デーモン: DisplaydLayer + width*height バイトの grid (+ has_cell_mask なら同じ大きさのマスク)
+};
+
+struct DisplaydHeader {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t type;
+    uint32_t length;  // ヘッダに続く本体のバイト数
+};
+
+struct DisplaydHello {
+    int32_t priority;  // 大きいほど優先
+    uint32_t hold_ms;  // 最後のフレームから何ミリ秒まで表示し続けるか（0 は切断 / RELEASE まで）
+    char name[32];     // ログ用の名前（NUL 終端）
+};
+
+struct DisplaydFrame {
+    uint16_t width;
+    uint16_t height;
+};
+
+struct DisplaydLayer {
+    int32_t z;              // 大きいほど上（HELLO の priority とは別）
+    int16_t x;              // パネル上の左上（桁）。はみ出した部分は切り捨てる
+    int16_t y;
+    uint16_t width;
+    uint16_t height;
+    uint8_t mode;           // GridBlend (0=REPLACE, 1=OR)
+    uint8_t segment_mask;   // このレイヤが触るセグメント
+    uint8_t has_cell_mask;
+    uint8_t reserved;
+};
+
+struct DisplaydWelcome {
+    uint16_t total_width;   // GRID はこの大きさで送る
+    uint16_t total_height;
+    uint32_t fps;           // デーモンが I2C に書き込む頻度
+};
+
+// SEG_DISPLAYD_SOCKET、なければ $RUNTIME_DIRECTORY/displayd.sock、なければ /run/7seg-panel/displayd.sock
+// （/run/7seg-panel がなく $XDG_RUNTIME_DIR があれば $XDG_RUNTIME_DIR/7seg-displayd.sock）
+std::string displayd_socket_path();
+
+class DisplayClient {
+public:
+    DisplayClient() = default;
+    ~DisplayClient();
+    DisplayClient(const DisplayClient&) = delete;
+    DisplayClient& operator=(const DisplayClient&) = delete;
+
+    // 接続して HELLO を送る。失敗しても設定は覚えておき、submit_* が1秒おきに接続し直す
+    bool connect(const std::string& name, int priority, int hold_ms = 500,
+                 const std::string& socket_path = displayd_socket_path());
+    void disconnect();
+    bool connected() const { return fd_ >= 0; }
+
+    // grid は width x height（パネルの大きさと違えばデーモンが捨てる）
+    bool submit_grid(const uint8_t* grid, int width, int height);
+    bool submit_grid(const std::vector<uint8_t>& grid, int width, int height) {
+        return submit_grid(grid.data(), width, height);
+    }
+    bool submit_gray(const uint8_t* pixels, int width, int height);
+    // 表示中のソースの上に重ねるレイヤ。送り続けている間（hold_ms）だけ重なる
+    bool submit_layer(const GridLayer& layer);
+    bool release();
+
+    // 送るものがなくても WELCOME を取り込む（切断されていれば接続し直す）。接続中なら true
+    bool refresh();
+
+    // デーモンから知らされたパネルの大きさ（未接続なら 0）
+    int panel_width() const { return welcome_.total_width; }
+    int panel_height() const { return welcome_.total_height; }
+    int panel_fps() const { return static_cast<int>(welcome_.fps); }
+
+private:
+    bool open_socket();
+    bool ensure_connected();
+    bool send_message(uint16_t type, const void* head, size_t head_len, const void* body, size_t body_len);
+    void drain_incoming();
+
+    int fd_ = -1;
+    std::string name_;
+    int priority_ = 0;
+    int hold_ms_ = 500;
+    std::string socket_path_;
+    bool configured_ = false;
+    std::chrono::steady_clock::time_point next_retry_{};
+    std::vector<uint8_t> inbuf_;
+    DisplaydWelcome welcome_{};
+};
+
+// 環境変数 SEG_DISPLAYD_PRIORITY が設定されていれば、プレイヤーは I2C を開かずに 7seg-displayd へ送る
+//   SEG_DISPLAYD_PRIORITY  このソースの優先度（設定されていれば有効）
+//   SEG_DISPLAYD_HOLD_MS   最後のフレームを表示し続ける時間（既定 500）
+// 有効なら接続を試みて true（つながらなくても後で接続し直す）。無効なら false
+bool connect_displayd_output_from_env(const std::string& source_name);
+// connect_displayd_output_from_env で有効になった出力先（無効なら nullptr）
+DisplayClient* displayd_output();
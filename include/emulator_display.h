@@ -1,7 +1,9 @@
 // emulator_display.h
 #pragma once
 #include <vector>
+#include <string>
 #include <cstdint>
+#include <atomic>
 
 // 7segエミュレータ/物理LED共通の出力インターフェース
 class IDisplayOutput {
@@ -14,6 +16,40 @@ public:
 extern bool debug_mode;
 
 // エミュレータ用出力クラス生成
+// 出力先は環境変数 EMULATOR_OUTPUT で切り替える（未設定時は "window"）
 IDisplayOutput* create_emulator_display(int digits);
 IDisplayOutput* create_emulator_display(int rows, int cols);
 IDisplayOutput* create_emulator_display(const std::string& config_name);
+
+// 出力先を明示して生成する
+//   "window"        : cv::imshow ウィンドウ（従来動作）
+//   "null"          : 描画のみ行い、どこにも出力しない（ベンチマーク用）
+//   "png:<dir>"     : <dir>/frame_000000.png ... の連番PNG
+//   "pipe:<path>"   : 生BGRフレームを書き出す（"-" は標準出力、FIFO可）
+//   "shm:<name>"    : POSIX共有メモリのリングバッファ（EmulatorShmHeader 参照）
+IDisplayOutput* create_emulator_display(int rows, int cols, const std::string& output_spec);
+
+// --- 共有メモリ出力のレイアウト ---
+// [EmulatorShmHeader][EmulatorShmSlot + BGRピクセル] x slot_count
+// ライターは (write_seq + 1) % slot_count のスロットに書き込み、
+// スロットの seq を更新してから write_seq を進める。
+// リーダーは write_seq からスロットを選び、コピー前後で slot.seq が一致するか確認する。
+constexpr uint32_t EMULATOR_SHM_MAGIC = 0x46474553; // "SEGF"
+constexpr uint32_t EMULATOR_SHM_VERSION = 1;
+
+struct EmulatorShmHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t width;       // ピクセル
+    uint32_t height;      // ピクセル
+    uint32_t stride;      // 1行のバイト数 (width * 3)
+    uint32_t slot_count;
+    uint64_t slot_size;   // EmulatorShmSlot を含む1スロットのバイト数
+    std::atomic<uint64_t> write_seq; // 書き込み完了した最新フレーム番号 (1始まり, 0はフレーム無し)
+};
+
+struct EmulatorShmSlot {
+    std::atomic<uint64_t> seq;   // このスロットに入っているフレーム番号（書き込み中は0）
+    uint64_t timestamp_ns;       // CLOCK_MONOTONIC
+    // 続いて height * stride バイトの BGR ピクセル
+};
@@ -0,0 +1,156 @@
+// src/frame_scheduler.h
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+struct UpdateStats; // led.h
+
+// 固定周期でフレームを表示するためのスケジューラ（video_thread / play_video_stream / エミュレータ共通）
+// フレーム n の締め切り（I2C への書き込みを終えたい時刻）は start + n * period の絶対時刻で決め、
+// 前のフレームの遅れを次へ持ち越さない。1フレームは次の順に進む:
+//   wait_next()    締め切り - (準備の見込み + 書き込みの見込み) に起きる
+//   （デコード・frame_to_grid などの準備）
+//   wait_commit()  締め切り - 書き込みの見込み まで待つ（準備のばらつきをここで吸収する）
+//   （I2C への書き込み）
+//   commit_done()
+// 見込みはそれぞれ実測の平均 + 2 * 平均偏差で更新するので、書き込みの終わりが締め切りに揃い、
+// 表示の間隔には I2C のばらつきしか残らない。wait_commit を呼ばなければ、起きてから書き込み終了までを
+// 書き込みの時間とみなす。Linux では timerfd の絶対時刻タイマで眠る（sleep_for の誤差の積み重ねがない）。
+//
+// 1周期以上遅れたら、間の締め切りは飛ばして次の締め切りに合わせる（飛ばした数を wait_next が返す。
+// ファイル再生では同じ数だけフレームを読み捨てて音声と揃える）。
+//
+// 環境変数:
+//   SEG_RT_PRIORITY     設定されていれば、出力スレッドを SCHED_FIFO のこの優先度 (1-99) で動かす
+//   SEG_FRAME_LEAD_US   書き込みの見込み時間を実測せずに固定する（マイクロ秒）
+//   SEG_OUTPUT_FPS      ストリーム (video_thread) の表示周期（既定 FPS）
+class FrameScheduler {
+public:
+    using Clock = std::chrono::steady_clock;
+    static constexpr double kMaxFps = 1000;  // set_fps はこの範囲 (1 - kMaxFps) に切る
+
+    explicit FrameScheduler(double fps);
+    ~FrameScheduler();
+    FrameScheduler(const FrameScheduler&) = delete;
+    FrameScheduler& operator=(const FrameScheduler&) = delete;
+
+    // 周期を変える。次のフレームから今を起点に数え直す
+    void set_fps(double fps);
+    double fps() const { return fps_; }
+
+    // 次のフレームの起床時刻まで眠る。戻り値は遅れのために飛ばした締め切りの数（普段は 0）
+    int wait_next();
+    // 準備が終わったら呼ぶ。I2C への書き込みを始める時刻まで眠る
+    void wait_commit();
+    // このフレームの書き込みが終わったら呼ぶ。見込み時間と jitter（締め切りとのずれ）を更新する
+    void commit_done();
+
+    Clock::time_point deadline() const { return deadline_; }
+    // 締め切りのどれだけ前に起きるか（準備 + 書き込み）と、書き込みを始めるか
+    int64_t lead_us() const { return (prepare_lead_ns_ + commit_lead_ns_) / 1000; }
+    int64_t commit_lead_us() const { return commit_lead_ns_ / 1000; }
+    // 直前のフレームの準備（起床から wait_commit まで）と書き込み（wait_commit から commit_done まで）の時間
+    int64_t last_prepare_ns() const { return last_prepare_ns_; }
+    int64_t last_commit_ns() const { return last_commit_ns_; }
+
+    struct Stats {
+        uint64_t frames = 0;          // commit_done の回数
+        uint64_t missed = 0;          // 飛ばした締め切り
+        double mean_abs_jitter_us = 0;
+        double max_abs_jitter_us = 0;
+        int64_t lead_us = 0;
+        int64_t commit_lead_us = 0;
+    };
+    Stats stats() const;
+
+private:
+    void sleep_until(Clock::time_point t);
+
+    double fps_;
+    Clock::duration period_;
+    Clock::time_point start_;
+    Clock::time_point deadline_;
+    Clock::time_point woke_at_;
+    Clock::time_point commit_at_;
+    int64_t frame_ = 0;
+    bool waiting_commit_ = false;
+    bool commit_started_ = false;
+    // 準備と書き込みにかかる時間 (ns) の見込み（指数移動平均と平均偏差）
+    struct Estimate {
+        double mean = 0;
+        double dev = 0;
+        bool primed = false;
+        void add(double ns);
+        double lead() const { return mean + 2 * dev; }
+    };
+    Estimate prepare_;
+    Estimate commit_;
+    bool fixed_commit_lead_ = false;
+    int64_t prepare_lead_ns_ = 0;
+    int64_t commit_lead_ns_ = 0;
+    int64_t last_prepare_ns_ = 0;
+    int64_t last_commit_ns_ = 0;
+    Stats stats_;
+    double jitter_sum_us_ = 0;
+    int timer_fd_ = -1;
+};
+
+// バスが追いつける表示周期を実測から選ぶ（video_thread / play_video_stream）
+// パネルの大きさで I2C の書き込み時間は何倍も違うので、固定の FPS では小さいパネルには遅すぎ、大きいパネルでは
+// 締め切りを守れない。フレームごとに observe() で準備・書き込みの時間と書いたモジュール数を受け取り、
+//   必要な時間 = 準備の p95 + max(書き込みの p95, 全体を書く時間)
+//   全体を書く時間 = 1チャンネル切り替えの時間 * 構成のチャンネル数 + 1モジュールの時間 * 構成の全モジュール数
+// が周期の 80% に収まる最大の fps（整数）を選ぶ。変化のないモジュールは書かないので、実際に書いた数で見積もると
+// 静かな場面では 0 になり、上げた周期のまま動きの多い場面に入ると締め切りを守れない。そのため書き込みは
+// 常に全体を書く場合の時間で見積もる。チャンネルの切り替えには固定の待ちがあり、1モジュールだけ書いたフレームの
+// 時間をモジュール数で割ると大きく見積もりすぎるので、2つの時間は直近のフレームの
+// (切り替え回数, 書いたモジュール数) → 書き込み時間 から最小二乗法で別々に求める。
+// 下げるときはすぐ（16 フレームごと）、上げるときは1秒以上余裕が続いてから 25% ずつ上げる。
+// 選んだ fps は戻り値で知らせるので、呼び出し側が FrameScheduler::set_fps に渡す。
+//
+// 環境変数:
+//   SEG_ADAPTIVE_FPS     0 なら固定の周期のまま（既定 1）
+//   SEG_OUTPUT_MIN_FPS   下げる下限（既定 5）
+//   SEG_OUTPUT_MAX_FPS   ストリーム (video_thread) で上げる上限（既定 60。ファイル再生は動画の fps が上限）
+class RateController {
+public:
+    RateController(double initial_fps, double max_fps);
+
+    bool enabled() const { return enabled_; }
+    double fps() const { return fps_; }
+    // 見積もった、バスが追いつける fps（上限・下限で切る前）
+    double sustainable_fps() const { return sustainable_fps_; }
+
+    // commit_done の後に、このフレームの書き込み量（last_update_stats()）を渡して呼ぶ
+    // 表示周期を変えるべきなら true（fps() が新しい値）
+    bool observe(const FrameScheduler& scheduler, const UpdateStats& work);
+
+private:
+    static constexpr size_t kWindow = 64;
+    static double percentile(std::vector<double> v, double q);
+    void fit_costs();
+
+    bool enabled_ = true;
+    double fps_;
+    double min_fps_ = 5;
+    double max_fps_;
+    double sustainable_fps_ = 0;
+    double ns_per_channel_ = 0;         // 1回のチャンネル切り替えの時間（fit_costs）
+    double ns_per_module_ = 0;          // 1モジュールあたりの書き込み時間（fit_costs）
+    std::vector<double> prepare_ns_;    // 直近 kWindow フレーム（リングバッファ）
+    std::vector<double> commit_ns_;
+    std::vector<double> modules_;
+    std::vector<double> channels_;
+    size_t next_ = 0;
+    int64_t frames_since_change_ = 0;
+};
+
+// SEG_RT_PRIORITY が設定されていれば、呼び出し元のスレッドを SCHED_FIFO にする（権限がなければ警告だけ）
+void set_output_thread_realtime_from_env(const char* thread_name);
+
+// SEG_OUTPUT_FPS、なければ fallback
+double output_fps_from_env(double fallback);
+// SEG_OUTPUT_MAX_FPS、なければ fallback
+double output_max_fps_from_env(double fallback);
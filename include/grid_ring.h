@@ -0,0 +1,106 @@
+// src/grid_ring.h
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// ローカルのプロデューサ（Python のツールなど）から 7seg-displayd へ grid を渡す共有メモリのリング
+// 7seg-displayd が作成し（既定名 /7seg-grid、SEG_GRID_RING で変更）、プロデューサは接続して grid を書き込む。
+// 書き込まれた grid はソケットのソースと同じく優先度つきで選ばれ、差分・まとめ書きを経て I2C に出る。
+//
+// [GridRingHeader][GridRingSlot + width*height バイト] x slot_count
+// プロデューサは claim_seq を進めてスロットを確保し、slot.seq を CAS で「書き込み中」(GRID_RING_WRITING) にしてから
+// grid を書き込み、slot.seq と publish_seq を更新して doorbell（futex）を鳴らす。複数のプロデューサが同時に書いてもよい。
+// 書き込み中のスロットは他のプロデューサが使わない（止まっていたプロデューサが周回後のスロットを壊さないように）。
+// デーモンは publish_seq からスロットを選び、コピー前後で slot.seq が一致するか確認する（エミュレータの shm 出力と同じ方式）。
+#define GRID_RING_MAGIC 0x44495247u   // "GRID"
+#define GRID_RING_VERSION 2u
+#define GRID_RING_SLOTS 4u
+#define GRID_RING_WRITING (1ull << 63)   // slot.seq のこのビットが立っていれば、そのフレーム番号で書き込み中
+
+#ifdef __cplusplus
+#include <atomic>
+#include <string>
+#include <vector>
+
+struct GridRingHeader {
+    uint32_t magic;        // 最後に書く（__atomic で読み書きする）
+    uint32_t version;
+    uint32_t width;        // grid の桁数（パネルの total_width）
+    uint32_t height;
+    uint32_t slot_count;
+    uint32_t reserved;
+    uint64_t slot_size;    // GridRingSlot を含む1スロットのバイト数
+    std::atomic<uint64_t> claim_seq;    // プロデューサが確保したフレーム番号
+    std::atomic<uint64_t> publish_seq;  // 書き込み完了した最新フレーム番号 (1始まり, 0はフレーム無し)
+    std::atomic<uint32_t> doorbell;     // futex ワード。publish のたびに進む
+    std::atomic<uint32_t> waiting;      // デーモンが doorbell で眠っていれば 1
+    std::atomic<uint32_t> closed;       // デーモンが終了した / 大きさを変えて作り直した（プロデューサは接続し直す）
+    uint32_t reserved2;
+};
+
+struct GridRingSlot {
+    std::atomic<uint64_t> seq;   // このスロットに入っているフレーム番号（書き込み中は GRID_RING_WRITING | 番号）
+    uint64_t timestamp_ns;       // CLOCK_MONOTONIC
+    // 続いて width * height バイトの grid (bit0=a ... bit7=dp)
+};
+
+// SEG_GRID_RING、なければ /7seg-grid（"0" なら無効として空文字列）
+std::string grid_ring_name();
+
+// デーモン側（リングの作成と読み出し）
+class GridRing {
+public:
+    GridRing() = default;
+    ~GridRing();
+    GridRing(const GridRing&) = delete;
+    GridRing& operator=(const GridRing&) = delete;
+
+    // 作成する。同じ名前の古いリングは closed にしてから消す（接続中のプロデューサは作り直しに気づく）
+    bool create(const std::string& name, int width, int height);
+    void close();
+    bool is_open() const { return header_ != nullptr; }
+    int width() const { return header_ ? width_ : 0; }
+    int height() const { return header_ ? height_ : 0; }
+
+    // 前回の読み出しより新しい grid があれば out にコピーして true
+    bool read_latest(std::vector<uint8_t>& out);
+    // 新しい grid が publish されるか timeout_ms が過ぎるまで眠る。新しい grid があれば true
+    bool wait(int timeout_ms);
+    // wait() で眠っているスレッドを起こす（終了・作り直しのとき）
+    void wake();
+
+private:
+    uint8_t* slot_ptr(uint64_t seq) const;
+
+    std::string name_;
+    uint8_t* base_ = nullptr;
+    size_t map_size_ = 0;
+    GridRingHeader* header_ = nullptr;
+    uint64_t last_read_ = 0;
+    // 大きさは作ったときの値を持っておく。共有メモリはプロデューサも書けるので、ヘッダの値は信用しない
+    int width_ = 0;
+    int height_ = 0;
+    size_t slot_size_ = 0;
+};
+
+extern "C" {
+#endif
+
+// --- プロデューサ側の C ABI（lib7seg-grid-ring.so。Python からは grid_ring.py で ctypes 経由） ---
+typedef struct grid_ring grid_ring;
+
+// 7seg-displayd が作ったリングに接続する。name が NULL なら grid_ring_name()。デーモンがいなければ NULL
+grid_ring* grid_ring_attach(const char* name);
+void grid_ring_detach(grid_ring* ring);
+// パネルの大きさ（デーモンが構成を変えると grid_ring_submit の中で接続し直して変わる）
+int grid_ring_width(const grid_ring* ring);
+int grid_ring_height(const grid_ring* ring);
+// width*height バイトの grid を書き込む
+//  0: 成功  -1: 大きさが違う（grid_ring_width/height で確かめて作り直す）  -2: デーモンがいない
+//  -3: 他のプロデューサが書き込み中でスロットが空かなかった（このフレームは捨てられる。次のフレームを送ればよい）
+int grid_ring_submit(grid_ring* ring, const uint8_t* grid, size_t len);
+
+#ifdef __cplusplus
+}
+#endif
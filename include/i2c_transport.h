@@ -0,0 +1,58 @@
+// src/i2c_transport.h
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// I2C バスへの送信を抽象化するインターフェース
+// 既定は /dev/i2c-N への ioctl/write。ベンチマークやオフライン計測では
+// FakeI2CTransport に差し替えて、実機なしで led.cpp の処理を通す。
+class I2CTransport {
+public:
+    virtual ~I2CTransport() = default;
+    // 以降の write の宛先スレーブアドレスを設定する
+    virtual bool set_slave(int fd, int addr) = 0;
+    // 現在のスレーブへ len バイト書き込む（全バイト送れたら true）
+    virtual bool write(int fd, const uint8_t* data, size_t len) = 0;
+    // デバイスの安定待ち（TCA9548A の切り替え後など）
+    virtual void settle_us(unsigned int usec) = 0;
+};
+
+// 現在のトランスポートを取得 / 差し替え (nullptr で既定に戻す)
+I2CTransport* get_i2c_transport();
+void set_i2c_transport(I2CTransport* transport);
+
+// 実機に触らず、トランザクション数とバス占有時間の見積もりだけを記録するトランスポート
+class FakeI2CTransport : public I2CTransport {
+public:
+    // bus_hz: 見積もりに使う SCL 周波数 (100kHz / 400kHz / 1MHz など)
+    explicit FakeI2CTransport(unsigned int bus_hz = 400000) : bus_hz_(bus_hz) {}
+
+    bool set_slave(int fd, int addr) override;
+    bool write(int fd, const uint8_t* data, size_t len) override;
+    void settle_us(unsigned int usec) override;
+
+    void reset();
+
+    uint64_t transactions() const { return transactions_; }
+    uint64_t bytes() const { return bytes_; }
+    uint64_t slave_switches() const { return slave_switches_; }
+    // 転送時間 + settle 待ちの合計見積もり (ns)
+    uint64_t simulated_ns() const { return simulated_ns_; }
+    int current_slave() const { return slave_; }
+
+    // 指定アドレスへの書き込みを失敗させる（障害注入, -1 で無効）
+    void set_fail_address(int addr) { fail_addr_ = addr; }
+    // 1トランザクションごとのバス以外の時間（write システムコールとコントローラの準備）を見積もりに足す
+    void set_transaction_overhead_ns(uint64_t ns) { overhead_ns_ = ns; }
+
+private:
+    unsigned int bus_hz_;
+    uint64_t overhead_ns_ = 0;
+    int slave_ = -1;
+    int fail_addr_ = -1;
+    uint64_t transactions_ = 0;
+    uint64_t bytes_ = 0;
+    uint64_t slave_switches_ = 0;
+    uint64_t simulated_ns_ = 0;
+};
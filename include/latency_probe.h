@@ -0,0 +1,47 @@
+// src/latency_probe.h
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// 送り手から表示までの遅れを測るための、映像に埋め込む時刻のパターン
+// 画面全体を 8 x 4 のマスに分け、1マス1ビット（白 = 1）で32ビットを左上から行ごとに並べる:
+//   下位 24 ビット: パターンを作った時刻（CLOCK_MONOTONIC のミリ秒、約4.6時間で一周）
+//   上位 8 ビット : 検査値（時刻の3バイトの XOR ^ 0xA5。ふつうの映像を時刻と取り違えないため）
+// マスは大きく、読むのは各マスの中央付近の平均なので、拡大縮小・低ビットレートの H.264・JPEG を通っても読める。
+// 送り手（7seg-latency-source）と受け手（video_thread）が同じマシンなら同じ時計なので、差がそのまま遅れになる。
+// OpenCV に依存しない。
+namespace latency_probe {
+
+constexpr int kColumns = 8;
+constexpr int kRows = 4;
+
+// 今の CLOCK_MONOTONIC のミリ秒（下位 24 ビット）
+uint32_t now_ms24();
+// ms24 を埋め込んだパターンを width x height の 8bit グレー画像として描く
+void render(uint32_t ms24, int width, int height, std::vector<uint8_t>& gray);
+// 8bit グレーの画像からパターンを読む（画素の並びは SamplingPlan と同じく pixel_step / stride）
+// パターンでなければ false
+bool decode(const uint8_t* pixels, int width, int height, int pixel_step, size_t stride, uint32_t& ms24);
+// ms24 から now までの遅れ（ミリ秒）。一周分の折り返しを考え、60 秒を超えるものは取り違えとみなして -1
+int64_t elapsed_ms(uint32_t ms24, std::chrono::steady_clock::time_point now);
+
+// 遅れの分布を区間ごとにまとめて出す（[probe] の行。Prometheus のヒストグラムは metrics.h）
+class Report {
+public:
+    // source_to_receive: パターンを作ってからプレイヤーが受け取るまで（ネットワーク・バッファ・デコード）
+    // receive_to_commit: 受け取ってから I2C に書き終わるまで（表示の周期待ち・変換・書き込み）
+    void add(int64_t source_to_receive_ms, int64_t receive_to_commit_ms);
+    // interval ごとに中央値 / p95 / 最大を標準出力へ出して区間を空にする
+    void print_if_due(std::chrono::seconds interval);
+
+private:
+    std::vector<int64_t> receive_ms_;
+    std::vector<int64_t> commit_ms_;
+    std::vector<int64_t> total_ms_;
+    std::chrono::steady_clock::time_point started_ = std::chrono::steady_clock::now();
+};
+
+} // namespace latency_probe
@@ -6,16 +6,43 @@
 #include <cstdint> 
 #include "common.h"
 
+// 1つのモジュールに初期化コマンド (発振器ON / 表示ON / 輝度最大) を送る
+bool initialize_module(int i2c_fd, int addr);
+
+// 実行中の構成差し替え (live_config.h) で、新しく置かれたモジュールだけを初期化し、外されたモジュールを消灯する
+// 配置が変わらないモジュールには何も送らない。初期化に失敗したモジュールは隔離し、失敗があれば false
+bool apply_layout_change(int i2c_fd, const DisplayConfig& before, const DisplayConfig& after);
+
 // 1つのモジュールにデータを書き込む内部関数 
 bool update_module_from_grid(int i2c_bus_fd, int addr, const std::vector<uint8_t>& grid16, I2CErrorInfo& error_info_out);
+// digits[物理桁] (最大16桁) を HT16K33 の表示RAMに変換して書き込む
+bool update_module_from_digits(int i2c_bus_fd, int addr, const uint8_t* digits, int digit_count, I2CErrorInfo& error_info_out);
 
 // パネル全体を描画する関数
+// 失敗したモジュールはバックオフ・隔離して残りを書き込む。全モジュールが失敗した場合のみ false
 bool update_flexible_display(int i2c_fd, const DisplayConfig& config, const std::vector<uint8_t>& grid, I2CErrorInfo& error_info_out);
+// モジュールごとの輝度（HT16K33 の 0-15、経路表のモジュール順）も合わせて書く（local_dimming.h）
+// 輝度コマンドは最後に書いた値から変わったモジュールにだけ、表示RAM と同じチャンネル選択のまま送る
+// brightness が空（または大きさが違う）なら全モジュール最大 (15)
+bool update_flexible_display(int i2c_fd, const DisplayConfig& config, const std::vector<uint8_t>& grid,
+                             const std::vector<uint8_t>& brightness, I2CErrorInfo& error_info_out);
+// このスレッドの直前の update_flexible_display の書き込み量（RateController 用）
+// チャンネルの切り替えには固定の待ち (settle) があるので、モジュールとは別に数える
+struct UpdateStats {
+    int modules_written = 0;   // I2C に書いたモジュール数（変化がなければ 0）
+    int module_count = 0;      // 構成の全モジュール数（全体を書くときの数）
+    int channel_selects = 0;   // TCA9548A に書いた回数（チャンネルの切り替え・閉じる）
+    int channel_count = 0;     // 構成の TCA チャンネル数（全体を書くときの切り替え回数）
+};
+const UpdateStats& last_update_stats();
 
 // I2C通信状態のキャッシュをリセットするための関数
 void reset_i2c_channel_cache();
 
 bool select_i2c_channel(int i2c_fd, int expander_addr, int channel, I2CErrorInfo& error_info_out);
+// TCA9548A の複数チャンネルを同時に有効にする（bit n = チャンネル n、0 は全無効）
+// 有効なチャンネルの同じアドレスのモジュールには、1回の書き込みが全て届く
+bool select_i2c_channels(int i2c_fd, int expander_addr, uint8_t channel_mask, I2CErrorInfo& error_info_out);
 
 // 全モジュールを消灯する（終了時に呼ぶ）
 bool clear_all_displays(const DisplayConfig& config);
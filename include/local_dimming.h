@@ -0,0 +1,35 @@
+// src/local_dimming.h
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+class RoutingTable;
+
+// モジュールごとの輝度（ローカルディミング）
+// initialize_displays は HT16K33 の輝度を最大 (0xEF) にしたまま変えないので、2値の映像では明るい場面も暗い場面も
+// 同じ明るさで光る。frame_to_levels のセグメントごとの明るさ (0-15) から、モジュールごとに点灯するセグメントの
+// 明るさの平均を取り、HT16K33 の輝度 16 段階（デューティ (n + 1) / 16）に割り当てる:
+//   目標 = 平均 * 16 / 15 - 1
+// 目標が今の輝度から 0.75 段以上離れたときだけ変える（境目の明るさで輝度がちらつかないように）。
+// 点灯するセグメントのないモジュールは輝度を変えない。輝度コマンドは1バイトで、変わったモジュールにだけ
+// update_flexible_display が表示RAM と一緒に送るので、バスの負担はほとんど増えない。
+// 擬似階調 (seg_dither.h) と組み合わせるときは平均ではなく最大の明るさで輝度を決め、セグメントの明るさを
+// 16 / (輝度 + 1) 倍して戻す（暗いモジュールでもディザの段数を使い切る）。
+class LocalDimming {
+public:
+    static constexpr int kMaxLevel = 15;
+
+    // levels（levels[桁 * 8 + セグメント]）から各モジュールの輝度を更新する
+    // gray が true なら levels を輝度に合わせて書き換える（TemporalDither に渡す前に呼ぶ）
+    void update(const RoutingTable& routing, std::vector<uint8_t>& levels, bool gray);
+
+    // 経路表のモジュール順の輝度（update_flexible_display に渡す）
+    const std::vector<uint8_t>& brightness() const { return brightness_; }
+
+private:
+    std::vector<uint8_t> brightness_;
+};
+
+// SEG_LOCAL_DIMMING=1 ならローカルディミングを使う（既定 0）
+bool local_dimming_from_env();
@@ -0,0 +1,114 @@
+// src/metrics.h
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// パイプライン各段の軽量な計測
+// 値の更新は std::atomic のみ（ロック無し）で、映像/I2C スレッドから直接呼んでよい。
+// 出力は Prometheus テキスト形式 (render_prometheus)。
+namespace metrics {
+
+class Counter {
+public:
+    void inc(uint64_t n = 1) { v_.fetch_add(n, std::memory_order_relaxed); }
+    uint64_t value() const { return v_.load(std::memory_order_relaxed); }
+private:
+    std::atomic<uint64_t> v_{0};
+};
+
+class Gauge {
+public:
+    void set(int64_t v) { v_.store(v, std::memory_order_relaxed); }
+    int64_t value() const { return v_.load(std::memory_order_relaxed); }
+private:
+    std::atomic<int64_t> v_{0};
+};
+
+// 固定バケットのレイテンシヒストグラム（記録はマイクロ秒、出力は秒）
+class Histogram {
+public:
+    static constexpr std::array<uint32_t, 14> kBoundsUs = {
+        50, 100, 250, 500, 1000, 2000, 5000, 10000, 20000, 33000, 50000, 100000, 250000, 1000000
+    };
+    static constexpr size_t kBuckets = kBoundsUs.size() + 1; // 最後は +Inf
+
+    void observe_us(uint64_t us);
+    // i 番目のバケットに入った数（累積ではない）
+    uint64_t bucket(size_t i) const { return buckets_[i].load(std::memory_order_relaxed); }
+    uint64_t sum_us() const { return sum_us_.load(std::memory_order_relaxed); }
+    bool used() const { return used_.load(std::memory_order_relaxed); }
+
+private:
+    std::array<std::atomic<uint64_t>, kBuckets> buckets_{};
+    std::atomic<uint64_t> sum_us_{0};
+    std::atomic<bool> used_{false};
+};
+
+// スコープの所要時間を Histogram に記録する
+class ScopedTimer {
+public:
+    explicit ScopedTimer(Histogram& h) : h_(h), t0_(std::chrono::steady_clock::now()) {}
+    ~ScopedTimer() {
+        auto us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - t0_).count();
+        h_.observe_us(us > 0 ? static_cast<uint64_t>(us) : 0);
+    }
+    ScopedTimer(const ScopedTimer&) = delete;
+    ScopedTimer& operator=(const ScopedTimer&) = delete;
+private:
+    Histogram& h_;
+    std::chrono::steady_clock::time_point t0_;
+};
+
+// --- パイプラインの計測点 ---
+Histogram& decode_latency();          // JPEG / 動画フレームのデコード
+Histogram& frame_to_grid_latency();   // 2値画像 → 7セググリッド
+Histogram& i2c_commit_latency();      // update_flexible_display 1回（全モジュール）
+// 1モジュールへの書き込み。場所は (バス, TCA9548A のアドレス, チャンネル, モジュールのアドレス)。
+// 直結は tca_address = channel = -1。errors の addr = -1 は TCA のチャンネル切り替えの失敗
+struct ModuleSeries {
+    Histogram write;
+    Counter errors;
+};
+// 場所から系列を引く（ロックと表引きがあるので、毎フレーム書くモジュールは経路表ごとに一度引いて持っておく）。
+// 返した参照はプロセスの終わりまで有効
+ModuleSeries& module_series(int bus, int tca_address, int channel, int addr);
+Histogram& module_write_latency(int bus, int tca_address, int channel, int addr);
+Counter& module_write_errors(int bus, int tca_address, int channel, int addr);
+Counter& i2c_bytes();                 // I2C に書いたバイト数（表示データのみ）
+Counter& i2c_broadcast_saved_writes(); // TCA の複数チャンネルへ同時に書いたことで省けたモジュール書き込み
+Counter& frames_displayed();
+Counter& frames_dropped();            // 表示される前に次のフレームで上書きされた数
+Histogram& frame_jitter();            // 書き込みが終わった時刻と締め切りのずれ（frame_scheduler.h）
+Counter& frame_deadline_misses();     // 遅れのために飛ばした締め切り
+Gauge& audio_queue_bytes();           // SDL の再生キューに積まれているバイト数
+// RateController（frame_scheduler.h）が選んだ表示周期と、実測から見積もった追いつける上限（どちらも 1/1000 fps 単位）
+Gauge& output_fps();
+Gauge& output_sustainable_fps();
+Gauge& gray_subframes();              // 擬似階調（seg_dither.h）で1映像フレームあたりに書くサブフレーム数
+Histogram& capture_to_display_latency(); // カメラがフレームを撮ってから I2C に書き終わるまで（v4l2_capture.h）
+// 時刻のパターン（latency_probe.h）を作ってからプレイヤーが受け取るまで / I2C に書き終わるまで
+Histogram& probe_source_to_receive_latency();
+Histogram& probe_source_to_commit_latency();
+// 7seg-net-player の受信パイプラインのキュー（名前の付いた queue / queue2）に溜まっている量
+enum StreamQueue { kQueueNet, kQueueVideo, kQueueRaw, kQueueAudio, kStreamQueueCount };
+Gauge& stream_queue_time_us(int queue);
+Gauge& stream_queue_buffers(int queue);
+Counter& late_frames_dropped();       // appsink で PTS が遅れすぎていて捨てたフレーム（SEG_LOW_LATENCY）
+
+// 出力に seg_panel_info{config="..."} として載せる構成名
+void set_panel_info(const std::string& config_name);
+
+std::string render_prometheus();
+
+// GET /metrics だけに応答する最小の HTTP リスナー（httplib を持たないプレイヤー用）
+bool start_metrics_server(int port);
+void stop_metrics_server();
+// 環境変数 METRICS_PORT が設定されていれば start_metrics_server する
+void start_metrics_server_from_env();
+
+} // namespace metrics
@@ -0,0 +1,70 @@
+// src/module_health.h
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <tuple>
+#include <vector>
+
+// モジュール（および TCA9548A チャンネル）単位の健全性管理
+// 1つのモジュールが書き込みに失敗しても、そのモジュールだけを指数バックオフで休ませ、
+// 残りのモジュールへの書き込みはそのフレームで続ける。
+// 連続失敗が一定回数を超えたモジュールは隔離し、再試行時にそのモジュールだけ再初期化する。
+//
+// 環境変数:
+//   MODULE_BACKOFF_BASE_MS   初回失敗後の待ち時間 (既定 100)
+//   MODULE_BACKOFF_MAX_MS    待ち時間の上限 (既定 10000)
+//   MODULE_QUARANTINE_AFTER  何回連続で失敗したら隔離するか (既定 3)
+
+// 書き込み前の判定結果
+enum class ModuleAction {
+    Write,   // 通常どおり書き込む
+    Reinit,  // 隔離からの再試行: 再初期化してから書き込む
+    Skip,    // バックオフ中: このフレームは触らない
+};
+
+struct ModuleHealthSnapshot {
+    int tca_address;      // -1 は直結
+    int channel;          // -1 は直結
+    int address;          // -1 はチャンネル全体（TCA の切り替え失敗）
+    int consecutive_failures;
+    uint64_t total_failures;
+    bool quarantined;
+    int retry_in_ms;      // 次の再試行までの残り時間
+};
+
+class ModuleHealthTable {
+public:
+    ModuleHealthTable();
+
+    // address = -1 でチャンネル全体を表す
+    ModuleAction check(int tca_address, int channel, int address);
+    void report_success(int tca_address, int channel, int address);
+    void report_failure(int tca_address, int channel, int address);
+    // 初期化に失敗したモジュール: 最初から隔離扱いにし、再試行時に再初期化させる
+    void report_init_failure(int tca_address, int channel, int address);
+
+    // 全体復旧 (attempt_i2c_recovery) 後などに全状態を健全に戻す
+    void reset();
+    std::vector<ModuleHealthSnapshot> snapshot() const;
+
+private:
+    using clock = std::chrono::steady_clock;
+    using Key = std::tuple<int, int, int>;
+    struct Entry {
+        int consecutive_failures = 0;
+        uint64_t total_failures = 0;
+        bool quarantined = false;
+        clock::time_point retry_at{};
+    };
+
+    mutable std::mutex mtx_;
+    std::map<Key, Entry> entries_; // 失敗したことのあるものだけを持つ
+    int base_ms_;
+    int max_ms_;
+    int quarantine_after_;
+};
+
+ModuleHealthTable& module_health();
@@ -0,0 +1,27 @@
+// src/module_ram.h
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+class RoutingTable;
+
+// grid（1バイト = 1桁, bit s = セグメント s）→ HT16K33 の表示RAM への変換
+// RAM はセグメントごとに2バイト（桁0-7 / 桁8-15）で、1ビットが1桁。
+// つまり「8桁 x 8セグメント」のビット行列を転置したものなので、8桁を uint64_t にまとめて
+// 64bit の SWAR 転置（3段のビット交換）で一度に並べ替える（桁 x セグメントの2重ループと分岐をなくす）。
+constexpr int MODULE_RAM_BYTES = 16;
+
+// digits[物理桁]（digit_count 桁、最大16桁）を1モジュール分の RAM にする
+void encode_module_ram(const uint8_t* digits, int digit_count, uint8_t ram[MODULE_RAM_BYTES]);
+
+// 経路表の全モジュールの RAM を grid から1回で作る
+// out はモジュール順に MODULE_RAM_BYTES ずつ連続した module_count() * 16 バイト（そのまま送れる並び）
+// よく使う形（4x4 / 8x2、列の反転あり・なし。RoutingShape）のモジュールは、経路表を作るときに選んだ
+// 専用の変換で grid の行をまとめて読む。それ以外は cell[] を1桁ずつ引く
+void encode_panel_ram(const RoutingTable& routing, const uint8_t* grid, size_t grid_size, uint8_t* out);
+// 全モジュールを cell[] を引く汎用の変換で作る（専用の変換と結果が同じかの確認用）
+void encode_panel_ram_generic(const RoutingTable& routing, const uint8_t* grid, size_t grid_size, uint8_t* out);
+
+// 1ビットずつ並べ替える従来のループ（ベンチマークと検証用）
+void encode_module_ram_reference(const uint8_t* digits, int digit_count, uint8_t ram[MODULE_RAM_BYTES]);
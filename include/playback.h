@@ -7,6 +7,8 @@
 #include <atomic>
 #include "common.h"
 
+namespace cv { class Mat; }
+
 extern std::atomic<bool>* g_current_stop_flag;
 
 // スケーリングモード
@@ -16,6 +18,15 @@ enum class ScalingMode {
     FIT      // アスペクト比を維持して全体を表示（余白可能）
 };
 
+// フレームをスケーリングモードに従って表示領域へ合わせ、グレースケールの画像を gray_frame に返す
+void prepare_gray_frame(const cv::Mat& frame, const DisplayConfig& config, ScalingMode scaling_mode,
+                        cv::Mat& gray_frame, bool debug = false, const char* debug_tag = "");
+
+// フレームをスケーリングモードに従って表示領域へ合わせ、2値化した画像を bw_frame に返す
+// debug_tag はデバッグ出力のタグ末尾（"-emu" など）
+void prepare_bw_frame(const cv::Mat& frame, const DisplayConfig& config, ScalingMode scaling_mode,
+                      int min_threshold, int max_threshold, cv::Mat& bw_frame, bool debug = false, const char* debug_tag = "");
+
 // 既存のファイル再生エンジン
 int play_video_stream(const std::string& video_path, const DisplayConfig& config, std::atomic<bool>& stop_flag, 
                      ScalingMode scaling_mode = ScalingMode::CROP, int min_threshold = 64, int max_threshold = 255, bool debug = false);
@@ -0,0 +1,113 @@
+// src/routing_table.h
+#pragma once
+
+#include "config.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+// 表示構成をコンパイルした「経路表」
+// grid (total_width x total_height) のどのセルを、どのバス / TCA チャンネル / モジュールの
+// 何桁目に送るかを起動時に1回だけ計算しておき、毎フレームはこの表を引くだけにする。
+//
+// ファイル形式（ネイティブエンディアン。同じマシンで作って同じマシンで読む前提）:
+//   [RoutingFileHeader][int32 x layout_words][RoutingGroup x group_count][RoutingModule x module_count]
+// 構造体と double (IEEE 754) をそのまま書くので、別のマシンで作ったファイルは読めない。
+// ヘッダの magic / version / byte_order / abi のどれかが違えば、古いキャッシュと同じく捨てて作り直す。
+// layout 節は DisplayConfig そのもの（バス / チャンネル / 上書き設定）で、キャッシュから読んだときに
+// JSON を解析せずに DisplayConfig を復元するために使う。
+constexpr uint32_t ROUTING_MAGIC = 0x54523753;  // "S7RT"
+constexpr uint32_t ROUTING_VERSION = 4;         // 形式や配置の計算を変えたら上げる（古いキャッシュを捨てさせる）
+constexpr uint32_t ROUTING_BYTE_ORDER = 0x01020304; // 書いたマシンのバイト順のまま入る（逆順なら別のエンディアン）
+constexpr uint16_t ROUTING_NO_CELL = 0xFFFF;    // この桁には何も割り当てられていない（消灯）
+constexpr int ROUTING_MAX_DIGITS = 16;          // HT16K33 1個あたりの桁数
+
+struct RoutingFileHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t source_checksum;   // config.json の内容 + 構成名（古いキャッシュの検出用）
+    uint64_t payload_checksum;  // ヘッダ以降のバイト列（破損の検出用）
+    uint32_t total_width;
+    uint32_t total_height;
+    uint32_t layout_words;
+    uint32_t group_count;
+    uint32_t module_count;
+    uint32_t byte_order;        // ROUTING_BYTE_ORDER
+    uint32_t abi;               // routing_abi()（構造体の大きさと double の形式。別の ABI で作ったファイルを弾く）
+    uint32_t reserved;
+};
+
+// 1回のチャンネル選択で書き込むモジュールのまとまり（書き込み順に並ぶ）
+struct RoutingGroup {
+    int16_t bus;
+    int16_t tca_address;    // -1 は直結
+    int16_t channel;
+    uint16_t first_module;  // modules の先頭インデックス
+    uint16_t module_count;
+    uint16_t reserved;
+};
+
+// モジュールの桁の並び。経路表を作るときに cell[] から判定しておき、encode_panel_ram が専用の変換を選ぶ
+// （grid 上で行ごとに桁が連続していれば、1行を1回で読める）
+enum RoutingShape : uint8_t {
+    ROUTING_SHAPE_GENERIC = 0,        // cell[] を1桁ずつ引く（module_index_map、大きさの違うモジュールなど）
+    ROUTING_SHAPE_4X4 = 1,            // 4桁 x 4行、物理桁 = 行 * 4 + 列
+    ROUTING_SHAPE_4X4_REVERSED = 2,   // 4桁 x 4行、物理桁 = 行 * 4 + (3 - 列)（module_column_reverse）
+    ROUTING_SHAPE_8X2 = 3,            // 8桁 x 2行、物理桁 = 行 * 8 + 列
+    ROUTING_SHAPE_8X2_REVERSED = 4,   // 8桁 x 2行、物理桁 = 行 * 8 + (7 - 列)
+};
+
+struct RoutingModule {
+    uint8_t address;
+    uint8_t digit_count;                  // width * height
+    uint8_t shape;                        // RoutingShape
+    uint8_t reserved;
+    uint16_t cell[ROUTING_MAX_DIGITS];    // cell[物理桁] = grid のインデックス (ROUTING_NO_CELL は消灯)
+};
+
+class RoutingTable {
+public:
+    RoutingTable() = default;
+    ~RoutingTable();
+    RoutingTable(const RoutingTable&) = delete;
+    RoutingTable& operator=(const RoutingTable&) = delete;
+
+    // DisplayConfig を検証して経路表を作る。問題があれば errors に1件ずつ入れて false
+    // warnings は動作はするが疑わしいもの（どのモジュールにも割り当てられていないセルなど）
+    static std::shared_ptr<RoutingTable> compile(const DisplayConfig& config, uint64_t source_checksum,
+                                                 std::vector<std::string>& errors,
+                                                 std::vector<std::string>& warnings);
+
+    // キャッシュファイルを mmap する。形式違い・チェックサム不一致（古い / 壊れている）なら nullptr
+    static std::shared_ptr<RoutingTable> map_file(const std::string& path, uint64_t source_checksum);
+
+    // 一時ファイルに書いてから rename する（読み手が書きかけを見ないように）
+    bool save(const std::string& path) const;
+
+    // layout 節から DisplayConfig を復元する（routing は設定しない）
+    bool restore_config(DisplayConfig& config) const;
+
+    int total_width() const { return static_cast<int>(header()->total_width); }
+    int total_height() const { return static_cast<int>(header()->total_height); }
+    size_t group_count() const { return header()->group_count; }
+    size_t module_count() const { return header()->module_count; }
+    const RoutingGroup& group(size_t i) const { return groups_[i]; }
+    const RoutingModule& module(size_t i) const { return modules_[i]; }
+
+private:
+    const RoutingFileHeader* header() const { return reinterpret_cast<const RoutingFileHeader*>(data_); }
+    void bind(const uint8_t* data);
+
+    std::vector<uint8_t> owned_;    // compile() で作った場合のファイルイメージ
+    void* mapping_ = nullptr;       // map_file() の場合の mmap 領域
+    size_t mapping_size_ = 0;
+    const uint8_t* data_ = nullptr;
+    const int32_t* layout_ = nullptr;
+    const RoutingGroup* groups_ = nullptr;
+    const RoutingModule* modules_ = nullptr;
+};
+
+// FNV-1a 64bit
+uint64_t routing_checksum(const void* data, size_t size, uint64_t seed = 1469598103934665603ull);
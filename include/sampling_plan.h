@@ -0,0 +1,41 @@
+// src/sampling_plan.h
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "config.h"
+
+// 画像のどの画素を、どの桁のどのセグメントとして読むかの表
+// パネルの物理的な縦横比 (CHAR_WIDTH_MM / CHAR_HEIGHT_MM) に合わせて画像の中央を切り取り、1桁を 5x5 に分けた
+// 位置（SEG_MAP）を読む。位置は画像の大きさとパネルの大きさだけで決まるので、フレームごとに座標を計算せず、
+// 画素のバイト位置 offset[桁 * 8 + セグメント] を一度だけ作る（画像の外は kNone）。
+// 画素の並びは pixel_step（隣の画素までのバイト数）と stride（次の行までのバイト数）で表すので、
+// cv::Mat のグレースケール画像 (1, step) も、V4L2 のバッファの Y 面（YUYV は 2、NV12 は 1）もコピーせずに読める。
+// OpenCV に依存しない（frame_to_grid / frame_to_levels と v4l2_capture.h が使う）。
+class SamplingPlan {
+public:
+    static constexpr uint32_t kNone = 0xFFFFFFFFu;
+
+    // 画像とパネルの大きさが前と同じなら何もしない（作り直したら true）
+    bool prepare(const DisplayConfig& config, int width, int height, int pixel_step, size_t stride);
+
+    // 128 を超える画素を点灯として grid（桁ごとのセグメント, bit0=a ... bit7=dp）を作る
+    void sample_grid(const uint8_t* pixels, std::vector<uint8_t>& grid, uint8_t threshold = 128) const;
+    // min_threshold 以下を 0、max_threshold 以上を 15 とした明るさ levels[桁 * 8 + セグメント]（seg_dither.h）
+    void sample_levels(const uint8_t* pixels, int min_threshold, int max_threshold, std::vector<uint8_t>& levels) const;
+
+    size_t digits() const { return offsets_.size() / 8; }
+
+private:
+    int width_ = 0;
+    int height_ = 0;
+    int pixel_step_ = 0;
+    size_t stride_ = 0;
+    int panel_width_ = 0;
+    int panel_height_ = 0;
+    double char_width_mm_ = 0;
+    double char_height_mm_ = 0;
+    std::vector<uint32_t> offsets_;
+};
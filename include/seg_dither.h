@@ -0,0 +1,30 @@
+// src/seg_dither.h
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+// 時間方向のディザ（擬似階調）
+// セグメントごとに 0-15 の明るさ（levels[桁 * 8 + セグメント]、bit0=a ... bit7=dp と同じ順）を持ち、
+// next() を呼ぶたびに2値の grid（サブフレーム）を1枚作る。1次のシグマデルタで、セグメントごとに
+//   acc += level; acc >= 15 なら点灯して acc -= 15
+// とするので、15 サブフレームあたりちょうど level 回点灯する。残りの誤差は次のサブフレーム・次の映像フレームへ
+// 持ち越す（サブフレーム数が15で割り切れなくても、長い目で見た明るさは level / 15 になる）。
+// 同じ明るさのセグメントが一斉に点滅しないよう、誤差の初期値はセグメントごとにずらす。
+// OpenCV に依存しない（明るさを作る frame_to_levels は video.h）。
+class TemporalDither {
+public:
+    static constexpr int kMaxLevel = 15;
+
+    // 映像フレームが変わったら呼ぶ（桁数が変われば誤差を初期化する）
+    void set_levels(const std::vector<uint8_t>& levels);
+    // 次のサブフレーム
+    void next(std::vector<uint8_t>& grid);
+
+private:
+    std::vector<uint8_t> levels_;
+    std::vector<uint8_t> acc_;
+};
+
+// SEG_GRAY_SUBFRAMES: 1映像フレームあたりのサブフレーム数の上限（0 / 未設定なら従来の2値化）
+int gray_subframes_from_env();
@@ -0,0 +1,59 @@
+// src/seg_text.h
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "config.h"
+
+// 7セグメント用の文字描画（テキスト・時計・カウントダウン・テロップ）
+// 文字を grid の1桁（bit0=a ... bit6=g, bit7=dp）に直接変換するので、映像を経由しない。
+//   - ASCII（英字は7セグで読める形に近づけたもの）、全角英数字、一部のカタカナの近似
+//   - '.' ',' ':' '。' '、' '・' は直前の桁の dp にまとめる（直前が空か dp 付きなら dp だけの桁にする）
+//   - テロップは半桁ずつ流せる（右半分の縦線を左へ、次の文字の左半分の縦線を右へ移す変換表を起動時に作る）
+// OpenCV に依存しないので、プレイヤー・7seg-displayd・7seg-text のどこからでも使える。
+
+enum class SegAlign {
+    LEFT,
+    CENTER,
+    RIGHT,
+};
+
+// 1文字分のセグメント（知らない文字は 0）
+uint8_t seg_glyph(char32_t ch);
+
+// UTF-8 の文字列を桁の列にする（dp をまとめた後の桁数が表示幅）
+std::vector<uint8_t> seg_encode(const std::string& utf8);
+
+// cells を grid（panel_width x panel_height）の y 行目、x 桁目からの width 桁に書く
+// 余った桁は消し、はみ出した分は切り捨てる（RIGHT なら左側を切り捨てる）
+void seg_draw(std::vector<uint8_t>& grid, int panel_width, int panel_height, int x, int y, int width,
+              const std::vector<uint8_t>& cells, SegAlign align = SegAlign::LEFT);
+
+// パネルの row 行目全体に文字列を書く
+void seg_draw_text(std::vector<uint8_t>& grid, const DisplayConfig& cfg, int row, const std::string& utf8,
+                   SegAlign align = SegAlign::LEFT);
+
+// 右から左へ流れるテロップ。位置は経過時間だけで決まる（フレームの遅れが積み重ならない）
+class SegTicker {
+public:
+    // digits_per_second: 1秒に流れる桁数。gap: 末尾と先頭の間の空白桁数（負なら表示幅と同じ）
+    SegTicker(const std::string& utf8, double digits_per_second, int gap = -1);
+
+    // 半桁単位の位置。経過時間 elapsed_ns から決まる
+    int64_t step_at(uint64_t elapsed_ns) const;
+    // 1周分の半桁数（表示幅 width のとき）
+    int64_t period_steps(int width) const;
+    // step の位置の width 桁を out に書く
+    void render(int64_t step, uint8_t* out, int width) const;
+    void render_at(uint64_t elapsed_ns, std::vector<uint8_t>& grid, int panel_width, int panel_height, int x, int y,
+                   int width) const;
+
+    bool empty() const { return cells_.empty(); }
+
+private:
+    std::vector<uint8_t> cells_;
+    double steps_per_second_;
+    int gap_;
+};
@@ -0,0 +1,42 @@
+// src/trace.h
+#pragma once
+
+#include <cstdint>
+
+// Chrome / Perfetto の trace_event JSON を書き出すオプトインのトレーサ
+//   SEG_TRACE=/tmp/7seg-trace.json ./bin/.../7seg-net-player ...
+// 終了時に chrome://tracing や ui.perfetto.dev で開ける JSON を書き出す。
+// イベントはスレッドごとのリングバッファに溜め、古いものから上書きする
+// （1スレッドあたりの件数は SEG_TRACE_EVENTS、既定 65536。バッファは記録した分だけ確保する）。
+// 時刻は CLOCK_MONOTONIC (steady_clock)。SEG_TRACE 未設定時は Scope の生成・破棄だけで何もしない。
+namespace trace {
+
+// SEG_TRACE が設定されていれば true（初回呼び出し時に環境変数を読む）
+bool enabled();
+
+// 呼び出し元スレッドの表示名（Perfetto のトラック名になる）。同じ名前での再呼び出しは安価
+void set_thread_name(const char* name);
+
+// 溜まっているイベントを SEG_TRACE のファイルへ書き出す（終了時にも自動で呼ばれる）
+void flush();
+
+// 生成から破棄までを1つの完了イベント ("ph":"X") として記録する
+// name / arg 名は文字列リテラルなど、プロセス終了まで生きている文字列を渡すこと
+class Scope {
+public:
+    explicit Scope(const char* name, const char* arg0_name = nullptr, int64_t arg0 = 0,
+                   const char* arg1_name = nullptr, int64_t arg1 = 0);
+    ~Scope();
+    Scope(const Scope&) = delete;
+    Scope& operator=(const Scope&) = delete;
+
+private:
+    const char* name_;
+    const char* arg0_name_;
+    const char* arg1_name_;
+    int64_t arg0_;
+    int64_t arg1_;
+    uint64_t start_ns_;
+};
+
+} // namespace trace
@@ -0,0 +1,66 @@
+// src/v4l2_capture.h
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// V4L2 のカメラから、mmap したバッファの Y 面をそのまま読む（7seg-camera-player）
+// RTP で送り直すとエンコード・ジッタバッファ・デコードで数百 ms 遅れるので、同じボードにつないだカメラは
+// 直接読む。YUYV（Y は2バイトおき）か NV12 / GREY（Y 面は連続）を小さい解像度で頼み、ドライバが選んだ形式の
+// Y の並び（pixel_step / stride）を SamplingPlan に渡す。フレームはコピーもデコードもせず、読み終わったら
+// release() でドライバに返す。溜まったフレームは dequeue() が最新の1枚だけ残して返す（古いものは表示しない）。
+// 単一平面 (VIDEO_CAPTURE) と多平面 (VIDEO_CAPTURE_MPLANE、Y は平面 0) の両方に対応する。
+// vivid（仮想カメラ: modprobe vivid）で試せる。macOS では open() が常に失敗する。
+class V4L2Capture {
+public:
+    struct Frame {
+        const uint8_t* luma = nullptr;   // Y の先頭
+        int width = 0;
+        int height = 0;
+        int pixel_step = 1;              // 隣の画素までのバイト数（YUYV は 2）
+        size_t stride = 0;               // 次の行までのバイト数
+        uint32_t sequence = 0;           // ドライバのフレーム番号（飛んだ数で取りこぼしが分かる）
+        std::chrono::steady_clock::time_point captured_at{};  // ドライバの時刻（CLOCK_MONOTONIC）
+        int index = -1;                  // release() に渡すバッファ番号
+    };
+
+    V4L2Capture() = default;
+    ~V4L2Capture();
+    V4L2Capture(const V4L2Capture&) = delete;
+    V4L2Capture& operator=(const V4L2Capture&) = delete;
+
+    // width x height / fps は希望（ドライバが近いものを選ぶ）。失敗したら理由を出して false
+    bool open(const std::string& device, int width, int height, int fps);
+    void close();
+    bool is_open() const { return fd_ >= 0; }
+
+    // 次のフレームを待つ（timeout_ms で諦めたら false）。溜まっていれば最新の1枚を返し、飛ばした数を dropped に足す
+    bool dequeue(Frame& frame, int timeout_ms, uint64_t& dropped);
+    // dequeue したフレームを読み終えたら返す
+    void release(const Frame& frame);
+
+    int width() const { return width_; }
+    int height() const { return height_; }
+    const std::string& format_name() const { return format_name_; }
+
+private:
+    struct Buffer {
+        void* start = nullptr;
+        size_t length = 0;
+    };
+    bool dequeue_one(Frame& frame);
+    bool queue(int index);
+
+    int fd_ = -1;
+    bool mplane_ = false;
+    bool streaming_ = false;
+    int width_ = 0;
+    int height_ = 0;
+    int pixel_step_ = 1;
+    size_t stride_ = 0;
+    std::string format_name_;
+    std::vector<Buffer> buffers_;
+};
@@ -7,6 +7,10 @@
 #include <vector>   // std::vector のためにインクルード
 
 void frame_to_grid(const cv::Mat& bw, const DisplayConfig& config, std::vector<uint8_t>& grid);
+// 2値化の代わりに、frame_to_grid と同じ位置のグレースケール値をセグメントごとの明るさ 0-15 にする
+// levels[桁 * 8 + セグメント]（seg_dither.h の TemporalDither に渡す）
+void frame_to_levels(const cv::Mat& gray, const DisplayConfig& config, int min_threshold, int max_threshold,
+                     std::vector<uint8_t>& levels);
 void video_thread(int& i2c_fd, const DisplayConfig& config, std::atomic<bool>& stop_flag);
 
 #endif // VIDEO_H
\ No newline at end of file
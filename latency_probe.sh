@@ -0,0 +1,68 @@
+#!/usr/bin/env bash
+set -euo pipefail
+
+# 送り手から表示までの遅れを測るための送出（7seg-latency-source の時刻のパターンを H.264 で送る）
+# 受け手は SEG_LATENCY_PROBE=1 で 7seg-net-player / 7seg-rtp-player を動かす（[probe] の行とメトリクスに出る）
+# 時刻は CLOCK_MONOTONIC なので、送り手と受け手は同じボードで動かす
+# Usage: ./latency_probe.sh MODE [HOST] [PORT] [WIDTHxHEIGHT] [FPS]
+#   MODE          : ts / flv / flv_srv / rtp（受け手のモードと同じ。flv と flv_srv は送り方が同じ）
+#   HOST          : 受信先IP（デフォルト 127.0.0.1）
+#   PORT          : ポート（デフォルト 5004。rtp では映像のポート）
+#   WIDTHxHEIGHT  : 映像の大きさ（デフォルト 320x240）
+#   FPS           : フレームレート（デフォルト 30）
+
+if [[ $# -lt 1 ]]; then
+  echo "Usage: $0 MODE [HOST] [PORT] [WIDTHxHEIGHT] [FPS]" >&2
+  exit 1
+fi
+
+MODE="$1"
+HOST="${2:-127.0.0.1}"
+PORT="${3:-5004}"
+SIZE="${4:-320x240}"
+FPS="${5:-30}"
+WIDTH="${SIZE%x*}"
+HEIGHT="${SIZE#*x}"
+
+SOURCE="${SOURCE:-}"
+if [[ -z "${SOURCE}" ]]; then
+  SOURCE="$(ls bin/*/7seg-latency-source 2>/dev/null | head -n 1 || true)"
+fi
+if [[ -z "${SOURCE}" || ! -x "${SOURCE}" ]]; then
+  echo "7seg-latency-source not found (run: make probe, or set SOURCE=...)" >&2
+  exit 1
+fi
+
+# エンコーダは遅れを足さない設定（B フレームなし、先読みなし、毎秒キーフレーム）
+VSRC="fdsrc fd=0 do-timestamp=true ! rawvideoparse format=gray8 width=${WIDTH} height=${HEIGHT} framerate=${FPS}/1 \
+  ! videoconvert ! video/x-raw,format=I420 \
+  ! x264enc tune=zerolatency speed-preset=ultrafast bframes=0 key-int-max=${FPS} bitrate=500 \
+  ! h264parse config-interval=1"
+# TS / FLV は音声があるものとして待つ受け手があるので、無音の AAC を付ける
+ASRC="audiotestsrc wave=silence is-live=true ! audioconvert ! audio/x-raw,rate=48000,channels=2 ! avenc_aac ! aacparse"
+
+echo "latency probe ${MODE} -> ${HOST}:${PORT} (${WIDTH}x${HEIGHT} @ ${FPS} fps)"
+
+case "${MODE}" in
+  ts)
+    # shellcheck disable=SC2086
+    "${SOURCE}" --size "${SIZE}" --fps "${FPS}" | gst-launch-1.0 -e \
+      ${VSRC} ! queue ! mpegtsmux name=mux alignment=7 ! udpsink host="${HOST}" port="${PORT}" sync=false \
+      ${ASRC} ! queue ! mux.
+    ;;
+  flv|flv_srv)
+    # shellcheck disable=SC2086
+    "${SOURCE}" --size "${SIZE}" --fps "${FPS}" | gst-launch-1.0 -e \
+      ${VSRC} ! queue ! flvmux name=mux streamable=true ! tcpclientsink host="${HOST}" port="${PORT}" sync=false \
+      ${ASRC} ! queue ! mux.
+    ;;
+  rtp)
+    # shellcheck disable=SC2086
+    "${SOURCE}" --size "${SIZE}" --fps "${FPS}" | gst-launch-1.0 -e \
+      ${VSRC} ! rtph264pay pt=96 config-interval=1 ! udpsink host="${HOST}" port="${PORT}" sync=false
+    ;;
+  *)
+    echo "unknown mode: ${MODE} (ts / flv / flv_srv / rtp)" >&2
+    exit 1
+    ;;
+esac
@@ -7,7 +7,10 @@ Reads config.json and runs a 7-segment lighting sequence:
  2) Then, for each digit, turn all segments on for 0.5s while others off
  3) Repeat forever
 
-Usage: python led_sequencer.py [--layout LAYOUT] [--delay 0.5]
+Usage: python led_sequencer.py [--layout LAYOUT] [--delay 0.5] [--mode print|i2c|shm]
+
+--mode shm sends each grid to 7seg-displayd through its shared-memory grid ring
+(grid_ring.py) instead of driving I2C; the panel size comes from the daemon.
 """
 from __future__ import annotations
 
@@ -64,7 +67,8 @@ def main() -> None:
     p = argparse.ArgumentParser(description="7-seg LED sequencer from config.json")
     p.add_argument("--layout", help="configuration name in config.json to use")
     p.add_argument("--delay", help="delay seconds between steps", type=float, default=0.5)
-    p.add_argument("--mode", choices=["print", "i2c"], default="print", help="operation mode: print (default) or i2c (write to HT16K33 devices)")
+    p.add_argument("--mode", choices=["print", "i2c", "shm"], default="print",
+                   help="operation mode: print (default), i2c (write to HT16K33 devices) or shm (send grids to 7seg-displayd)")
     p.add_argument("--debug", action="store_true", help="print per-module display buffers before I2C write")
     args = p.parse_args()
 
@@ -76,6 +80,13 @@ def main() -> None:
 
     cfg = load_config(config_path)
     layout = choose_layout(cfg, args.layout)
+    ring = None
+    if args.mode == "shm":
+        # I2C とモジュールの初期化は 7seg-displayd が行う。桁数はデーモンの構成に合わせる
+        from grid_ring import GridRing
+        ring = GridRing()
+        layout = dict(layout, total_width=ring.width, total_height=ring.height,
+                      name=f"7seg-displayd grid ring {ring.width}x{ring.height}")
     digits = build_digits_list(layout)
 
     delay = float(args.delay)
@@ -111,8 +122,11 @@ def main() -> None:
                         # build full-grid where only this digit has the seg_bit set
                         grid = [0] * len(digits)
                         grid[idx] = seg_bit
-                        ok = apply_grid_to_modules(bus, layout, grid, error_on_fail=False)
-                        print(f"{ts} - Digit #{idx} SEG {seg} -> i2c grid write seg=0x{seg_bit:02X} ok={ok}")
+                        if ring is not None:
+                            ok = ring.submit(grid)
+                        else:
+                            ok = apply_grid_to_modules(bus, layout, grid, error_on_fail=False)
+                        print(f"{ts} - Digit #{idx} SEG {seg} -> {mode} grid write seg=0x{seg_bit:02X} ok={ok}")
                     time.sleep(delay)
 
             # Phase 2: one digit at a time all segments ON (others OFF)
@@ -124,8 +138,11 @@ def main() -> None:
                     # a..g + dp bits = 0xFF
                     grid = [0] * len(digits)
                     grid[idx] = 0xFF
-                    ok = apply_grid_to_modules(bus, layout, grid, error_on_fail=False)
-                    print(f"{ts} - Digit #{idx} ALL SEGMENTS ON -> i2c grid write ok={ok}")
+                    if ring is not None:
+                        ok = ring.submit(grid)
+                    else:
+                        ok = apply_grid_to_modules(bus, layout, grid, error_on_fail=False)
+                    print(f"{ts} - Digit #{idx} ALL SEGMENTS ON -> {mode} grid write ok={ok}")
                 time.sleep(delay)
 
     except KeyboardInterrupt:
@@ -133,6 +150,8 @@ def main() -> None:
     finally:
         if mode == "i2c" and 'bus' in locals():
             bus.close()
+        if ring is not None:
+            ring.close()
 
 
 # `main()` をファイル末尾で呼び出します（helper 関数定義の後）
@@ -1,4 +1,6 @@
 #include "audio.h"
+#include "metrics.h"
+#include "trace.h"
 #ifdef __APPLE__
 #include <iostream>
 #include <vector>
@@ -106,6 +108,7 @@ bool audio_init(int samplerate, int channels) {
 }
 
 void audio_queue(const char* data, size_t len) {
+    trace::Scope trace_scope("audio_queue", "bytes", static_cast<int64_t>(len));
 #ifdef __APPLE__
     // Macではオーディオを無効化
     (void)data;
@@ -158,6 +161,7 @@ void audio_queue(const char* data, size_t len) {
                 std::cerr << "SDL_QueueAudio error: " << SDL_GetError() << std::endl;
             }
         }
+        metrics::audio_queue_bytes().set(SDL_GetQueuedAudioSize(dev));
     }
 #endif
 }
@@ -0,0 +1,160 @@
+// src/camera_player.cpp
+// 7seg-camera-player: 同じボードにつないだ V4L2 カメラを直接パネルに出す
+//   ./7seg-camera-player /dev/video0 48x8 --threshold 96 255
+// RTP（send_rtp_cam_*.sh → 7seg-rtp-player）を通さず、mmap したバッファの Y 面をサンプリング位置の表
+// (sampling_plan.h) で直接読むので、エンコード・ジッタバッファ・デコードの遅れがない。
+// フレームはカメラの周期で届いたらすぐ書く（FrameScheduler の締め切りは使わない）。書き込みが追いつかなければ
+// 溜まったフレームは最新の1枚だけ残して捨てる。
+// 環境変数:
+//   SEG_CAMERA_SIZE   頼む解像度（既定 320x240。ドライバが近いものを選ぶ）
+//   SEG_CAMERA_FPS    頼むフレームレート（既定 30）
+//   SEG_LOCAL_DIMMING 1 ならモジュールごとの輝度を映像の明るさに合わせる（local_dimming.h）
+#include "common.h"
+#include "led.h"
+#include "main_common.hpp"
+#include "metrics.h"
+#include "live_config.h"
+#include "display_client.h"
+#include "frame_scheduler.h"
+#include "local_dimming.h"
+#include "sampling_plan.h"
+#include "v4l2_capture.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <unistd.h>
+
+int main(int argc, char* argv[]) {
+    const std::string usage =
+        "Usage: " + std::string(argv[0]) + " <device> [config_name] [options]\n"
+        "  device: V4L2 capture device (e.g. /dev/video0; vivid works for testing)\n"
+        "  config_name: 24x4 (default), 12x8, etc. from config.json\n"
+        "  options:\n"
+        "    --threshold min max, -t min max: Set binarization threshold (default: 64 255)\n"
+        "    --debug, -d: Print capture-to-display latency on exit\n"
+        "  The picture is always cropped to the panel's aspect ratio.";
+
+    return common_main_runner(usage, argc, argv,
+        [](const std::string& device, const DisplayConfig& config, ScalingMode scaling_mode, int min_threshold, int max_threshold, bool debug, bool loop) {
+            (void)loop;
+            // カメラの画像は拡大縮小せず、パネルの縦横比で中央を切り取って読む（CROP と同じ）
+            (void)scaling_mode;
+
+            int width = 320, height = 240, fps = 30;
+            if (const char* v = std::getenv("SEG_CAMERA_SIZE")) {
+                if (std::sscanf(v, "%dx%d", &width, &height) != 2) {
+                    std::cerr << "[camera] SEG_CAMERA_SIZE must look like 320x240 (got " << v << ")" << std::endl;
+                    width = 320;
+                    height = 240;
+                }
+            }
+            if (const char* v = std::getenv("SEG_CAMERA_FPS")) fps = std::max(1, std::atoi(v));
+
+            V4L2Capture camera;
+            if (!camera.open(device, width, height, fps)) return;
+
+            std::shared_ptr<const LiveSettings> live = live_settings_or(config, ScalingMode::CROP, min_threshold, max_threshold);
+            // 7seg-displayd に送る場合（SEG_DISPLAYD_PRIORITY）は I2C を開かない
+            DisplayClient* output = displayd_output();
+            int i2c_fd = -1;
+            if (!output) {
+                i2c_fd = open_i2c_auto(*live->display);
+                if (i2c_fd < 0) {
+                    std::cerr << "I2C communication failed: No I2C devices found or access denied." << std::endl;
+                    return;
+                }
+                if (!initialize_displays(i2c_fd, *live->display)) {
+                    std::cerr << "Failed to initialize display modules." << std::endl;
+                    close(i2c_fd);
+                    return;
+                }
+            }
+
+            const bool dimming = local_dimming_from_env() && !output;
+            LocalDimming local_dimming;
+            SamplingPlan plan;
+            std::vector<uint8_t> grid;
+            std::vector<uint8_t> levels;
+            set_output_thread_realtime_from_env("camera");
+
+            uint64_t shown = 0;
+            uint64_t latency_sum_us = 0;
+            uint64_t latency_max_us = 0;
+            bool has_sequence = false;
+            uint32_t last_sequence = 0;
+            while (!g_should_exit) {
+                V4L2Capture::Frame frame;
+                uint64_t dropped = 0;
+                if (!camera.dequeue(frame, 1000, dropped)) {
+                    if (!g_should_exit) std::cerr << "[camera] no frame from " << device << " for 1 s" << std::endl;
+                    continue;
+                }
+                // 書き込み中にドライバの中で上書きされたフレームは sequence が飛ぶ
+                if (has_sequence && frame.sequence > last_sequence + 1) {
+                    dropped = std::max<uint64_t>(dropped, frame.sequence - last_sequence - 1);
+                }
+                metrics::frames_dropped().inc(dropped);
+                has_sequence = true;
+                last_sequence = frame.sequence;
+
+                if (auto next = live_config().current(); next && next != live) {
+                    if (!output && next->display != live->display) apply_layout_change(i2c_fd, *live->display, *next->display);
+                    live = std::move(next);
+                }
+                const DisplayConfig& cfg = *live->display;
+                {
+                    // Y 面をそのまま読み、読み終えたらすぐバッファをドライバに返す
+                    metrics::ScopedTimer timer(metrics::frame_to_grid_latency());
+                    if (plan.prepare(cfg, frame.width, frame.height, frame.pixel_step, frame.stride) && debug) {
+                        std::cerr << "[camera] sampling plan for " << frame.width << "x" << frame.height << " -> "
+                                  << cfg.total_width << "x" << cfg.total_height << std::endl;
+                    }
+                    // 他のプレイヤーの2値化 (THRESH_BINARY) と同じく min_threshold を超えたら点灯
+                    plan.sample_grid(frame.luma, grid, static_cast<uint8_t>(std::max(0, std::min(255, live->min_threshold))));
+                    if (dimming) plan.sample_levels(frame.luma, live->min_threshold, live->max_threshold, levels);
+                    camera.release(frame);
+                }
+                if (dimming && cfg.routing) local_dimming.update(*cfg.routing, levels, false);
+
+                bool ok;
+                if (output) {
+                    ok = output->submit_grid(grid, cfg.total_width, cfg.total_height);
+                } else {
+                    I2CErrorInfo error_info;
+                    ok = update_flexible_display(i2c_fd, cfg, grid, local_dimming.brightness(), error_info);
+                    if (!ok && !attempt_i2c_recovery(i2c_fd, cfg)) {
+                        // 全ての復旧に失敗した場合、長めに待つ
+                        std::cerr << "Recovery failed in camera player. Pausing before next attempt..." << std::endl;
+                        sleep(2);
+                    }
+                }
+                if (!ok) continue;
+                metrics::frames_displayed().inc();
+                const auto latency = std::chrono::duration_cast<std::chrono::microseconds>(
+                    std::chrono::steady_clock::now() - frame.captured_at).count();
+                const uint64_t latency_us = latency > 0 ? static_cast<uint64_t>(latency) : 0;
+                metrics::capture_to_display_latency().observe_us(latency_us);
+                ++shown;
+                latency_sum_us += latency_us;
+                latency_max_us = std::max(latency_max_us, latency_us);
+            }
+
+            if (debug && shown > 0) {
+                std::cerr << "[camera] frames " << shown << ", dropped " << metrics::frames_dropped().value()
+                          << ", capture-to-display mean " << latency_sum_us / shown / 1000.0 << " ms / max "
+                          << latency_max_us / 1000.0 << " ms" << std::endl;
+            }
+            camera.close();
+            if (output) {
+                // パネルはデーモンのもの。消灯せずに表示を手放す
+                output->release();
+            } else {
+                close(i2c_fd);
+                if (!clear_all_displays(*live->display)) std::cerr << "Warning: failed to clear displays on exit." << std::endl;
+            }
+        }
+    );
+}
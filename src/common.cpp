@@ -1,5 +1,7 @@
 #include "common.h"
 #include "led.h"      // initialize_displays, reset_i2c_channel_cache のために必要
+#include "trace.h"
+#include "module_health.h"
 #include <iostream>
 #include <unistd.h>   // close, usleep, sleep
 #include <fcntl.h>    // open, O_RDWR
@@ -13,6 +15,8 @@ std::deque<std::vector<char>> audio_buf;
 std::mutex frame_mtx;
 std::vector<uint8_t> latest_frame;
 std::atomic<int> last_pts_ms(0);
+uint64_t latest_frame_seq = 0;
+std::chrono::steady_clock::time_point latest_frame_received_at;
 double start_time = 0.0;
 int audio_bytes_received = 0;
 
@@ -20,14 +24,14 @@ int audio_bytes_received = 0;
 //const std::vector<int> MODULE_ADDRESSES = {0x70, 0x71, 0x72, 0x73, 0x74, 0x75};
 
 std::atomic<bool> g_should_exit(false);
-
-double CHAR_WIDTH_MM = 12.7;
-double CHAR_HEIGHT_MM = 19.2;
+std::atomic<bool> g_reload_requested(false);
 
 // シグナルハンドラ関数
 void signal_handler(int signal) {
     if (signal == SIGINT || signal == SIGTERM) {
         g_should_exit = true;
+    } else if (signal == SIGHUP) {
+        g_reload_requested = true;
     }
 }
 
@@ -39,9 +43,47 @@ void setup_signal_handlers() {
     sa.sa_flags = 0;
     sigaction(SIGINT, &sa, NULL);
     sigaction(SIGTERM, &sa, NULL);
+    sigaction(SIGHUP, &sa, NULL);
+}
+
+std::map<std::tuple<int, int, int, int>, int> g_error_counts;
+std::mutex g_error_counts_mtx;
+
+void record_i2c_error(int bus, int tca_address, int channel, int address) {
+    std::lock_guard<std::mutex> lock(g_error_counts_mtx);
+    g_error_counts[{bus, tca_address, channel, address}]++;
+}
+
+void print_i2c_error_summary() {
+    std::cout << "\n--- I2C Error Analysis ---" << std::endl;
+    std::unique_lock<std::mutex> lock(g_error_counts_mtx, std::try_to_lock);
+    if (!lock.owns_lock()) {
+        std::cout << "(error counts are being updated)" << std::endl;
+    } else if (g_error_counts.empty()) {
+        std::cout << "No I2C errors were recorded." << std::endl;
+    } else {
+        for (const auto& [key, count] : g_error_counts) {
+            const auto [bus, tca_address, channel, address] = key;
+            std::cout << "Bus: " << bus << ", TCA: ";
+            if (tca_address >= 0) {
+                std::cout << "0x" << std::hex << tca_address << std::dec << ", Channel: " << channel;
+            } else {
+                std::cout << "direct";
+            }
+            std::cout << ", Address: ";
+            if (address >= 0) {
+                std::cout << "0x" << std::hex << address << std::dec;
+            } else {
+                std::cout << "(channel select)";
+            }
+            std::cout << "  => " << count << " errors" << std::endl;
+        }
+    }
+    std::cout << "--------------------------" << std::endl;
 }
 
 bool attempt_i2c_recovery(int& i2c_fd, const DisplayConfig& config) {
+    trace::Scope trace_scope("attempt_i2c_recovery");
     std::cerr << "I2C communication failed. Starting recovery procedure..." << std::endl;
     
     const int MAX_RECOVERY_RETRIES = 3; // 最大3回までリトライ
@@ -70,7 +112,9 @@ bool attempt_i2c_recovery(int& i2c_fd, const DisplayConfig& config) {
             continue; // 次のリトライへ
         }
 
-        // 6. 再初期化を試みる
+        // 6. 再初期化を試みる（バスが不安定だったので、状態ファイルがあっても全初期化する）
+        // 個別のバックオフ / 隔離は解除し、応答しないモジュールは初期化の中で隔離し直す
+        module_health().reset();
         if (initialize_displays(i2c_fd, config)) {
             std::cout << "[Recovery] Recovery successful!" << std::endl;
             return true; // ★成功したので true を返して終了
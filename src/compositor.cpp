@@ -0,0 +1,88 @@
+// src/compositor.cpp
+#include "compositor.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+constexpr uint64_t BYTE_LANES = 0x0101010101010101ULL;
+
+inline uint64_t load64(const uint8_t* p) {
+    uint64_t v;
+    std::memcpy(&v, p, sizeof(v)); // 境界を揃えなくてよい（コンパイラが1命令にする）
+    return v;
+}
+
+inline void store64(uint8_t* p, uint64_t v) {
+    std::memcpy(p, &v, sizeof(v));
+}
+
+// 1行分（n 桁）を重ねる。mask は桁ごとのマスク（nullptr なら全桁 seg）
+inline void blend_row(uint8_t* dst, const uint8_t* src, const uint8_t* mask, int n, GridBlend mode, uint8_t seg) {
+    const uint64_t seg64 = BYTE_LANES * seg;
+    int i = 0;
+    if (mode == GridBlend::OR) {
+        for (; i + 8 <= n; i += 8) {
+            uint64_t m = mask ? (load64(mask + i) & seg64) : seg64;
+            store64(dst + i, load64(dst + i) | (load64(src + i) & m));
+        }
+        for (; i < n; ++i) {
+            uint8_t m = mask ? (mask[i] & seg) : seg;
+            dst[i] |= src[i] & m;
+        }
+    } else {
+        for (; i + 8 <= n; i += 8) {
+            uint64_t m = mask ? (load64(mask + i) & seg64) : seg64;
+            store64(dst + i, (load64(dst + i) & ~m) | (load64(src + i) & m));
+        }
+        for (; i < n; ++i) {
+            uint8_t m = mask ? (mask[i] & seg) : seg;
+            dst[i] = static_cast<uint8_t>((dst[i] & ~m) | (src[i] & m));
+        }
+    }
+}
+
+} // namespace
+
+void blend_grid_layer(std::vector<uint8_t>& grid, int panel_width, int panel_height, const GridLayer& layer) {
+    // パネルからはみ出す部分を切り捨てる
+    const int x0 = std::max(0, layer.x);
+    const int y0 = std::max(0, layer.y);
+    const int x1 = std::min(panel_width, layer.x + layer.width);
+    const int y1 = std::min(panel_height, layer.y + layer.height);
+    if (x0 >= x1 || y0 >= y1 || layer.segment_mask == 0) return;
+    const int n = x1 - x0;
+    const bool has_mask = !layer.cell_mask.empty();
+
+    for (int y = y0; y < y1; ++y) {
+        const size_t src_off = static_cast<size_t>(y - layer.y) * layer.width + (x0 - layer.x);
+        blend_row(grid.data() + static_cast<size_t>(y) * panel_width + x0,
+                  layer.cells.data() + src_off,
+                  has_mask ? layer.cell_mask.data() + src_off : nullptr,
+                  n, layer.mode, layer.segment_mask);
+    }
+}
+
+bool GridCompositor::set_layer(const std::string& name, GridLayer layer) {
+    const size_t n = static_cast<size_t>(std::max(0, layer.width)) * std::max(0, layer.height);
+    if (layer.cells.size() != n || (!layer.cell_mask.empty() && layer.cell_mask.size() != n)) return false;
+    remove_layer(name);
+    // z の昇順を保って挿入する（同じ z なら後から来たものが上）
+    auto pos = std::upper_bound(layers_.begin(), layers_.end(), layer.z,
+                                [](int z, const Entry& e) { return z < e.layer.z; });
+    layers_.insert(pos, Entry{name, std::move(layer)});
+    return true;
+}
+
+void GridCompositor::remove_layer(const std::string& name) {
+    layers_.erase(std::remove_if(layers_.begin(), layers_.end(), [&](const Entry& e) { return e.name == name; }),
+                  layers_.end());
+}
+
+void GridCompositor::compose(const std::vector<uint8_t>& base, int panel_width, int panel_height,
+                             std::vector<uint8_t>& out) const {
+    if (&out != &base) out = base;
+    out.resize(static_cast<size_t>(panel_width) * panel_height, 0);
+    for (const auto& e : layers_) blend_grid_layer(out, panel_width, panel_height, e.layer);
+}
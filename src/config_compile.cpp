@@ -0,0 +1,71 @@
+// src/config_compile.cpp
+// config.json のレイアウトを検証し、経路表キャッシュを作り直すツール
+//   ./7seg-config-compile                 全構成を検証してキャッシュを作る
+//   ./7seg-config-compile 24x16 48x8      指定した構成だけ
+//   ./7seg-config-compile --config path/to/config.json --check   検証のみ（キャッシュを書かない）
+// 1つでも不正な構成があれば終了コード 1（CI やデプロイ前のチェック用）
+#include "config_loader.hpp"
+#include "routing_table.h"
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+static void print_usage(const char* prog) {
+    std::cerr << "Usage: " << prog << " [--config config.json] [--check] [name ...]" << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+    std::string config_file = "config.json";
+    std::vector<std::string> names;
+    bool write_cache = true;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--config" && i + 1 < argc) {
+            config_file = argv[++i];
+        } else if (arg == "--check") {
+            // 検証だけ行い、キャッシュは書かない
+            write_cache = false;
+            setenv("SEG_CONFIG_CACHE", "0", 1);
+        } else if (arg == "-h" || arg == "--help") {
+            print_usage(argv[0]);
+            return 0;
+        } else if (!arg.empty() && arg[0] == '-') {
+            print_usage(argv[0]);
+            return 2;
+        } else {
+            names.push_back(arg);
+        }
+    }
+
+    try {
+        if (names.empty()) names = list_config_names(config_file);
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+
+    int bad = 0;
+    for (const auto& name : names) {
+        // 古いキャッシュを読まずに必ずコンパイルし直す
+        const std::string cache = routing_cache_path(name);
+        if (write_cache && !cache.empty()) unlink(cache.c_str());
+        try {
+            DisplayConfig config = load_config_from_json(name, config_file);
+            const RoutingTable& rt = *config.routing;
+            std::cout << "OK    " << name << ": " << config.total_width << "x" << config.total_height
+                      << ", " << rt.module_count() << " modules in " << rt.group_count() << " channel groups";
+            if (write_cache) std::cout << " -> " << cache;
+            std::cout << std::endl;
+        } catch (const std::exception& e) {
+            std::cout << "ERROR " << e.what() << std::endl;
+            ++bad;
+        }
+    }
+    if (bad > 0) {
+        std::cerr << bad << " of " << names.size() << " configurations are invalid" << std::endl;
+        return 1;
+    }
+    return 0;
+}
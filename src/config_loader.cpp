@@ -0,0 +1,268 @@
+// src/config_loader.cpp
+#include "config_loader.hpp"
+#include "routing_table.h"
+#include "json.hpp" // nlohmann/json をインクルード
+#include <cctype>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// JSONをパースするためのヘルパー
+using json = nlohmann::json;
+
+double CHAR_WIDTH_MM = 12.7;
+double CHAR_HEIGHT_MM = 19.2;
+
+int hex_str_to_int(const std::string& hex_str) {
+    return std::stoi(hex_str, nullptr, 16);
+}
+
+namespace {
+
+std::string read_file(const std::string& filename) {
+    std::ifstream f(filename, std::ios::binary);
+    if (!f.is_open()) {
+        throw std::runtime_error("Could not open config file: " + filename);
+    }
+    std::ostringstream ss;
+    ss << f.rdbuf();
+    return ss.str();
+}
+
+std::string cache_dir() {
+    if (const char* d = std::getenv("SEG_CONFIG_CACHE_DIR")) {
+        if (*d) return d;
+    }
+    if (const char* d = std::getenv("RUNTIME_DIRECTORY")) {
+        // systemd の RuntimeDirectory= は ':' 区切りで複数ありうる。先頭を使う
+        std::string dir(d);
+        dir = dir.substr(0, dir.find(':'));
+        if (!dir.empty()) return dir;
+    }
+    // 誰でも書ける /tmp には置かない（別のユーザが先にディレクトリを作れば、読み込む経路表を差し替えられる）
+    if (const char* d = std::getenv("XDG_CACHE_HOME")) {
+        if (*d == '/') return std::string(d) + "/7seg-panel";
+    }
+    if (const char* d = std::getenv("HOME")) {
+        if (*d == '/') return std::string(d) + "/.cache/7seg-panel";
+    }
+    return ""; // 置き場所がなければキャッシュしない
+}
+
+// 自分のもので、他のユーザが書き込めないディレクトリか（なければ 0700 で作る）
+bool cache_dir_trusted(const std::string& dir) {
+    if (dir.empty()) return false;
+    const size_t slash = dir.find_last_of('/');
+    if (slash != std::string::npos && slash > 0) mkdir(dir.substr(0, slash).c_str(), 0700); // ~/.cache がなければ
+    mkdir(dir.c_str(), 0700); // 既にあれば EEXIST で失敗するだけ
+    struct stat st {};
+    if (lstat(dir.c_str(), &st) != 0 || !S_ISDIR(st.st_mode) || st.st_uid != geteuid() ||
+        (st.st_mode & (S_IWGRP | S_IWOTH))) {
+        std::cerr << "[config] routing cache disabled: " << dir
+                  << " is not a directory owned by this user and closed to others" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool cache_enabled() {
+    const char* v = std::getenv("SEG_CONFIG_CACHE");
+    return !(v && std::string(v) == "0");
+}
+
+// "0x70" / "112" のどちらも受け付ける（module_sizes などのキー）
+int parse_address_key(const std::string& key, const std::string& what) {
+    try {
+        size_t used = 0;
+        int v = (key.rfind("0x", 0) == 0 || key.rfind("0X", 0) == 0) ? std::stoi(key, &used, 16)
+                                                                     : std::stoi(key, &used, 10);
+        if (used == key.size()) return v;
+    } catch (const std::exception&) {
+    }
+    throw std::runtime_error(what + ": invalid module address key \"" + key + "\"");
+}
+
+DisplayConfig parse_config(const json& data, const std::string& config_name) {
+    if (!data.contains("configurations") || !data["configurations"].contains(config_name)) {
+        throw std::runtime_error("Configuration not found: " + config_name);
+    }
+
+    const auto& conf_json = data["configurations"][config_name];
+    DisplayConfig config;
+
+    config.name = conf_json["name"];
+    if (conf_json.contains("type")) {
+        config.type = conf_json["type"];
+    } else {
+        config.type = "physical";
+    }
+
+    if (conf_json.contains("buses")) {
+        for (const auto& [bus_str, bus_json] : conf_json["buses"].items()) {
+            int bus_id = std::stoi(bus_str);
+            BusConfig bus_config;
+            if (bus_json.contains("tca9548as")) {
+                for (const auto& tca_json : bus_json["tca9548as"]) {
+                    TCA9548AConfig tca;
+                    if (tca_json.contains("address") && !tca_json["address"].is_null()) {
+                        tca.address = hex_str_to_int(tca_json["address"]);
+                    } else {
+                        tca.address = -1;
+                    }
+                    if (tca_json.contains("channels")) {
+                        for (const auto& [ch_str, grid_json] : tca_json["channels"].items()) {
+                            int channel = std::stoi(ch_str);
+                            std::vector<std::vector<int>> grid;
+                            for (const auto& row_json : grid_json) {
+                                std::vector<int> row;
+                                for (const auto& addr_str : row_json) {
+                                    row.push_back(hex_str_to_int(addr_str));
+                                }
+                                grid.push_back(row);
+                            }
+                            tca.channels[channel] = grid;
+                        }
+                    }
+                    // チャンネルの明示配置: "origins": {"0": {"row": 0, "col": 24}, ...}
+                    if (tca_json.contains("origins")) {
+                        for (const auto& [ch_str, origin_json] : tca_json["origins"].items()) {
+                            int channel = std::stoi(ch_str);
+                            tca.origins[channel] = {origin_json.at("row").get<int>(), origin_json.at("col").get<int>()};
+                        }
+                    }
+                    // 旧形式 "rows" は origins の別名（以前は 48x8 のときだけ使われていた）
+                    if (tca_json.contains("rows")) {
+                        for (const auto& [row_str, row_config_json] : tca_json["rows"].items()) {
+                            int channel = row_config_json.at("channel");
+                            if (tca.origins.count(channel)) {
+                                throw std::runtime_error("rows[" + row_str + "]: channel " + std::to_string(channel) +
+                                                         " is placed twice");
+                            }
+                            tca.origins[channel] = {row_config_json.at("row_offset").get<int>(),
+                                                    row_config_json.at("col_offset").get<int>()};
+                        }
+                    }
+                    bus_config.tca9548as.push_back(tca);
+                }
+            }
+            config.buses[bus_id] = bus_config;
+        }
+    }
+
+    config.module_digits_width = conf_json["module_digits_width"];
+    config.module_digits_height = conf_json["module_digits_height"];
+    config.total_width = conf_json["total_width"];
+    config.total_height = conf_json["total_height"];
+
+    // Optional: per-module size overrides
+    if (conf_json.contains("module_sizes")) {
+        for (const auto& [addr_str, size_json] : conf_json["module_sizes"].items()) {
+            int addr = parse_address_key(addr_str, "module_sizes");
+            if (!size_json.is_array() || size_json.size() != 2) {
+                throw std::runtime_error("module_sizes[" + addr_str + "] must be [width, height]");
+            }
+            config.module_sizes_by_address[addr] = {size_json[0].get<int>(), size_json[1].get<int>()};
+        }
+    }
+
+    // Optional: per-module column reversal flags
+    if (conf_json.contains("module_column_reverse")) {
+        for (const auto& [addr_str, val] : conf_json["module_column_reverse"].items()) {
+            int addr = parse_address_key(addr_str, "module_column_reverse");
+            if (!val.is_boolean()) {
+                throw std::runtime_error("module_column_reverse[" + addr_str + "] must be true or false");
+            }
+            config.module_column_reverse[addr] = val.get<bool>();
+        }
+    }
+
+    // Optional: per-module explicit index mapping
+    if (conf_json.contains("module_index_map")) {
+        for (const auto& [addr_str, arr] : conf_json["module_index_map"].items()) {
+            int addr = parse_address_key(addr_str, "module_index_map");
+            if (!arr.is_array()) {
+                throw std::runtime_error("module_index_map[" + addr_str + "] must be an array");
+            }
+            config.module_index_map[addr] = arr.get<std::vector<int>>();
+        }
+    }
+
+    // C++版で使う物理寸法もJSONから読み込む
+    CHAR_WIDTH_MM = data["char_width_mm"];
+    CHAR_HEIGHT_MM = data["char_height_mm"];
+
+    return config;
+}
+
+} // namespace
+
+std::string routing_cache_path(const std::string& config_name) {
+    const std::string dir = cache_dir();
+    if (dir.empty()) return "";
+    std::string safe;
+    for (char c : config_name) {
+        safe += (isalnum(static_cast<unsigned char>(c)) || c == '-' || c == '_' || c == '.') ? c : '_';
+    }
+    return dir + "/" + safe + ".route";
+}
+
+DisplayConfig load_config_from_json(const std::string& config_name, const std::string& filename) {
+    const std::string text = read_file(filename);
+    // ファイル内容が変わるか、別の構成名なら別のキャッシュ
+    const uint64_t source = routing_checksum(config_name.data(), config_name.size(),
+                                             routing_checksum(text.data(), text.size()));
+    const bool use_cache = cache_enabled() && cache_dir_trusted(cache_dir());
+    const std::string cache_path = use_cache ? routing_cache_path(config_name) : std::string();
+
+    if (use_cache) {
+        if (auto table = RoutingTable::map_file(cache_path, source)) {
+            DisplayConfig config;
+            if (table->restore_config(config)) {
+                config.routing = table;
+                return config;
+            }
+        }
+    }
+
+    DisplayConfig config;
+    try {
+        config = parse_config(json::parse(text), config_name);
+    } catch (const json::exception& e) {
+        // 型違い（文字列のはずが数値など）もここに来る
+        throw std::runtime_error("Invalid configuration " + config_name + " in " + filename + ": " + e.what());
+    }
+
+    std::vector<std::string> errors, warnings;
+    auto table = RoutingTable::compile(config, source, errors, warnings);
+    for (const auto& w : warnings) {
+        std::cerr << "[config] " << config_name << ": warning: " << w << std::endl;
+    }
+    if (!table) {
+        std::string msg = "Invalid layout " + config_name + " in " + filename + ":";
+        for (const auto& e : errors) msg += "\n  - " + e;
+        throw std::runtime_error(msg);
+    }
+    config.routing = table;
+
+    if (use_cache) {
+        if (!table->save(cache_path)) {
+            std::cerr << "[config] could not write routing cache " << cache_path << std::endl;
+        }
+    }
+    return config;
+}
+
+std::vector<std::string> list_config_names(const std::string& filename) {
+    json data = json::parse(read_file(filename));
+    std::vector<std::string> names;
+    if (data.contains("configurations")) {
+        for (const auto& [name, conf] : data["configurations"].items()) {
+            (void)conf;
+            names.push_back(name);
+        }
+    }
+    return names;
+}
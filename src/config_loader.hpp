@@ -1,155 +1,26 @@
 #pragma once
 
 #include <string>
-#include <fstream>
 #include <vector>
-#include <map>
 #include <stdexcept>
-#include "json.hpp" // nlohmann/json をインクルード
 #include "config.h" // 既存のDisplayConfig構造体の定義をインクルード
 
-// JSONをパースするためのヘルパー
-using json = nlohmann::json;
+// config.json から構成を読み込む（実装は config_loader.cpp）
+// レイアウトを検証して経路表 (routing_table.h) にコンパイルし、config.routing に設定する。
+// 不正なレイアウトは理由を全て並べた std::runtime_error で即座に失敗する。
+// コンパイル結果はキャッシュディレクトリに保存し、config.json が変わっていなければ次回は
+// JSON を解析せずに mmap して使う。
+//   SEG_CONFIG_CACHE_DIR  キャッシュの置き場所（既定: $RUNTIME_DIRECTORY、なければ $XDG_CACHE_HOME/7seg-panel、
+//                         なければ $HOME/.cache/7seg-panel。どれもなければキャッシュしない）
+// 置き場所は自分のもので他のユーザが書けないディレクトリでなければ使わない。読んだキャッシュは構造も確かめる
+//   SEG_CONFIG_CACHE=0    キャッシュを使わない
+DisplayConfig load_config_from_json(const std::string& config_name, const std::string& filename = "config.json");
 
-// JSONから16進数文字列をintに変換するヘルパー関数
-int hex_str_to_int(const std::string& hex_str) {
-    return std::stoi(hex_str, nullptr, 16);
-}
-
-DisplayConfig load_config_from_json(const std::string& config_name, const std::string& filename = "config.json") {
-    std::ifstream f(filename);
-    if (!f.is_open()) {
-        throw std::runtime_error("Could not open config file: " + filename);
-    }
-    json data = json::parse(f);
-
-    if (!data["configurations"].contains(config_name)) {
-        throw std::runtime_error("Configuration not found: " + config_name);
-    }
-
-    const auto& conf_json = data["configurations"][config_name];
-    DisplayConfig config;
-
-    config.name = conf_json["name"];
-    if (conf_json.contains("type")) {
-        config.type = conf_json["type"];
-    } else {
-        config.type = "physical";
-    }
-
-    if (conf_json.contains("buses")) {
-        for (const auto& [bus_str, bus_json] : conf_json["buses"].items()) {
-            int bus_id = std::stoi(bus_str);
-            BusConfig bus_config;
-            if (bus_json.contains("tca9548as")) {
-                for (const auto& tca_json : bus_json["tca9548as"]) {
-                    TCA9548AConfig tca;
-                    if (tca_json.contains("address") && !tca_json["address"].is_null()) {
-                        tca.address = hex_str_to_int(tca_json["address"]);
-                    } else {
-                        tca.address = -1;
-                    }
-                    if (tca_json.contains("channels")) {
-                        for (const auto& [ch_str, grid_json] : tca_json["channels"].items()) {
-                            int channel = std::stoi(ch_str);
-                            std::vector<std::vector<int>> grid;
-                            for (const auto& row_json : grid_json) {
-                                std::vector<int> row;
-                                for (const auto& addr_str : row_json) {
-                                    row.push_back(hex_str_to_int(addr_str));
-                                }
-                                grid.push_back(row);
-                            }
-                            tca.channels[channel] = grid;
-                        }
-                    }
-                    if (tca_json.contains("rows")) {
-                        for (const auto& [row_str, row_config_json] : tca_json["rows"].items()) {
-                            int row = std::stoi(row_str);
-                            int channel = row_config_json["channel"];
-                            int row_offset = row_config_json["row_offset"];
-                            int col_offset = row_config_json["col_offset"];
-                            tca.rows[row] = {channel, row_offset, col_offset};
-                        }
-                    }
-                    bus_config.tca9548as.push_back(tca);
-                }
-            }
-            config.buses[bus_id] = bus_config;
-        }
-    }
+// 設定ファイルに定義されている構成名を列挙する（ベンチマークなどで全レイアウトを回すため）
+std::vector<std::string> list_config_names(const std::string& filename = "config.json");
 
-    config.module_digits_width = conf_json["module_digits_width"];
-    config.module_digits_height = conf_json["module_digits_height"];
-    config.total_width = conf_json["total_width"];
-    config.total_height = conf_json["total_height"];
-
-    // Optional: per-module size overrides
-    if (conf_json.contains("module_sizes")) {
-        for (const auto& [addr_str, size_json] : conf_json["module_sizes"].items()) {
-            int addr = 0;
-            try {
-                if (addr_str.rfind("0x", 0) == 0 || addr_str.rfind("0X", 0) == 0) {
-                    addr = std::stoi(addr_str, nullptr, 16);
-                } else {
-                    addr = std::stoi(addr_str);
-                }
-            } catch (...) {
-                // ignore invalid keys
-                continue;
-            }
-            if (size_json.is_array() && size_json.size() >= 2) {
-                int w = size_json[0];
-                int h = size_json[1];
-                config.module_sizes_by_address[addr] = {w, h};
-            }
-        }
-    }
-
-    // Optional: per-module column reversal flags
-    if (conf_json.contains("module_column_reverse")) {
-        for (const auto& [addr_str, val] : conf_json["module_column_reverse"].items()) {
-            int addr = 0;
-            try {
-                if (addr_str.rfind("0x", 0) == 0 || addr_str.rfind("0X", 0) == 0) {
-                    addr = std::stoi(addr_str, nullptr, 16);
-                } else {
-                    addr = std::stoi(addr_str);
-                }
-            } catch (...) {
-                continue;
-            }
-            bool b = false;
-            try { b = static_cast<bool>(val.get<bool>()); } catch(...) { b = false; }
-            config.module_column_reverse[addr] = b;
-        }
-    }
-
-    // Optional: per-module explicit index mapping
-    if (conf_json.contains("module_index_map")) {
-        for (const auto& [addr_str, arr] : conf_json["module_index_map"].items()) {
-            int addr = 0;
-            try {
-                if (addr_str.rfind("0x", 0) == 0 || addr_str.rfind("0X", 0) == 0) {
-                    addr = std::stoi(addr_str, nullptr, 16);
-                } else {
-                    addr = std::stoi(addr_str);
-                }
-            } catch (...) {
-                continue;
-            }
-            if (!arr.is_array()) continue;
-            std::vector<int> v;
-            for (const auto& el : arr) {
-                try { v.push_back(el.get<int>()); } catch(...) { v.push_back(0); }
-            }
-            config.module_index_map[addr] = v;
-        }
-    }
-
-    // C++版で使う物理寸法もJSONから読み込む
-    CHAR_WIDTH_MM = data["char_width_mm"];
-    CHAR_HEIGHT_MM = data["char_height_mm"];
+// JSONから16進数文字列をintに変換するヘルパー関数
+int hex_str_to_int(const std::string& hex_str);
 
-    return config;
-}
\ No newline at end of file
+// 構成のキャッシュファイルのパス（置き場所がなければ空文字列）
+std::string routing_cache_path(const std::string& config_name);
@@ -0,0 +1,234 @@
+// src/display_client.cpp
+#include "display_client.h"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0 // macOS: SO_NOSIGPIPE で代用
+#endif
+
+std::string displayd_socket_path() {
+    if (const char* p = std::getenv("SEG_DISPLAYD_SOCKET")) {
+        if (*p) return p;
+    }
+    if (const char* d = std::getenv("RUNTIME_DIRECTORY")) {
+        // systemd の RuntimeDirectory= は ':' 区切りで複数ありうる。先頭を使う
+        std::string dir(d);
+        dir = dir.substr(0, dir.find(':'));
+        if (!dir.empty()) return dir + "/displayd.sock";
+    }
+    // 誰でも書ける /tmp には置かない（別のユーザが先にソケットを作ってなりすませる）。
+    // systemd の外で動かすときも、unit と同じ /run/7seg-panel があればそこを使う
+    struct stat st;
+    if (::stat("/run/7seg-panel", &st) == 0 && S_ISDIR(st.st_mode)) return "/run/7seg-panel/displayd.sock";
+    if (const char* d = std::getenv("XDG_RUNTIME_DIR")) {
+        if (*d) return std::string(d) + "/7seg-displayd.sock";
+    }
+    return "/run/7seg-panel/displayd.sock";
+}
+
+DisplayClient::~DisplayClient() {
+    disconnect();
+}
+
+bool DisplayClient::connect(const std::string& name, int priority, int hold_ms, const std::string& socket_path) {
+    disconnect();
+    name_ = name;
+    priority_ = priority;
+    hold_ms_ = hold_ms;
+    socket_path_ = socket_path;
+    configured_ = true;
+    return open_socket();
+}
+
+bool DisplayClient::open_socket() {
+    next_retry_ = std::chrono::steady_clock::now() + std::chrono::seconds(1);
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    if (socket_path_.size() >= sizeof(addr.sun_path)) {
+        std::cerr << "[displayd-client] socket path too long: " << socket_path_ << std::endl;
+        return false;
+    }
+    std::strncpy(addr.sun_path, socket_path_.c_str(), sizeof(addr.sun_path) - 1);
+
+    int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        perror("[displayd-client] socket");
+        return false;
+    }
+#ifdef SO_NOSIGPIPE
+    int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &one, sizeof(one));
+#endif
+    if (::connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0) {
+        ::close(fd);
+        return false;
+    }
+    fd_ = fd;
+    inbuf_.clear();
+    welcome_ = DisplaydWelcome{};
+
+    DisplaydHello hello{};
+    hello.priority = priority_;
+    hello.hold_ms = hold_ms_ < 0 ? 0 : static_cast<uint32_t>(hold_ms_);
+    std::strncpy(hello.name, name_.c_str(), sizeof(hello.name) - 1);
+    if (!send_message(DISPLAYD_HELLO, &hello, sizeof(hello), nullptr, 0)) return false;
+    std::cout << "[displayd-client] connected to " << socket_path_ << " as " << name_
+              << " (priority " << priority_ << ")" << std::endl;
+    return true;
+}
+
+void DisplayClient::disconnect() {
+    if (fd_ >= 0) ::close(fd_);
+    fd_ = -1;
+    welcome_ = DisplaydWelcome{};
+}
+
+// 切断されていれば、1秒に1回まで接続し直す（デーモンの再起動を待つ間はフレームを捨てる）
+bool DisplayClient::ensure_connected() {
+    if (fd_ >= 0) return true;
+    if (!configured_ || std::chrono::steady_clock::now() < next_retry_) return false;
+    return open_socket();
+}
+
+bool DisplayClient::send_message(uint16_t type, const void* head, size_t head_len, const void* body, size_t body_len) {
+    if (fd_ < 0) return false;
+    DisplaydHeader hdr{DISPLAYD_MAGIC, DISPLAYD_VERSION, type, static_cast<uint32_t>(head_len + body_len)};
+    iovec iov[3] = {
+        {&hdr, sizeof(hdr)},
+        {const_cast<void*>(head), head_len},
+        {const_cast<void*>(body), body_len},
+    };
+    size_t total = sizeof(hdr) + head_len + body_len;
+    size_t sent = 0;
+    int first = 0;
+    // 途中まで送れた場合は残りを送り切る（メッセージの途中で止めるとストリームが壊れる）
+    while (sent < total) {
+        msghdr msg{};
+        msg.msg_iov = iov + first;
+        msg.msg_iovlen = 3 - first;
+        ssize_t n = ::sendmsg(fd_, &msg, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            std::cerr << "[displayd-client] send failed: " << std::strerror(errno) << " (will reconnect)" << std::endl;
+            disconnect();
+            return false;
+        }
+        sent += static_cast<size_t>(n);
+        size_t consumed = static_cast<size_t>(n);
+        while (first < 3 && consumed >= iov[first].iov_len) {
+            consumed -= iov[first].iov_len;
+            ++first;
+        }
+        if (first < 3) {
+            iov[first].iov_base = static_cast<uint8_t*>(iov[first].iov_base) + consumed;
+            iov[first].iov_len -= consumed;
+        }
+    }
+    return true;
+}
+
+// デーモンからの WELCOME（パネルの大きさ）を取り込む。ブロックしない
+void DisplayClient::drain_incoming() {
+    uint8_t buf[256];
+    while (fd_ >= 0) {
+        ssize_t n = ::recv(fd_, buf, sizeof(buf), MSG_DONTWAIT);
+        if (n == 0) {
+            std::cerr << "[displayd-client] daemon closed the connection (will reconnect)" << std::endl;
+            disconnect();
+            return;
+        }
+        if (n < 0) break;
+        inbuf_.insert(inbuf_.end(), buf, buf + n);
+    }
+    while (inbuf_.size() >= sizeof(DisplaydHeader)) {
+        DisplaydHeader hdr;
+        std::memcpy(&hdr, inbuf_.data(), sizeof(hdr));
+        if (hdr.magic != DISPLAYD_MAGIC || hdr.length > DISPLAYD_MAX_PAYLOAD) {
+            std::cerr << "[displayd-client] protocol error from daemon" << std::endl;
+            disconnect();
+            return;
+        }
+        if (inbuf_.size() < sizeof(hdr) + hdr.length) break;
+        if (hdr.type == DISPLAYD_WELCOME && hdr.length >= sizeof(DisplaydWelcome)) {
+            std::memcpy(&welcome_, inbuf_.data() + sizeof(hdr), sizeof(welcome_));
+        }
+        inbuf_.erase(inbuf_.begin(), inbuf_.begin() + sizeof(hdr) + hdr.length);
+    }
+}
+
+bool DisplayClient::submit_grid(const uint8_t* grid, int width, int height) {
+    if (!ensure_connected()) return false;
+    drain_incoming();
+    DisplaydFrame frame{static_cast<uint16_t>(width), static_cast<uint16_t>(height)};
+    return send_message(DISPLAYD_GRID, &frame, sizeof(frame), grid, static_cast<size_t>(width) * height);
+}
+
+bool DisplayClient::submit_gray(const uint8_t* pixels, int width, int height) {
+    if (!ensure_connected()) return false;
+    drain_incoming();
+    DisplaydFrame frame{static_cast<uint16_t>(width), static_cast<uint16_t>(height)};
+    return send_message(DISPLAYD_GRAY, &frame, sizeof(frame), pixels, static_cast<size_t>(width) * height);
+}
+
+bool DisplayClient::submit_layer(const GridLayer& layer) {
+    if (!ensure_connected()) return false;
+    drain_incoming();
+    DisplaydLayer head{};
+    head.z = layer.z;
+    head.x = static_cast<int16_t>(layer.x);
+    head.y = static_cast<int16_t>(layer.y);
+    head.width = static_cast<uint16_t>(layer.width);
+    head.height = static_cast<uint16_t>(layer.height);
+    head.mode = static_cast<uint8_t>(layer.mode);
+    head.segment_mask = layer.segment_mask;
+    head.has_cell_mask = layer.cell_mask.empty() ? 0 : 1;
+    if (layer.cell_mask.empty()) {
+        return send_message(DISPLAYD_LAYER, &head, sizeof(head), layer.cells.data(), layer.cells.size());
+    }
+    std::vector<uint8_t> body(layer.cells);
+    body.insert(body.end(), layer.cell_mask.begin(), layer.cell_mask.end());
+    return send_message(DISPLAYD_LAYER, &head, sizeof(head), body.data(), body.size());
+}
+
+bool DisplayClient::refresh() {
+    if (!ensure_connected()) return false;
+    drain_incoming();
+    return fd_ >= 0;
+}
+
+bool DisplayClient::release() {
+    if (fd_ < 0) return false;
+    return send_message(DISPLAYD_RELEASE, nullptr, 0, nullptr, 0);
+}
+
+namespace {
+std::unique_ptr<DisplayClient> g_output;
+} // namespace
+
+bool connect_displayd_output_from_env(const std::string& source_name) {
+    const char* prio = std::getenv("SEG_DISPLAYD_PRIORITY");
+    if (!prio || !*prio) return false;
+    int hold_ms = 500;
+    if (const char* v = std::getenv("SEG_DISPLAYD_HOLD_MS")) hold_ms = std::atoi(v);
+    g_output = std::make_unique<DisplayClient>();
+    if (!g_output->connect(source_name, std::atoi(prio), hold_ms)) {
+        std::cerr << "[displayd-client] 7seg-displayd is not running at " << displayd_socket_path()
+                  << " (frames are dropped until it starts)" << std::endl;
+    }
+    return true;
+}
+
+DisplayClient* displayd_output() {
+    return g_output.get();
+}
@@ -0,0 +1,551 @@
+// src/displayd.cpp
+// 7seg-displayd: I2C バスとコンパイル済みレイアウトを持ち続ける常駐プロセス
+//   ./7seg-displayd [config_name]
+// 映像ソース（SEG_DISPLAYD_PRIORITY を設定した各プレイヤーや、display_client.h を使うツール）は
+// Unix ドメインソケットに接続してフレームを送る。デーモンは毎フレーム、表示期間内のフレームを持つ
+// ソースのうち priority が最も高いもの（同じなら新しいフレーム）を表示する。
+// ソースを切り替えてもバスの開き直しやモジュールの初期化は起きないので、切り替えは1フレームで終わる。
+//
+// ローカルのプロデューサは共有メモリのリング（grid_ring.h）にも grid を書ける。リングは1つのソースとして扱う。
+// LAYER を送るソース（時計やテロップ）は選ばれる対象にならず、表示するソースの grid の上に z の順で重なる（compositor.h）。
+//
+// 環境変数:
+//   SEG_DISPLAYD_SOCKET  ソケットのパス（既定: $RUNTIME_DIRECTORY/displayd.sock、なければ /run/7seg-panel/displayd.sock）
+//   SEG_DISPLAYD_FPS     I2C に書き込む頻度の上限（既定 30）
+//   SEG_GRID_RING        共有メモリのリング名（既定 /7seg-grid、"0" で作らない）
+//   SEG_GRID_RING_PRIORITY / SEG_GRID_RING_HOLD_MS  リングのソースとしての優先度（既定 0）と表示時間（既定 500）
+//   SEG_GRID_RING_OVERLAY  1 ならリングをソースではなく、パネル全体に OR で重ねるレイヤにする（z は SEG_GRID_RING_PRIORITY）
+//   SEG_RT_PRIORITY      設定されていれば、I2C に書き込むメインループを SCHED_FIFO で動かす（frame_scheduler.h）
+//   METRICS_PORT         設定されていれば /metrics を公開する
+#include "common.h"
+#include "compositor.h"
+#include "config_loader.hpp"
+#include "display_client.h"
+#include "frame_scheduler.h"
+#include "grid_ring.h"
+#include "led.h"
+#include "live_config.h"
+#include "metrics.h"
+#include "trace.h"
+#include "video.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <list>
+#include <string>
+#include <thread>
+#include <vector>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#ifndef __APPLE__
+#include <sys/eventfd.h>
+#endif
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct Source {
+    int fd = -1;                     // 共有メモリのリングは -1
+    std::string name = "(unnamed)";
+    int priority = 0;
+    int hold_ms = 500;
+    bool hello = false;
+    std::vector<uint8_t> inbuf;      // 受信途中のバイト列
+    // 最新フレーム（表示するときに grid へ変換する。低優先のソースのグレー画像は変換しない）
+    std::vector<uint8_t> pixels;
+    int width = 0;
+    int height = 0;
+    bool gray = false;
+    bool has_frame = false;
+    Clock::time_point frame_at{};
+    bool size_warned = false;
+    // LAYER を送ってきたソースは選ばれる対象にならず、overlays に layer_key で重ねられる
+    bool overlay = false;
+    std::string layer_key;
+};
+
+int open_listen_socket(const std::string& path) {
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(addr.sun_path)) {
+        std::cerr << "[displayd] socket path too long: " << path << std::endl;
+        return -1;
+    }
+    std::strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+
+    int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        perror("[displayd] socket");
+        return -1;
+    }
+    // 前回のソケットファイルが残っていれば消す。ただし別のデーモンが応答するなら二重起動
+    if (::connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == 0) {
+        std::cerr << "[displayd] another 7seg-displayd is already listening on " << path << std::endl;
+        ::close(fd);
+        return -1;
+    }
+    ::close(fd);
+    ::unlink(path.c_str());
+
+    fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || ::bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0 || ::listen(fd, 8) < 0) {
+        perror("[displayd] bind/listen");
+        if (fd >= 0) ::close(fd);
+        return -1;
+    }
+    ::chmod(path.c_str(), 0660); // 同じグループのツールからも送れるように
+    ::fcntl(fd, F_SETFL, O_NONBLOCK);
+    return fd;
+}
+
+void send_welcome(const Source& src, const DisplayConfig& cfg, int fps) {
+    DisplaydHeader hdr{DISPLAYD_MAGIC, DISPLAYD_VERSION, DISPLAYD_WELCOME, sizeof(DisplaydWelcome)};
+    DisplaydWelcome w{static_cast<uint16_t>(cfg.total_width), static_cast<uint16_t>(cfg.total_height),
+                      static_cast<uint32_t>(fps)};
+    uint8_t buf[sizeof(hdr) + sizeof(w)];
+    std::memcpy(buf, &hdr, sizeof(hdr));
+    std::memcpy(buf + sizeof(hdr), &w, sizeof(w));
+    // 小さいので一度に送れる。送れなければ相手が読んでいないだけなので諦める
+    (void)::send(src.fd, buf, sizeof(buf), MSG_NOSIGNAL | MSG_DONTWAIT);
+}
+
+// inbuf_ に溜まった完全なメッセージを処理する。プロトコル違反なら false（切断する）
+bool handle_messages(Source& src, const DisplayConfig& cfg, int fps, GridCompositor& overlays) {
+    size_t off = 0;
+    while (src.inbuf.size() - off >= sizeof(DisplaydHeader)) {
+        DisplaydHeader hdr;
+        std::memcpy(&hdr, src.inbuf.data() + off, sizeof(hdr));
+        if (hdr.magic != DISPLAYD_MAGIC || hdr.version != DISPLAYD_VERSION || hdr.length > DISPLAYD_MAX_PAYLOAD) {
+            std::cerr << "[displayd] protocol error from " << src.name << std::endl;
+            return false;
+        }
+        if (src.inbuf.size() - off < sizeof(hdr) + hdr.length) break;
+        const uint8_t* body = src.inbuf.data() + off + sizeof(hdr);
+
+        switch (hdr.type) {
+            case DISPLAYD_HELLO: {
+                if (hdr.length < sizeof(DisplaydHello)) return false;
+                DisplaydHello hello;
+                std::memcpy(&hello, body, sizeof(hello));
+                hello.name[sizeof(hello.name) - 1] = '\0';
+                src.name = hello.name;
+                src.priority = hello.priority;
+                src.hold_ms = static_cast<int>(hello.hold_ms);
+                src.hello = true;
+                std::cout << "[displayd] source connected: " << src.name << " (priority " << src.priority
+                          << ", hold " << src.hold_ms << " ms)" << std::endl;
+                send_welcome(src, cfg, fps);
+                break;
+            }
+            case DISPLAYD_GRID:
+            case DISPLAYD_GRAY: {
+                if (hdr.length < sizeof(DisplaydFrame)) return false;
+                DisplaydFrame frame;
+                std::memcpy(&frame, body, sizeof(frame));
+                const size_t n = static_cast<size_t>(frame.width) * frame.height;
+                if (hdr.length != sizeof(frame) + n) return false;
+                const bool gray = (hdr.type == DISPLAYD_GRAY);
+                // grid はパネルと同じ大きさでなければ使えない（グレー画像は任意の大きさでよい）
+                if (!gray && (frame.width != cfg.total_width || frame.height != cfg.total_height)) {
+                    if (!src.size_warned) {
+                        std::cerr << "[displayd] " << src.name << ": grid " << frame.width << "x" << frame.height
+                                  << " does not match the panel " << cfg.total_width << "x" << cfg.total_height
+                                  << " (dropped)" << std::endl;
+                        src.size_warned = true;
+                    }
+                    break;
+                }
+                if (src.overlay) {
+                    overlays.remove_layer(src.layer_key);
+                    src.overlay = false;
+                }
+                src.pixels.assign(body + sizeof(frame), body + sizeof(frame) + n);
+                src.width = frame.width;
+                src.height = frame.height;
+                src.gray = gray;
+                src.has_frame = true;
+                src.frame_at = Clock::now();
+                break;
+            }
+            case DISPLAYD_LAYER: {
+                if (hdr.length < sizeof(DisplaydLayer)) return false;
+                DisplaydLayer head;
+                std::memcpy(&head, body, sizeof(head));
+                const size_t n = static_cast<size_t>(head.width) * head.height;
+                if (hdr.length != sizeof(head) + n * (head.has_cell_mask ? 2 : 1)) return false;
+                GridLayer layer;
+                layer.z = head.z;
+                layer.x = head.x;
+                layer.y = head.y;
+                layer.width = head.width;
+                layer.height = head.height;
+                layer.mode = (head.mode == static_cast<uint8_t>(GridBlend::OR)) ? GridBlend::OR : GridBlend::REPLACE;
+                layer.segment_mask = head.segment_mask;
+                const uint8_t* cells = body + sizeof(head);
+                layer.cells.assign(cells, cells + n);
+                if (head.has_cell_mask) layer.cell_mask.assign(cells + n, cells + 2 * n);
+                overlays.set_layer(src.layer_key, std::move(layer));
+                if (!src.overlay) {
+                    std::cout << "[displayd] overlay from " << src.name << " (z " << head.z << ")" << std::endl;
+                }
+                src.overlay = true;
+                src.pixels.clear();
+                src.has_frame = true;
+                src.frame_at = Clock::now();
+                break;
+            }
+            case DISPLAYD_RELEASE:
+                if (src.overlay) overlays.remove_layer(src.layer_key);
+                src.has_frame = false;
+                break;
+            default:
+                // 未知のメッセージは読み飛ばす（新しいクライアントとの互換のため）
+                break;
+        }
+        off += sizeof(hdr) + hdr.length;
+    }
+    src.inbuf.erase(src.inbuf.begin(), src.inbuf.begin() + off);
+    return true;
+}
+
+bool frame_is_live(const Source& src, Clock::time_point now) {
+    if (!src.hello || !src.has_frame) return false;
+    if (src.hold_ms == 0) return true;
+    return now - src.frame_at <= std::chrono::milliseconds(src.hold_ms);
+}
+
+// 表示するソース: 優先度が最も高く、同じなら新しいフレームを持つもの（重ねるレイヤのソースは除く）
+const Source* pick_source(const std::list<Source>& sources, Clock::time_point now) {
+    const Source* best = nullptr;
+    for (const auto& src : sources) {
+        if (src.overlay || !frame_is_live(src, now)) continue;
+        if (!best || src.priority > best->priority ||
+            (src.priority == best->priority && src.frame_at > best->frame_at)) {
+            best = &src;
+        }
+    }
+    return best;
+}
+
+void source_to_grid(const Source& src, const LiveSettings& live, std::vector<uint8_t>& grid) {
+    if (!src.gray) {
+        grid = src.pixels;
+        return;
+    }
+    // グレー画像はデーモンの2値化パラメータで2値化する（POST /config や config.json の再読み込みと同じ値）
+    // const_cast: cv::Mat はデータを書き換えないが、const ポインタを受け取るコンストラクタがない
+    cv::Mat gray(src.height, src.width, CV_8UC1, const_cast<uint8_t*>(src.pixels.data()));
+    cv::Mat bw;
+    cv::threshold(gray, bw, live.min_threshold, live.max_threshold, cv::THRESH_BINARY);
+    frame_to_grid(bw, *live.display, grid);
+}
+
+// リングの doorbell（futex）で眠り、publish されたらイベント fd でメインループを起こす
+class RingWatcher {
+public:
+    RingWatcher() {
+#ifdef __APPLE__
+        int p[2];
+        if (::pipe(p) == 0) {
+            read_fd_ = p[0];
+            write_fd_ = p[1];
+            ::fcntl(read_fd_, F_SETFL, O_NONBLOCK);
+        }
+#else
+        read_fd_ = write_fd_ = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+#endif
+    }
+    ~RingWatcher() {
+        stop();
+        if (read_fd_ >= 0) ::close(read_fd_);
+        if (write_fd_ >= 0 && write_fd_ != read_fd_) ::close(write_fd_);
+    }
+    int fd() const { return read_fd_; }
+
+    void start(GridRing& ring) {
+        stop();
+        stop_ = false;
+        ring_ = &ring;
+        thread_ = std::thread([this, &ring] {
+            trace::set_thread_name("grid_ring");
+            while (!stop_) {
+                if (ring.wait(500) && !stop_) notify();
+            }
+        });
+    }
+    // リングを作り直す前に必ず止める（スレッドが古い写像を触らないように）
+    void stop() {
+        if (!thread_.joinable()) return;
+        stop_ = true;
+        if (ring_) ring_->wake();
+        thread_.join();
+    }
+    void drain() {
+        uint64_t v;
+        while (::read(read_fd_, &v, sizeof(v)) > 0) {
+        }
+    }
+
+private:
+    void notify() {
+        uint64_t one = 1;
+        (void)!::write(write_fd_, &one, sizeof(one));
+    }
+    int read_fd_ = -1;
+    int write_fd_ = -1;
+    GridRing* ring_ = nullptr;
+    std::atomic<bool> stop_{false};
+    std::thread thread_;
+};
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    const std::string config_name = (argc > 1) ? argv[1] : "24x4";
+    int fps = 30;
+    if (const char* v = std::getenv("SEG_DISPLAYD_FPS")) fps = std::max(1, std::min(240, std::atoi(v)));
+
+    DisplayConfig initial;
+    try {
+        initial = load_config_from_json(config_name);
+        std::cout << "Successfully loaded configuration: " << initial.name << std::endl;
+    } catch (const std::exception& e) {
+        std::cerr << "Error loading configuration: " << e.what() << std::endl;
+        return 1;
+    }
+
+    // 二重起動ならバスに触る前に止める
+    const std::string socket_path = displayd_socket_path();
+    int listen_fd = open_listen_socket(socket_path);
+    if (listen_fd < 0) return 1;
+
+    int i2c_fd = open_i2c_auto(initial);
+    if (i2c_fd < 0) {
+        perror("Failed to open I2C device");
+        ::close(listen_fd);
+        ::unlink(socket_path.c_str());
+        return 1;
+    }
+    if (!initialize_displays(i2c_fd, initial)) {
+        std::cerr << "Failed to initialize display modules." << std::endl;
+        close(i2c_fd);
+        ::close(listen_fd);
+        ::unlink(socket_path.c_str());
+        return 1;
+    }
+
+    setup_signal_handlers();
+    signal(SIGPIPE, SIG_IGN);
+    live_config().publish_initial(initial, ScalingMode::FIT, 64, 255, config_name);
+    live_config().start_watcher();
+    metrics::set_panel_info(config_name);
+    metrics::start_metrics_server_from_env();
+
+    std::cout << "[displayd] listening on " << socket_path << " (" << fps << " fps)" << std::endl;
+    trace::set_thread_name("displayd");
+    set_output_thread_realtime_from_env("displayd");
+
+    std::shared_ptr<const LiveSettings> live = live_config().current();
+    std::list<Source> sources;
+    GridCompositor overlays;
+    uint64_t next_source_id = 0;
+
+    // 共有メモリのリング（Python などのローカルなプロデューサ用）
+    GridRing ring;
+    RingWatcher ring_watcher;
+    Source* ring_src = nullptr;
+    const std::string ring_name = grid_ring_name();
+    if (!ring_name.empty() && ring.create(ring_name, live->display->total_width, live->display->total_height)) {
+        Source src;
+        src.name = "grid-ring";
+        src.layer_key = "grid-ring";
+        src.hello = true;
+        if (const char* v = std::getenv("SEG_GRID_RING_PRIORITY")) src.priority = std::atoi(v);
+        if (const char* v = std::getenv("SEG_GRID_RING_HOLD_MS")) src.hold_ms = std::max(0, std::atoi(v));
+        if (const char* v = std::getenv("SEG_GRID_RING_OVERLAY")) src.overlay = (std::atoi(v) != 0);
+        sources.push_back(std::move(src));
+        ring_src = &sources.back();
+        ring_watcher.start(ring);
+        std::cout << "[displayd] grid ring: " << ring_name << " (" << ring.width() << "x" << ring.height()
+                  << (ring_src->overlay ? ", overlay z " : ", priority ") << ring_src->priority << ")" << std::endl;
+    }
+
+    const Source* shown = nullptr;
+    std::string shown_name;
+    std::vector<uint8_t> grid;
+    const auto period = std::chrono::microseconds(1000000 / fps);
+    auto next_tick = Clock::now();
+    auto last_write = Clock::now() - period;  // 最後に I2C へ書いた時刻（書き込み頻度の上限に使う）
+    bool fresh = false;  // 前回の表示以降に新しいフレームが届いた
+
+    while (!g_should_exit) {
+        // --- 次のフレーム時刻まで、接続とフレームの受信を待つ ---
+        // 新しいフレームが届いていれば、前回の書き込みから1周期たった時点ですぐ表示する（tick を待たない）
+        std::vector<pollfd> pfds;
+        pfds.push_back({listen_fd, POLLIN, 0});
+        pfds.push_back({ring_src ? ring_watcher.fd() : -1, POLLIN, 0});
+        for (const auto& src : sources) pfds.push_back({src.fd, POLLIN, 0}); // fd が -1 のリングは poll が無視する
+        const auto due = fresh ? std::min(next_tick, last_write + period) : next_tick;
+        // poll はミリ秒単位なので切り上げる（切り捨てると 1ms 未満の残りで 0 になり、期限まで空回りする）
+        auto wait = std::chrono::ceil<std::chrono::milliseconds>(due - Clock::now()).count();
+        int r = ::poll(pfds.data(), pfds.size(), static_cast<int>(std::max<long long>(0, wait)));
+        if (r < 0 && errno != EINTR) {
+            perror("[displayd] poll");
+            break;
+        }
+
+        if (r > 0) {
+            if (pfds[0].revents & POLLIN) {
+                int cfd;
+                while ((cfd = ::accept(listen_fd, nullptr, nullptr)) >= 0) {
+                    Source src;
+                    src.fd = cfd;
+                    src.layer_key = "source-" + std::to_string(++next_source_id);
+                    sources.push_back(std::move(src));
+                }
+            }
+            if (pfds[1].revents & POLLIN) ring_watcher.drain();
+            size_t i = 2;
+            for (auto it = sources.begin(); it != sources.end(); ++i) {
+                bool drop = false;
+                if (i < pfds.size() && (pfds[i].revents & (POLLIN | POLLHUP | POLLERR))) {
+                    uint8_t buf[65536];
+                    ssize_t n = ::recv(it->fd, buf, sizeof(buf), MSG_DONTWAIT);
+                    if (n > 0) {
+                        const bool had = it->has_frame;
+                        const auto at = it->frame_at;
+                        it->inbuf.insert(it->inbuf.end(), buf, buf + n);
+                        drop = !handle_messages(*it, *live->display, fps, overlays);
+                        if (it->has_frame && (!had || it->frame_at != at)) fresh = true;
+                    } else if (n == 0 || (errno != EAGAIN && errno != EINTR)) {
+                        drop = true;
+                    }
+                }
+                if (drop) {
+                    std::cout << "[displayd] source disconnected: " << it->name << std::endl;
+                    if (&*it == shown) shown = nullptr;
+                    if (it->overlay) overlays.remove_layer(it->layer_key);
+                    ::close(it->fd);
+                    it = sources.erase(it);
+                } else {
+                    ++it;
+                }
+            }
+        }
+
+        // リングは doorbell を待たずに毎回見る（起こされた分も、取りこぼした分もここで拾う）
+        if (ring_src && ring.read_latest(ring_src->pixels)) {
+            ring_src->width = ring.width();
+            ring_src->height = ring.height();
+            ring_src->has_frame = true;
+            ring_src->frame_at = Clock::now();
+            if (ring_src->overlay) {
+                GridLayer layer;
+                layer.z = ring_src->priority;
+                layer.width = ring.width();
+                layer.height = ring.height();
+                layer.mode = GridBlend::OR;
+                layer.cells = ring_src->pixels;
+                overlays.set_layer(ring_src->layer_key, std::move(layer));
+            }
+            fresh = true;
+        }
+
+        const auto now = Clock::now();
+        if (now < next_tick && !(fresh && now >= last_write + period)) continue;
+        next_tick += period;
+        if (next_tick < now) next_tick = now + period; // 大きく遅れたら追いつこうとせず今から数え直す
+        fresh = false;
+
+        // --- 1フレーム分の表示 ---
+        trace::Scope frame_scope("displayd_frame");
+        if (auto next = live_config().current(); next && next->display != live->display) {
+            apply_layout_change(i2c_fd, *live->display, *next->display);
+            live = std::move(next);
+            for (auto& src : sources) {
+                // 大きさの合わない grid は捨て、新しい大きさを知らせる（ソケットのレイヤははみ出しを切り捨てて残す）
+                const bool clipped_layer = src.overlay && src.fd >= 0;
+                if (src.has_frame && !src.gray && !clipped_layer &&
+                    (src.width != live->display->total_width || src.height != live->display->total_height)) {
+                    src.has_frame = false;
+                    if (src.overlay) overlays.remove_layer(src.layer_key);
+                }
+                src.size_warned = false;
+                if (src.hello && src.fd >= 0) send_welcome(src, *live->display, fps);
+            }
+            // リングは新しい大きさで作り直す（プロデューサは closed を見て接続し直す）
+            if (ring_src && (ring.width() != live->display->total_width || ring.height() != live->display->total_height)) {
+                ring_watcher.stop();
+                if (ring.create(ring_name, live->display->total_width, live->display->total_height)) {
+                    ring_watcher.start(ring);
+                } else {
+                    std::cerr << "[displayd] grid ring disabled: could not recreate " << ring_name << std::endl;
+                    ring_src->has_frame = false;
+                    ring_src->hello = false;
+                }
+            }
+        }
+        const DisplayConfig& cfg = *live->display;
+
+        // 表示期間の切れたレイヤを外す
+        for (auto& src : sources) {
+            if (src.overlay && src.has_frame && !frame_is_live(src, now)) {
+                overlays.remove_layer(src.layer_key);
+                src.has_frame = false;
+            }
+        }
+
+        const Source* pick = pick_source(sources, now);
+        const std::string pick_name = pick ? pick->name : std::string();
+        if (pick != shown || pick_name != shown_name) {
+            std::cout << "[displayd] showing " << (pick ? pick_name : std::string("(nothing: blank)")) << std::endl;
+            shown = pick;
+            shown_name = pick_name;
+        }
+        if (pick) {
+            source_to_grid(*pick, *live, grid);
+        } else {
+            grid.assign(cfg.total_digits(), 0); // 表示するソースがなければ消灯
+        }
+        if (!overlays.empty()) overlays.compose(grid, cfg.total_width, cfg.total_height, grid);
+        // grid が前と同じでも毎フレーム渡す。変わっていないモジュールは led.cpp のシャドウ RAM の比較で送らずに済み、
+        // 休ませているモジュールの再試行・再初期化と SEG_I2C_REFRESH_MS の定期書き直しはここで呼ばれないと進まない
+        I2CErrorInfo error_info;
+        last_write = now;
+        if (update_flexible_display(i2c_fd, cfg, grid, error_info)) {
+            metrics::frames_displayed().inc();
+        } else {
+            if (!attempt_i2c_recovery(i2c_fd, cfg)) {
+                std::cerr << "Recovery failed in displayd. Pausing before next attempt..." << std::endl;
+                sleep(2);
+            }
+        }
+    }
+
+    std::cout << "\n[displayd] shutting down" << std::endl;
+    ring_watcher.stop();
+    ring.close();
+    for (auto& src : sources) {
+        if (src.fd >= 0) ::close(src.fd);
+    }
+    ::close(listen_fd);
+    ::unlink(socket_path.c_str());
+    close(i2c_fd);
+    if (!clear_all_displays(*live->display)) {
+        std::cerr << "Warning: failed to clear displays on exit." << std::endl;
+    }
+    metrics::stop_metrics_server();
+    return 0;
+}
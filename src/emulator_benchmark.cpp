@@ -1,57 +1,474 @@
+// src/emulator_benchmark.cpp
+// 表示パイプライン全体のベンチマーク
+//   frame_to_grid / crop・fit 前処理 / 表示RAM への変換 / update_flexible_display (FakeI2CTransport) /
+//   レイヤの合成 / テロップの描画 / audio_queue / エミュレータ描画 を config.json の全レイアウトで計測し、JSON で出力する。
 #include "emulator_display.h"
+#include "common.h"
+#include "led.h"
+#include "video.h"
+#include "audio.h"
+#include "playback.h"
+#include "i2c_transport.h"
+#include "compositor.h"
+#include "seg_text.h"
+#include "module_ram.h"
+#include "routing_table.h"
+#include "config_loader.hpp"
+#include "json.hpp"
+#include <opencv2/opencv.hpp>
 #include <vector>
 #include <chrono>
 #include <iostream>
-#include <random>
+#include <fstream>
+#include <algorithm>
+#include <numeric>
+#include <memory>
+#include <string>
+#include <cstdlib>
+#include <cmath>
 
-// パフォーマンスベンチマーク関数
-void run_performance_benchmark() {
-    const int ROWS = 4;
-    const int COLS = 8;
-    const int TOTAL_DIGITS = ROWS * COLS;
-    const int FRAMES = 1000; // ベンチマーク用のフレーム数
+using json = nlohmann::json;
 
-    // エミュレータ表示クラスを作成
-    auto display = create_emulator_display(ROWS, COLS);
+namespace {
 
-    // ランダムデータ生成器
-    std::random_device rd;
-    std::mt19937 gen(rd());
-    std::uniform_int_distribution<> dis(0, 255);
+struct BenchOptions {
+    std::string config_file = "config.json";
+    std::string layout;                 // 空なら全レイアウト
+    std::string video_path = "test.mp4";
+    std::string output_spec = "null";   // エミュレータ描画の出力先
+    std::string json_path;              // 空なら標準出力
+    std::string label;                  // 比較用のラベル（コミットIDなど）
+    int frames = 300;                   // 1シナリオあたりのフレーム数
+    int warmup = 10;
+    bool verify = false;                // 計測せずに表示RAM の変換の一致だけを確かめる
+};
 
-    // ベンチマーク開始
-    auto start_time = std::chrono::high_resolution_clock::now();
+// 1シナリオ分の計測結果
+struct BenchResult {
+    std::string layout;
+    std::string input;
+    std::string stage;
+    std::vector<double> samples_us;
+    double total_s = 0.0;
+    json extra = json::object();
+};
 
-    for (int frame = 0; frame < FRAMES; ++frame) {
-        // ランダムなグリッドデータを生成
-        std::vector<uint8_t> grid(TOTAL_DIGITS);
-        for (int i = 0; i < TOTAL_DIGITS; ++i) {
-            grid[i] = dis(gen);
+using bench_clock = std::chrono::steady_clock;
+
+double percentile(std::vector<double> v, double p) {
+    if (v.empty()) return 0.0;
+    std::sort(v.begin(), v.end());
+    size_t idx = static_cast<size_t>(std::ceil(p / 100.0 * v.size()));
+    if (idx > 0) --idx;
+    return v[std::min(idx, v.size() - 1)];
+}
+
+json result_to_json(const BenchResult& r) {
+    json j;
+    j["layout"] = r.layout;
+    j["input"] = r.input;
+    j["stage"] = r.stage;
+    j["samples"] = r.samples_us.size();
+    double mean = r.samples_us.empty() ? 0.0
+        : std::accumulate(r.samples_us.begin(), r.samples_us.end(), 0.0) / r.samples_us.size();
+    j["mean_us"] = mean;
+    j["p50_us"] = percentile(r.samples_us, 50.0);
+    j["p99_us"] = percentile(r.samples_us, 99.0);
+    j["max_us"] = r.samples_us.empty() ? 0.0 : *std::max_element(r.samples_us.begin(), r.samples_us.end());
+    j["throughput_per_s"] = r.total_s > 0.0 ? r.samples_us.size() / r.total_s : 0.0;
+    for (const auto& [k, v] : r.extra.items()) j[k] = v;
+    return j;
+}
+
+// frames 個の入力に対して fn(i) を warmup 後に計測する
+template <typename Fn>
+BenchResult run_stage(const std::string& layout, const std::string& input, const std::string& stage,
+                      size_t count, int frames, int warmup, Fn&& fn) {
+    BenchResult r;
+    r.layout = layout;
+    r.input = input;
+    r.stage = stage;
+    if (count == 0) return r;
+    for (int i = 0; i < warmup; ++i) fn(static_cast<size_t>(i) % count);
+    r.samples_us.reserve(frames);
+    auto begin = bench_clock::now();
+    for (int i = 0; i < frames; ++i) {
+        auto t0 = bench_clock::now();
+        fn(static_cast<size_t>(i) % count);
+        auto t1 = bench_clock::now();
+        r.samples_us.push_back(std::chrono::duration<double, std::micro>(t1 - t0).count());
+    }
+    r.total_s = std::chrono::duration<double>(bench_clock::now() - begin).count();
+    return r;
+}
+
+// --- 入力フレームの生成 ---
+// static: 同じ絵を繰り返す（差分描画が効く典型ケース）
+std::vector<cv::Mat> make_static_frames() {
+    cv::Mat img = cv::Mat::zeros(H, W, CV_8UC3);
+    cv::putText(img, "7SEG", cv::Point(W / 8, H / 2), cv::FONT_HERSHEY_SIMPLEX, 5.0, cv::Scalar(255, 255, 255), 25);
+    cv::circle(img, cv::Point(W * 3 / 4, H * 3 / 4), H / 8, cv::Scalar(255, 255, 255), -1);
+    return {img};
+}
+
+// ticker: 文字列が右から左へ流れる（一部の桁だけが毎フレーム変化する）
+std::vector<cv::Mat> make_ticker_frames(int count) {
+    std::vector<cv::Mat> frames;
+    frames.reserve(count);
+    const std::string text = "HELLO 7SEG PANEL 0123456789";
+    for (int i = 0; i < count; ++i) {
+        cv::Mat img = cv::Mat::zeros(H, W, CV_8UC3);
+        int x = W - (i * 8) % (W * 4);
+        cv::putText(img, text, cv::Point(x, H * 2 / 3), cv::FONT_HERSHEY_SIMPLEX, 4.0, cv::Scalar(255, 255, 255), 20);
+        frames.push_back(img);
+    }
+    return frames;
+}
+
+// video: 実際の動画フレーム（起動時に一度だけデコードしてメモリに保持）
+std::vector<cv::Mat> load_video_frames(const std::string& path, int max_frames) {
+    std::vector<cv::Mat> frames;
+    cv::VideoCapture cap(path, cv::CAP_FFMPEG);
+    if (!cap.isOpened()) {
+        std::cerr << "[bench] 動画を開けません（video 入力はスキップ）: " << path << std::endl;
+        return frames;
+    }
+    cv::Mat frame;
+    while (static_cast<int>(frames.size()) < max_frames && cap.read(frame)) {
+        cv::Mat resized;
+        cv::resize(frame, resized, cv::Size(W, H));
+        frames.push_back(resized);
+    }
+    std::cerr << "[bench] decoded " << frames.size() << " frames from " << path << std::endl;
+    return frames;
+}
+
+// 1レイアウト分の全ステージを計測する
+void bench_layout(const std::string& name, const DisplayConfig& config,
+                  const std::vector<std::pair<std::string, const std::vector<cv::Mat>*>>& inputs,
+                  const BenchOptions& opt, std::vector<BenchResult>& results) {
+    FakeI2CTransport fake;
+    set_i2c_transport(&fake);
+
+    for (const auto& [input_name, frames_ptr] : inputs) {
+        const auto& frames = *frames_ptr;
+        if (frames.empty()) continue;
+
+        // 前処理 (crop / fit) → 2値画像
+        std::vector<cv::Mat> bw_frames(frames.size());
+        results.push_back(run_stage(name, input_name, "prepare_crop", frames.size(), opt.frames, opt.warmup,
+            [&](size_t i) { prepare_bw_frame(frames[i], config, ScalingMode::CROP, 64, 255, bw_frames[i]); }));
+        std::vector<cv::Mat> bw_fit(frames.size());
+        results.push_back(run_stage(name, input_name, "prepare_fit", frames.size(), opt.frames, opt.warmup,
+            [&](size_t i) { prepare_bw_frame(frames[i], config, ScalingMode::FIT, 64, 255, bw_fit[i]); }));
+
+        // frame_to_grid
+        std::vector<std::vector<uint8_t>> grids(frames.size());
+        results.push_back(run_stage(name, input_name, "frame_to_grid", frames.size(), opt.frames, opt.warmup,
+            [&](size_t i) { frame_to_grid(bw_frames[i], config, grids[i]); }));
+
+        // レイヤの合成（displayd の時計・テロップ相当: 右上に REPLACE の矩形、下段全体に OR のレイヤ）
+        GridCompositor overlays;
+        GridLayer clock;
+        clock.z = 1;
+        clock.width = std::min(config.total_width, 5);
+        clock.height = 1;
+        clock.x = config.total_width - clock.width;
+        clock.cells.assign(static_cast<size_t>(clock.width), 0x7F);
+        overlays.set_layer("clock", std::move(clock));
+        GridLayer ticker;
+        ticker.width = config.total_width;
+        ticker.height = 1;
+        ticker.y = config.total_height - 1;
+        ticker.mode = GridBlend::OR;
+        ticker.segment_mask = 0x80;
+        ticker.cells.assign(static_cast<size_t>(ticker.width), 0x80);
+        overlays.set_layer("ticker", std::move(ticker));
+        std::vector<uint8_t> composed;
+        results.push_back(run_stage(name, input_name, "compose", grids.size(), opt.frames, opt.warmup,
+            [&](size_t i) { overlays.compose(grids[i], config.total_width, config.total_height, composed); }));
+
+        // 表示RAM への変換: 全モジュールを SWAR 転置で1回に作る encode_panel_ram と、従来の1ビットずつのループ
+        if (config.routing) {
+            const RoutingTable& routing = *config.routing;
+            std::vector<uint8_t> ram(routing.module_count() * MODULE_RAM_BYTES);
+            std::vector<uint8_t> ref(ram.size());
+            auto reference = [&](const std::vector<uint8_t>& g) {
+                uint8_t digits[ROUTING_MAX_DIGITS];
+                for (size_t mi = 0; mi < routing.module_count(); ++mi) {
+                    const RoutingModule& m = routing.module(mi);
+                    for (int d = 0; d < m.digit_count; ++d) digits[d] = (m.cell[d] < g.size()) ? g[m.cell[d]] : 0;
+                    encode_module_ram_reference(digits, m.digit_count, &ref[mi * MODULE_RAM_BYTES]);
+                }
+            };
+            results.push_back(run_stage(name, input_name, "encode_ram_reference", grids.size(), opt.frames, opt.warmup,
+                [&](size_t i) { reference(grids[i]); }));
+            auto swar = run_stage(name, input_name, "encode_ram", grids.size(), opt.frames, opt.warmup,
+                [&](size_t i) { encode_panel_ram(routing, grids[i].data(), grids[i].size(), ram.data()); });
+            uint64_t mismatches = 0;
+            for (const auto& g : grids) {
+                reference(g);
+                encode_panel_ram(routing, g.data(), g.size(), ram.data());
+                if (ram != ref) ++mismatches;
+            }
+            swar.extra["mismatches"] = mismatches;
+            results.push_back(std::move(swar));
         }
 
-        // 表示更新
-        display->update(grid);
+        // update_flexible_display（実機の代わりに FakeI2CTransport でバス時間を見積もる）
+        reset_i2c_channel_cache();
+        fake.reset();
+        uint64_t failures = 0;
+        auto led = run_stage(name, input_name, "update_flexible_display", grids.size(), opt.frames, 0,
+            [&](size_t i) {
+                I2CErrorInfo err;
+                if (!update_flexible_display(-1, config, grids[i], err)) ++failures;
+            });
+        size_t n = std::max<size_t>(1, led.samples_us.size());
+        led.extra["i2c_transactions_per_frame"] = static_cast<double>(fake.transactions()) / n;
+        led.extra["i2c_bytes_per_frame"] = static_cast<double>(fake.bytes()) / n;
+        led.extra["i2c_bus_time_us_per_frame"] = static_cast<double>(fake.simulated_ns()) / 1000.0 / n;
+        led.extra["failures"] = failures;
+        results.push_back(std::move(led));
+
+        // エミュレータ描画
+        std::unique_ptr<IDisplayOutput> display(create_emulator_display(config.total_height, config.total_width, opt.output_spec));
+        if (display) {
+            results.push_back(run_stage(name, input_name, "emulator_render", grids.size(), opt.frames, opt.warmup,
+                [&](size_t i) { display->update(grids[i]); }));
+        }
     }
 
-    auto end_time = std::chrono::high_resolution_clock::now();
-    auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(end_time - start_time);
+    // テロップ（seg_text.h）: 全行に同じ文字列を半桁ずつ流す。映像のデコードと比べるための基準
+    SegTicker ticker("HELLO 7SEG PANEL 0123456789", 6.0);
+    std::vector<uint8_t> text_grid(static_cast<size_t>(config.total_digits()), 0);
+    uint64_t text_frame = 0;
+    results.push_back(run_stage(name, "text", "text_ticker", 1, opt.frames, opt.warmup,
+        [&](size_t) {
+            const uint64_t t = ++text_frame * 33333333ULL; // 30fps 相当で進める
+            for (int row = 0; row < config.total_height; ++row) {
+                ticker.render_at(t, text_grid, config.total_width, config.total_height, 0, row, config.total_width);
+            }
+        }));
 
-    // 結果出力
-    double fps = static_cast<double>(FRAMES) / (duration.count() / 1000.0);
-    double avg_frame_time = static_cast<double>(duration.count()) / FRAMES;
+    set_i2c_transport(nullptr);
+}
 
-    std::cout << "=== Performance Benchmark Results ===" << std::endl;
-    std::cout << "Frames: " << FRAMES << std::endl;
-    std::cout << "Total time: " << duration.count() << " ms" << std::endl;
-    std::cout << "Average FPS: " << fps << std::endl;
-    std::cout << "Average frame time: " << avg_frame_time << " ms" << std::endl;
-    std::cout << "====================================" << std::endl;
+// --verify: encode_panel_ram（形ごとの専用の変換）が汎用の変換・1ビットずつの参照実装と同じ RAM を作るか
+// ランダム・全消灯・全点灯の grid と、パネルより小さい grid（汎用の変換に落ちる）で比べる。不一致の数を返す
+uint64_t verify_routing(const std::string& name, const RoutingTable& routing) {
+    const size_t digits = static_cast<size_t>(routing.total_width()) * routing.total_height();
+    std::vector<uint8_t> ram(routing.module_count() * MODULE_RAM_BYTES);
+    std::vector<uint8_t> generic(ram.size());
+    std::vector<uint8_t> ref(ram.size());
+    size_t shapes[ROUTING_SHAPE_8X2_REVERSED + 1] = {};
+    for (size_t mi = 0; mi < routing.module_count(); ++mi) {
+        const uint8_t shape = routing.module(mi).shape;
+        if (shape <= ROUTING_SHAPE_8X2_REVERSED) ++shapes[shape];
+    }
 
-    delete display;
+    std::vector<std::vector<uint8_t>> grids;
+    grids.emplace_back(digits, 0x00);
+    grids.emplace_back(digits, 0xFF);
+    uint64_t x = 0x9E3779B97F4A7C15ULL;
+    for (int k = 0; k < 64; ++k) {
+        std::vector<uint8_t> g(digits);
+        for (auto& v : g) {
+            x ^= x << 13; x ^= x >> 7; x ^= x << 17;
+            v = static_cast<uint8_t>(x);
+        }
+        grids.push_back(std::move(g));
+    }
+    grids.emplace_back(grids.back().begin(), grids.back().begin() + digits / 2);
+
+    uint64_t mismatches = 0;
+    for (const auto& g : grids) {
+        encode_panel_ram(routing, g.data(), g.size(), ram.data());
+        encode_panel_ram_generic(routing, g.data(), g.size(), generic.data());
+        uint8_t cells[ROUTING_MAX_DIGITS];
+        for (size_t mi = 0; mi < routing.module_count(); ++mi) {
+            const RoutingModule& m = routing.module(mi);
+            for (int d = 0; d < m.digit_count; ++d) cells[d] = (m.cell[d] < g.size()) ? g[m.cell[d]] : 0;
+            encode_module_ram_reference(cells, m.digit_count, &ref[mi * MODULE_RAM_BYTES]);
+        }
+        if (ram != ref || generic != ref) ++mismatches;
+    }
+    fprintf(stderr, "%-24s modules=%-4zu 4x4=%zu 4x4r=%zu 8x2=%zu 8x2r=%zu generic=%zu grids=%zu %s\n",
+            name.c_str(), routing.module_count(), shapes[ROUTING_SHAPE_4X4], shapes[ROUTING_SHAPE_4X4_REVERSED],
+            shapes[ROUTING_SHAPE_8X2], shapes[ROUTING_SHAPE_8X2_REVERSED], shapes[ROUTING_SHAPE_GENERIC], grids.size(),
+            mismatches ? "MISMATCH" : "ok");
+    return mismatches;
 }
 
-int main() {
-    std::cout << "Starting emulator performance benchmark..." << std::endl;
-    run_performance_benchmark();
+// 専用の変換の組み合わせを網羅するための合成レイアウト（2行 x 3列のモジュールを1チャンネルに並べる）
+DisplayConfig synthetic_config(int module_w, int module_h, bool reverse, bool index_map) {
+    DisplayConfig config;
+    config.type = "emulator";
+    config.module_digits_width = module_w;
+    config.module_digits_height = module_h;
+    config.total_width = module_w * 3;
+    config.total_height = module_h * 2;
+    TCA9548AConfig tca;
+    tca.address = -1;
+    tca.channels[0] = {{0x70, 0x71, 0x72}, {0x73, 0x74, 0x75}};
+    config.buses[1].tca9548as.push_back(tca);
+    for (int addr = 0x70; addr <= 0x75; ++addr) {
+        if (reverse && (addr & 1)) config.module_column_reverse[addr] = true; // 反転あり・なしを混ぜる
+        if (index_map && addr == 0x72) {
+            std::vector<int> map(static_cast<size_t>(module_w * module_h));
+            for (size_t i = 0; i < map.size(); ++i) map[i] = static_cast<int>(map.size() - 1 - i);
+            config.module_index_map[addr] = map;
+        }
+    }
+    return config;
+}
+
+int run_verify(const BenchOptions& opt, const std::vector<std::string>& layouts) {
+    uint64_t mismatches = 0;
+    for (const auto& name : layouts) {
+        try {
+            DisplayConfig config = load_config_from_json(name, opt.config_file);
+            if (config.routing) mismatches += verify_routing(name, *config.routing);
+        } catch (const std::exception& e) {
+            std::cerr << "[bench] skip " << name << ": " << e.what() << std::endl;
+        }
+    }
+    const struct { const char* name; int w, h; bool reverse, index_map; } cases[] = {
+        {"synthetic-4x4", 4, 4, false, false},
+        {"synthetic-4x4-reverse", 4, 4, true, false},
+        {"synthetic-8x2", 8, 2, false, false},
+        {"synthetic-8x2-reverse", 8, 2, true, true},
+        {"synthetic-4x2", 4, 2, true, false},
+        {"synthetic-16x1", 16, 1, false, false},
+        {"synthetic-4x4-index-map", 4, 4, false, true},
+    };
+    for (const auto& c : cases) {
+        std::vector<std::string> errors, warnings;
+        auto routing = RoutingTable::compile(synthetic_config(c.w, c.h, c.reverse, c.index_map), 0, errors, warnings);
+        if (!routing) {
+            std::cerr << "[bench] " << c.name << ": " << (errors.empty() ? "compile failed" : errors.front()) << std::endl;
+            ++mismatches;
+            continue;
+        }
+        mismatches += verify_routing(c.name, *routing);
+    }
+    std::cerr << "[bench] verify: " << (mismatches ? "FAILED" : "all encoders match") << std::endl;
+    return mismatches ? 1 : 0;
+}
+
+// audio_queue（レイアウトに依存しないので1回だけ）
+void bench_audio(const BenchOptions& opt, std::vector<BenchResult>& results) {
+    // 実デバイスが無い環境でも動くよう、未指定ならダミードライバを使う
+    setenv("SDL_AUDIODRIVER", "dummy", 0);
+    if (!audio_init(SAMPLE_RATE, CHANNELS)) {
+        std::cerr << "[bench] audio_init failed（audio_queue はスキップ）" << std::endl;
+        return;
+    }
+    // 1映像フレーム分の 16bit PCM（440Hz サイン波）
+    const size_t samples_per_frame = SAMPLE_RATE / FPS;
+    std::vector<int16_t> pcm(samples_per_frame * CHANNELS);
+    for (size_t i = 0; i < samples_per_frame; ++i) {
+        int16_t v = static_cast<int16_t>(8000.0 * std::sin(2.0 * M_PI * 440.0 * i / SAMPLE_RATE));
+        for (int c = 0; c < CHANNELS; ++c) pcm[i * CHANNELS + c] = v;
+    }
+    results.push_back(run_stage("-", "sine440", "audio_queue", 1, opt.frames, opt.warmup,
+        [&](size_t) { audio_queue(reinterpret_cast<const char*>(pcm.data()), pcm.size() * sizeof(int16_t)); }));
+    audio_cleanup();
+}
+
+void print_usage(const char* prog) {
+    std::cerr << "Usage: " << prog << " [options]\n"
+              << "  --config <file>    設定ファイル (default: config.json)\n"
+              << "  --layout <name>    このレイアウトのみ計測 (default: 全レイアウト)\n"
+              << "  --video <path>     video 入力に使う動画 (default: test.mp4)\n"
+              << "  --frames <n>       1シナリオあたりのフレーム数 (default: 300)\n"
+              << "  --output <spec>    エミュレータ出力先 null|window|png:<dir>|pipe:<path>|shm:<name> (default: null)\n"
+              << "  --json <file>      結果JSONの出力先 (default: 標準出力)\n"
+              << "  --label <text>     結果に付けるラベル（コミットIDなど）\n"
+              << "  --verify           計測せず、表示RAM の専用の変換が汎用の変換・参照実装と一致するかだけを確かめる\n";
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    BenchOptions opt;
+    for (int i = 1; i < argc; ++i) {
+        std::string a = argv[i];
+        auto next = [&]() -> std::string {
+            if (i + 1 >= argc) { print_usage(argv[0]); std::exit(1); }
+            return argv[++i];
+        };
+        if (a == "--config") opt.config_file = next();
+        else if (a == "--layout") opt.layout = next();
+        else if (a == "--video") opt.video_path = next();
+        else if (a == "--frames") opt.frames = std::max(1, std::atoi(next().c_str()));
+        else if (a == "--output") opt.output_spec = next();
+        else if (a == "--json") opt.json_path = next();
+        else if (a == "--label") opt.label = next();
+        else if (a == "--verify") opt.verify = true;
+        else if (a == "-h" || a == "--help") { print_usage(argv[0]); return 0; }
+        else { print_usage(argv[0]); return 1; }
+    }
+
+    std::vector<std::string> layouts;
+    try {
+        layouts = opt.layout.empty() ? list_config_names(opt.config_file) : std::vector<std::string>{opt.layout};
+    } catch (const std::exception& e) {
+        std::cerr << "[bench] " << e.what() << std::endl;
+        return 1;
+    }
+    if (opt.verify) return run_verify(opt, layouts);
+
+    // 入力は全レイアウトで共通（動画のデコードは一度だけ）
+    auto static_frames = make_static_frames();
+    auto ticker_frames = make_ticker_frames(std::min(opt.frames, 240));
+    auto video_frames = load_video_frames(opt.video_path, opt.frames);
+    std::vector<std::pair<std::string, const std::vector<cv::Mat>*>> inputs = {
+        {"static", &static_frames},
+        {"ticker", &ticker_frames},
+        {"video", &video_frames},
+    };
+
+    std::vector<BenchResult> results;
+    for (const auto& name : layouts) {
+        DisplayConfig config;
+        try {
+            config = load_config_from_json(name, opt.config_file);
+        } catch (const std::exception& e) {
+            std::cerr << "[bench] skip " << name << ": " << e.what() << std::endl;
+            continue;
+        }
+        if (config.total_width <= 0 || config.total_height <= 0) continue;
+        std::cerr << "[bench] layout " << name << " (" << config.total_width << "x" << config.total_height << ")" << std::endl;
+        bench_layout(name, config, inputs, opt, results);
+    }
+    bench_audio(opt, results);
+
+    json out;
+    out["label"] = opt.label;
+    out["frames"] = opt.frames;
+    out["output"] = opt.output_spec;
+    out["results"] = json::array();
+    for (const auto& r : results) out["results"].push_back(result_to_json(r));
+
+    if (opt.json_path.empty()) {
+        std::cout << out.dump(2) << std::endl;
+    } else {
+        std::ofstream f(opt.json_path);
+        if (!f) {
+            std::cerr << "[bench] cannot write " << opt.json_path << std::endl;
+            return 1;
+        }
+        f << out.dump(2) << std::endl;
+        std::cerr << "[bench] wrote " << opt.json_path << std::endl;
+    }
+
+    // 人が読む用の要約
+    for (const auto& r : results) {
+        json j = result_to_json(r);
+        fprintf(stderr, "%-24s %-7s %-24s p50=%9.1fus p99=%9.1fus %10.1f/s\n",
+                r.layout.c_str(), r.input.c_str(), r.stage.c_str(),
+                j["p50_us"].get<double>(), j["p99_us"].get<double>(), j["throughput_per_s"].get<double>());
+    }
     return 0;
 }
@@ -7,7 +7,16 @@
 #include <mutex>
 #include <iostream> // デバッグログ出力用
 #include <fstream>
-#include "json.hpp"
+#include <memory>
+#include <cstdio>
+#include <cstring>
+#include <cerrno>
+#include <chrono>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "config_loader.hpp"
 
 // デバッグモードフラグ
 bool debug_mode = false;
@@ -171,9 +180,210 @@ SegmentLayout make_layout(int digit_idx, double package_center_x, double package
 
 
 
+namespace {
+// --- 描画済みフレームの出力先 ---
+class IFrameSink {
+public:
+    virtual ~IFrameSink() = default;
+    virtual void write(const cv::Mat& bgr) = 0;
+};
+
+// 従来の cv::imshow ウィンドウ
+class WindowFrameSink : public IFrameSink {
+public:
+    void write(const cv::Mat& bgr) override {
+        cv::imshow("7seg-emulator", bgr);
+        cv::waitKey(1);
+    }
+};
+
+// 描画だけ行って捨てる（ベンチマーク用）
+class NullFrameSink : public IFrameSink {
+public:
+    void write(const cv::Mat&) override {}
+};
+
+// 連番PNG: <dir>/frame_000000.png, frame_000001.png, ...
+class PngSequenceSink : public IFrameSink {
+public:
+    explicit PngSequenceSink(const std::string& dir) : dir_(dir) {
+        if (dir_.empty()) dir_ = ".";
+        if (mkdir(dir_.c_str(), 0755) < 0 && errno != EEXIST) {
+            std::cerr << "[emulator] mkdir failed: " << dir_ << " (" << std::strerror(errno) << ")" << std::endl;
+        }
+    }
+    void write(const cv::Mat& bgr) override {
+        char name[32];
+        std::snprintf(name, sizeof(name), "/frame_%06llu.png", static_cast<unsigned long long>(index_++));
+        // 圧縮レベルを下げて書き出し速度を優先
+        if (!cv::imwrite(dir_ + name, bgr, {cv::IMWRITE_PNG_COMPRESSION, 1})) {
+            std::cerr << "[emulator] failed to write " << dir_ << name << std::endl;
+        }
+    }
+private:
+    std::string dir_;
+    unsigned long long index_ = 0;
+};
+
+// 生BGRフレームをファイル/FIFO/標準出力へ書き出す
+// 例: EMULATOR_OUTPUT=pipe:- ./emulator_test | ffmpeg -f rawvideo -pix_fmt bgr24 -s WxH -i - out.mp4
+class RawPipeSink : public IFrameSink {
+public:
+    explicit RawPipeSink(const std::string& path) {
+        if (path.empty() || path == "-") {
+            fd_ = STDOUT_FILENO;
+        } else {
+            fd_ = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+            owns_fd_ = true;
+            if (fd_ < 0) {
+                std::cerr << "[emulator] failed to open pipe output: " << path << " (" << std::strerror(errno) << ")" << std::endl;
+            }
+        }
+    }
+    ~RawPipeSink() override {
+        if (owns_fd_ && fd_ >= 0) close(fd_);
+    }
+    void write(const cv::Mat& bgr) override {
+        if (fd_ < 0) return;
+        for (int r = 0; r < bgr.rows; ++r) {
+            const uint8_t* row = bgr.ptr<uint8_t>(r);
+            size_t left = static_cast<size_t>(bgr.cols) * 3;
+            while (left > 0) {
+                ssize_t n = ::write(fd_, row, left);
+                if (n < 0) {
+                    if (errno == EINTR) continue;
+                    // 読み手がいなくなったら以降の出力を止める
+                    std::cerr << "[emulator] pipe write failed (" << std::strerror(errno) << "), output disabled" << std::endl;
+                    if (owns_fd_) close(fd_);
+                    fd_ = -1;
+                    return;
+                }
+                row += n;
+                left -= static_cast<size_t>(n);
+            }
+        }
+    }
+private:
+    int fd_ = -1;
+    bool owns_fd_ = false;
+};
+
+// POSIX共有メモリのリングバッファ（レイアウトは emulator_display.h を参照）
+class ShmRingSink : public IFrameSink {
+public:
+    static constexpr uint32_t SLOT_COUNT = 3;
+
+    ShmRingSink(const std::string& name, int width, int height) {
+        name_ = (!name.empty() && name[0] == '/') ? name : "/" + name;
+        const size_t stride = static_cast<size_t>(width) * 3;
+        // スロット先頭を8バイト境界に揃える
+        slot_size_ = (sizeof(EmulatorShmSlot) + stride * height + 7) & ~static_cast<size_t>(7);
+        map_size_ = sizeof(EmulatorShmHeader) + slot_size_ * SLOT_COUNT;
+
+        int fd = shm_open(name_.c_str(), O_CREAT | O_RDWR, 0644);
+        if (fd < 0) {
+            std::cerr << "[emulator] shm_open failed: " << name_ << " (" << std::strerror(errno) << ")" << std::endl;
+            return;
+        }
+        if (ftruncate(fd, static_cast<off_t>(map_size_)) < 0) {
+            std::cerr << "[emulator] ftruncate failed: " << name_ << " (" << std::strerror(errno) << ")" << std::endl;
+            close(fd);
+            return;
+        }
+        void* p = mmap(nullptr, map_size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd);
+        if (p == MAP_FAILED) {
+            std::cerr << "[emulator] mmap failed: " << name_ << " (" << std::strerror(errno) << ")" << std::endl;
+            return;
+        }
+        base_ = static_cast<uint8_t*>(p);
+        std::memset(base_, 0, map_size_);
+        header_ = new (base_) EmulatorShmHeader{};
+        header_->version = EMULATOR_SHM_VERSION;
+        header_->width = static_cast<uint32_t>(width);
+        header_->height = static_cast<uint32_t>(height);
+        header_->stride = static_cast<uint32_t>(stride);
+        header_->slot_count = SLOT_COUNT;
+        header_->slot_size = slot_size_;
+        header_->write_seq.store(0, std::memory_order_relaxed);
+        for (uint32_t i = 0; i < SLOT_COUNT; ++i) {
+            new (slot_ptr(i)) EmulatorShmSlot{};
+        }
+        // magic は最後に書いて、リーダーが初期化途中のヘッダを読まないようにする
+        std::atomic_thread_fence(std::memory_order_release);
+        header_->magic = EMULATOR_SHM_MAGIC;
+        std::cerr << "[emulator] shm output: " << name_ << " (" << width << "x" << height << ", "
+                  << SLOT_COUNT << " slots)" << std::endl;
+    }
+    ~ShmRingSink() override {
+        if (base_) {
+            munmap(base_, map_size_);
+            shm_unlink(name_.c_str());
+        }
+    }
+    void write(const cv::Mat& bgr) override {
+        if (!header_) return;
+        const uint64_t seq = header_->write_seq.load(std::memory_order_relaxed) + 1;
+        auto* slot = reinterpret_cast<EmulatorShmSlot*>(slot_ptr(static_cast<uint32_t>(seq % SLOT_COUNT)));
+        slot->seq.store(0, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        slot->timestamp_ns = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count());
+        uint8_t* dst = reinterpret_cast<uint8_t*>(slot) + sizeof(EmulatorShmSlot);
+        const size_t row_bytes = std::min<size_t>(header_->stride, static_cast<size_t>(bgr.cols) * 3);
+        const int rows = std::min<int>(static_cast<int>(header_->height), bgr.rows);
+        for (int r = 0; r < rows; ++r) {
+            std::memcpy(dst + static_cast<size_t>(r) * header_->stride, bgr.ptr<uint8_t>(r), row_bytes);
+        }
+        slot->seq.store(seq, std::memory_order_release);
+        header_->write_seq.store(seq, std::memory_order_release);
+    }
+private:
+    uint8_t* slot_ptr(uint32_t i) const {
+        return base_ + sizeof(EmulatorShmHeader) + slot_size_ * i;
+    }
+    std::string name_;
+    uint8_t* base_ = nullptr;
+    EmulatorShmHeader* header_ = nullptr;
+    size_t slot_size_ = 0;
+    size_t map_size_ = 0;
+};
+
+// 出力指定文字列から出力先を生成する
+std::unique_ptr<IFrameSink> make_frame_sink(const std::string& spec, int width, int height) {
+    std::string kind = spec;
+    std::string arg;
+    size_t colon = spec.find(':');
+    if (colon != std::string::npos) {
+        kind = spec.substr(0, colon);
+        arg = spec.substr(colon + 1);
+    }
+    if (kind == "null") return std::make_unique<NullFrameSink>();
+    if (kind == "png") return std::make_unique<PngSequenceSink>(arg.empty() ? "emulator_frames" : arg);
+    if (kind == "pipe") return std::make_unique<RawPipeSink>(arg);
+    if (kind == "shm") return std::make_unique<ShmRingSink>(arg.empty() ? "/7seg-emulator" : arg, width, height);
+    if (kind != "window" && !kind.empty()) {
+        std::cerr << "[emulator] unknown output '" << spec << "', falling back to window" << std::endl;
+    }
+#if !defined(__APPLE__)
+    // ディスプレイサーバが無い環境では imshow が失敗するので描画のみにする
+    if (!std::getenv("DISPLAY") && !std::getenv("WAYLAND_DISPLAY")) {
+        std::cerr << "[emulator] no display server, using null output (set EMULATOR_OUTPUT to png:/pipe:/shm:)" << std::endl;
+        return std::make_unique<NullFrameSink>();
+    }
+#endif
+    return std::make_unique<WindowFrameSink>();
+}
+
+std::string default_output_spec() {
+    const char* v = std::getenv("EMULATOR_OUTPUT");
+    return v ? std::string(v) : std::string("window");
+}
+}
+
 class EmulatorDisplay : public IDisplayOutput {
 public:
-    EmulatorDisplay(int rows, int cols) : rows_(rows), cols_(cols) {
+    EmulatorDisplay(int rows, int cols, const std::string& output_spec = default_output_spec()) : rows_(rows), cols_(cols) {
         // 前のフレーム状態を初期化（全て消灯状態）
         prev_grid_.assign(rows_ * cols_, 0);
         
@@ -195,6 +405,8 @@ public:
         
         // 初回描画：背景と全セグメント（灰色）を描画
         initialize_display();
+
+        sink_ = make_frame_sink(output_spec, window_width_, window_height_);
     }
     
     void initialize_display() {
@@ -269,9 +481,8 @@ public:
         // 差分描画：変更されたセグメントのみ更新
         update_changed_segments(grid);
         
-        // 表示
-        cv::imshow("7seg-emulator", img_);
-        cv::waitKey(1);
+        // 表示（ウィンドウ / PNG / パイプ / 共有メモリ）
+        sink_->write(img_);
     }
 private:
     int rows_;
@@ -282,6 +493,7 @@ private:
     std::mutex mtx_;
     std::vector<std::pair<double, double>> package_centers_;
     std::vector<uint8_t> prev_grid_; // 前のフレーム状態
+    std::unique_ptr<IFrameSink> sink_;
 };
 
 
@@ -289,20 +501,17 @@ IDisplayOutput* create_emulator_display(int rows, int cols) {
     return new EmulatorDisplay(rows, cols);
 }
 
+IDisplayOutput* create_emulator_display(int rows, int cols, const std::string& output_spec) {
+    return new EmulatorDisplay(rows, cols, output_spec);
+}
+
 IDisplayOutput* create_emulator_display(const std::string& config_name) {
-    std::ifstream f("config.json");
-    if (!f.is_open()) {
-        std::cerr << "Failed to open config.json" << std::endl;
-        return nullptr;
-    }
-    nlohmann::json config;
-    f >> config;
-    if (config["configurations"].find(config_name) == config["configurations"].end()) {
-        std::cerr << "Configuration " << config_name << " not found" << std::endl;
+    DisplayConfig config;
+    try {
+        config = load_config_from_json(config_name);
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
         return nullptr;
     }
-    auto& conf = config["configurations"][config_name];
-    int total_width = conf["total_width"];
-    int total_height = conf["total_height"];
-    return new EmulatorDisplay(total_height, total_width); // rows, cols
+    return new EmulatorDisplay(config.total_height, config.total_width); // rows, cols
 }
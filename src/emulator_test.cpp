@@ -6,9 +6,8 @@
 #include <vector>
 #include <cstdint>
 #include <opencv2/opencv.hpp>  // ←これを追加
-#include <fstream>
 #include <iostream>
-#include "json.hpp"
+#include "config_loader.hpp"
 
 int main(int argc, char* argv[]) {
     std::string config_name = "emulator-12x8"; // デフォルト
@@ -26,20 +25,15 @@ int main(int argc, char* argv[]) {
     debug_mode = debug;
 
     // JSONから構成を読み込み
-    std::ifstream f("config.json");
-    if (!f.is_open()) {
-        std::cerr << "Failed to open config.json" << std::endl;
+    DisplayConfig config;
+    try {
+        config = load_config_from_json(config_name);
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
         return 1;
     }
-    nlohmann::json config;
-    f >> config;
-    if (config["configurations"].find(config_name) == config["configurations"].end()) {
-        std::cerr << "Configuration " << config_name << " not found" << std::endl;
-        return 1;
-    }
-    auto& conf = config["configurations"][config_name];
-    int total_width = conf["total_width"];
-    int total_height = conf["total_height"];
+    const int total_width = config.total_width;
+    const int total_height = config.total_height;
 
     IDisplayOutput* display = create_emulator_display(config_name);
     if (!display) {
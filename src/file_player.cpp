@@ -5,6 +5,9 @@
 #include "video.h"
 #include "file_audio_gst.h"
 #include "audio.h"
+#include "live_config.h"
+#include "display_client.h"
+#include "frame_scheduler.h"
 #include <thread>
 #include <mutex>
 #include <condition_variable>
@@ -42,24 +45,32 @@ int main(int argc, char* argv[]) {
                 std::atomic<bool> writer_stop(false);
                 std::mutex q_mtx;
                 std::condition_variable q_cv;
-                std::deque<std::vector<uint8_t>> q;
+                // grid と、それを作ったときの設定（構成の差し替えをライター側でも同じ順に適用する）
+                std::deque<std::pair<std::shared_ptr<const LiveSettings>, std::vector<uint8_t>>> q;
+                std::shared_ptr<const LiveSettings> live = live_settings_or(config, scaling_mode, min_threshold, max_threshold);
 
                 // I2Cオープンと初期化はメインスレッドで行い、ライタースレッドは同じfdを使う
-                int i2c_fd = open_i2c_auto(config);
-                if (i2c_fd < 0) {
-                    std::cerr << "I2C communication failed: No I2C devices found or access denied." << std::endl;
-                    return -1;
-                }
-                if (!initialize_displays(i2c_fd, config)) {
-                    std::cerr << "Failed to initialize display modules." << std::endl;
-                    close(i2c_fd);
-                    return -1;
+                // 7seg-displayd に送る場合（SEG_DISPLAYD_PRIORITY）は I2C を開かず、ライターがデーモンへ送る
+                DisplayClient* output = displayd_output();
+                int i2c_fd = -1;
+                if (!output) {
+                    i2c_fd = open_i2c_auto(*live->display);
+                    if (i2c_fd < 0) {
+                        std::cerr << "I2C communication failed: No I2C devices found or access denied." << std::endl;
+                        return -1;
+                    }
+                    if (!initialize_displays(i2c_fd, *live->display)) {
+                        std::cerr << "Failed to initialize display modules." << std::endl;
+                        close(i2c_fd);
+                        return -1;
+                    }
                 }
 
                 // ライタースレッド
-                std::thread writer([&]{
+                std::thread writer([&, shown = live->display]() mutable {
+                    set_output_thread_realtime_from_env("file-player writer");
                     while (!writer_stop) {
-                        std::vector<uint8_t> frame;
+                        std::pair<std::shared_ptr<const LiveSettings>, std::vector<uint8_t>> frame;
                         {
                             std::unique_lock<std::mutex> lk(q_mtx);
                             if (q.empty()) {
@@ -72,13 +83,22 @@ int main(int argc, char* argv[]) {
                             q.pop_front();
                         }
 
-                        if (frame.empty()) continue;
+                        if (frame.second.empty()) continue;
+                        if (output) {
+                            const DisplayConfig& cfg = *frame.first->display;
+                            output->submit_grid(frame.second, cfg.total_width, cfg.total_height);
+                            continue;
+                        }
+                        if (frame.first->display != shown) {
+                            apply_layout_change(i2c_fd, *shown, *frame.first->display);
+                            shown = frame.first->display;
+                        }
                         I2CErrorInfo err;
                         // 非同期でも既存の更新関数を使う（モジュール単位で失敗しても戻る）
-                        if (!update_flexible_display(i2c_fd, config, frame, err)) {
+                        if (!update_flexible_display(i2c_fd, *shown, frame.second, err)) {
                             std::cerr << "[file-player writer] I2C write failed (non-blocking): attempting recovery" << std::endl;
                             // 復旧は試すが、失敗してもループ継続（メインはブロックされない）
-                            attempt_i2c_recovery(i2c_fd, config);
+                            attempt_i2c_recovery(i2c_fd, *shown);
                         }
                     }
                 });
@@ -96,7 +116,7 @@ int main(int argc, char* argv[]) {
                 }
                 if (!cap.isOpened()) {
                     std::cerr << "動画ソースを開けません: " << video_path << std::endl;
-                    writer_stop = true; q_cv.notify_all(); writer.join(); close(i2c_fd); return -1;
+                    writer_stop = true; q_cv.notify_all(); writer.join(); if (i2c_fd >= 0) close(i2c_fd); return -1;
                 }
 
                 bool use_ffplay = false;
@@ -121,28 +141,32 @@ int main(int argc, char* argv[]) {
 
                 double fps = cap.get(cv::CAP_PROP_FPS);
                 if (fps <= 0) fps = 30.0;
-                auto frame_duration = std::chrono::microseconds(static_cast<long long>(1000000.0 / fps));
 
-                auto next_frame_time = std::chrono::steady_clock::now();
+                // 動画の fps で締め切りを刻み、ライターへ渡すまでを1フレームの仕事とみなす
+                // 遅れて飛ばした締め切りの分は読み捨てて音声と揃える
+                FrameScheduler scheduler(fps);
                 cv::Mat frame;
-                while (!g_should_exit && !stop_flag && cap.read(frame)) {
+                while (!g_should_exit && !stop_flag) {
+                    const int skipped = scheduler.wait_next();
+                    for (int i = 0; i < skipped && cap.grab(); ++i) metrics::frames_dropped().inc();
+                    if (!cap.read(frame)) break;
+                    if (auto next = live_config().current()) live = std::move(next);
                     cv::Mat gray;
                     cv::cvtColor(frame, gray, cv::COLOR_BGR2GRAY);
                     cv::Mat bw;
-                    cv::threshold(gray, bw, min_threshold, max_threshold, cv::THRESH_BINARY);
+                    cv::threshold(gray, bw, live->min_threshold, live->max_threshold, cv::THRESH_BINARY);
                     std::vector<uint8_t> grid;
-                    frame_to_grid(bw, config, grid);
+                    frame_to_grid(bw, *live->display, grid);
 
                     // enqueue latest frame (非ブロッキング)
+                    scheduler.wait_commit();
                     {
                         std::lock_guard<std::mutex> lk(q_mtx);
-                        q.push_back(grid);
+                        q.emplace_back(live, std::move(grid));
                         if (q.size() > 4) q.pop_front();
                     }
                     q_cv.notify_one();
-
-                    next_frame_time += frame_duration;
-                    std::this_thread::sleep_until(next_frame_time);
+                    scheduler.commit_done();
                 }
 
                 // 停止処理
@@ -152,7 +176,7 @@ int main(int argc, char* argv[]) {
                     if (use_ffplay) system("killall ffplay > /dev/null 2>&1"); else { file_audio_stop(); audio_cleanup(); }
                 }
                 cap.release();
-                close(i2c_fd);
+                if (i2c_fd >= 0) close(i2c_fd);
                 return 0;
             };
 
@@ -179,8 +203,11 @@ int main(int argc, char* argv[]) {
             // ここでの待ちは不要。playback ループは g_should_exit を見て終了する。
 
             // 再生終了時に物理パネルを消灯する（エミュレータでは不要）
-            if (config.type != "emulator") {
-                if (!clear_all_displays(config)) {
+            if (DisplayClient* output = displayd_output()) {
+                // パネルはデーモンのもの。消灯せずに表示を手放す（次に優先度の高いソースへ切り替わる）
+                output->release();
+            } else if (config.type != "emulator") {
+                if (!clear_all_displays(*live_settings_or(config, scaling_mode, min_threshold, max_threshold)->display)) {
                     std::cerr << "Warning: failed to clear displays on exit." << std::endl;
                 } else {
                     std::cerr << "Displays cleared on exit." << std::endl;
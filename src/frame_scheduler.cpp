@@ -0,0 +1,283 @@
+// src/frame_scheduler.cpp
+#include "frame_scheduler.h"
+#include "led.h"
+#include "metrics.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <thread>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#ifndef __APPLE__
+#include <sys/timerfd.h>
+#endif
+
+FrameScheduler::FrameScheduler(double fps) {
+#ifndef __APPLE__
+    timer_fd_ = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC); // steady_clock と同じ時計
+#endif
+    if (const char* v = std::getenv("SEG_FRAME_LEAD_US")) {
+        fixed_commit_lead_ = true;
+        commit_lead_ns_ = std::max(0LL, std::atoll(v)) * 1000;
+    }
+    set_fps(fps);
+}
+
+FrameScheduler::~FrameScheduler() {
+    if (timer_fd_ >= 0) ::close(timer_fd_);
+}
+
+void FrameScheduler::set_fps(double fps) {
+    fps_ = std::max(1.0, std::min(kMaxFps, fps));
+    period_ = std::chrono::duration_cast<Clock::duration>(std::chrono::nanoseconds(std::llround(1e9 / fps_)));
+    start_ = Clock::now();
+    deadline_ = start_;
+    frame_ = 0;
+    waiting_commit_ = false;
+    commit_started_ = false;
+}
+
+void FrameScheduler::Estimate::add(double ns) {
+    if (!primed) {
+        mean = ns;
+        dev = ns / 4;
+        primed = true;
+        return;
+    }
+    mean += (ns - mean) / 8;
+    dev += (std::fabs(ns - mean) - dev) / 8;
+}
+
+void FrameScheduler::sleep_until(Clock::time_point t) {
+    if (t <= Clock::now()) return;
+#ifndef __APPLE__
+    if (timer_fd_ >= 0) {
+        const int64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(t.time_since_epoch()).count();
+        itimerspec its{};
+        its.it_value.tv_sec = static_cast<time_t>(ns / 1000000000);
+        its.it_value.tv_nsec = static_cast<long>(ns % 1000000000);
+        if (timerfd_settime(timer_fd_, TFD_TIMER_ABSTIME, &its, nullptr) == 0) {
+            uint64_t expirations;
+            // シグナルで起こされても締め切りまでは眠る（終了フラグは呼び出し側が次の周で見る）
+            while (::read(timer_fd_, &expirations, sizeof(expirations)) < 0 && errno == EINTR) {
+            }
+            return;
+        }
+    }
+#endif
+    std::this_thread::sleep_until(t);
+}
+
+int FrameScheduler::wait_next() {
+    ++frame_;
+    deadline_ = start_ + frame_ * period_;
+    const auto lead = std::chrono::nanoseconds(prepare_lead_ns_ + commit_lead_ns_);
+    const auto now = Clock::now();
+    int skipped = 0;
+    // 起床時刻を1周期以上過ぎていれば、間に合う締め切りまで飛ばす（まとめて出して追いつこうとしない）
+    if (now > deadline_ - lead + period_) {
+        const int64_t behind = (now - (deadline_ - lead)) / period_;
+        frame_ += behind;
+        deadline_ += behind * period_;
+        skipped = static_cast<int>(behind);
+        stats_.missed += static_cast<uint64_t>(behind);
+        metrics::frame_deadline_misses().inc(static_cast<uint64_t>(behind));
+    }
+    sleep_until(deadline_ - lead);
+    woke_at_ = Clock::now();
+    waiting_commit_ = true;
+    commit_started_ = false;
+    return skipped;
+}
+
+void FrameScheduler::wait_commit() {
+    if (!waiting_commit_ || commit_started_) return;
+    last_prepare_ns_ = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - woke_at_).count();
+    prepare_.add(static_cast<double>(last_prepare_ns_));
+    sleep_until(deadline_ - std::chrono::nanoseconds(commit_lead_ns_));
+    commit_at_ = Clock::now();
+    commit_started_ = true;
+}
+
+void FrameScheduler::commit_done() {
+    if (!waiting_commit_) return;
+    waiting_commit_ = false;
+    const auto now = Clock::now();
+
+    // wait_commit を呼ばない使い方では、起きてから書き込み終了までを書き込みの時間とみなす
+    const auto commit_from = commit_started_ ? commit_at_ : woke_at_;
+    if (!commit_started_) last_prepare_ns_ = 0;
+    last_commit_ns_ = std::chrono::duration_cast<std::chrono::nanoseconds>(now - commit_from).count();
+    commit_.add(static_cast<double>(last_commit_ns_));
+    commit_started_ = false;
+
+    // 合わせて周期の 3/4 までしか前倒ししない（それより重ければ締め切りを飛ばして追いつく）
+    const double max_lead = static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(period_).count()) * 0.75;
+    if (!fixed_commit_lead_) commit_lead_ns_ = static_cast<int64_t>(std::min(max_lead, commit_.lead()));
+    prepare_lead_ns_ = static_cast<int64_t>(std::max(0.0, std::min(max_lead - static_cast<double>(commit_lead_ns_), prepare_.lead())));
+
+    // jitter: 書き込みが終わった時刻と締め切りのずれ
+    const double jitter_us = std::fabs(std::chrono::duration<double, std::micro>(now - deadline_).count());
+    metrics::frame_jitter().observe_us(static_cast<uint64_t>(jitter_us));
+    ++stats_.frames;
+    jitter_sum_us_ += jitter_us;
+    stats_.max_abs_jitter_us = std::max(stats_.max_abs_jitter_us, jitter_us);
+}
+
+FrameScheduler::Stats FrameScheduler::stats() const {
+    Stats s = stats_;
+    s.mean_abs_jitter_us = s.frames ? jitter_sum_us_ / static_cast<double>(s.frames) : 0;
+    s.lead_us = lead_us();
+    s.commit_lead_us = commit_lead_us();
+    return s;
+}
+
+RateController::RateController(double initial_fps, double max_fps) {
+    if (const char* v = std::getenv("SEG_ADAPTIVE_FPS")) enabled_ = (std::atoi(v) != 0);
+    if (const char* v = std::getenv("SEG_OUTPUT_MIN_FPS")) min_fps_ = std::max(1.0, std::atof(v));
+    max_fps_ = std::max(min_fps_, max_fps);
+    fps_ = std::max(min_fps_, std::min(max_fps_, initial_fps));
+    if (!enabled_) fps_ = initial_fps;
+    prepare_ns_.reserve(kWindow);
+    commit_ns_.reserve(kWindow);
+    modules_.reserve(kWindow);
+    channels_.reserve(kWindow);
+    metrics::output_fps().set(static_cast<int64_t>(std::llround(fps_ * 1000)));
+}
+
+double RateController::percentile(std::vector<double> v, double q) {
+    if (v.empty()) return 0;
+    const size_t k = std::min(v.size() - 1, static_cast<size_t>(q * static_cast<double>(v.size())));
+    std::nth_element(v.begin(), v.begin() + static_cast<std::ptrdiff_t>(k), v.end());
+    return v[k];
+}
+
+// 書き込み時間 = ns_per_channel_ * 切り替え回数 + ns_per_module_ * モジュール数 を窓の中で最小二乗法で解く
+// 窓の中で2つが比例している（毎フレーム同じ1チャンネル・1モジュールだけ書くなど）と分けられないので、前の値を使う
+void RateController::fit_costs() {
+    double scc = 0, scm = 0, smm = 0, sct = 0, smt = 0;
+    for (size_t i = 0; i < commit_ns_.size(); ++i) {
+        const double c = channels_[i], m = modules_[i], t = commit_ns_[i];
+        scc += c * c;
+        scm += c * m;
+        smm += m * m;
+        sct += c * t;
+        smt += m * t;
+    }
+    const double det = scc * smm - scm * scm;
+    if (scc == 0 && smm > 0) {
+        // TCA を使わない構成（直結）ではモジュールだけ
+        ns_per_channel_ = 0;
+        ns_per_module_ = smt / smm;
+    } else if (det > 1e-6 * scc * smm) {
+        double per_channel = (sct * smm - smt * scm) / det;
+        double per_module = (smt * scc - sct * scm) / det;
+        // 負になったら（ばらつき）その項を 0 にして、もう一方だけで合わせる
+        if (per_channel < 0) {
+            per_channel = 0;
+            per_module = smt / smm;
+        } else if (per_module < 0) {
+            per_module = 0;
+            per_channel = sct / scc;
+        }
+        ns_per_channel_ = per_channel;
+        ns_per_module_ = per_module;
+    } else if (ns_per_channel_ == 0 && ns_per_module_ == 0 && scc + smm > 0) {
+        // まだ分けられたことがなければ、切り替えとモジュールを同じ重さとみなす
+        double st = 0, sn = 0;
+        for (size_t i = 0; i < commit_ns_.size(); ++i) {
+            st += commit_ns_[i];
+            sn += channels_[i] + modules_[i];
+        }
+        ns_per_channel_ = ns_per_module_ = (sn > 0) ? st / sn : 0;
+    }
+}
+
+bool RateController::observe(const FrameScheduler& scheduler, const UpdateStats& work) {
+    if (!enabled_) return false;
+    const double prepare = static_cast<double>(scheduler.last_prepare_ns());
+    const double commit = static_cast<double>(scheduler.last_commit_ns());
+    if (prepare_ns_.size() < kWindow) {
+        prepare_ns_.push_back(prepare);
+        commit_ns_.push_back(commit);
+        modules_.push_back(work.modules_written);
+        channels_.push_back(work.channel_selects);
+    } else {
+        prepare_ns_[next_] = prepare;
+        commit_ns_[next_] = commit;
+        modules_[next_] = work.modules_written;
+        channels_[next_] = work.channel_selects;
+    }
+    next_ = (next_ + 1) % kWindow;
+    ++frames_since_change_;
+    if (prepare_ns_.size() < 16) return false;
+
+    // 書き込むモジュール数は場面で変わるので、全体を書く時間で見積もる
+    fit_costs();
+    const double modules = std::max(percentile(modules_, 0.95), static_cast<double>(work.module_count));
+    const double channels = std::max(percentile(channels_, 0.95), static_cast<double>(work.channel_count));
+    const double full_write_ns = ns_per_channel_ * channels + ns_per_module_ * modules;
+    const double need_ns = percentile(prepare_ns_, 0.95) + std::max(percentile(commit_ns_, 0.95), full_write_ns);
+    sustainable_fps_ = (need_ns > 0) ? 0.8e9 / need_ns : max_fps_;
+    metrics::output_sustainable_fps().set(static_cast<int64_t>(std::llround(std::min(sustainable_fps_, 1e6) * 1000)));
+
+    double next = fps_;
+    if (sustainable_fps_ < fps_ * 0.95 && frames_since_change_ >= 16) {
+        next = std::floor(sustainable_fps_);
+    } else if (sustainable_fps_ > fps_ * 1.15 && frames_since_change_ >= static_cast<int64_t>(fps_)) {
+        next = std::floor(std::min(sustainable_fps_, fps_ * 1.25));
+    }
+    next = std::max(min_fps_, std::min(max_fps_, next));
+    if (std::fabs(next - fps_) < 0.5) return false;
+
+    std::cout << "[rate] output " << fps_ << " -> " << next << " fps (prepare p95 "
+              << static_cast<int64_t>(percentile(prepare_ns_, 0.95) / 1000) << " us, commit p95 "
+              << static_cast<int64_t>(percentile(commit_ns_, 0.95) / 1000) << " us, "
+              << percentile(modules_, 0.95) << " modules/frame, full write "
+              << static_cast<int64_t>(full_write_ns / 1000) << " us)" << std::endl;
+    fps_ = next;
+    frames_since_change_ = 0;
+    metrics::output_fps().set(static_cast<int64_t>(std::llround(fps_ * 1000)));
+    return true;
+}
+
+void set_output_thread_realtime_from_env(const char* thread_name) {
+    const char* v = std::getenv("SEG_RT_PRIORITY");
+    if (!v || !*v) return;
+    const int prio = std::max(1, std::min(99, std::atoi(v)));
+#ifdef __APPLE__
+    std::cerr << "[sched] " << thread_name << ": SCHED_FIFO is not supported on macOS (ignored)" << std::endl;
+    (void)prio;
+#else
+    sched_param sp{};
+    sp.sched_priority = prio;
+    const int rc = pthread_setschedparam(pthread_self(), SCHED_FIFO, &sp);
+    if (rc != 0) {
+        std::cerr << "[sched] " << thread_name << ": SCHED_FIFO " << prio << " failed: " << std::strerror(rc)
+                  << " (needs CAP_SYS_NICE or LimitRTPRIO)" << std::endl;
+    } else {
+        std::cout << "[sched] " << thread_name << ": SCHED_FIFO priority " << prio << std::endl;
+    }
+#endif
+}
+
+double output_fps_from_env(double fallback) {
+    if (const char* v = std::getenv("SEG_OUTPUT_FPS")) {
+        const double fps = std::atof(v);
+        if (fps > 0) return fps;
+    }
+    return fallback;
+}
+
+double output_max_fps_from_env(double fallback) {
+    if (const char* v = std::getenv("SEG_OUTPUT_MAX_FPS")) {
+        const double fps = std::atof(v);
+        if (fps > 0) return fps;
+    }
+    return fallback;
+}
@@ -0,0 +1,297 @@
+// src/grid_ring.cpp
+#include "grid_ring.h"
+
+#include <cerrno>
+#include <chrono>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <new>
+#include <thread>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#ifndef __APPLE__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#endif
+
+namespace {
+
+std::string normalize_name(const std::string& name) {
+    return (!name.empty() && name[0] == '/') ? name : "/" + name;
+}
+
+uint64_t now_ns() {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+#ifndef __APPLE__
+// プロセスをまたぐので FUTEX_PRIVATE_FLAG は付けない
+uint32_t* futex_word(std::atomic<uint32_t>& a) {
+    return reinterpret_cast<uint32_t*>(&a);
+}
+#endif
+
+void doorbell_wake(GridRingHeader* h) {
+    h->doorbell.fetch_add(1);
+#ifndef __APPLE__
+    if (h->waiting.load()) syscall(SYS_futex, futex_word(h->doorbell), FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+#endif
+}
+
+} // namespace
+
+std::string grid_ring_name() {
+    const char* v = std::getenv("SEG_GRID_RING");
+    if (!v || !*v) return "/7seg-grid";
+    if (std::string(v) == "0") return "";
+    return normalize_name(v);
+}
+
+// ---------------------------------------------------------------------------
+// デーモン側
+// ---------------------------------------------------------------------------
+GridRing::~GridRing() {
+    close();
+}
+
+bool GridRing::create(const std::string& name, int width, int height) {
+    close();
+    name_ = normalize_name(name);
+
+    // 前回のリング（デーモンの再起動や大きさの変更）に接続しているプロデューサへ作り直しを知らせる
+    int old = shm_open(name_.c_str(), O_RDWR, 0);
+    if (old >= 0) {
+        struct stat st{};
+        if (fstat(old, &st) == 0 && static_cast<size_t>(st.st_size) >= sizeof(GridRingHeader)) {
+            void* p = mmap(nullptr, sizeof(GridRingHeader), PROT_READ | PROT_WRITE, MAP_SHARED, old, 0);
+            if (p != MAP_FAILED) {
+                auto* h = static_cast<GridRingHeader*>(p);
+                if (h->magic == GRID_RING_MAGIC) {
+                    h->closed.store(1);
+                    doorbell_wake(h);
+                }
+                munmap(p, sizeof(GridRingHeader));
+            }
+        }
+        ::close(old);
+        shm_unlink(name_.c_str());
+    }
+
+    // スロット先頭を8バイト境界に揃える
+    const size_t slot_size = (sizeof(GridRingSlot) + static_cast<size_t>(width) * height + 7) & ~static_cast<size_t>(7);
+    map_size_ = sizeof(GridRingHeader) + slot_size * GRID_RING_SLOTS;
+
+    int fd = shm_open(name_.c_str(), O_CREAT | O_EXCL | O_RDWR, 0660);
+    if (fd < 0) {
+        std::cerr << "[grid-ring] shm_open failed: " << name_ << " (" << std::strerror(errno) << ")" << std::endl;
+        return false;
+    }
+    fchmod(fd, 0660); // umask に関係なく、同じグループのツールから書けるように
+    if (ftruncate(fd, static_cast<off_t>(map_size_)) < 0) {
+        std::cerr << "[grid-ring] ftruncate failed: " << name_ << " (" << std::strerror(errno) << ")" << std::endl;
+        ::close(fd);
+        shm_unlink(name_.c_str());
+        return false;
+    }
+    void* p = mmap(nullptr, map_size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (p == MAP_FAILED) {
+        std::cerr << "[grid-ring] mmap failed: " << name_ << " (" << std::strerror(errno) << ")" << std::endl;
+        shm_unlink(name_.c_str());
+        return false;
+    }
+    base_ = static_cast<uint8_t*>(p);
+    std::memset(base_, 0, map_size_);
+    header_ = new (base_) GridRingHeader{};
+    header_->version = GRID_RING_VERSION;
+    header_->width = static_cast<uint32_t>(width);
+    header_->height = static_cast<uint32_t>(height);
+    header_->slot_count = GRID_RING_SLOTS;
+    header_->slot_size = slot_size;
+    for (uint32_t i = 0; i < GRID_RING_SLOTS; ++i) {
+        new (slot_ptr(i)) GridRingSlot{};
+    }
+    last_read_ = 0;
+    width_ = width;
+    height_ = height;
+    slot_size_ = slot_size;
+    // magic は最後に書いて、プロデューサが初期化途中のヘッダを読まないようにする
+    __atomic_store_n(&header_->magic, GRID_RING_MAGIC, __ATOMIC_RELEASE);
+    return true;
+}
+
+void GridRing::close() {
+    if (!base_) return;
+    header_->closed.store(1);
+    doorbell_wake(header_);
+    munmap(base_, map_size_);
+    shm_unlink(name_.c_str());
+    base_ = nullptr;
+    header_ = nullptr;
+}
+
+uint8_t* GridRing::slot_ptr(uint64_t seq) const {
+    return base_ + sizeof(GridRingHeader) + slot_size_ * (seq % GRID_RING_SLOTS);
+}
+
+bool GridRing::read_latest(std::vector<uint8_t>& out) {
+    if (!header_) return false;
+    const size_t bytes = static_cast<size_t>(width_) * height_;
+    // コピー中に同じスロットが上書きされたら、より新しいフレームで読み直す
+    // publish_seq もプロデューサが書けるので、書き込み中の印が立った値は受け付けない（スロットは剰余で必ず範囲内）
+    for (int attempt = 0; attempt < 4; ++attempt) {
+        const uint64_t seq = header_->publish_seq.load(std::memory_order_acquire);
+        if (seq == 0 || seq == last_read_ || (seq & GRID_RING_WRITING)) return false;
+        auto* slot = reinterpret_cast<GridRingSlot*>(slot_ptr(seq));
+        if (slot->seq.load(std::memory_order_acquire) != seq) continue;
+        out.assign(reinterpret_cast<const uint8_t*>(slot) + sizeof(GridRingSlot),
+                   reinterpret_cast<const uint8_t*>(slot) + sizeof(GridRingSlot) + bytes);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot->seq.load(std::memory_order_relaxed) != seq) continue;
+        last_read_ = seq;
+        return true;
+    }
+    return false;
+}
+
+bool GridRing::wait(int timeout_ms) {
+    if (!header_) return false;
+    const uint32_t bell = header_->doorbell.load();
+    const uint64_t seq = header_->publish_seq.load(std::memory_order_acquire);
+    if (seq != 0 && seq != last_read_) return true;
+#ifdef __APPLE__
+    // macOS には futex がないので短い間隔で見に行く
+    (void)bell;
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+    while (std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+        if (header_->doorbell.load() != bell) break;
+    }
+#else
+    header_->waiting.store(1);
+    timespec ts{timeout_ms / 1000, (timeout_ms % 1000) * 1000000L};
+    syscall(SYS_futex, futex_word(header_->doorbell), FUTEX_WAIT, bell, &ts, nullptr, 0);
+    header_->waiting.store(0);
+#endif
+    const uint64_t after = header_->publish_seq.load(std::memory_order_acquire);
+    return after != 0 && after != last_read_;
+}
+
+void GridRing::wake() {
+    if (header_) doorbell_wake(header_);
+}
+
+// ---------------------------------------------------------------------------
+// プロデューサ側（C ABI）
+// ---------------------------------------------------------------------------
+struct grid_ring {
+    std::string name;
+    uint8_t* base = nullptr;
+    size_t map_size = 0;
+    GridRingHeader* header = nullptr;
+};
+
+namespace {
+
+bool map_ring(grid_ring* r) {
+    int fd = shm_open(r->name.c_str(), O_RDWR, 0);
+    if (fd < 0) return false;
+    struct stat st{};
+    if (fstat(fd, &st) < 0 || static_cast<size_t>(st.st_size) < sizeof(GridRingHeader)) {
+        ::close(fd);
+        return false;
+    }
+    void* p = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (p == MAP_FAILED) return false;
+    auto* h = static_cast<GridRingHeader*>(p);
+    // magic を読んでから他のフィールドを読む（magic が揃っていれば、デーモンが書いたヘッダの残りも見える）
+    const bool ready = __atomic_load_n(&h->magic, __ATOMIC_ACQUIRE) == GRID_RING_MAGIC;
+    if (!ready || h->version != GRID_RING_VERSION || h->slot_count != GRID_RING_SLOTS ||
+        sizeof(GridRingHeader) + h->slot_size * h->slot_count > static_cast<size_t>(st.st_size) || h->closed.load()) {
+        munmap(p, static_cast<size_t>(st.st_size));
+        return false;
+    }
+    r->base = static_cast<uint8_t*>(p);
+    r->map_size = static_cast<size_t>(st.st_size);
+    r->header = h;
+    return true;
+}
+
+void unmap_ring(grid_ring* r) {
+    if (r->base) munmap(r->base, r->map_size);
+    r->base = nullptr;
+    r->header = nullptr;
+}
+
+} // namespace
+
+extern "C" {
+
+grid_ring* grid_ring_attach(const char* name) {
+    auto* r = new grid_ring;
+    r->name = name ? normalize_name(name) : grid_ring_name();
+    if (r->name.empty() || !map_ring(r)) {
+        delete r;
+        return nullptr;
+    }
+    return r;
+}
+
+void grid_ring_detach(grid_ring* ring) {
+    if (!ring) return;
+    unmap_ring(ring);
+    delete ring;
+}
+
+int grid_ring_width(const grid_ring* ring) {
+    return (ring && ring->header) ? static_cast<int>(ring->header->width) : 0;
+}
+
+int grid_ring_height(const grid_ring* ring) {
+    return (ring && ring->header) ? static_cast<int>(ring->header->height) : 0;
+}
+
+int grid_ring_submit(grid_ring* ring, const uint8_t* grid, size_t len) {
+    if (!ring) return -2;
+    // デーモンが再起動した / 構成が変わって作り直された
+    if (!ring->header || ring->header->closed.load()) {
+        unmap_ring(ring);
+        if (!map_ring(ring)) return -2;
+    }
+    GridRingHeader* h = ring->header;
+    const size_t bytes = static_cast<size_t>(h->width) * h->height;
+    if (len != bytes) return -1;
+
+    // スロットは CAS で「書き込み中」にしてから書く。別のプロデューサが書き込み中（止まっている可能性もある）なら
+    // そのスロットは使わず、次の番号を取り直す。書き込み中のスロットに2人が同時に書くと、デーモンが番号の一致を
+    // 確認しても中身が混ざる（リングが一周する間止まっていたプロデューサが、新しいフレームを上書きする）
+    uint64_t seq = 0;
+    GridRingSlot* slot = nullptr;
+    for (uint32_t attempt = 0; attempt < 2 * h->slot_count && !slot; ++attempt) {
+        seq = h->claim_seq.fetch_add(1) + 1;
+        auto* s = reinterpret_cast<GridRingSlot*>(ring->base + sizeof(GridRingHeader) + h->slot_size * (seq % h->slot_count));
+        uint64_t cur = s->seq.load(std::memory_order_relaxed);
+        if ((cur & GRID_RING_WRITING) || cur > seq) continue;
+        if (s->seq.compare_exchange_strong(cur, seq | GRID_RING_WRITING, std::memory_order_acquire)) slot = s;
+    }
+    if (!slot) return -3;
+    std::atomic_thread_fence(std::memory_order_release);
+    slot->timestamp_ns = now_ns();
+    std::memcpy(reinterpret_cast<uint8_t*>(slot) + sizeof(GridRingSlot), grid, bytes);
+    slot->seq.store(seq, std::memory_order_release);
+
+    // 複数のプロデューサが同時に書いても publish_seq は後戻りさせない
+    uint64_t cur = h->publish_seq.load(std::memory_order_relaxed);
+    while (cur < seq && !h->publish_seq.compare_exchange_weak(cur, seq, std::memory_order_release)) {
+    }
+    doorbell_wake(h);
+    return 0;
+}
+
+} // extern "C"
@@ -1,6 +1,9 @@
 #include "common.h"
 #include "playback.h"
 #include "main_common.hpp" // ★★★ 共通ヘッダーをインクルード
+#include "metrics.h"
+#include "module_health.h"
+#include "live_config.h"
 #include "httplib.h"
 
 #include <vector>
@@ -29,14 +32,6 @@ const size_t MAX_FILE_SIZE = 100 * 1024 * 1024;
 std::vector<std::string> g_default_videos;
 size_t g_next_default_video_index = 0;
 
-// 画像処理パラメータ
-ScalingMode g_scaling_mode = ScalingMode::FIT;
-int g_min_threshold = 64;
-int g_max_threshold = 255;
-
-// I2Cエラー分析用のグローバル変数
-std::map<std::pair<int, int>, int> g_error_counts;
-
 // アプリケーション終了用のシグナルハンドラ
 void http_player_shutdown_handler(int signal_num) {
     if (signal_num == SIGINT) {
@@ -44,17 +39,7 @@ void http_player_shutdown_handler(int signal_num) {
             std::cout << "\nSIGINT received, shutting down..." << std::endl;
             
             // --- I2C Error Analysis ---
-            std::cout << "\n--- I2C Error Analysis ---" << std::endl;
-            if (g_error_counts.empty()) {
-                std::cout << "No I2C errors were recorded." << std::endl;
-            } else {
-                for (const auto& [key, count] : g_error_counts) {
-                    std::cout << "Channel: " << key.first 
-                              << ", Address: 0x" << std::hex << key.second << std::dec
-                              << "  => " << count << " errors" << std::endl;
-                }
-            }
-            std::cout << "--------------------------" << std::endl;
+            print_i2c_error_summary();
 
             g_should_exit = true;
         }
@@ -99,10 +84,12 @@ void playback_thread_worker(const DisplayConfig& config) { // ★★★ config
         }
 
         if (!path_to_play.empty()) {
+            // 画像処理パラメータは POST /config で再生中にも変わる（再生関数がフレームごとに読み直す）
+            auto live = live_settings_or(config, ScalingMode::FIT, 64, 255);
             if (config.type == "emulator") {
-                play_video_stream_emulator(path_to_play, config, g_stop_current_video, g_scaling_mode, g_min_threshold, g_max_threshold);
+                play_video_stream_emulator(path_to_play, *live->display, g_stop_current_video, live->scaling_mode, live->min_threshold, live->max_threshold);
             } else {
-                play_video_stream(path_to_play, config, g_stop_current_video, g_scaling_mode, g_min_threshold, g_max_threshold);
+                play_video_stream(path_to_play, *live->display, g_stop_current_video, live->scaling_mode, live->min_threshold, live->max_threshold);
             }
             g_stop_current_video = false; // 次の再生のためにリセット
             {
@@ -131,10 +118,12 @@ void playback_thread_worker_main(const DisplayConfig& config) {
         }
 
         if (!path_to_play.empty()) {
+            // 画像処理パラメータは POST /config で再生中にも変わる（再生関数がフレームごとに読み直す）
+            auto live = live_settings_or(config, ScalingMode::FIT, 64, 255);
             if (config.type == "emulator") {
-                play_video_stream_emulator(path_to_play, config, g_stop_current_video, g_scaling_mode, g_min_threshold, g_max_threshold);
+                play_video_stream_emulator(path_to_play, *live->display, g_stop_current_video, live->scaling_mode, live->min_threshold, live->max_threshold);
             } else {
-                play_video_stream(path_to_play, config, g_stop_current_video, g_scaling_mode, g_min_threshold, g_max_threshold);
+                play_video_stream(path_to_play, *live->display, g_stop_current_video, live->scaling_mode, live->min_threshold, live->max_threshold);
             }
             g_stop_current_video = false; // 次の再生のためにリセット
             {
@@ -157,11 +146,11 @@ int main(int argc, char* argv[]) {
             (void)debug; // debug flag is provided by caller; not used in this lambda
             (void)loop; // loop flag is not applicable to http_player
 
-            // 画像処理パラメータを設定
-            g_scaling_mode = scaling_mode;
-            g_min_threshold = min_threshold;
-            g_max_threshold = max_threshold;
-            
+            // 画像処理パラメータは common_main_runner が live_config() に発行済み
+            (void)scaling_mode;
+            (void)min_threshold;
+            (void)max_threshold;
+
             std::cout << "Using default video directory: '" << default_video_path << "'" << std::endl;
             load_default_videos(default_video_path, g_default_videos);
             
@@ -185,9 +174,79 @@ int main(int argc, char* argv[]) {
                         if (i < video_queue.size() - 1) json << ",";
                     }
                 }
+                json << "],";
+                // バックオフ中 / 隔離中のモジュール
+                json << "\"unhealthy_modules\": [";
+                bool first = true;
+                for (const auto& m : module_health().snapshot()) {
+                    if (m.consecutive_failures == 0) continue;
+                    if (!first) json << ",";
+                    first = false;
+                    json << "{\"channel\": " << m.channel << ", \"address\": " << m.address
+                         << ", \"failures\": " << m.consecutive_failures
+                         << ", \"quarantined\": " << (m.quarantined ? "true" : "false")
+                         << ", \"retry_in_ms\": " << m.retry_in_ms << "}";
+                }
                 json << "]}";
                 res.set_content(json.str(), "application/json");
             });
+
+            // 実行中の設定（表示構成 / 2値化 / スケーリング）
+            auto config_json = []() {
+                auto live = live_config().current();
+                std::stringstream json;
+                json << "{\"config\": \"" << live->display->name << "\", \"generation\": " << live->generation
+                     << ", \"total_width\": " << live->display->total_width
+                     << ", \"total_height\": " << live->display->total_height
+                     << ", \"scaling\": \"" << scaling_mode_name(live->scaling_mode) << "\""
+                     << ", \"min_threshold\": " << live->min_threshold
+                     << ", \"max_threshold\": " << live->max_threshold << "}";
+                return json.str();
+            };
+            svr.Get("/config", [config_json](const httplib::Request&, httplib::Response& res) {
+                res.set_content(config_json(), "application/json");
+            });
+            // scaling=fit|crop|stretch, min_threshold, max_threshold を変更する。reload=1 で config.json を読み直す
+            // どれも次のフレームから反映され、パイプラインや I2C は開き直さない
+            svr.Post("/config", [config_json](const httplib::Request& req, httplib::Response& res) {
+                std::string error;
+                if (req.form.has_field("reload") && req.form.get_field("reload") == "1") {
+                    if (!live_config().reload(error)) {
+                        res.status = 400;
+                        res.set_content("Reload failed: " + error, "text/plain");
+                        return;
+                    }
+                }
+                auto live = live_config().current();
+                ScalingMode mode = live->scaling_mode;
+                int min_t = live->min_threshold;
+                int max_t = live->max_threshold;
+                try {
+                    if (req.form.has_field("scaling") && !parse_scaling_mode(req.form.get_field("scaling"), mode)) {
+                        throw std::invalid_argument("scaling must be fit, crop or stretch");
+                    }
+                    if (req.form.has_field("min_threshold")) min_t = std::stoi(req.form.get_field("min_threshold"));
+                    if (req.form.has_field("max_threshold")) max_t = std::stoi(req.form.get_field("max_threshold"));
+                } catch (const std::exception& e) {
+                    res.status = 400;
+                    res.set_content(std::string("Invalid parameter: ") + e.what(), "text/plain");
+                    return;
+                }
+                const bool processing_changed = mode != live->scaling_mode || min_t != live->min_threshold ||
+                                                max_t != live->max_threshold;
+                if (processing_changed && !live_config().set_processing(mode, min_t, max_t, error)) {
+                    res.status = 400;
+                    res.set_content(error, "text/plain");
+                    return;
+                }
+                if (processing_changed) std::cout << "[config] scaling=" << scaling_mode_name(mode) << " threshold=" << min_t << "-" << max_t << std::endl;
+                res.set_content(config_json(), "application/json");
+            });
+
+            // Prometheus 形式の計測値（デコード / grid 変換 / I2C 書き込みのレイテンシなど）
+            svr.Get("/metrics", [](const httplib::Request&, httplib::Response& res) {
+                res.set_content(metrics::render_prometheus(), "text/plain; version=0.0.4");
+            });
             
             svr.Post("/upload", [&](const httplib::Request& req, httplib::Response& res) {
                 if (req.form.has_file("video_file")) {
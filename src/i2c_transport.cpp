@@ -0,0 +1,83 @@
+// src/i2c_transport.cpp
+#include "i2c_transport.h"
+#include <unistd.h>
+#include <sys/ioctl.h>
+#ifndef __APPLE__
+#include <linux/i2c-dev.h>
+#endif
+#include <cstdio>
+
+namespace {
+
+// /dev/i2c-N を直接叩く既定のトランスポート
+class LinuxI2CTransport : public I2CTransport {
+public:
+    bool set_slave(int fd, int addr) override {
+#ifdef __APPLE__
+        // MacではI2Cがないので、スタブ
+        (void)fd;
+        (void)addr;
+        return true;
+#else
+        return ioctl(fd, I2C_SLAVE, addr) >= 0;
+#endif
+    }
+    bool write(int fd, const uint8_t* data, size_t len) override {
+#ifdef __APPLE__
+        (void)fd;
+        (void)data;
+        (void)len;
+        return true;
+#else
+        return ::write(fd, data, len) == static_cast<ssize_t>(len);
+#endif
+    }
+    void settle_us(unsigned int usec) override {
+#ifdef __APPLE__
+        (void)usec;
+#else
+        if (usec > 0) usleep(usec);
+#endif
+    }
+};
+
+LinuxI2CTransport g_linux_transport;
+I2CTransport* g_transport = &g_linux_transport;
+
+} // namespace
+
+I2CTransport* get_i2c_transport() {
+    return g_transport;
+}
+
+void set_i2c_transport(I2CTransport* transport) {
+    g_transport = transport ? transport : &g_linux_transport;
+}
+
+bool FakeI2CTransport::set_slave(int, int addr) {
+    // ioctl はバスに何も流さないので時間は加算しない
+    if (addr != slave_) ++slave_switches_;
+    slave_ = addr;
+    return true;
+}
+
+bool FakeI2CTransport::write(int, const uint8_t*, size_t len) {
+    ++transactions_;
+    bytes_ += len;
+    // START + アドレス(8bit+ACK) + データ(各8bit+ACK) + STOP ≒ 9 * (len + 1) + 2 クロック
+    const uint64_t clocks = 9ull * (len + 1) + 2;
+    simulated_ns_ += clocks * 1000000000ull / bus_hz_ + overhead_ns_;
+    return slave_ != fail_addr_;
+}
+
+void FakeI2CTransport::settle_us(unsigned int usec) {
+    simulated_ns_ += static_cast<uint64_t>(usec) * 1000ull;
+}
+
+void FakeI2CTransport::reset() {
+    slave_ = -1;
+    transactions_ = 0;
+    bytes_ = 0;
+    slave_switches_ = 0;
+    simulated_ns_ = 0;
+}
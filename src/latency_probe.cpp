@@ -0,0 +1,111 @@
+// src/latency_probe.cpp
+#include "latency_probe.h"
+
+#include <algorithm>
+#include <iostream>
+
+namespace latency_probe {
+
+namespace {
+
+constexpr uint32_t kMask24 = 0xFFFFFF;
+
+uint8_t check_byte(uint32_t ms24) {
+    return static_cast<uint8_t>((ms24 ^ (ms24 >> 8) ^ (ms24 >> 16) ^ 0xA5) & 0xFF);
+}
+
+int64_t percentile(std::vector<int64_t>& v, double q) {
+    const size_t k = std::min(v.size() - 1, static_cast<size_t>(q * static_cast<double>(v.size())));
+    std::nth_element(v.begin(), v.begin() + static_cast<std::ptrdiff_t>(k), v.end());
+    return v[k];
+}
+
+} // namespace
+
+uint32_t now_ms24() {
+    // steady_clock と同じ時計（Linux では CLOCK_MONOTONIC）
+    const auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+    return static_cast<uint32_t>(ms) & kMask24;
+}
+
+void render(uint32_t ms24, int width, int height, std::vector<uint8_t>& gray) {
+    const uint32_t word = (static_cast<uint32_t>(check_byte(ms24 & kMask24)) << 24) | (ms24 & kMask24);
+    gray.assign(static_cast<size_t>(width) * height, 0);
+    for (int y = 0; y < height; ++y) {
+        const int row = y * kRows / height;
+        uint8_t* line = &gray[static_cast<size_t>(y) * width];
+        for (int x = 0; x < width; ++x) {
+            const int bit = row * kColumns + x * kColumns / width;
+            line[x] = ((word >> (31 - bit)) & 1) ? 255 : 0;
+        }
+    }
+}
+
+bool decode(const uint8_t* pixels, int width, int height, int pixel_step, size_t stride, uint32_t& ms24) {
+    if (!pixels || width < kColumns * 4 || height < kRows * 4) return false;
+    uint32_t word = 0;
+    // 各マスの中央の、マスの 1/4 四方を平均する（境目のにじみを避ける）
+    const int cell_w = width / kColumns;
+    const int cell_h = height / kRows;
+    const int half_w = std::max(1, cell_w / 8);
+    const int half_h = std::max(1, cell_h / 8);
+    for (int bit = 0; bit < kColumns * kRows; ++bit) {
+        const int cx = (bit % kColumns) * width / kColumns + cell_w / 2;
+        const int cy = (bit / kColumns) * height / kRows + cell_h / 2;
+        int sum = 0;
+        int n = 0;
+        int lo = 255;
+        int hi = 0;
+        for (int y = cy - half_h; y <= cy + half_h; ++y) {
+            const uint8_t* line = pixels + static_cast<size_t>(y) * stride;
+            for (int x = cx - half_w; x <= cx + half_w; ++x) {
+                const int v = line[static_cast<size_t>(x) * pixel_step];
+                sum += v;
+                lo = std::min(lo, v);
+                hi = std::max(hi, v);
+                ++n;
+            }
+        }
+        // パターンのマスは一様なので、中でむらのあるものは映像とみなす
+        if (hi - lo > 96) return false;
+        word = (word << 1) | ((sum / n) > 128 ? 1u : 0u);
+    }
+    ms24 = word & kMask24;
+    return static_cast<uint8_t>(word >> 24) == check_byte(ms24);
+}
+
+int64_t elapsed_ms(uint32_t ms24, std::chrono::steady_clock::time_point now) {
+    const auto now_ms = std::chrono::duration_cast<std::chrono::milliseconds>(now.time_since_epoch()).count();
+    const int64_t d = static_cast<int64_t>((static_cast<uint32_t>(now_ms) - ms24) & kMask24);
+    return d > 60000 ? -1 : d;
+}
+
+void Report::add(int64_t source_to_receive_ms, int64_t receive_to_commit_ms) {
+    receive_ms_.push_back(source_to_receive_ms);
+    commit_ms_.push_back(receive_to_commit_ms);
+    total_ms_.push_back(source_to_receive_ms + receive_to_commit_ms);
+}
+
+void Report::print_if_due(std::chrono::seconds interval) {
+    const auto now = std::chrono::steady_clock::now();
+    if (now - started_ < interval) return;
+    started_ = now;
+    if (total_ms_.empty()) {
+        std::cout << "[probe] no probe frames in the last " << interval.count() << " s" << std::endl;
+        return;
+    }
+    auto summary = [](std::vector<int64_t>& v) {
+        const int64_t p50 = percentile(v, 0.5);
+        const int64_t p95 = percentile(v, 0.95);
+        const int64_t max = *std::max_element(v.begin(), v.end());
+        return std::to_string(p50) + "/" + std::to_string(p95) + "/" + std::to_string(max);
+    };
+    std::cout << "[probe] " << total_ms_.size() << " frames, ms p50/p95/max: source->receive " << summary(receive_ms_)
+              << ", receive->commit " << summary(commit_ms_) << ", source->commit " << summary(total_ms_) << std::endl;
+    receive_ms_.clear();
+    commit_ms_.clear();
+    total_ms_.clear();
+}
+
+} // namespace latency_probe
@@ -0,0 +1,65 @@
+// src/latency_source.cpp
+// 7seg-latency-source: 時刻のパターン（latency_probe.h）を埋め込んだ 8bit グレーの raw 映像を標準出力へ書く
+//   ./7seg-latency-source --size 320x240 --fps 30 | gst-launch-1.0 fdsrc ! rawvideoparse format=gray8 ... ! x264enc ...
+// 各フレームは書き出す直前の時刻を持つので、エンコード・送信・受信・表示の遅れがすべて測れる。
+// ts / flv / flv_srv / rtp の送り方は latency_probe.sh にまとめてある。OpenCV / GStreamer 不要。
+#include "latency_probe.h"
+
+#include <algorithm>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+void print_usage(const char* prog) {
+    std::cerr << "Usage: " << prog << " [options] > raw.gray8\n"
+              << "  --size WxH     frame size (default 320x240)\n"
+              << "  --fps N        frames per second (default 30)\n"
+              << "  --seconds N    stop after N seconds (default: run until the pipe closes)\n"
+              << std::endl;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    int width = 320, height = 240, fps = 30;
+    double seconds = 0;
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        const bool has_value = (i + 1 < argc);
+        if (arg == "--size" && has_value) {
+            if (std::sscanf(argv[++i], "%dx%d", &width, &height) != 2 || width < 32 || height < 16) {
+                print_usage(argv[0]);
+                return 2;
+            }
+        } else if (arg == "--fps" && has_value) {
+            fps = std::max(1, std::atoi(argv[++i]));
+        } else if (arg == "--seconds" && has_value) {
+            seconds = std::atof(argv[++i]);
+        } else {
+            print_usage(argv[0]);
+            return (arg == "-h" || arg == "--help") ? 0 : 2;
+        }
+    }
+    // 読み手がいなくなったら fwrite の失敗で終わる
+    std::signal(SIGPIPE, SIG_IGN);
+
+    std::cerr << "[probe] " << width << "x" << height << " gray8 @ " << fps << " fps" << std::endl;
+    const auto period = std::chrono::nanoseconds(1000000000LL / fps);
+    const auto start = std::chrono::steady_clock::now();
+    std::vector<uint8_t> frame;
+    for (int64_t n = 0;; ++n) {
+        const auto due = start + n * period;
+        if (seconds > 0 && due - start >= std::chrono::duration<double>(seconds)) break;
+        std::this_thread::sleep_until(due);
+        latency_probe::render(latency_probe::now_ms24(), width, height, frame);
+        if (std::fwrite(frame.data(), 1, frame.size(), stdout) != frame.size() || std::fflush(stdout) != 0) break;
+    }
+    return 0;
+}
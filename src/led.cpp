@@ -1,8 +1,17 @@
 // src/led.cpp
 #include "led.h"
 #include "common.h"
+#include "i2c_transport.h"
+#include "metrics.h"
+#include "trace.h"
+#include "module_health.h"
+#include "routing_table.h"
+#include "module_ram.h"
+#include <algorithm>
+#include <memory>
 #include <vector>
 #include <map>
+#include <set>
 #include <cstring>
 #include <unistd.h>
 #include <fcntl.h>
@@ -13,59 +22,241 @@
 #include <cstdio>
 #include <cstdint>
 #include <iostream>
-
-// 現在選択されているチャンネルを記憶する (-1は未選択/直接接続)
-static int g_current_channel = -2; // 初期値を-2にして初回は必ず設定されるようにする
+#include <fstream>
+#include <string>
+#include <chrono>
+#include <cstdlib>
+
+// TCA9548A ごと（I2C の fd とアドレスの組）に、有効にしているチャンネルのビットを記憶する
+// (0 は全無効、-2 は不明で次は必ず書き込む)。同じバスに TCA が複数あっても互いの状態を上書きしない
+struct ExpanderState {
+    int fd;
+    int address;
+    int mask;
+};
+static std::vector<ExpanderState> g_expanders;
+// 計測のラベルに使う、今書いているモジュールの場所
+// バス（経路表のグループ・構成から呼び出し側が設定する）、TCA のアドレスとチャンネル（有効なチャンネルのうち最も小さいもの）。
+// 直接接続は TCA もチャンネルも -1
+static int g_current_bus = -1;
+static int g_current_tca = -1;
+static int g_current_channel = -1;
+
+// 最後にモジュールへ書けた表示RAM（経路表のモジュール順）。内容が変わらないモジュールには書き込まない
+// 電源の瞬断などで表示が消えても戻るよう、SEG_I2C_REFRESH_MS（既定 1000、0 で毎フレーム）ごとに全モジュールを書き直す
+struct ShadowRam {
+    std::shared_ptr<const RoutingTable> routing;
+    int fd = -1;
+    std::vector<uint8_t> ram; // module_count * MODULE_RAM_BYTES
+    std::vector<uint8_t> valid;
+    std::vector<uint8_t> dim; // 最後に書いた輝度 (0-15)。kDimUnknown は不明（起動直後・復旧後）
+    std::vector<metrics::ModuleSeries*> series; // モジュールごとの計測の系列（書き込みの度に表を引かない）
+    std::chrono::steady_clock::time_point refreshed_at{};
+};
+static constexpr uint8_t kDimUnknown = 0xFF;
+static ShadowRam g_shadow;
+// 直前の update_flexible_display の書き込み量（呼び出したスレッドごと）
+static thread_local UpdateStats t_last_update;
+
+const UpdateStats& last_update_stats() {
+    return t_last_update;
+}
 
 void reset_i2c_channel_cache() {
-    g_current_channel = -2; // 初期値に戻す
+    // 知っている TCA は残して状態だけ不明にする（別の TCA を選ぶ前に閉じられるように）
+    for (auto& e : g_expanders) e.mask = -2;
+    // 復旧や再初期化の後は、モジュールの表示RAM と輝度も当てにしない
+    std::fill(g_shadow.valid.begin(), g_shadow.valid.end(), 0);
+    std::fill(g_shadow.dim.begin(), g_shadow.dim.end(), kDimUnknown);
 }
 
+static ExpanderState& expander_state(int fd, int address) {
+    for (auto& e : g_expanders) {
+        if (e.fd == fd && e.address == address) return e;
+    }
+    g_expanders.push_back({fd, address, -2});
+    return g_expanders.back();
+}
 
+static int lowest_channel(uint8_t mask) {
+    return mask ? __builtin_ctz(mask) : -1;
+}
+
+// 複数チャンネルへの同時書き込み（初期化・消灯・同じ内容のモジュール）を使うか
+//   SEG_I2C_BROADCAST=0 で無効（チャンネルを1つずつ選んで書く従来の動作）
+static bool i2c_broadcast_enabled() {
+    static const bool enabled = [] {
+        const char* v = std::getenv("SEG_I2C_BROADCAST");
+        return !(v && std::atoi(v) == 0);
+    }();
+    return enabled;
+}
+
+// 変化のないモジュールも含めて全部書き直す間隔
+static std::chrono::milliseconds i2c_refresh_interval() {
+    static const std::chrono::milliseconds interval = [] {
+        const char* v = std::getenv("SEG_I2C_REFRESH_MS");
+        return std::chrono::milliseconds(v ? std::max(0, std::atoi(v)) : 1000);
+    }();
+    return interval;
+}
+
+static bool write_expander(int i2c_fd, int expander_addr, uint8_t channel_mask, I2CErrorInfo& error_info_out);
+static void close_other_expanders(int i2c_fd, int keep_address);
 
 // ★変更★ 戻り値の型を void から bool に変更
 bool select_i2c_channel(int i2c_fd, int expander_addr, int channel, I2CErrorInfo& error_info_out) {
-#ifdef __APPLE__
-    // MacではI2Cがないので、スタブ
-    (void)i2c_fd;
-    (void)expander_addr;
-    (void)channel;
-    (void)error_info_out;
-    return true;
-#else
     if (expander_addr < 0) {
+        // 直結のモジュールと同じアドレスが、開いたままの TCA のチャンネルにもあれば書き込みが漏れる
+        close_other_expanders(i2c_fd, -1);
+        g_current_tca = -1;
         g_current_channel = -1;
         return true; // TCAがない場合は常に成功
     }
-    if (channel == g_current_channel) {
+    return select_i2c_channels(i2c_fd, expander_addr, (channel < 0) ? 0 : static_cast<uint8_t>(1 << channel),
+                               error_info_out);
+}
+
+bool select_i2c_channels(int i2c_fd, int expander_addr, uint8_t channel_mask, I2CErrorInfo& error_info_out) {
+    const int channel = lowest_channel(channel_mask);
+    // 同じバスの他の TCA にチャンネルが開いていれば先に閉じる（同じアドレスのモジュールにも届いてしまう）
+    if (channel_mask != 0) close_other_expanders(i2c_fd, expander_addr);
+    ExpanderState& state = expander_state(i2c_fd, expander_addr);
+    if (channel_mask == state.mask) {
+        g_current_tca = expander_addr;
+        g_current_channel = channel;
         return true; // チャンネル変更が不要な場合は成功
     }
+    if (!write_expander(i2c_fd, expander_addr, channel_mask, error_info_out)) {
+        state.mask = -2;
+        return false; // ★変更★ エラー時に false を返す
+    }
+    state.mask = channel_mask;
+    g_current_tca = expander_addr;
+    g_current_channel = channel;
+    return true; // ★変更★ 成功時に true を返す
+}
+
+// TCA9548A の制御レジスタにチャンネルのビットを書く
+static bool write_expander(int i2c_fd, int expander_addr, uint8_t channel_mask, I2CErrorInfo& error_info_out) {
+    I2CTransport* bus = get_i2c_transport();
+    const int channel = lowest_channel(channel_mask);
 
-    if (ioctl(i2c_fd, I2C_SLAVE, expander_addr) < 0) {
+    if (!bus->set_slave(i2c_fd, expander_addr)) {
         fprintf(stderr, "ERROR: ioctl I2C_SLAVE for TCA9548A (0x%02X) failed\n", expander_addr);
         perror("ioctl");
+        metrics::module_write_errors(g_current_bus, expander_addr, channel, -1).inc();
         error_info_out.error_occurred = true;
         error_info_out.channel = channel;
         error_info_out.address = expander_addr; // エラーはエキスパンダ自体で発生
-        return false; // ★変更★ エラー時に false を返す
+        return false;
     }
-    uint8_t cmd = (channel < 0) ? 0x00 : (1 << channel);
-    if (write(i2c_fd, &cmd, 1) != 1) {
-        fprintf(stderr, "ERROR: Failed to write to TCA9548A (0x%02X) to select channel %d\n", expander_addr, channel);
+    uint8_t cmd = channel_mask;
+    if (!bus->write(i2c_fd, &cmd, 1)) {
+        fprintf(stderr, "ERROR: Failed to write to TCA9548A (0x%02X) to select channels 0x%02X\n", expander_addr, channel_mask);
         perror("write");
+        metrics::module_write_errors(g_current_bus, expander_addr, channel, -1).inc();
         error_info_out.error_occurred = true;
         error_info_out.channel = channel;
         error_info_out.address = expander_addr;
-        return false; // ★変更★ エラー時に false を返す
+        return false;
     }
-    
-    g_current_channel = channel;
-    usleep(1000); 
-    return true; // ★変更★ 成功時に true を返す
-#endif
+    bus->settle_us(1000);
+    ++t_last_update.channel_selects;
+    return true;
+}
+
+// 応答しない TCA は閉じたものとみなす（そこで止めると、生きている TCA まで書けなくなる）
+static void close_other_expanders(int i2c_fd, int keep_address) {
+    for (auto& e : g_expanders) {
+        if (e.fd != i2c_fd || e.address == keep_address || e.mask == 0) continue;
+        I2CErrorInfo unused;
+        if (!write_expander(i2c_fd, e.address, 0, unused)) {
+            fprintf(stderr, "WARN: could not disable channels on TCA9548A (0x%02X)\n", e.address);
+        }
+        e.mask = 0;
+    }
+}
+
+
+bool initialize_module(int i2c_fd, int addr) {
+    I2CTransport* bus = get_i2c_transport();
+    if (!bus->set_slave(i2c_fd, addr)) {
+        perror("ioctl I2C_SLAVE failed during initialization");
+        return false;
+    }
+    // 発振器ON / 表示ON・点滅なし / 輝度最大
+    uint8_t commands[] = { 0x21, 0x81, 0xEF };
+    for (uint8_t cmd : commands) {
+        if (!bus->write(i2c_fd, &cmd, 1)) {
+            fprintf(stderr, "ERROR [Init]: Failed to write command 0x%02X to addr 0x%02X\n", cmd, addr);
+            perror(" -> i2c write command");
+            return false;
+        }
+        bus->settle_us(1000);
+    }
+    return true;
 }
 
 
+// --- 起動時の初期化 ---
+// 電源を入れ直したモジュールは発振器が止まっていても 表示ON (0x81) に ACK を返すので、
+// 応答だけでは初期化済みかどうか分からない。初期化コマンドは毎回全て送り、送り方（まとめて送る）だけを速くする
+namespace {
+
+// 1チャンネル分のモジュールをまとめて初期化する
+// 全モジュールに発振器ONを送ってから1回だけ待ち、その後 表示ON / 輝度 を続けて送る
+// （モジュールごと・コマンドごとに待つと、モジュール数 x 3ms かかる）
+// 戻り値は初期化できたモジュール数。失敗したアドレスは failed に入る
+int initialize_channel_modules(int i2c_fd, const std::vector<int>& addrs, std::vector<int>& failed) {
+    I2CTransport* bus = get_i2c_transport();
+    auto send = [&](int addr, uint8_t cmd) {
+        if (!bus->set_slave(i2c_fd, addr) || !bus->write(i2c_fd, &cmd, 1)) {
+            fprintf(stderr, "ERROR [Init]: Failed to write command 0x%02X to addr 0x%02X\n", cmd, addr);
+            return false;
+        }
+        return true;
+    };
+
+    int done = 0;
+    std::vector<int> osc_on;
+    for (int addr : addrs) {
+        if (send(addr, 0x21)) {
+            osc_on.push_back(addr);
+        } else {
+            failed.push_back(addr);
+        }
+    }
+    if (osc_on.empty()) return done;
+    bus->settle_us(1000); // 発振器の起動待ち（チャンネルごとに1回）
+    for (int addr : osc_on) {
+        if (send(addr, 0x81) && send(addr, 0xEF)) {
+            ++done;
+        } else {
+            failed.push_back(addr);
+        }
+    }
+    return done;
+}
+
+// TCA の下のモジュールを「同時に有効にするチャンネルのビット → アドレス」にまとめる
+// 各アドレスはそのアドレスのモジュールがあるチャンネルだけを有効にして1回ずつ送る
+// （全チャンネルで 0x70-0x75 を使う構成なら、まとまりは1つで、送る回数はチャンネル数分の1になる）
+std::map<uint8_t, std::vector<int>> broadcast_sets(const TCA9548AConfig& tca) {
+    std::map<int, uint8_t> mask_of;
+    for (const auto& [channel, grid] : tca.channels) {
+        if (channel < 0 || channel > 7) continue;
+        for (const auto& row : grid) {
+            for (int addr : row) mask_of[addr] |= static_cast<uint8_t>(1 << channel);
+        }
+    }
+    std::map<uint8_t, std::vector<int>> sets;
+    for (const auto& [addr, mask] : mask_of) sets[mask].push_back(addr);
+    return sets;
+}
+
+} // namespace
+
 bool initialize_displays(int i2c_fd, const DisplayConfig& config) {
 #ifdef __APPLE__
     // MacではI2Cがないので、スタブ
@@ -74,89 +265,197 @@ bool initialize_displays(int i2c_fd, const DisplayConfig& config) {
     std::cout << "Initialization skipped on macOS (no I2C)" << std::endl;
     return true;
 #else
+    trace::Scope trace_scope("initialize_displays");
+    const auto t0 = std::chrono::steady_clock::now();
     std::cout << "Initializing modules..." << std::endl;
+
     I2CErrorInfo dummy_error_info; // ★★★ ダミーの変数を定義 ★★★
+    ModuleHealthTable& health = module_health();
+    reset_i2c_channel_cache(); // 前回の選択状態は信用しない
+    int initialized = 0;
+    int failures = 0;
 
+    // 注: open_i2c_auto は最初のバスの fd しか開かないため、バスは1本ずつ順に処理する
     for (const auto& [bus_id, bus_config] : config.buses) {
+        g_current_bus = bus_id;
         for (const auto& tca : bus_config.tca9548as) {
             bool use_tca = (tca.address != -1);
+            // チャンネルごとに初期化するモジュール（同時書き込みをしない / 失敗したものだけ）
+            std::map<int, std::vector<int>> per_channel;
             for (const auto& [channel, grid] : tca.channels) {
-                if (use_tca) {
-                    // チャンネル切り替えに失敗したら、即座に中断
-                    if (!select_i2c_channel(i2c_fd, tca.address, channel, dummy_error_info)) {
-                        fprintf(stderr, "ERROR [Init]: Failed to select channel %d on TCA 0x%02X\n", channel, tca.address);
-                        return false;
+                auto& addrs = per_channel[channel];
+                for (const auto& row : grid) addrs.insert(addrs.end(), row.begin(), row.end());
+            }
+            // 同じアドレスのモジュールがあるチャンネルを同時に有効にして1回で送る
+            // （ACK はどれか1つが返せば成立するので、失敗したアドレスはチャンネルごとにやり直す）
+            if (use_tca && i2c_broadcast_enabled() && tca.channels.size() > 1) {
+                for (auto& [channel, addrs] : per_channel) addrs.clear();
+                for (const auto& [mask, addrs] : broadcast_sets(tca)) {
+                    std::vector<int> failed;
+                    if (select_i2c_channels(i2c_fd, tca.address, mask, dummy_error_info)) {
+                        initialized += initialize_channel_modules(i2c_fd, addrs, failed) * __builtin_popcount(mask);
+                    } else {
+                        reset_i2c_channel_cache();
+                        failed = addrs;
                     }
-                    usleep(5000);
-                }
-
-                for (const auto& row : grid) {
-                    for (int addr : row) {
-                        if (ioctl(i2c_fd, I2C_SLAVE, addr) < 0) {
-                            perror("ioctl I2C_SLAVE failed during initialization");
-                            return false;
-                        }
-                        uint8_t commands[] = { 0x21, 0x81, 0xEF };
-                        for (uint8_t cmd : commands) {
-                            if (write(i2c_fd, &cmd, 1) != 1) {
-                                fprintf(stderr, "ERROR [Init]: Failed to write command 0x%02X to CH%d addr 0x%02X\n", cmd, channel, addr);
-                                perror(" -> i2c write command");
-                                // エラー発生時に即座に false を返す
-                                return false; 
-                            }
-                            usleep(1000);
+                    // 失敗したアドレスは、どのチャンネルのモジュールかを知るために1チャンネルずつやり直す
+                    for (int channel = 0; channel < 8; ++channel) {
+                        if (mask & (1 << channel)) {
+                            auto& retry = per_channel[channel];
+                            retry.insert(retry.end(), failed.begin(), failed.end());
                         }
                     }
                 }
             }
+            for (const auto& [channel, addrs] : per_channel) {
+                if (addrs.empty()) continue;
+                // チャンネル切り替えに失敗したら、そのチャンネルだけ諦める
+                if (use_tca && !select_i2c_channel(i2c_fd, tca.address, channel, dummy_error_info)) {
+                    fprintf(stderr, "ERROR [Init]: Failed to select channel %d on TCA 0x%02X\n", channel, tca.address);
+                    reset_i2c_channel_cache();
+                    health.report_init_failure(tca.address, channel, -1);
+                    record_i2c_error(bus_id, tca.address, channel, -1);
+                    ++failures;
+                    continue;
+                }
+
+                std::vector<int> failed;
+                initialized += initialize_channel_modules(i2c_fd, addrs, failed);
+                for (int addr : failed) {
+                    fprintf(stderr, "ERROR [Init]: Failed to initialize CH%d addr 0x%02X\n", channel, addr);
+                    health.report_init_failure(tca.address, channel, addr);
+                    record_i2c_error(bus_id, tca.address, channel, addr);
+                }
+                failures += static_cast<int>(failed.size());
+            }
             if (use_tca) {
                 // 全チャンネルを無効化
                 if (!select_i2c_channel(i2c_fd, tca.address, -1, dummy_error_info)) {
                     fprintf(stderr, "ERROR [Init]: Failed to disable all channels on TCA9548A 0x%02X\n", tca.address);
-                    return false;
+                    reset_i2c_channel_cache();
+                    ++failures;
                 }
             }
         }
     }
-    
-    std::cout << "Initialization complete." << std::endl;
-    return true; 
+
+    const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+    if (failures == 0) {
+        printf("Initialization complete: %d modules in %.1f ms\n", initialized, ms);
+        return true;
+    }
+    fprintf(stderr, "[Init] %d modules initialized, %d failures in %.1f ms\n", initialized, failures, ms);
+    // 失敗したモジュールは隔離済み（update_flexible_display が後で再初期化を試みる）。
+    // 1つも応答しない場合だけバス自体の異常として失敗を返す
+    return initialized > 0;
 #endif
 }
 
-
-bool update_module_from_grid(int i2c_bus_fd, int addr, const std::vector<uint8_t>& grid16, I2CErrorInfo& error_info_out) {
+bool apply_layout_change(int i2c_fd, const DisplayConfig& before, const DisplayConfig& after) {
 #ifdef __APPLE__
-    // MacではI2Cがないので、スタブ
-    (void)i2c_bus_fd;
-    (void)addr;
-    (void)grid16;
-    (void)error_info_out;
+    (void)i2c_fd;
+    (void)before;
+    (void)after;
     return true;
 #else
-    // ... バッファ作成のロジック...
-    uint8_t display_buffer[16] = {0};
-    const int DIGITS_PER_MODULE = 16; 
-    for (int digit_index = 0; digit_index < DIGITS_PER_MODULE && static_cast<size_t>(digit_index) < grid16.size(); ++digit_index) {
-        uint8_t bitmask = grid16[digit_index];
-        for (int seg = 0; seg < 8; ++seg) {
-            if ((bitmask >> seg) & 1) {
-                int base = seg * 2;
-                int addr_to_write, bit_pos;
-                if (digit_index < 8) {
-                    addr_to_write = base; bit_pos = digit_index;
-                } else {
-                    addr_to_write = base + 1; bit_pos = digit_index - 8;
-                }
-                if (addr_to_write < 16) {
-                    display_buffer[addr_to_write] |= (1 << bit_pos);
+    trace::Scope trace_scope("apply_layout_change");
+    // (TCA アドレス, チャンネル) → その下のモジュールアドレス
+    using ChannelKey = std::pair<int, int>;
+    auto modules_by_channel = [](const DisplayConfig& config) {
+        std::map<ChannelKey, std::set<int>> out;
+        for (const auto& [bus_id, bus_config] : config.buses) {
+            for (const auto& tca : bus_config.tca9548as) {
+                for (const auto& [channel, grid] : tca.channels) {
+                    auto& addrs = out[{tca.address, channel}];
+                    for (const auto& row : grid) addrs.insert(row.begin(), row.end());
                 }
             }
         }
+        return out;
+    };
+    const auto old_modules = modules_by_channel(before);
+    const auto new_modules = modules_by_channel(after);
+
+    // 新しく置かれたモジュールだけを初期化し、外されたモジュールは消灯する
+    // 同じ場所に残るモジュールは（桁の割り当てが変わっていても）次のフレームで書き直されるだけ
+    std::map<ChannelKey, std::vector<int>> added, removed;
+    for (const auto& [key, addrs] : new_modules) {
+        auto it = old_modules.find(key);
+        for (int addr : addrs) {
+            if (it == old_modules.end() || !it->second.count(addr)) added[key].push_back(addr);
+        }
+    }
+    for (const auto& [key, addrs] : old_modules) {
+        auto it = new_modules.find(key);
+        for (int addr : addrs) {
+            if (it == new_modules.end() || !it->second.count(addr)) removed[key].push_back(addr);
+        }
+    }
+    if (added.empty() && removed.empty()) return true;
+
+    // open_i2c_auto が開くのは最初のバスだけ
+    if (!after.buses.empty()) g_current_bus = after.buses.begin()->first;
+    ModuleHealthTable& health = module_health();
+    I2CErrorInfo dummy_error_info;
+    reset_i2c_channel_cache();
+    int initialized = 0;
+    int cleared = 0;
+    int failures = 0;
+
+    std::set<ChannelKey> touched;
+    for (const auto& [key, addrs] : added) touched.insert(key);
+    for (const auto& [key, addrs] : removed) touched.insert(key);
+    for (const auto& key : touched) {
+        const auto [tca_address, channel] = key;
+        if (tca_address >= 0 && !select_i2c_channel(i2c_fd, tca_address, channel, dummy_error_info)) {
+            fprintf(stderr, "ERROR [Reload]: Failed to select channel %d on TCA 0x%02X\n", channel, tca_address);
+            reset_i2c_channel_cache();
+            if (added.count(key)) health.report_init_failure(tca_address, channel, -1);
+            record_i2c_error(g_current_bus, tca_address, channel, -1);
+            ++failures;
+            continue;
+        }
+        if (auto it = removed.find(key); it != removed.end()) {
+            const uint8_t blank[ROUTING_MAX_DIGITS] = {0};
+            for (int addr : it->second) {
+                I2CErrorInfo err;
+                if (update_module_from_digits(i2c_fd, addr, blank, ROUTING_MAX_DIGITS, err)) ++cleared;
+            }
+        }
+        if (auto it = added.find(key); it != added.end()) {
+            std::vector<int> failed;
+            initialized += initialize_channel_modules(i2c_fd, it->second, failed);
+            for (int addr : failed) {
+                fprintf(stderr, "ERROR [Reload]: Failed to initialize CH%d addr 0x%02X\n", channel, addr);
+                health.report_init_failure(tca_address, channel, addr);
+                record_i2c_error(g_current_bus, tca_address, channel, addr);
+            }
+            failures += static_cast<int>(failed.size());
+        }
     }
+    reset_i2c_channel_cache();
+
+    printf("[Reload] layout change applied: %d modules initialized, %d cleared, %d failures\n",
+           initialized, cleared, failures);
+    return failures == 0;
+#endif
+}
+
+
+bool update_module_from_grid(int i2c_bus_fd, int addr, const std::vector<uint8_t>& grid16, I2CErrorInfo& error_info_out) {
+    return update_module_from_digits(i2c_bus_fd, addr, grid16.data(), static_cast<int>(grid16.size()), error_info_out);
+}
 
-    if (ioctl(i2c_bus_fd, I2C_SLAVE, addr) < 0) {
+// 表示RAM をそのままモジュールへ書く（有効なチャンネルが複数なら、その全てのモジュールに届く）
+// 所要時間と失敗は series に記録する
+static bool write_module_ram(int i2c_bus_fd, int addr, const uint8_t display_buffer[MODULE_RAM_BYTES],
+                             metrics::ModuleSeries& series, I2CErrorInfo& error_info_out) {
+    metrics::ScopedTimer timer(series.write);
+    trace::Scope trace_scope("module_write", "channel", g_current_channel, "addr", addr);
+    I2CTransport* bus = get_i2c_transport();
+    if (!bus->set_slave(i2c_bus_fd, addr)) {
         perror("ioctl I2C_SLAVE");
+        series.errors.inc();
         error_info_out.error_occurred = true;
         error_info_out.address = addr;
         return false; // ★変更★ エラー時に false を返す
@@ -165,17 +464,186 @@ bool update_module_from_grid(int i2c_bus_fd, int addr, const std::vector<uint8_t
     uint8_t buf[17];
     buf[0] = 0x00;
     memcpy(buf + 1, display_buffer, 16);
-    if (write(i2c_bus_fd, buf, 17) != 17) {
+    if (!bus->write(i2c_bus_fd, buf, 17)) {
         fprintf(stderr, "ERROR: Failed to write display data to module at address 0x%02X\n", addr);
         perror(" -> i2c write");
+        series.errors.inc();
         error_info_out.error_occurred = true;
         error_info_out.address = addr;
         return false; // ★変更★ エラー時に false を返す
     }
+    metrics::i2c_bytes().inc(sizeof(buf));
     return true; // ★変更★ 成功時に true を返す
-#endif
 }
 
+bool update_module_from_digits(int i2c_bus_fd, int addr, const uint8_t* digits, int digit_count, I2CErrorInfo& error_info_out) {
+    uint8_t display_buffer[MODULE_RAM_BYTES];
+    encode_module_ram(digits, digit_count, display_buffer);
+    metrics::ModuleSeries& series = metrics::module_series(g_current_bus, g_current_tca, g_current_channel, addr);
+    return write_module_ram(i2c_bus_fd, addr, display_buffer, series, error_info_out);
+}
+
+
+// 1モジュール / 1チャンネルの書き込み結果
+enum class CommitResult { Written, Skipped, Failed };
+
+// HT16K33 の輝度コマンド (0xE0 | level) を送る（チャンネルは選択済み）
+static bool write_module_dimming(int i2c_bus_fd, int addr, uint8_t level, metrics::ModuleSeries& series) {
+    I2CTransport* bus = get_i2c_transport();
+    const uint8_t cmd = static_cast<uint8_t>(0xE0 | (level & 0x0F));
+    if (!bus->set_slave(i2c_bus_fd, addr) || !bus->write(i2c_bus_fd, &cmd, 1)) {
+        fprintf(stderr, "ERROR: Failed to write dimming 0x%02X to module at address 0x%02X\n", cmd, addr);
+        series.errors.inc();
+        return false;
+    }
+    metrics::i2c_bytes().inc(1);
+    return true;
+}
+
+static void note_first_error(I2CErrorInfo& error_info_out, int channel, int address) {
+    if (error_info_out.error_occurred) return;
+    error_info_out.error_occurred = true;
+    error_info_out.channel = channel;
+    error_info_out.address = address;
+}
+
+// TCA9548A のチャンネルを健全性を見ながら選択する
+// 隔離からの再試行時は、チャンネル上の全モジュールを再初期化する。初期化できなかったモジュールはそれぞれ隔離し、
+// 1つも初期化できなければチャンネルごと失敗として扱う（切り替えに ACK が返っても、その先が生きているとは限らない）
+// 再初期化したら reinitialized を true にする（モジュールの輝度は最大に戻っている）
+static CommitResult select_channel_with_health(int i2c_fd, const RoutingTable& routing, const RoutingGroup& group,
+                                               I2CErrorInfo& error_info_out, bool& reinitialized) {
+    const int tca_address = group.tca_address;
+    const int channel = group.channel;
+    g_current_bus = group.bus;
+    if (tca_address < 0) {
+        I2CErrorInfo unused;
+        select_i2c_channel(i2c_fd, tca_address, channel, unused);
+        return CommitResult::Written;
+    }
+    ModuleHealthTable& health = module_health();
+    ModuleAction action = health.check(tca_address, channel, -1);
+    if (action == ModuleAction::Skip) return CommitResult::Skipped;
+
+    I2CErrorInfo err;
+    if (action == ModuleAction::Reinit) reset_i2c_channel_cache();
+    if (!select_i2c_channel(i2c_fd, tca_address, channel, err)) {
+        // 切り替えが中途半端な可能性があるので、次回は必ず選択し直す
+        reset_i2c_channel_cache();
+        health.report_failure(tca_address, channel, -1);
+        record_i2c_error(group.bus, tca_address, channel, -1);
+        note_first_error(error_info_out, channel, tca_address);
+        return CommitResult::Failed;
+    }
+    if (action == ModuleAction::Reinit) {
+        std::vector<int> addrs, failed;
+        for (size_t i = 0; i < group.module_count; ++i) {
+            addrs.push_back(routing.module(group.first_module + i).address);
+        }
+        const int initialized = initialize_channel_modules(i2c_fd, addrs, failed);
+        for (int addr : failed) {
+            fprintf(stderr, "ERROR [Reinit]: Failed to initialize CH%d addr 0x%02X\n", channel, addr);
+            health.report_init_failure(tca_address, channel, addr);
+            record_i2c_error(group.bus, tca_address, channel, addr);
+        }
+        if (initialized == 0 && !addrs.empty()) {
+            health.report_failure(tca_address, channel, -1);
+            note_first_error(error_info_out, channel, failed.empty() ? tca_address : failed.front());
+            return CommitResult::Failed;
+        }
+        reinitialized = true;
+    }
+    health.report_success(tca_address, channel, -1);
+    return CommitResult::Written;
+}
+
+// 健全性を見ながら1モジュールを書き込む。失敗してもフレームの残りは続ける
+// 隔離からの再試行で再初期化できたら reinitialized を true にする（輝度は最大に戻っている）
+static CommitResult commit_module(int i2c_fd, const RoutingGroup& group, int module_addr, const uint8_t* ram,
+                                  metrics::ModuleSeries& series, I2CErrorInfo& error_info_out, bool& reinitialized) {
+    const int tca_address = group.tca_address;
+    const int channel = group.channel;
+    ModuleHealthTable& health = module_health();
+    ModuleAction action = health.check(tca_address, channel, module_addr);
+    if (action == ModuleAction::Skip) return CommitResult::Skipped;
+
+    I2CErrorInfo err;
+    bool ok = true;
+    if (action == ModuleAction::Reinit) {
+        ok = initialize_module(i2c_fd, module_addr);
+        reinitialized = ok;
+    }
+    ok = ok && write_module_ram(i2c_fd, module_addr, ram, series, err);
+    if (ok) {
+        health.report_success(tca_address, channel, module_addr);
+        return CommitResult::Written;
+    }
+    health.report_failure(tca_address, channel, module_addr);
+    record_i2c_error(group.bus, tca_address, channel, module_addr);
+    note_first_error(error_info_out, channel, module_addr);
+    return CommitResult::Failed;
+}
+
+// 同じ TCA の別々のチャンネルに、同じアドレスで同じ表示RAM を書くモジュールがあれば、
+// それらのチャンネルを同時に有効にして1回で書く（左右対称の絵や空白の多い画面でトランザクションが減る）。
+// ACK はどれか1つのモジュールが返せば成立し、個々の失敗は見分けられないので、健全なモジュールだけをまとめ、
+// module_health() にも成功を報告しない（バックオフや再初期化待ちを同時書き込みで消さない）。
+// 黙って書けていないモジュールは、再送フレームのチャンネルごとの書き込みで見つける。
+// 書けなかったものはチャンネルごとの書き込みに回す。戻り値は書けたモジュール数（書いたものは done を 2 にする）
+static int broadcast_identical_modules(int i2c_fd, const RoutingTable& routing, const uint8_t* ram,
+                                       const uint16_t* group_of, metrics::ModuleSeries* const* series, uint8_t* done) {
+    ModuleHealthTable& health = module_health();
+    auto healthy = [&](const RoutingGroup& g, int addr) {
+        return health.check(g.tca_address, g.channel, -1) == ModuleAction::Write &&
+               health.check(g.tca_address, g.channel, addr) == ModuleAction::Write;
+    };
+    const size_t module_count = routing.module_count();
+    thread_local std::vector<size_t> members;
+    // done: 0 = 未書き込み, 1 = 変化なし, 2 = このフレームで書いた
+    int written = 0;
+    for (size_t i = 0; i < module_count; ++i) {
+        const RoutingGroup& gi = routing.group(group_of[i]);
+        const RoutingModule& mi = routing.module(i);
+        if (done[i] || gi.tca_address < 0 || gi.channel < 0 || gi.channel > 7) continue;
+        uint8_t mask = static_cast<uint8_t>(1 << gi.channel);
+        members.assign(1, i);
+        for (size_t j = i + 1; j < module_count; ++j) {
+            const RoutingGroup& gj = routing.group(group_of[j]);
+            if (done[j] || gj.tca_address != gi.tca_address || gj.bus != gi.bus || gj.channel < 0 || gj.channel > 7 ||
+                (mask & (1 << gj.channel)) || routing.module(j).address != mi.address ||
+                memcmp(ram + j * MODULE_RAM_BYTES, ram + i * MODULE_RAM_BYTES, MODULE_RAM_BYTES) != 0) {
+                continue;
+            }
+            mask |= static_cast<uint8_t>(1 << gj.channel);
+            members.push_back(j);
+        }
+        if (members.size() < 2) continue;
+        // バックオフ中・再初期化待ちのモジュールは外して、チャンネルごとの書き込みに任せる
+        mask = 0;
+        size_t kept = 0;
+        for (size_t k : members) {
+            const RoutingGroup& g = routing.group(group_of[k]);
+            if (!healthy(g, mi.address)) continue;
+            mask |= static_cast<uint8_t>(1 << g.channel);
+            members[kept++] = k;
+        }
+        members.resize(kept);
+        if (members.size() < 2) continue;
+
+        trace::Scope scope("tca_broadcast", "channels", mask, "addr", mi.address);
+        g_current_bus = gi.bus;
+        I2CErrorInfo err;
+        if (!select_i2c_channels(i2c_fd, gi.tca_address, mask, err)) {
+            reset_i2c_channel_cache();
+            continue;
+        }
+        if (!write_module_ram(i2c_fd, mi.address, ram + i * MODULE_RAM_BYTES, *series[i], err)) continue;
+        for (size_t k : members) done[k] = 2;
+        written += static_cast<int>(members.size());
+        metrics::i2c_broadcast_saved_writes().inc(members.size() - 1);
+    }
+    return written;
+}
 
 /**
  * @brief 物理レイアウトを元にディスプレイ全体を更新する (修正版)
@@ -187,216 +655,193 @@ bool update_module_from_grid(int i2c_bus_fd, int addr, const std::vector<uint8_t
 
 
 bool update_flexible_display(int i2c_fd, const DisplayConfig& config, const std::vector<uint8_t>& grid, I2CErrorInfo& error_info_out) {
-#ifdef __APPLE__
-    // MacではI2Cがないので、スタブ
-    (void)i2c_fd;
-    (void)config;
-    (void)grid;
-    (void)error_info_out;
-    return true;
-#else
-    (void)0; // placeholder to avoid unused warnings
-    int global_row_offset = 0;
-    int global_col_offset = 0;
-
-    for (const auto& [bus_id, bus_config] : config.buses) {
-        // Bus ごとにオフセットをリセット
-        int bus_row_offset = 0;
-        int bus_col_offset = 0;
-        for (const auto& tca : bus_config.tca9548as) {
-            bool use_tca = (tca.address != -1);
-            // 48x8の場合：rowsベースの処理
-            if (config.total_width == 48 && config.total_height == 8 && !tca.rows.empty()) {
-                if (getenv("DEBUG_LED")) {
-                    printf("DEBUG: Using rows-based processing, rows.size()=%zu\n", tca.rows.size());
-                    printf("DEBUG: total_width=%d, total_height=%d\n", config.total_width, config.total_height);
-                }
-                for (const auto& [row_id, row_config] : tca.rows) {
-                    auto [channel, row_offset, col_offset] = row_config;
-                    if (getenv("DEBUG_LED")) printf("DEBUG: Processing row_id=%d, channel=%d, row_offset=%d, col_offset=%d\n", row_id, channel, row_offset, col_offset);
-                    if (tca.channels.find(channel) == tca.channels.end()) continue;
-                    const auto& address_grid = tca.channels.at(channel);
-                    
-                    if (use_tca) {
-                        if (!select_i2c_channel(i2c_fd, tca.address, channel, error_info_out)) {
-                            return false;
-                        }
-                    }
-                    
-                    if (address_grid.empty()) continue;
-                    const int channel_grid_height = address_grid.size();
-                    const int channel_grid_width = address_grid[0].size();
-
-                    // Precompute per-module widths/heights for this address grid
-                    std::vector<std::vector<int>> mod_widths(channel_grid_height, std::vector<int>(channel_grid_width));
-                    std::vector<std::vector<int>> mod_heights(channel_grid_height, std::vector<int>(channel_grid_width));
-                    for (int rr = 0; rr < channel_grid_height; ++rr) {
-                        for (int cc = 0; cc < channel_grid_width; ++cc) {
-                            int maddr = address_grid[rr][cc];
-                            auto [mw, mh] = config.module_size_for_address(maddr);
-                            mod_widths[rr][cc] = mw;
-                            mod_heights[rr][cc] = mh;
-                        }
-                    }
+    static const std::vector<uint8_t> full_brightness;
+    return update_flexible_display(i2c_fd, config, grid, full_brightness, error_info_out);
+}
 
-                    for (int grid_r = 0; grid_r < channel_grid_height; ++grid_r) {
-                        for (int grid_c = 0; grid_c < channel_grid_width; ++grid_c) {
-                            int module_addr = address_grid[grid_r][grid_c];
-                            // compute start col by summing widths of previous modules in the same row
-                            int col_sum = 0;
-                            for (int pc = 0; pc < grid_c; ++pc) col_sum += mod_widths[grid_r][pc];
-                            int module_start_col = col_offset + bus_col_offset + col_sum;
-                            // compute start row by summing heights of previous rows at this column
-                            int row_sum = 0;
-                            for (int pr = 0; pr < grid_r; ++pr) row_sum += mod_heights[pr][grid_c];
-                            int module_start_row = row_offset + bus_row_offset + row_sum;
-
-                            int mod_w = mod_widths[grid_r][grid_c];
-                            int mod_h = mod_heights[grid_r][grid_c];
-                            std::vector<uint8_t> local_module_buffer(mod_w * mod_h);
-
-                            for (int r_in_mod = 0; r_in_mod < mod_h; ++r_in_mod) {
-                                for (int c_in_mod = 0; c_in_mod < mod_w; ++c_in_mod) {
-                                    int total_grid_col = global_col_offset + module_start_col + c_in_mod;
-                                    int total_grid_row = global_row_offset + module_start_row + r_in_mod;
-                                    int grid_index = total_grid_row * config.total_width + total_grid_col;
-                                    int logical_idx = r_in_mod * mod_w + c_in_mod;
-                                    const std::vector<int>* idx_map = config.module_index_map_for_address(module_addr);
-                                    int module_buffer_index = logical_idx;
-                                    if (idx_map && static_cast<int>(idx_map->size()) == mod_w * mod_h) {
-                                        module_buffer_index = (*idx_map)[logical_idx];
-                                    } else {
-                                        int use_c = c_in_mod;
-                                        bool reverse_cols = config.module_columns_reversed(module_addr);
-                                        if (reverse_cols) use_c = (mod_w - 1 - c_in_mod);
-                                        module_buffer_index = r_in_mod * mod_w + use_c;
-                                    }
-                                    if (static_cast<size_t>(grid_index) < grid.size() && static_cast<size_t>(module_buffer_index) < local_module_buffer.size()) {
-                                        local_module_buffer[module_buffer_index] = grid[grid_index];
-                                    }
-                                }
-                            }
-
-                            if (!update_module_from_grid(i2c_fd, module_addr, local_module_buffer, error_info_out)) {
-                                fprintf(stderr, "Failed to update module at CH%d addr 0x%02X. Aborting update.\n", channel, module_addr);
-                                error_info_out.channel = channel; 
-                                return false;
-                            }
-                        }
-                    }
-                }
-            } else {
-                // 従来のチャンネルベースの処理
-                for (const auto& [channel, address_grid] : tca.channels) {
-                    if (use_tca) {
-                        // ★変更★ select_i2c_channel の戻り値を確認
-                        if (!select_i2c_channel(i2c_fd, tca.address, channel, error_info_out)) {
-                            return false;
-                        }
-                    }
-                    if (address_grid.empty()) continue;
-                    const int channel_grid_height = address_grid.size();
-                    const int channel_grid_width = address_grid[0].size();
-
-                    // 48x8の場合の特殊処理：チャンネル番号に基づいてオフセットを決定
-                    int channel_row_offset = 0;
-                    int channel_col_offset = 0;
-                    if (config.total_width == 48 && config.total_height == 8) {
-                        // チャンネル0,2：上半分（行0-3）、チャンネル1,3：下半分（行4-7）
-                        channel_row_offset = (channel % 2) * 4;
-                        // チャンネル0,1：左半分（列0-23）、チャンネル2,3：右半分（列24-47）
-                        channel_col_offset = (channel / 2) * 24;
-                        fprintf(stderr, "DEBUG: Channel %d -> row_offset=%d, col_offset=%d\n", channel, channel_row_offset, channel_col_offset);
-                    }
+bool update_flexible_display(int i2c_fd, const DisplayConfig& config, const std::vector<uint8_t>& grid,
+                             const std::vector<uint8_t>& brightness, I2CErrorInfo& error_info_out) {
+    // 実際のバス操作は I2CTransport 経由（macOS では何もしない既定実装）
+    metrics::ScopedTimer commit_timer(metrics::i2c_commit_latency());
+    trace::Scope trace_scope("update_flexible_display");
+    t_last_update = UpdateStats{};
+
+    // 配置は load_config_from_json がコンパイル済みの経路表を引く
+    // （手で組み立てた DisplayConfig の場合はここでコンパイルする）
+    std::shared_ptr<const RoutingTable> routing = config.routing;
+    if (!routing) {
+        std::vector<std::string> errors, warnings;
+        routing = RoutingTable::compile(config, 0, errors, warnings);
+        if (!routing) {
+            for (const auto& e : errors) fprintf(stderr, "ERROR: invalid layout: %s\n", e.c_str());
+            return false;
+        }
+    }
 
-                    // Precompute per-module widths/heights for this address grid
-                    std::vector<std::vector<int>> mod_widths(channel_grid_height, std::vector<int>(channel_grid_width));
-                    std::vector<std::vector<int>> mod_heights(channel_grid_height, std::vector<int>(channel_grid_width));
-                    for (int rr = 0; rr < channel_grid_height; ++rr) {
-                        for (int cc = 0; cc < channel_grid_width; ++cc) {
-                            int maddr = address_grid[rr][cc];
-                            auto [mw, mh] = config.module_size_for_address(maddr);
-                            mod_widths[rr][cc] = mw;
-                            mod_heights[rr][cc] = mh;
-                        }
-                    }
+    // 全モジュールの表示RAM を1回で作る（モジュール順に16バイトずつ）と、そのモジュールが属するグループ（チャンネル）
+    const size_t module_count = routing->module_count();
+    t_last_update.module_count = static_cast<int>(module_count);
+    for (size_t gi = 0; gi < routing->group_count(); ++gi) {
+        if (routing->group(gi).tca_address >= 0) ++t_last_update.channel_count;
+    }
+    thread_local std::vector<uint8_t> ram;
+    thread_local std::vector<uint16_t> group_of;
+    thread_local std::vector<uint8_t> done; // 0 = 未書き込み, 1 = 変化なし, 2 = このフレームで書いた
+    thread_local std::vector<uint8_t> dim_pending; // 1 = 輝度コマンドを送る（表示RAM とは別に見る）
+    ram.resize(module_count * MODULE_RAM_BYTES);
+    group_of.resize(module_count);
+    dim_pending.assign(module_count, 0);
+    const bool dimming = (brightness.size() == module_count);
+    encode_panel_ram(*routing, grid.data(), grid.size(), ram.data());
+    done.assign(module_count, 0);
+
+    // 前のフレームと違う経路表・バスなら、書いた内容の記録は使えない
+    ShadowRam& shadow = g_shadow;
+    const auto now = std::chrono::steady_clock::now();
+    bool refresh_frame = false;  // 全モジュールを書き直すフレーム（同時書き込みをせず、1つずつ ACK を確かめる）
+    if (shadow.routing != routing || shadow.fd != i2c_fd) {
+        shadow.routing = routing;
+        shadow.fd = i2c_fd;
+        shadow.ram.assign(module_count * MODULE_RAM_BYTES, 0);
+        shadow.valid.assign(module_count, 0);
+        shadow.dim.assign(module_count, kDimUnknown);
+        shadow.series.assign(module_count, nullptr);
+        for (size_t gi = 0; gi < routing->group_count(); ++gi) {
+            const RoutingGroup& group = routing->group(gi);
+            const int channel = group.tca_address >= 0 ? group.channel : -1;
+            for (size_t mi = group.first_module; mi < group.first_module + group.module_count; ++mi) {
+                shadow.series[mi] = &metrics::module_series(group.bus, group.tca_address, channel,
+                                                            routing->module(mi).address);
+            }
+        }
+        shadow.refreshed_at = now;
+        refresh_frame = true;
+    }
+    if (now - shadow.refreshed_at >= i2c_refresh_interval()) {
+        std::fill(shadow.valid.begin(), shadow.valid.end(), 0);
+        shadow.refreshed_at = now;
+        refresh_frame = true;
+    }
 
-                    for (int grid_r = 0; grid_r < channel_grid_height; ++grid_r) {
-                        for (int grid_c = 0; grid_c < channel_grid_width; ++grid_c) {
-                            int module_addr = address_grid[grid_r][grid_c];
-                            // compute start col by summing widths of previous modules in the same row
-                            int col_sum = 0;
-                            for (int pc = 0; pc < grid_c; ++pc) col_sum += mod_widths[grid_r][pc];
-                            int module_start_col = channel_col_offset + bus_col_offset + col_sum;
-                            // compute start row by summing heights of previous rows at this column
-                            int row_sum = 0;
-                            for (int pr = 0; pr < grid_r; ++pr) row_sum += mod_heights[pr][grid_c];
-                            int module_start_row = channel_row_offset + bus_row_offset + row_sum;
-
-                            int mod_w = mod_widths[grid_r][grid_c];
-                            int mod_h = mod_heights[grid_r][grid_c];
-                            std::vector<uint8_t> local_module_buffer(mod_w * mod_h);
-
-                            for (int r_in_mod = 0; r_in_mod < mod_h; ++r_in_mod) {
-                                for (int c_in_mod = 0; c_in_mod < mod_w; ++c_in_mod) {
-                                    int total_grid_col = global_col_offset + module_start_col + c_in_mod;
-                                    int total_grid_row = global_row_offset + module_start_row + r_in_mod;
-                                    int grid_index = total_grid_row * config.total_width + total_grid_col;
-                                    int logical_idx = r_in_mod * mod_w + c_in_mod;
-                                    const std::vector<int>* idx_map2 = config.module_index_map_for_address(module_addr);
-                                    int module_buffer_index2 = logical_idx;
-                                    if (idx_map2 && static_cast<int>(idx_map2->size()) == mod_w * mod_h) {
-                                        module_buffer_index2 = (*idx_map2)[logical_idx];
-                                    } else {
-                                        int use_c = c_in_mod;
-                                        bool reverse_cols = config.module_columns_reversed(module_addr);
-                                        if (reverse_cols) use_c = (mod_w - 1 - c_in_mod);
-                                        module_buffer_index2 = r_in_mod * mod_w + use_c;
-                                    }
-                                    if (static_cast<size_t>(grid_index) < grid.size() && static_cast<size_t>(module_buffer_index2) < local_module_buffer.size()) {
-                                        local_module_buffer[module_buffer_index2] = grid[grid_index];
-                                    }
-                                }
-                            }
-
-                            if (!update_module_from_grid(i2c_fd, module_addr, local_module_buffer, error_info_out)) {
-                                fprintf(stderr, "Failed to update module at CH%d addr 0x%02X. Aborting update.\n", channel, module_addr);
-                                error_info_out.channel = channel; 
-                                return false; // エラーを伝播
-                            }
-                        }
-                    }
+    bool multi_channel = false;
+    int pending = 0;
+    for (size_t gi = 0; gi < routing->group_count(); ++gi) {
+        const RoutingGroup& group = routing->group(gi);
+        multi_channel = multi_channel || (gi > 0 && group.tca_address >= 0 &&
+                                          group.tca_address == routing->group(gi - 1).tca_address);
+        for (size_t mi = group.first_module; mi < group.first_module + group.module_count; ++mi) {
+            group_of[mi] = static_cast<uint16_t>(gi);
+            // 輝度を指定しないときは初期化の 0xEF（最大）のまま。このプロセスで暗くしたモジュールだけ戻す
+            dim_pending[mi] = dimming ? (shadow.dim[mi] != (brightness[mi] & 0x0F))
+                                      : (shadow.dim[mi] != kDimUnknown && shadow.dim[mi] != 15);
+            if (shadow.valid[mi] && memcmp(&shadow.ram[mi * MODULE_RAM_BYTES], &ram[mi * MODULE_RAM_BYTES], MODULE_RAM_BYTES) == 0) {
+                done[mi] = 1;
+                if (dim_pending[mi]) ++pending;
+            } else {
+                ++pending;
+            }
+        }
+    }
+    if (pending == 0) return true; // 前のフレームと同じ表示
+
+    // 失敗したモジュール / チャンネルは module_health() が休ませ、残りはこのフレームで書き込む
+    int written = 0;
+    int failed = 0;
+    int selects_tried = 0;  // TCA のチャンネルを選ぼうとしたグループ（バックオフ中のものは数えない）
+    int selects_failed = 0;
+    if (multi_channel && !refresh_frame && i2c_broadcast_enabled()) {
+        written += broadcast_identical_modules(i2c_fd, *routing, ram.data(), group_of.data(), shadow.series.data(),
+                                               done.data());
+    }
 
-                    // compute channel width/height in digits by summing per-module sizes
-                    int channel_width_in_digits = 0;
-                    for (int cc = 0; cc < channel_grid_width; ++cc) {
-                        // assume top row's widths represent column widths
-                        channel_width_in_digits += mod_widths[0][cc];
-                    }
-                    int channel_height_in_digits = 0;
-                    for (int rr = 0; rr < channel_grid_height; ++rr) {
-                        // assume left column's heights represent row heights
-                        channel_height_in_digits += mod_heights[rr][0];
-                    }
-                    if ((bus_col_offset + channel_width_in_digits) < config.total_width) {
-                        bus_col_offset += channel_width_in_digits;
-                    } else {
-                        bus_col_offset = 0;
-                        bus_row_offset += channel_height_in_digits;
-                    }
+    // 書き込むモジュールのあるチャンネルを、今選ばれているチャンネルから順に回る（切り替えを1回減らす）
+    const size_t group_count = routing->group_count();
+    auto has_pending = [&](const RoutingGroup& group) {
+        for (size_t mi = group.first_module; mi < group.first_module + group.module_count; ++mi) {
+            if (done[mi] == 0 || dim_pending[mi]) return true;
+        }
+        return false;
+    };
+    // 再初期化したモジュールは輝度が 0xEF（最大）に戻るので、覚えていた輝度を捨てて同じフレームで送り直す
+    auto forget_dimming = [&](size_t mi) {
+        shadow.dim[mi] = kDimUnknown;
+        dim_pending[mi] = dimming;
+    };
+    size_t start = 0;
+    for (size_t gi = 0; gi < group_count; ++gi) {
+        const RoutingGroup& group = routing->group(gi);
+        if (group.tca_address >= 0 && group.channel >= 0 && has_pending(group) &&
+            expander_state(i2c_fd, group.tca_address).mask == (1 << group.channel)) {
+            start = gi;
+            break;
+        }
+    }
+    for (size_t k = 0; k < group_count; ++k) {
+        const size_t gi = (start + k) % group_count;
+        const RoutingGroup& group = routing->group(gi);
+        if (!has_pending(group)) continue; // 変化がないか、同時書き込みで済んだ
+        const size_t end = group.first_module + group.module_count;
+        trace::Scope channel_scope("tca_channel", "channel", group.channel, "tca_addr", group.tca_address);
+        bool channel_reinit = false;
+        CommitResult selected = select_channel_with_health(i2c_fd, *routing, group, error_info_out, channel_reinit);
+        if (group.tca_address >= 0 && selected != CommitResult::Skipped) ++selects_tried;
+        if (selected != CommitResult::Written) {
+            if (selected == CommitResult::Failed) {
+                ++failed;
+                ++selects_failed;
+            }
+            continue;
+        }
+        if (channel_reinit) {
+            for (size_t mi = group.first_module; mi < end; ++mi) forget_dimming(mi);
+        }
+        for (size_t mi = group.first_module; mi < end; ++mi) {
+            const RoutingModule& m = routing->module(mi);
+            if (!done[mi]) {
+                bool module_reinit = false;
+                CommitResult r = commit_module(i2c_fd, group, m.address, &ram[mi * MODULE_RAM_BYTES], *shadow.series[mi],
+                                               error_info_out, module_reinit);
+                if (module_reinit) forget_dimming(mi);
+                if (r == CommitResult::Written) {
+                    done[mi] = 2;
+                    ++written;
+                } else {
+                    if (r == CommitResult::Failed) ++failed;
+                    continue; // 表示RAM を書けないモジュールには輝度も送らない
+                }
+            }
+            if (dim_pending[mi]) {
+                // 輝度は1バイトなので、同じチャンネル選択のまま続けて送る
+                const uint8_t level = dimming ? (brightness[mi] & 0x0F) : 15;
+                if (write_module_dimming(i2c_fd, m.address, level, *shadow.series[mi])) {
+                    shadow.dim[mi] = level;
+                } else {
+                    shadow.dim[mi] = kDimUnknown;
+                    record_i2c_error(group.bus, group.tca_address, group.channel, m.address);
+                    note_first_error(error_info_out, group.channel, m.address);
+                    ++failed;
                 }
             }
         }
-        // Bus のオフセットをグローバルに反映
-        if ((global_col_offset + bus_col_offset) < config.total_width) {
-            global_col_offset += bus_col_offset;
-        } else {
-            global_col_offset = 0;
-            global_row_offset += bus_row_offset;
+    }
+
+    t_last_update.modules_written = written;
+    // 書けたモジュールだけ記録する（失敗・バックオフ中のものは次のフレームでも書く）
+    for (size_t mi = 0; mi < module_count; ++mi) {
+        if (done[mi] == 2) {
+            memcpy(&shadow.ram[mi * MODULE_RAM_BYTES], &ram[mi * MODULE_RAM_BYTES], MODULE_RAM_BYTES);
+            shadow.valid[mi] = 1;
+        } else if (done[mi] == 0) {
+            shadow.valid[mi] = 0;
         }
     }
-    return true; // ★変更★ すべて成功したら true を返す
-#endif
+    // 1つも書けずに失敗だけした場合、次のどちらかならバス全体の障害とみなし、呼び出し側の全体復旧に任せる
+    //   - 全モジュールを書こうとした
+    //   - 選ぼうとした TCA のチャンネルが全て失敗した（変化の少ないフレームでも、TCA が応答しなければバスの異常）
+    // 変化のある1モジュールだけが失敗したフレームでは判断しない（そのモジュールは module_health() が休ませる）
+    const bool all_pending_failed = (pending == static_cast<int>(module_count));
+    const bool all_selects_failed = (selects_tried > 0 && selects_failed == selects_tried);
+    return !(failed > 0 && written == 0 && (all_pending_failed || all_selects_failed));
 }
 
 
@@ -434,34 +879,57 @@ bool clear_all_displays(const DisplayConfig& config) {
     }
 
     I2CErrorInfo dummy;
+    I2CTransport* bus = get_i2c_transport();
+    auto clear_module = [&](int addr) {
+        if (!bus->set_slave(fd, addr)) {
+            perror("ioctl I2C_SLAVE failed during clear_all_displays");
+            return false;
+        }
+        uint8_t buf[17];
+        buf[0] = 0x00; // register 0x00
+        memset(buf + 1, 0x00, 16);
+        const bool ok = bus->write(fd, buf, 17);
+        if (!ok) {
+            fprintf(stderr, "ERROR: Failed to write clear data to module at address 0x%02X\n", addr);
+            perror(" -> i2c write");
+        }
+        bus->settle_us(1000);
+        return ok;
+    };
+    reset_i2c_channel_cache();
     // 全モジュールに対して0表示を書き込む
     for (const auto& [bus_id, bus_config] : config.buses) {
         for (const auto& tca : bus_config.tca9548as) {
             bool use_tca = (tca.address != -1);
+            // チャンネルごとに消すモジュール（同時書き込みをしない / 失敗したものだけ）
+            std::map<int, std::vector<int>> per_channel;
             for (const auto& [channel, address_grid] : tca.channels) {
+                auto& addrs = per_channel[channel];
+                for (const auto& row : address_grid) addrs.insert(addrs.end(), row.begin(), row.end());
+            }
+            // 同じアドレスのモジュールがあるチャンネルを同時に有効にして、各アドレスに1回だけ送る
+            if (use_tca && i2c_broadcast_enabled() && tca.channels.size() > 1) {
+                for (auto& [channel, addrs] : per_channel) addrs.clear();
+                for (const auto& [mask, addrs] : broadcast_sets(tca)) {
+                    const bool selected = select_i2c_channels(fd, tca.address, mask, dummy);
+                    if (!selected) reset_i2c_channel_cache();
+                    for (int addr : addrs) {
+                        if (selected && clear_module(addr)) continue;
+                        for (int channel = 0; channel < 8; ++channel) {
+                            if (mask & (1 << channel)) per_channel[channel].push_back(addr);
+                        }
+                    }
+                }
+            }
+            for (const auto& [channel, addrs] : per_channel) {
+                if (addrs.empty()) continue;
                 if (use_tca) {
                     if (!select_i2c_channel(fd, tca.address, channel, dummy)) {
                         std::cerr << "ERROR: Failed to select channel " << channel << " on TCA 0x" << std::hex << tca.address << std::dec << std::endl;
                         // 続行は試みるがエラーを記録
                     }
                 }
-
-                for (const auto& row : address_grid) {
-                    for (int addr : row) {
-                        if (ioctl(fd, I2C_SLAVE, addr) < 0) {
-                            perror("ioctl I2C_SLAVE failed during clear_all_displays");
-                            continue;
-                        }
-                        uint8_t buf[17];
-                        buf[0] = 0x00; // register 0x00
-                        memset(buf + 1, 0x00, 16);
-                        if (write(fd, buf, 17) != 17) {
-                            fprintf(stderr, "ERROR: Failed to write clear data to module at address 0x%02X\n", addr);
-                            perror(" -> i2c write");
-                        }
-                        usleep(1000);
-                    }
-                }
+                for (int addr : addrs) clear_module(addr);
             }
             if (use_tca) {
                 // 全チャンネルを無効化
@@ -0,0 +1,234 @@
+// src/live_config.cpp
+#include "live_config.h"
+#include "common.h"
+#include "config_loader.hpp"
+#include "trace.h"
+
+#include <cctype>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <set>
+#include <unistd.h>
+#include <poll.h>
+#ifndef __APPLE__
+#include <sys/inotify.h>
+#endif
+
+namespace {
+
+std::set<int> bus_ids(const DisplayConfig& config) {
+    std::set<int> ids;
+    for (const auto& [bus_id, bus_config] : config.buses) ids.insert(bus_id);
+    return ids;
+}
+
+// エディタは一時ファイルに書いて rename することが多いので、ファイルではなくディレクトリを監視する
+std::string dir_of(const std::string& path) {
+    size_t slash = path.find_last_of('/');
+    if (slash == std::string::npos) return ".";
+    if (slash == 0) return "/";
+    return path.substr(0, slash);
+}
+
+std::string base_of(const std::string& path) {
+    size_t slash = path.find_last_of('/');
+    return (slash == std::string::npos) ? path : path.substr(slash + 1);
+}
+
+} // namespace
+
+LiveConfig::~LiveConfig() {
+    // main から stop せずに抜けても、joinable な std::thread の破棄で落ちないようにする
+    stop_watcher();
+}
+
+void LiveConfig::publish_initial(const DisplayConfig& config, ScalingMode scaling_mode, int min_threshold,
+                                 int max_threshold, const std::string& config_name, const std::string& config_file) {
+    std::lock_guard<std::mutex> lock(write_mtx_);
+    config_name_ = config_name;
+    config_file_ = config_file;
+    auto next = std::make_shared<LiveSettings>();
+    next->display = std::make_shared<const DisplayConfig>(config);
+    next->scaling_mode = scaling_mode;
+    next->min_threshold = min_threshold;
+    next->max_threshold = max_threshold;
+    publish(std::move(next));
+}
+
+std::shared_ptr<const LiveSettings> LiveConfig::current() const {
+    return std::atomic_load(&current_);
+}
+
+// write_mtx_ を持った状態で呼ぶ
+void LiveConfig::publish(std::shared_ptr<const LiveSettings> next) {
+    auto prev = std::atomic_load(&current_);
+    auto stamped = std::make_shared<LiveSettings>(*next);
+    stamped->generation = prev ? prev->generation + 1 : 1;
+    std::atomic_store(&current_, std::shared_ptr<const LiveSettings>(std::move(stamped)));
+}
+
+bool LiveConfig::reload(std::string& error) {
+    trace::Scope trace_scope("config_reload");
+    std::lock_guard<std::mutex> lock(write_mtx_);
+    auto cur = std::atomic_load(&current_);
+    if (!cur || config_name_.empty()) {
+        error = "no configuration has been published yet";
+        return false;
+    }
+
+    DisplayConfig loaded;
+    try {
+        // 検証と経路表のコンパイルもここで済ませる（描画ループでは何もコンパイルしない）
+        loaded = load_config_from_json(config_name_, config_file_);
+    } catch (const std::exception& e) {
+        error = e.what();
+        return false;
+    }
+    // I2C の fd と描画先（実機 / エミュレータ）は起動時に決まるので、ここは変えられない
+    if (bus_ids(loaded) != bus_ids(*cur->display)) {
+        error = "I2C bus numbers changed; restart the player to apply";
+        return false;
+    }
+    if (loaded.type != cur->display->type) {
+        error = "type changed (" + cur->display->type + " -> " + loaded.type + "); restart the player to apply";
+        return false;
+    }
+
+    auto next = std::make_shared<LiveSettings>(*cur);
+    next->display = std::make_shared<const DisplayConfig>(std::move(loaded));
+    publish(std::move(next));
+    return true;
+}
+
+bool LiveConfig::set_processing(ScalingMode scaling_mode, int min_threshold, int max_threshold, std::string& error) {
+    if (min_threshold < 0 || min_threshold > 255 || max_threshold < 0 || max_threshold > 255) {
+        error = "thresholds must be in 0..255";
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(write_mtx_);
+    auto cur = std::atomic_load(&current_);
+    if (!cur) {
+        error = "no configuration has been published yet";
+        return false;
+    }
+    auto next = std::make_shared<LiveSettings>(*cur); // display は同じものを共有する
+    next->scaling_mode = scaling_mode;
+    next->min_threshold = min_threshold;
+    next->max_threshold = max_threshold;
+    publish(std::move(next));
+    return true;
+}
+
+bool LiveConfig::start_watcher() {
+    if (watching_) return true;
+    int inotify_fd = -1;
+#ifndef __APPLE__
+    const char* v = std::getenv("SEG_CONFIG_WATCH");
+    if (!(v && std::string(v) == "0")) {
+        inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (inotify_fd < 0) {
+            perror("[config] inotify_init1");
+        } else if (inotify_add_watch(inotify_fd, dir_of(config_file_).c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+            perror("[config] inotify_add_watch");
+            close(inotify_fd);
+            inotify_fd = -1;
+        } else {
+            std::cout << "[config] watching " << config_file_ << " for changes" << std::endl;
+        }
+    }
+#endif
+    watching_ = true;
+    watcher_ = std::thread(&LiveConfig::watch_loop, this, inotify_fd);
+    return true;
+}
+
+void LiveConfig::stop_watcher() {
+    if (!watching_) return;
+    watching_ = false;
+    if (watcher_.joinable()) watcher_.join();
+}
+
+void LiveConfig::watch_loop(int inotify_fd) {
+    trace::set_thread_name("config_watch");
+    using clock = std::chrono::steady_clock;
+    // 保存1回で複数のイベントが来るので、最後のイベントから少し待ってから読み直す
+    constexpr auto kDebounce = std::chrono::milliseconds(200);
+    const std::string watched = base_of(config_file_);
+    bool pending = false;
+    clock::time_point due{};
+
+    while (watching_) {
+        if (inotify_fd >= 0) {
+#ifndef __APPLE__
+            pollfd pfd{inotify_fd, POLLIN, 0};
+            if (::poll(&pfd, 1, 200) > 0 && (pfd.revents & POLLIN)) {
+                alignas(inotify_event) char buf[4096];
+                ssize_t n = ::read(inotify_fd, buf, sizeof(buf));
+                for (ssize_t off = 0; n > 0 && off < n;) {
+                    const auto* ev = reinterpret_cast<const inotify_event*>(buf + off);
+                    if (ev->len > 0 && watched == ev->name) {
+                        pending = true;
+                        due = clock::now() + kDebounce;
+                    }
+                    off += static_cast<ssize_t>(sizeof(inotify_event) + ev->len);
+                }
+            }
+#endif
+        } else {
+            std::this_thread::sleep_for(std::chrono::milliseconds(200));
+        }
+        if (g_reload_requested.exchange(false)) {
+            std::cout << "[config] SIGHUP received" << std::endl;
+            pending = true;
+            due = clock::now();
+        }
+        if (!pending || clock::now() < due) continue;
+        pending = false;
+
+        std::string error;
+        if (reload(error)) {
+            auto cur = current();
+            std::cout << "[config] reloaded " << config_name_ << " (generation " << cur->generation << ", "
+                      << cur->display->total_width << "x" << cur->display->total_height << ")" << std::endl;
+        } else {
+            std::cerr << "[config] reload failed, keeping the current layout: " << error << std::endl;
+        }
+    }
+    if (inotify_fd >= 0) close(inotify_fd);
+}
+
+LiveConfig& live_config() {
+    static LiveConfig instance;
+    return instance;
+}
+
+std::shared_ptr<const LiveSettings> live_settings_or(const DisplayConfig& config, ScalingMode scaling_mode,
+                                                     int min_threshold, int max_threshold) {
+    if (auto cur = live_config().current()) return cur;
+    auto fixed = std::make_shared<LiveSettings>();
+    fixed->display = std::make_shared<const DisplayConfig>(config);
+    fixed->scaling_mode = scaling_mode;
+    fixed->min_threshold = min_threshold;
+    fixed->max_threshold = max_threshold;
+    return fixed;
+}
+
+bool parse_scaling_mode(const std::string& name, ScalingMode& out) {
+    std::string s;
+    for (char c : name) s += static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+    if (s == "fit") out = ScalingMode::FIT;
+    else if (s == "crop") out = ScalingMode::CROP;
+    else if (s == "stretch") out = ScalingMode::STRETCH;
+    else return false;
+    return true;
+}
+
+const char* scaling_mode_name(ScalingMode mode) {
+    switch (mode) {
+        case ScalingMode::CROP: return "CROP";
+        case ScalingMode::STRETCH: return "STRETCH";
+        case ScalingMode::FIT: return "FIT";
+    }
+    return "FIT";
+}
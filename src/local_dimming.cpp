@@ -0,0 +1,60 @@
+// src/local_dimming.cpp
+#include "local_dimming.h"
+#include "routing_table.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+
+void LocalDimming::update(const RoutingTable& routing, std::vector<uint8_t>& levels, bool gray) {
+    const size_t module_count = routing.module_count();
+    // 経路表が変わったら最大から始める（initialize_displays と同じ）
+    if (brightness_.size() != module_count) brightness_.assign(module_count, kMaxLevel);
+    const size_t cells = levels.size() / 8;
+
+    for (size_t mi = 0; mi < module_count; ++mi) {
+        const RoutingModule& m = routing.module(mi);
+        int sum = 0;
+        int lit = 0;
+        int peak = 0;
+        for (int d = 0; d < m.digit_count; ++d) {
+            const uint16_t cell = m.cell[d];
+            if (cell == ROUTING_NO_CELL || cell >= cells) continue;
+            const uint8_t* seg = &levels[static_cast<size_t>(cell) * 8];
+            for (int b = 0; b < 8; ++b) {
+                if (seg[b] == 0) continue;
+                sum += seg[b];
+                ++lit;
+                peak = std::max(peak, static_cast<int>(seg[b]));
+            }
+        }
+        if (lit == 0) continue;
+
+        const double level = gray ? peak : static_cast<double>(sum) / lit;
+        const double target = std::max(0.0, std::min(static_cast<double>(kMaxLevel), level * 16.0 / kMaxLevel - 1.0));
+        const int current = brightness_[mi];
+        // 擬似階調ではセグメントが明るさを受け持つので、輝度は最大の明るさを下回らない段まで上げる
+        if (gray && target > current) {
+            brightness_[mi] = static_cast<uint8_t>(std::ceil(target));
+        } else if (std::fabs(target - current) >= 0.75) {
+            brightness_[mi] = static_cast<uint8_t>(gray ? std::ceil(target) : std::lround(target));
+        }
+        if (!gray) continue;
+
+        // デューティが (輝度 + 1) / 16 に下がった分だけセグメントの明るさを上げる
+        const int scale = brightness_[mi] + 1;
+        for (int d = 0; d < m.digit_count; ++d) {
+            const uint16_t cell = m.cell[d];
+            if (cell == ROUTING_NO_CELL || cell >= cells) continue;
+            uint8_t* seg = &levels[static_cast<size_t>(cell) * 8];
+            for (int b = 0; b < 8; ++b) {
+                seg[b] = static_cast<uint8_t>(std::min(kMaxLevel, (seg[b] * 16 + scale / 2) / scale));
+            }
+        }
+    }
+}
+
+bool local_dimming_from_env() {
+    const char* v = std::getenv("SEG_LOCAL_DIMMING");
+    return v && std::atoi(v) != 0;
+}
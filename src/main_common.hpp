@@ -6,10 +6,10 @@
 #include <stdexcept>
 #include "config.h"
 #include "config_loader.hpp"
+#include "metrics.h"
 #include <map>
 #include <utility>
 
-extern std::map<std::pair<int, int>, int> g_error_counts;
 
 
 #pragma once
@@ -23,8 +23,9 @@ extern std::map<std::pair<int, int>, int> g_error_counts;
 #include <map>
 #include <utility>
 #include "playback.h" // ScalingModeのため
+#include "live_config.h"
+#include "display_client.h"
 
-extern std::map<std::pair<int, int>, int> g_error_counts;
 
 
 // C++17の [[nodiscard]] 属性。戻り値を使わないと警告を出す。
@@ -99,6 +100,7 @@ int common_main_runner(const std::string& usage, int argc, char* argv[], PlayerL
     try {
         DisplayConfig active_config = load_config_from_json(config_name);
         std::cout << "Using display configuration: " << active_config.name << std::endl;
+        metrics::set_panel_info(config_name);
         std::string mode_str;
         if (scaling_mode == ScalingMode::CROP) mode_str = "CROP";
         else if (scaling_mode == ScalingMode::STRETCH) mode_str = "STRETCH";
@@ -109,6 +111,17 @@ int common_main_runner(const std::string& usage, int argc, char* argv[], PlayerL
 
         setup_signal_handlers();
 
+        // config.json の保存 / SIGHUP で構成と2値化パラメータを再起動なしに差し替える
+        live_config().publish_initial(active_config, scaling_mode, min_threshold, max_threshold, config_name);
+        live_config().start_watcher();
+
+        // SEG_DISPLAYD_PRIORITY が設定されていれば、I2C の代わりに 7seg-displayd へ送る
+        if (active_config.type != "emulator") {
+            std::string source_name = argv[0];
+            source_name = source_name.substr(source_name.find_last_of('/') + 1);
+            connect_displayd_output_from_env(source_name);
+        }
+
     // 各プレイヤー固有のロジックをここで実行
     player_logic(first_arg, active_config, scaling_mode, min_threshold, max_threshold, debug, loop);
 
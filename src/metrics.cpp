@@ -0,0 +1,376 @@
+// src/metrics.cpp
+#include "metrics.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <tuple>
+#include <vector>
+#include <unistd.h>
+#include <poll.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+
+namespace metrics {
+
+void Histogram::observe_us(uint64_t us) {
+    // バケット数は少ないので線形探索で十分
+    size_t i = 0;
+    while (i < kBoundsUs.size() && us > kBoundsUs[i]) ++i;
+    buckets_[i].fetch_add(1, std::memory_order_relaxed);
+    sum_us_.fetch_add(us, std::memory_order_relaxed);
+    if (!used_.load(std::memory_order_relaxed)) used_.store(true, std::memory_order_relaxed);
+}
+
+namespace {
+
+// モジュール単位の系列は (バス, TCA のアドレス, チャンネル, モジュールのアドレス) ごとに初めて使われたときに作る
+// （module_health.h と同じ場所の区別。別の TCA の同じチャンネル・アドレスを混ぜない）。消さないので参照は変わらない
+using ModuleKey = std::tuple<int, int, int, int>;
+std::mutex g_module_mtx;
+std::map<ModuleKey, std::unique_ptr<ModuleSeries>> g_modules;
+
+Histogram g_decode;
+Histogram g_frame_to_grid;
+Histogram g_i2c_commit;
+Counter g_i2c_bytes;
+Counter g_i2c_broadcast_saved;
+Counter g_frames_displayed;
+Counter g_frames_dropped;
+Histogram g_frame_jitter;
+Counter g_frame_deadline_misses;
+Gauge g_audio_queue_bytes;
+Gauge g_output_fps;
+Gauge g_output_sustainable_fps;
+Gauge g_gray_subframes;
+Histogram g_capture_to_display;
+Histogram g_probe_receive;
+Histogram g_probe_commit;
+const char* const kStreamQueueNames[kStreamQueueCount] = {"net", "video", "raw", "audio"};
+Gauge g_stream_queue_time_us[kStreamQueueCount];
+Gauge g_stream_queue_buffers[kStreamQueueCount];
+std::atomic<bool> g_stream_queue_used[kStreamQueueCount];
+Counter g_late_frames_dropped;
+Gauge g_overflow_gauge;
+
+std::mutex g_info_mtx;
+std::string g_panel_config;
+
+// Prometheus のラベル値として \ " 改行をエスケープする
+std::string escape_label(const std::string& v) {
+    std::string out;
+    out.reserve(v.size());
+    for (char c : v) {
+        if (c == '\\' || c == '"') {
+            out += '\\';
+            out += c;
+        } else if (c == '\n') {
+            out += "\\n";
+        } else {
+            out += c;
+        }
+    }
+    return out;
+}
+
+void render_histogram(std::ostringstream& os, const std::string& name, const std::string& labels, const Histogram& h) {
+    uint64_t cumulative = 0;
+    const std::string sep = labels.empty() ? "" : ",";
+    for (size_t i = 0; i < Histogram::kBuckets; ++i) {
+        cumulative += h.bucket(i);
+        os << name << "_bucket{" << labels << sep << "le=\"";
+        if (i < Histogram::kBoundsUs.size()) {
+            os << Histogram::kBoundsUs[i] / 1e6;
+        } else {
+            os << "+Inf";
+        }
+        os << "\"} " << cumulative << "\n";
+    }
+    const std::string lbl = labels.empty() ? "" : "{" + labels + "}";
+    os << name << "_sum" << lbl << " " << h.sum_us() / 1e6 << "\n";
+    os << name << "_count" << lbl << " " << cumulative << "\n";
+}
+
+void render_header(std::ostringstream& os, const char* name, const char* type, const char* help) {
+    os << "# HELP " << name << " " << help << "\n";
+    os << "# TYPE " << name << " " << type << "\n";
+}
+
+// 直結のモジュールは tca="none" channel="-1"、TCA の切り替えの失敗は addr="none"
+std::string module_labels(const ModuleKey& key) {
+    const auto [bus, tca_address, channel, addr] = key;
+    char tca[8] = "none";
+    char module[8] = "none";
+    if (tca_address >= 0) snprintf(tca, sizeof(tca), "0x%02X", tca_address & 0xFF);
+    if (addr >= 0) snprintf(module, sizeof(module), "0x%02X", addr & 0xFF);
+    char buf[96];
+    snprintf(buf, sizeof(buf), "bus=\"%d\",tca=\"%s\",channel=\"%d\",addr=\"%s\"", bus, tca, channel, module);
+    return buf;
+}
+
+} // namespace
+
+Histogram& decode_latency() { return g_decode; }
+Histogram& frame_to_grid_latency() { return g_frame_to_grid; }
+Histogram& i2c_commit_latency() { return g_i2c_commit; }
+
+ModuleSeries& module_series(int bus, int tca_address, int channel, int addr) {
+    std::lock_guard<std::mutex> lk(g_module_mtx);
+    std::unique_ptr<ModuleSeries>& series = g_modules[ModuleKey{bus, tca_address, channel, addr}];
+    if (!series) series = std::make_unique<ModuleSeries>();
+    return *series;
+}
+
+Histogram& module_write_latency(int bus, int tca_address, int channel, int addr) {
+    return module_series(bus, tca_address, channel, addr).write;
+}
+
+Counter& module_write_errors(int bus, int tca_address, int channel, int addr) {
+    return module_series(bus, tca_address, channel, addr).errors;
+}
+
+Counter& i2c_bytes() { return g_i2c_bytes; }
+Counter& i2c_broadcast_saved_writes() { return g_i2c_broadcast_saved; }
+Counter& frames_displayed() { return g_frames_displayed; }
+Counter& frames_dropped() { return g_frames_dropped; }
+Histogram& frame_jitter() { return g_frame_jitter; }
+Counter& frame_deadline_misses() { return g_frame_deadline_misses; }
+Gauge& audio_queue_bytes() { return g_audio_queue_bytes; }
+Gauge& output_fps() { return g_output_fps; }
+Gauge& output_sustainable_fps() { return g_output_sustainable_fps; }
+Gauge& gray_subframes() { return g_gray_subframes; }
+Histogram& capture_to_display_latency() { return g_capture_to_display; }
+Histogram& probe_source_to_receive_latency() { return g_probe_receive; }
+Histogram& probe_source_to_commit_latency() { return g_probe_commit; }
+Gauge& stream_queue_time_us(int queue) {
+    if (queue < 0 || queue >= kStreamQueueCount) return g_overflow_gauge;
+    g_stream_queue_used[queue].store(true, std::memory_order_relaxed);
+    return g_stream_queue_time_us[queue];
+}
+Gauge& stream_queue_buffers(int queue) {
+    if (queue < 0 || queue >= kStreamQueueCount) return g_overflow_gauge;
+    g_stream_queue_used[queue].store(true, std::memory_order_relaxed);
+    return g_stream_queue_buffers[queue];
+}
+Counter& late_frames_dropped() { return g_late_frames_dropped; }
+
+void set_panel_info(const std::string& config_name) {
+    std::lock_guard<std::mutex> lk(g_info_mtx);
+    g_panel_config = config_name;
+}
+
+std::string render_prometheus() {
+    std::ostringstream os;
+
+    {
+        std::lock_guard<std::mutex> lk(g_info_mtx);
+        if (!g_panel_config.empty()) {
+            render_header(os, "seg_panel_info", "gauge", "Display configuration in use.");
+            os << "seg_panel_info{config=\"" << escape_label(g_panel_config) << "\"} 1\n";
+        }
+    }
+
+    render_header(os, "seg_decode_seconds", "histogram", "Frame decode latency.");
+    render_histogram(os, "seg_decode_seconds", "", g_decode);
+    render_header(os, "seg_frame_to_grid_seconds", "histogram", "Image to 7-segment grid conversion latency.");
+    render_histogram(os, "seg_frame_to_grid_seconds", "", g_frame_to_grid);
+    render_header(os, "seg_i2c_commit_seconds", "histogram", "Latency of one full display update over I2C.");
+    render_histogram(os, "seg_i2c_commit_seconds", "", g_i2c_commit);
+
+    {
+        std::lock_guard<std::mutex> lk(g_module_mtx);
+        render_header(os, "seg_i2c_module_write_seconds", "histogram", "Latency of one module write (slave select + 17 byte RAM write).");
+        for (const auto& [key, series] : g_modules) {
+            if (series->write.used()) render_histogram(os, "seg_i2c_module_write_seconds", module_labels(key), series->write);
+        }
+        render_header(os, "seg_i2c_module_errors_total", "counter", "Failed module writes and TCA9548A channel selections.");
+        for (const auto& [key, series] : g_modules) {
+            const uint64_t v = series->errors.value();
+            if (v > 0) os << "seg_i2c_module_errors_total{" << module_labels(key) << "} " << v << "\n";
+        }
+    }
+
+    render_header(os, "seg_i2c_bytes_total", "counter", "Display data bytes written to I2C.");
+    os << "seg_i2c_bytes_total " << g_i2c_bytes.value() << "\n";
+    render_header(os, "seg_i2c_broadcast_saved_writes_total", "counter", "Module writes saved by enabling several TCA9548A channels at once.");
+    os << "seg_i2c_broadcast_saved_writes_total " << g_i2c_broadcast_saved.value() << "\n";
+    render_header(os, "seg_frames_displayed_total", "counter", "Frames committed to the display.");
+    os << "seg_frames_displayed_total " << g_frames_displayed.value() << "\n";
+    render_header(os, "seg_frames_dropped_total", "counter", "Frames overwritten or skipped before being displayed.");
+    os << "seg_frames_dropped_total " << g_frames_dropped.value() << "\n";
+    if (g_frame_jitter.used()) {
+        render_header(os, "seg_frame_jitter_seconds", "histogram", "Distance between the end of a display update and its frame deadline.");
+        render_histogram(os, "seg_frame_jitter_seconds", "", g_frame_jitter);
+    }
+    render_header(os, "seg_frame_deadline_misses_total", "counter", "Frame deadlines skipped because output fell a full period behind.");
+    os << "seg_frame_deadline_misses_total " << g_frame_deadline_misses.value() << "\n";
+    if (g_output_fps.value() > 0) {
+        render_header(os, "seg_output_fps", "gauge", "Output frame rate chosen by the rate controller.");
+        os << "seg_output_fps " << g_output_fps.value() / 1000.0 << "\n";
+        render_header(os, "seg_output_sustainable_fps", "gauge", "Highest frame rate the measured prepare and I2C commit times allow.");
+        os << "seg_output_sustainable_fps " << g_output_sustainable_fps.value() / 1000.0 << "\n";
+    }
+    if (g_gray_subframes.value() > 0) {
+        render_header(os, "seg_gray_subframes", "gauge", "Temporal-dithering sub-frames committed per video frame.");
+        os << "seg_gray_subframes " << g_gray_subframes.value() << "\n";
+    }
+    if (g_capture_to_display.used()) {
+        render_header(os, "seg_capture_to_display_seconds", "histogram", "Time from camera capture to the end of the display update.");
+        render_histogram(os, "seg_capture_to_display_seconds", "", g_capture_to_display);
+    }
+    if (g_probe_commit.used()) {
+        render_header(os, "seg_probe_source_to_receive_seconds", "histogram", "Time from a latency-probe frame's timestamp to its arrival at the player.");
+        render_histogram(os, "seg_probe_source_to_receive_seconds", "", g_probe_receive);
+        render_header(os, "seg_probe_source_to_commit_seconds", "histogram", "Time from a latency-probe frame's timestamp to the end of its display update.");
+        render_histogram(os, "seg_probe_source_to_commit_seconds", "", g_probe_commit);
+    }
+    bool any_queue = false;
+    for (int q = 0; q < kStreamQueueCount; ++q) any_queue = any_queue || g_stream_queue_used[q].load(std::memory_order_relaxed);
+    if (any_queue) {
+        render_header(os, "seg_stream_queue_seconds", "gauge", "Data held in each receive pipeline queue, by running time.");
+        for (int q = 0; q < kStreamQueueCount; ++q) {
+            if (!g_stream_queue_used[q].load(std::memory_order_relaxed)) continue;
+            os << "seg_stream_queue_seconds{queue=\"" << kStreamQueueNames[q] << "\"} " << g_stream_queue_time_us[q].value() / 1e6 << "\n";
+        }
+        render_header(os, "seg_stream_queue_buffers", "gauge", "Buffers held in each receive pipeline queue.");
+        for (int q = 0; q < kStreamQueueCount; ++q) {
+            if (!g_stream_queue_used[q].load(std::memory_order_relaxed)) continue;
+            os << "seg_stream_queue_buffers{queue=\"" << kStreamQueueNames[q] << "\"} " << g_stream_queue_buffers[q].value() << "\n";
+        }
+    }
+    if (g_late_frames_dropped.value() > 0) {
+        render_header(os, "seg_late_frames_dropped_total", "counter", "Decoded frames dropped at the appsink because their PTS was too far behind the pipeline clock.");
+        os << "seg_late_frames_dropped_total " << g_late_frames_dropped.value() << "\n";
+    }
+    render_header(os, "seg_audio_queue_bytes", "gauge", "Bytes queued in the SDL audio device.");
+    os << "seg_audio_queue_bytes " << g_audio_queue_bytes.value() << "\n";
+    return os.str();
+}
+
+// --- 最小の HTTP リスナー ---
+namespace {
+std::atomic<bool> g_server_running{false};
+std::thread g_server_thread;
+int g_listen_fd = -1;
+
+// 要求が届いている（poll で読める）クライアントに応答する
+void serve_client(int fd) {
+    // 受け取らないクライアントに送り続けて止まらないよう、送信にも期限をつける
+    timeval tv{};
+    tv.tv_sec = 1;
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+    char req[1024];
+    ssize_t n = ::recv(fd, req, sizeof(req) - 1, MSG_DONTWAIT);
+    if (n <= 0) return;
+    req[n] = '\0';
+
+    std::string body;
+    const char* status = "200 OK";
+    if (strncmp(req, "GET /metrics", 12) == 0) {
+        body = render_prometheus();
+    } else {
+        status = "404 Not Found";
+        body = "not found\n";
+    }
+    std::ostringstream resp;
+    resp << "HTTP/1.1 " << status << "\r\n"
+         << "Content-Type: text/plain; version=0.0.4\r\n"
+         << "Content-Length: " << body.size() << "\r\n"
+         << "Connection: close\r\n\r\n"
+         << body;
+    const std::string out = resp.str();
+    size_t off = 0;
+    while (off < out.size()) {
+        ssize_t w = ::send(fd, out.data() + off, out.size() - off, 0);
+        if (w <= 0) break;
+        off += static_cast<size_t>(w);
+    }
+}
+
+// 1スレッドで、接続を待ちながら要求の届いたクライアントから順に応答する
+// 接続したまま何も送らないクライアントは他を待たせず、1秒で切る
+void server_loop() {
+    struct Client {
+        int fd;
+        std::chrono::steady_clock::time_point accepted_at;
+    };
+    std::vector<Client> clients;
+    std::vector<pollfd> pfds;
+    while (g_server_running) {
+        pfds.assign(1, pollfd{g_listen_fd, POLLIN, 0});
+        for (const Client& c : clients) pfds.push_back(pollfd{c.fd, POLLIN, 0});
+        const int r = ::poll(pfds.data(), pfds.size(), 200);
+        const auto now = std::chrono::steady_clock::now();
+        std::vector<Client> waiting;
+        for (size_t i = 0; i < clients.size(); ++i) {
+            if (r > 0 && (pfds[i + 1].revents & (POLLIN | POLLHUP | POLLERR))) {
+                serve_client(clients[i].fd);
+                ::close(clients[i].fd);
+            } else if (now - clients[i].accepted_at >= std::chrono::seconds(1)) {
+                ::close(clients[i].fd);
+            } else {
+                waiting.push_back(clients[i]);
+            }
+        }
+        clients.swap(waiting);
+        if (r > 0 && (pfds[0].revents & POLLIN)) {
+            const int cfd = ::accept(g_listen_fd, nullptr, nullptr);
+            if (cfd >= 0) clients.push_back(Client{cfd, now});
+        }
+    }
+    for (const Client& c : clients) ::close(c.fd);
+}
+} // namespace
+
+bool start_metrics_server(int port) {
+    if (g_server_running) return true;
+    int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) { perror("[metrics] socket"); return false; }
+    int yes = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons(static_cast<uint16_t>(port));
+    if (::bind(fd, (sockaddr*)&addr, sizeof(addr)) < 0) { perror("[metrics] bind"); ::close(fd); return false; }
+    if (::listen(fd, 4) < 0) { perror("[metrics] listen"); ::close(fd); return false; }
+    g_listen_fd = fd;
+    g_server_running = true;
+    g_server_thread = std::thread(server_loop);
+    std::cout << "[metrics] serving http://0.0.0.0:" << port << "/metrics" << std::endl;
+    return true;
+}
+
+void stop_metrics_server() {
+    if (!g_server_running) return;
+    g_server_running = false;
+    if (g_server_thread.joinable()) g_server_thread.join();
+    ::close(g_listen_fd);
+    g_listen_fd = -1;
+}
+
+namespace {
+// main から stop せずに抜けても、joinable な std::thread の破棄で落ちないようにする
+struct ServerGuard {
+    ~ServerGuard() { stop_metrics_server(); }
+} g_server_guard;
+} // namespace
+
+void start_metrics_server_from_env() {
+    const char* v = std::getenv("METRICS_PORT");
+    if (!v || !*v) return;
+    int port = std::atoi(v);
+    if (port <= 0 || port > 65535) {
+        std::cerr << "[metrics] invalid METRICS_PORT: " << v << std::endl;
+        return;
+    }
+    start_metrics_server(port);
+}
+
+} // namespace metrics
@@ -0,0 +1,105 @@
+// src/module_health.cpp
+#include "module_health.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+
+namespace {
+int env_int(const char* name, int def, int min_value) {
+    if (const char* v = std::getenv(name)) {
+        return std::max(min_value, std::atoi(v));
+    }
+    return def;
+}
+
+void log_key(const char* what, int tca_address, int channel, int address, int failures, int wait_ms) {
+    if (address < 0) {
+        fprintf(stderr, "[health] TCA 0x%02X CH%d %s (failures=%d, retry in %d ms)\n",
+                tca_address, channel, what, failures, wait_ms);
+    } else {
+        fprintf(stderr, "[health] CH%d addr 0x%02X %s (failures=%d, retry in %d ms)\n",
+                channel, address, what, failures, wait_ms);
+    }
+}
+} // namespace
+
+ModuleHealthTable::ModuleHealthTable()
+    : base_ms_(env_int("MODULE_BACKOFF_BASE_MS", 100, 1)),
+      max_ms_(env_int("MODULE_BACKOFF_MAX_MS", 10000, 1)),
+      quarantine_after_(env_int("MODULE_QUARANTINE_AFTER", 3, 1)) {}
+
+ModuleAction ModuleHealthTable::check(int tca_address, int channel, int address) {
+    std::lock_guard<std::mutex> lk(mtx_);
+    auto it = entries_.find(Key{tca_address, channel, address});
+    if (it == entries_.end() || it->second.consecutive_failures == 0) return ModuleAction::Write;
+    if (clock::now() < it->second.retry_at) return ModuleAction::Skip;
+    return it->second.quarantined ? ModuleAction::Reinit : ModuleAction::Write;
+}
+
+void ModuleHealthTable::report_success(int tca_address, int channel, int address) {
+    std::lock_guard<std::mutex> lk(mtx_);
+    auto it = entries_.find(Key{tca_address, channel, address});
+    if (it == entries_.end() || it->second.consecutive_failures == 0) return;
+    if (it->second.quarantined) {
+        log_key("recovered", tca_address, channel, address, it->second.consecutive_failures, 0);
+    }
+    it->second.consecutive_failures = 0;
+    it->second.quarantined = false;
+}
+
+void ModuleHealthTable::report_failure(int tca_address, int channel, int address) {
+    std::lock_guard<std::mutex> lk(mtx_);
+    Entry& e = entries_[Key{tca_address, channel, address}];
+    ++e.consecutive_failures;
+    ++e.total_failures;
+    // 待ち時間は base * 2^(n-1)、上限 max
+    int shift = std::min(e.consecutive_failures - 1, 20);
+    int wait_ms = static_cast<int>(std::min<int64_t>(static_cast<int64_t>(base_ms_) << shift, max_ms_));
+    e.retry_at = clock::now() + std::chrono::milliseconds(wait_ms);
+    if (!e.quarantined && e.consecutive_failures >= quarantine_after_) {
+        e.quarantined = true;
+        log_key("quarantined", tca_address, channel, address, e.consecutive_failures, wait_ms);
+    } else if (e.consecutive_failures == 1) {
+        log_key("backing off", tca_address, channel, address, e.consecutive_failures, wait_ms);
+    }
+}
+
+void ModuleHealthTable::report_init_failure(int tca_address, int channel, int address) {
+    std::lock_guard<std::mutex> lk(mtx_);
+    Entry& e = entries_[Key{tca_address, channel, address}];
+    ++e.consecutive_failures;
+    ++e.total_failures;
+    e.retry_at = clock::now() + std::chrono::milliseconds(base_ms_);
+    if (!e.quarantined) {
+        e.quarantined = true;
+        log_key("not initialized, quarantined", tca_address, channel, address, e.consecutive_failures, base_ms_);
+    }
+}
+
+void ModuleHealthTable::reset() {
+    std::lock_guard<std::mutex> lk(mtx_);
+    for (auto& [key, e] : entries_) {
+        e.consecutive_failures = 0;
+        e.quarantined = false;
+    }
+}
+
+std::vector<ModuleHealthSnapshot> ModuleHealthTable::snapshot() const {
+    std::lock_guard<std::mutex> lk(mtx_);
+    std::vector<ModuleHealthSnapshot> out;
+    const auto now = clock::now();
+    for (const auto& [key, e] : entries_) {
+        int retry_ms = 0;
+        if (e.consecutive_failures > 0 && e.retry_at > now) {
+            retry_ms = static_cast<int>(std::chrono::duration_cast<std::chrono::milliseconds>(e.retry_at - now).count());
+        }
+        out.push_back({std::get<0>(key), std::get<1>(key), std::get<2>(key),
+                       e.consecutive_failures, e.total_failures, e.quarantined, retry_ms});
+    }
+    return out;
+}
+
+ModuleHealthTable& module_health() {
+    static ModuleHealthTable table;
+    return table;
+}
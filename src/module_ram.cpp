@@ -0,0 +1,136 @@
+// src/module_ram.cpp
+#include "module_ram.h"
+#include "routing_table.h"
+
+#include <cstring>
+
+namespace {
+
+// 8x8 のビット行列の転置。入力はバイト r のビット c が (r, c)、出力はバイト c のビット r
+// 2x2 → 4x4 → 8x8 のブロックの順に、対角をはさんだビットを入れ替える
+inline uint64_t transpose8x8(uint64_t x) {
+    uint64_t t;
+    t = (x ^ (x >> 7)) & 0x00AA00AA00AA00AAULL;
+    x ^= t ^ (t << 7);
+    t = (x ^ (x >> 14)) & 0x0000CCCC0000CCCCULL;
+    x ^= t ^ (t << 14);
+    t = (x ^ (x >> 28)) & 0x00000000F0F0F0F0ULL;
+    x ^= t ^ (t << 28);
+    return x;
+}
+
+// 転置した下位8桁 / 上位8桁を、セグメントごとの2バイトに交互に並べる
+inline void store_ram(uint64_t lo, uint64_t hi, uint8_t* ram) {
+    lo = transpose8x8(lo);
+    hi = hi ? transpose8x8(hi) : 0;
+    for (int s = 0; s < 8; ++s) {
+        ram[2 * s] = static_cast<uint8_t>(lo >> (8 * s));
+        ram[2 * s + 1] = static_cast<uint8_t>(hi >> (8 * s));
+    }
+}
+
+// grid の行の W 桁をそのまま読む（1バイト目が下位）。Reversed なら行の中を逆順にする
+template <int W, bool Reversed>
+inline uint64_t load_row(const uint8_t* p) {
+    if constexpr (W == 8) {
+        uint64_t v;
+        std::memcpy(&v, p, 8);
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+        v = __builtin_bswap64(v);
+#endif
+        return Reversed ? __builtin_bswap64(v) : v;
+    } else {
+        static_assert(W == 4, "rows of 4 or 8 digits");
+        uint32_t v;
+        std::memcpy(&v, p, 4);
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+        v = __builtin_bswap32(v);
+#endif
+        return Reversed ? __builtin_bswap32(v) : v;
+    }
+}
+
+// 16桁（W 桁 x H 行、行ごとに grid 上で連続）のモジュールを top_left から読んで RAM にする
+// 行数・桁数がコンパイル時に決まるので、ループは展開されて分岐も添字の表引きもなくなる
+template <int W, int H, bool Reversed>
+inline void encode_rows(const uint8_t* top_left, size_t stride, uint8_t* ram) {
+    static_assert(W * H == 16, "16-digit modules only");
+    uint64_t half[2] = {0, 0}; // 物理桁 0-7 / 8-15
+    for (int r = 0; r < H; ++r) {
+        const int first = r * W;
+        half[first / 8] |= load_row<W, Reversed>(top_left + r * stride) << (8 * (first % 8));
+    }
+    store_ram(half[0], half[1], ram);
+}
+
+// cell[] を1桁ずつ引く（どんな並びでも使える）
+inline void encode_generic(const RoutingModule& m, const uint8_t* grid, size_t grid_size, uint8_t* ram) {
+    const int n = (m.digit_count < ROUTING_MAX_DIGITS) ? m.digit_count : ROUTING_MAX_DIGITS;
+    // 消灯の桁 (ROUTING_NO_CELL) は grid の外を指すので 0 になる
+    uint64_t lo = 0, hi = 0;
+    for (int d = 0; d < n && d < 8; ++d) {
+        const uint16_t cell = m.cell[d];
+        lo |= static_cast<uint64_t>(cell < grid_size ? grid[cell] : 0) << (8 * d);
+    }
+    for (int d = 8; d < n; ++d) {
+        const uint16_t cell = m.cell[d];
+        hi |= static_cast<uint64_t>(cell < grid_size ? grid[cell] : 0) << (8 * (d - 8));
+    }
+    store_ram(lo, hi, ram);
+}
+
+} // namespace
+
+void encode_module_ram(const uint8_t* digits, int digit_count, uint8_t ram[MODULE_RAM_BYTES]) {
+    uint64_t lo = 0, hi = 0;
+    const int n = (digit_count < 16) ? digit_count : 16;
+    for (int d = 0; d < n && d < 8; ++d) lo |= static_cast<uint64_t>(digits[d]) << (8 * d);
+    for (int d = 8; d < n; ++d) hi |= static_cast<uint64_t>(digits[d]) << (8 * (d - 8));
+    store_ram(lo, hi, ram);
+}
+
+void encode_panel_ram(const RoutingTable& routing, const uint8_t* grid, size_t grid_size, uint8_t* out) {
+    const size_t module_count = routing.module_count();
+    const size_t stride = static_cast<size_t>(routing.total_width());
+    // 専用の変換は grid の範囲を確かめずに行ごとに読むので、grid がパネルより小さいときは使わない
+    const bool full_grid = grid_size >= stride * static_cast<size_t>(routing.total_height());
+    for (size_t mi = 0; mi < module_count; ++mi) {
+        const RoutingModule& m = routing.module(mi);
+        uint8_t* ram = out + mi * MODULE_RAM_BYTES;
+        switch (full_grid ? m.shape : static_cast<uint8_t>(ROUTING_SHAPE_GENERIC)) {
+            case ROUTING_SHAPE_4X4: encode_rows<4, 4, false>(grid + m.cell[0], stride, ram); break;
+            case ROUTING_SHAPE_4X4_REVERSED: encode_rows<4, 4, true>(grid + m.cell[3], stride, ram); break;
+            case ROUTING_SHAPE_8X2: encode_rows<8, 2, false>(grid + m.cell[0], stride, ram); break;
+            case ROUTING_SHAPE_8X2_REVERSED: encode_rows<8, 2, true>(grid + m.cell[7], stride, ram); break;
+            default: encode_generic(m, grid, grid_size, ram); break;
+        }
+    }
+}
+
+void encode_panel_ram_generic(const RoutingTable& routing, const uint8_t* grid, size_t grid_size, uint8_t* out) {
+    for (size_t mi = 0; mi < routing.module_count(); ++mi) {
+        encode_generic(routing.module(mi), grid, grid_size, out + mi * MODULE_RAM_BYTES);
+    }
+}
+
+void encode_module_ram_reference(const uint8_t* digits, int digit_count, uint8_t ram[MODULE_RAM_BYTES]) {
+    std::memset(ram, 0, MODULE_RAM_BYTES);
+    const int DIGITS_PER_MODULE = 16;
+    for (int digit_index = 0; digit_index < DIGITS_PER_MODULE && digit_index < digit_count; ++digit_index) {
+        uint8_t bitmask = digits[digit_index];
+        for (int seg = 0; seg < 8; ++seg) {
+            if ((bitmask >> seg) & 1) {
+                int base = seg * 2;
+                int addr_to_write, bit_pos;
+                if (digit_index < 8) {
+                    addr_to_write = base; bit_pos = digit_index;
+                } else {
+                    addr_to_write = base + 1; bit_pos = digit_index - 8;
+                }
+                if (addr_to_write < 16) {
+                    ram[addr_to_write] |= (1 << bit_pos);
+                }
+            }
+        }
+    }
+}
@@ -4,6 +4,10 @@
 #include "led.h"
 #include "video.h"
 #include "audio.h"
+#include "metrics.h"
+#include "trace.h"
+#include "live_config.h"
+#include "display_client.h"
 
 #include <gst/gst.h>
 #include <gst/app/gstappsink.h>
@@ -14,6 +18,7 @@
 #include <atomic>
 #include <csignal>
 #include <iostream>
+#include <sstream>
 #include <string>
 #include <thread>
 #include <vector>
@@ -32,10 +37,82 @@
 
 // 受信開始判定などの追加フラグは使わない（従来動作に戻す）
 
+// 低遅延プロファイル（SEG_LOW_LATENCY=1）
+// 既定の ts / flv / flv_srv は queue2 で 1-2 秒溜めてから流すので、健全なストリームでも1秒以上遅れる。
+// 低遅延では:
+//   - 溜めるための queue2 をやめ、小さなキューにする（圧縮前の映像は捨てると次のキーフレームまで崩れるので
+//     捨てず、デコード後の映像と音声は古いものから捨てる leaky=2）
+//   - decodebin の中のデコーダをフレーム遅延なしにする（avdec_* のフレームスレッドは スレッド数-1 枚遅れて出す）
+//   - appsink に届いたフレームの PTS をパイプラインの時計と比べ、遅れすぎたものは JPEG にせず捨てる
+// どちらのプロファイルでもキューの中身を seg_stream_queue_seconds / _buffers に出し、
+// SEG_QUEUE_REPORT_S 秒ごと（低遅延の既定 5、通常の既定 0 = 出さない）に [queue] の行を出す。
+// 環境変数:
+//   SEG_LOW_LATENCY     1 で低遅延プロファイル
+//   SEG_LATE_FRAME_MS   ふだんの遅れよりこれ以上遅れたフレームを捨てる（既定 50）
+//   SEG_QUEUE_REPORT_S  キューの中身を出す間隔（秒）
+static bool g_low_latency = false;
+static int64_t g_late_frame_ns = 50 * GST_MSECOND;
+
+// PTS の遅れ（今のランニングタイム - フレームのランニングタイム）で遅れたフレームを見分ける
+// 送り手の時計とパイプラインの時計の差（接続を待った時間なども含む）は一定なので、遅れの下限を基準にして
+// そこからの超過で判定する。時計のずれを追うため基準は少しずつ上げ、2秒を超える飛びはタイムラインが
+// 変わったとみなして基準を取り直す。捨て続けて表示が止まらないよう、続けて捨てるのは kMaxConsecutive 枚まで。
+struct LateFrameGate {
+    static constexpr int kMaxConsecutive = 15;
+    bool primed = false;
+    int64_t base_ns = 0;
+    int consecutive = 0;
+
+    bool late(int64_t lag_ns) {
+        if (!primed || lag_ns < base_ns || lag_ns - base_ns > 2 * static_cast<int64_t>(GST_SECOND)) {
+            primed = true;
+            base_ns = lag_ns;
+            consecutive = 0;
+            return false;
+        }
+        base_ns += (lag_ns - base_ns) / 512;
+        if (lag_ns - base_ns <= g_late_frame_ns || consecutive >= kMaxConsecutive) {
+            consecutive = 0;
+            return false;
+        }
+        ++consecutive;
+        return true;
+    }
+};
+static LateFrameGate g_late_gate; // appsink の streaming スレッドだけが触る（パイプラインを作るたびに作り直す）
+
+// フレームの PTS がパイプラインの時計からどれだけ遅れているか。時計か PTS がなければ false
+static bool frame_lag_ns(GstAppSink* sink, GstSample* sample, int64_t& lag_ns) {
+    GstBuffer* buffer = gst_sample_get_buffer(sample);
+    const GstSegment* segment = gst_sample_get_segment(sample);
+    if (!buffer || !segment || !GST_BUFFER_PTS_IS_VALID(buffer)) return false;
+    const guint64 frame_rt = gst_segment_to_running_time(segment, GST_FORMAT_TIME, GST_BUFFER_PTS(buffer));
+    if (!GST_CLOCK_TIME_IS_VALID(frame_rt)) return false;
+    GstClock* clock = gst_element_get_clock(GST_ELEMENT(sink));
+    if (!clock) return false;
+    const GstClockTime now_rt = gst_clock_get_time(clock) - gst_element_get_base_time(GST_ELEMENT(sink));
+    gst_object_unref(clock);
+    lag_ns = static_cast<int64_t>(now_rt) - static_cast<int64_t>(frame_rt);
+    return true;
+}
+
 static GstFlowReturn on_new_sample_video(GstAppSink* sink, gpointer user_data) {
+    trace::set_thread_name("appsink_video");
+    trace::Scope trace_scope("on_new_sample_video");
     GstSample* sample = gst_app_sink_pull_sample(sink);
+    // デコード済みのフレームを受け取った時刻（JPEG にする前）
+    const auto received_at = std::chrono::steady_clock::now();
     if (!sample) return GST_FLOW_OK;
 
+    if (g_low_latency) {
+        int64_t lag_ns = 0;
+        if (frame_lag_ns(sink, sample, lag_ns) && g_late_gate.late(lag_ns)) {
+            metrics::late_frames_dropped().inc();
+            gst_sample_unref(sample);
+            return GST_FLOW_OK;
+        }
+    }
+
     GstBuffer* buffer = gst_sample_get_buffer(sample);
     GstCaps* caps = gst_sample_get_caps(sample);
     if (!buffer || !caps) {
@@ -75,6 +152,8 @@ static GstFlowReturn on_new_sample_video(GstAppSink* sink, gpointer user_data) {
         std::lock_guard<std::mutex> lk(frame_mtx);
         if (!jpg.empty()) {
             latest_frame = std::move(jpg);
+            ++latest_frame_seq;
+            latest_frame_received_at = received_at;
         }
         last_pts_ms = pts_ms;
     }
@@ -85,6 +164,8 @@ static GstFlowReturn on_new_sample_video(GstAppSink* sink, gpointer user_data) {
 }
 
 static GstFlowReturn on_new_sample_audio(GstAppSink* sink, gpointer user_data) {
+    trace::set_thread_name("appsink_audio");
+    trace::Scope trace_scope("on_new_sample_audio");
     GstSample* sample = gst_app_sink_pull_sample(sink);
     if (!sample) return GST_FLOW_OK;
 
@@ -121,6 +202,67 @@ static GstFlowReturn on_new_sample_audio(GstAppSink* sink, gpointer user_data) {
     return GST_FLOW_OK;
 }
 
+// decodebin が中に作ったデコーダをフレーム遅延なしにする（低遅延プロファイル）
+static void on_deep_element_added(GstBin*, GstBin*, GstElement* element, gpointer) {
+    GstElementFactory* factory = gst_element_get_factory(element);
+    if (!factory) return;
+    const gchar* name = GST_OBJECT_NAME(factory);
+    if (!g_str_has_prefix(name, "avdec_")) return;
+    GObjectClass* klass = G_OBJECT_GET_CLASS(element);
+    if (g_object_class_find_property(klass, "thread-type")) {
+        // スライススレッドだけなら遅れずに並列にデコードできる（2 = slice）
+        g_object_set(element, "thread-type", 2, NULL);
+    } else if (g_object_class_find_property(klass, "max-threads")) {
+        g_object_set(element, "max-threads", 1, NULL);
+    }
+    std::cout << "[lowlatency] " << name << ": frame threading off" << std::endl;
+}
+
+// 名前の付いたキュー（q_net / q_video / q_raw / q_audio）に溜まっている量を調べる
+static const char* const kQueueElementNames[metrics::kStreamQueueCount] = {"q_net", "q_video", "q_raw", "q_audio"};
+
+struct QueueReport {
+    GstElement* pipeline {nullptr};
+    int interval_s {0};
+    std::chrono::steady_clock::time_point last_print {std::chrono::steady_clock::now()};
+};
+
+static gboolean on_queue_report(gpointer user_ptr) {
+    QueueReport* report = reinterpret_cast<QueueReport*>(user_ptr);
+    std::ostringstream line;
+    for (int q = 0; q < metrics::kStreamQueueCount; ++q) {
+        GstElement* queue = gst_bin_get_by_name(GST_BIN(report->pipeline), kQueueElementNames[q]);
+        if (!queue) continue;
+        guint64 level_ns = 0;
+        guint level_buffers = 0, level_bytes = 0;
+        g_object_get(queue, "current-level-time", &level_ns, "current-level-buffers", &level_buffers,
+                     "current-level-bytes", &level_bytes, NULL);
+        gst_object_unref(queue);
+        metrics::stream_queue_time_us(q).set(static_cast<int64_t>(level_ns / GST_USECOND));
+        metrics::stream_queue_buffers(q).set(level_buffers);
+        line << " " << (kQueueElementNames[q] + 2) << " " << level_ns / GST_MSECOND << " ms/" << level_buffers
+             << " buf/" << level_bytes / 1024 << " KB";
+    }
+    const auto now = std::chrono::steady_clock::now();
+    if (report->interval_s > 0 && now - report->last_print >= std::chrono::seconds(report->interval_s)) {
+        report->last_print = now;
+        std::cout << "[queue]" << line.str() << ", late frames dropped " << metrics::late_frames_dropped().value() << std::endl;
+    }
+    return G_SOURCE_CONTINUE;
+}
+
+// パイプラインを PLAYING にする前に呼ぶ。キューの監視を始め、低遅延ならデコーダの設定を仕込む
+// 戻り値の GSource id はパイプラインを止めたら g_source_remove する
+static guint prepare_pipeline(GstElement* pipeline, QueueReport& report) {
+    g_late_gate = LateFrameGate{};
+    if (g_low_latency) g_signal_connect(pipeline, "deep-element-added", G_CALLBACK(on_deep_element_added), nullptr);
+    report.pipeline = pipeline;
+    report.interval_s = g_low_latency ? 5 : 0;
+    if (const char* v = std::getenv("SEG_QUEUE_REPORT_S")) report.interval_s = std::max(0, atoi(v));
+    // メトリクスは1秒ごとに更新する（行を出すのは interval_s ごと）
+    return g_timeout_add_seconds(1, on_queue_report, &report);
+}
+
 struct BusCtx {
     GMainLoop* loop {nullptr};
     GstElement* pipeline {nullptr};
@@ -196,19 +338,31 @@ int main(int argc, char* argv[]) {
         return 1;
     }
 
-    int i2c_fd = open_i2c_auto(active_config);
-    if (i2c_fd < 0) {
-        perror("Failed to open I2C device");
-        return 1;
-    }
-    if (!initialize_displays(i2c_fd, active_config)) {
-        std::cerr << "Failed to initialize display modules." << std::endl;
-        close(i2c_fd);
-        return 1;
+    // SEG_DISPLAYD_PRIORITY が設定されていれば I2C は開かず、7seg-displayd にフレームを送る
+    int i2c_fd = -1;
+    if (!connect_displayd_output_from_env("net-player")) {
+        i2c_fd = open_i2c_auto(active_config);
+        if (i2c_fd < 0) {
+            perror("Failed to open I2C device");
+            return 1;
+        }
+        if (!initialize_displays(i2c_fd, active_config)) {
+            std::cerr << "Failed to initialize display modules." << std::endl;
+            close(i2c_fd);
+            return 1;
+        }
     }
 
     setup_signal_handlers();
 
+    // config.json の保存 / SIGHUP で構成を再起動なしに差し替える（映像スレッドがフレームごとに拾う）
+    live_config().publish_initial(active_config, ScalingMode::FIT, 64, 255, config_name);
+    live_config().start_watcher();
+
+    // METRICS_PORT が設定されていれば /metrics を公開する
+    metrics::set_panel_info(config_name);
+    metrics::start_metrics_server_from_env();
+
     if (!audio_init(SAMPLE_RATE, CHANNELS)) {
         std::cerr << "Audio init failed" << std::endl;
     }
@@ -228,6 +382,13 @@ int main(int argc, char* argv[]) {
 
     // 追加の終了制御は行わず、従来の自動再始動に戻す
 
+    if (const char* v = std::getenv("SEG_LOW_LATENCY")) g_low_latency = (std::atoi(v) != 0);
+    if (const char* v = std::getenv("SEG_LATE_FRAME_MS")) g_late_frame_ns = std::max(1, std::atoi(v)) * static_cast<int64_t>(GST_MSECOND);
+    if (g_low_latency) {
+        std::cout << "[lowlatency] small leaky queues, no frame-threaded decoding, dropping frames more than "
+                  << g_late_frame_ns / GST_MSECOND << " ms late" << std::endl;
+    }
+
     auto has_element = [](const char* name) -> bool {
         GstElementFactory* f = gst_element_factory_find(name);
         if (f) { gst_object_unref(f); return true; }
@@ -235,33 +396,73 @@ int main(int argc, char* argv[]) {
     };
     const bool have_avdec_h264 = has_element("avdec_h264");
     const bool have_avdec_aac  = has_element("avdec_aac");
+    // tsdemux の latency（ライブの TS で PCR を待つ時間。既定 700 ms）は GStreamer 1.18 から
+    auto has_property = [](const char* element, const char* property) -> bool {
+        GstElement* e = gst_element_factory_make(element, nullptr);
+        if (!e) return false;
+        const bool found = g_object_class_find_property(G_OBJECT_GET_CLASS(e), property) != nullptr;
+        gst_object_unref(e);
+        return found;
+    };
+
+    // 低遅延プロファイルの、デコード後の映像と音声の枝（flv / flv_srv で decodebin の後ろにつなぐ）
+    const std::string audio_caps = "audio/x-raw,format=S16LE,rate=" + std::to_string(SAMPLE_RATE) + ",channels=" + std::to_string(CHANNELS);
+    const std::string low_latency_video_tail =
+        "queue name=q_raw leaky=2 max-size-buffers=1 max-size-bytes=0 max-size-time=0 ! "
+        "videoconvert ! video/x-raw,format=BGR ! "
+        "appsink name=vsink emit-signals=true sync=false max-buffers=1 drop=true ";
+    const std::string low_latency_audio_tail =
+        "queue name=q_audio leaky=2 max-size-time=200000000 max-size-buffers=0 max-size-bytes=0 ! "
+        "audioconvert ! audioresample ! " + audio_caps + " ! "
+        "appsink name=asink emit-signals=true sync=false max-buffers=100 drop=false";
 
     std::string pipeline_desc;
-    if (mode == "ts") {
+    if (mode == "ts" && g_low_latency) {
+        // TS のパケットは UDP で既に失われうるので、入口のキューは溢れたら古いものから捨てる
+        pipeline_desc =
+            "udpsrc port=" + std::to_string(port) + " caps=\"video/mpegts,systemstream=true,packetsize=188\" buffer-size=2097152 do-timestamp=true ! "
+            "queue name=q_net leaky=2 max-size-time=200000000 max-size-buffers=0 max-size-bytes=0 ! "
+            "tsparse set-timestamps=true ! tsdemux name=demux" + std::string(has_property("tsdemux", "latency") ? " latency=100 " : " ") +
+            // 映像（圧縮されたままのフレームは捨てない）
+            "demux. ! queue name=q_video max-size-time=200000000 max-size-buffers=0 max-size-bytes=0 ! "
+            "decodebin ! " + low_latency_video_tail +
+            // 音声（AAC のフレームは1つずつ独立しているので捨ててよい）
+            "demux. ! queue name=q_audio leaky=2 max-size-time=200000000 max-size-buffers=0 max-size-bytes=0 ! "
+            "decodebin ! audioconvert ! audioresample ! " + audio_caps + " ! "
+            "appsink name=asink emit-signals=true sync=false max-buffers=100 drop=false";
+    } else if (mode == "ts") {
         pipeline_desc =
             "udpsrc port=" + std::to_string(port) + " caps=\"video/mpegts,systemstream=true,packetsize=188\" buffer-size=2097152 do-timestamp=true ! "
-            "queue2 use-buffering=true max-size-time=1500000000 max-size-buffers=0 max-size-bytes=0 ! "
+            "queue2 name=q_net use-buffering=true max-size-time=1500000000 max-size-buffers=0 max-size-bytes=0 ! "
             "tsparse set-timestamps=true ! tsdemux name=demux "
             // 映像
-            "demux. ! queue2 use-buffering=true max-size-time=1000000000 max-size-buffers=0 max-size-bytes=0 ! "
+            "demux. ! queue2 name=q_video use-buffering=true max-size-time=1000000000 max-size-buffers=0 max-size-bytes=0 ! "
             "decodebin ! videoconvert ! video/x-raw,format=BGR ! "
             "appsink name=vsink emit-signals=true sync=false max-buffers=8 drop=true "
             // 音声
-            "demux. ! queue2 use-buffering=true max-size-time=1500000000 max-size-buffers=0 max-size-bytes=0 ! "
+            "demux. ! queue2 name=q_audio use-buffering=true max-size-time=1500000000 max-size-buffers=0 max-size-bytes=0 ! "
             "decodebin ! audioconvert ! audioresample ! audio/x-raw,format=S16LE,rate=" + std::to_string(SAMPLE_RATE) + ",channels=" + std::to_string(CHANNELS) + " ! "
             "appsink name=asink emit-signals=true sync=false max-buffers=100 drop=false";
+    } else if (mode == "flv" && g_low_latency) {
+        // TCP のバイト列は途中を捨てると FLV が壊れるので、入口のキューは小さくするだけで捨てない
+        pipeline_desc =
+            "tcpserversrc host=0.0.0.0 port=" + std::to_string(port) + " ! "
+            "queue name=q_net max-size-time=0 max-size-buffers=0 max-size-bytes=1048576 ! "
+            "typefind ! decodebin name=dec "
+            "dec. ! " + low_latency_video_tail +
+            "dec. ! " + low_latency_audio_tail;
     } else if (mode == "flv") {
         // 以前の安定版: tcpserversrc → typefind → decodebin（映像/音声のPadに自動分岐）
         pipeline_desc =
             "tcpserversrc host=0.0.0.0 port=" + std::to_string(port) + " ! "
-            "queue2 use-buffering=true max-size-time=2000000000 max-size-buffers=0 max-size-bytes=0 ! "
+            "queue2 name=q_net use-buffering=true max-size-time=2000000000 max-size-buffers=0 max-size-bytes=0 ! "
             "typefind ! decodebin name=dec "
             // 映像
-            "dec. ! queue leaky=2 max-size-buffers=8 max-size-bytes=0 max-size-time=0 ! "
+            "dec. ! queue name=q_raw leaky=2 max-size-buffers=8 max-size-bytes=0 max-size-time=0 ! "
             "videoconvert ! video/x-raw,format=BGR ! "
             "appsink name=vsink emit-signals=true sync=false max-buffers=8 drop=true "
             // 音声
-            "dec. ! queue max-size-buffers=100 max-size-bytes=0 max-size-time=0 ! "
+            "dec. ! queue name=q_audio max-size-buffers=100 max-size-bytes=0 max-size-time=0 ! "
             "audioconvert ! audioresample ! audio/x-raw,format=S16LE,rate=" + std::to_string(SAMPLE_RATE) + ",channels=" + std::to_string(CHANNELS) + " ! "
             "appsink name=asink emit-signals=true sync=false max-buffers=100 drop=false";
     } else if (mode == "flv_srv") {
@@ -281,16 +482,21 @@ int main(int argc, char* argv[]) {
     std::cout << "[flv_srv] Listening on 0.0.0.0:" << port << std::endl;
 
         auto build_and_run_from_fd = [&](int conn_fd) -> bool {
-            std::string pdesc =
+            std::string pdesc = g_low_latency ?
+                "fdsrc fd=" + std::to_string(conn_fd) + " do-timestamp=true blocksize=4096 ! "
+                "queue name=q_net max-size-time=0 max-size-buffers=0 max-size-bytes=1048576 ! "
+                "typefind ! decodebin name=dec "
+                "dec. ! " + low_latency_video_tail +
+                "dec. ! " + low_latency_audio_tail :
                 "fdsrc fd=" + std::to_string(conn_fd) + " do-timestamp=true blocksize=4096 ! "
-                "queue2 use-buffering=true max-size-time=2000000000 max-size-buffers=0 max-size-bytes=0 ! "
+                "queue2 name=q_net use-buffering=true max-size-time=2000000000 max-size-buffers=0 max-size-bytes=0 ! "
                 "typefind ! decodebin name=dec "
                 // 映像
-                "dec. ! queue leaky=2 max-size-buffers=8 max-size-bytes=0 max-size-time=0 ! "
+                "dec. ! queue name=q_raw leaky=2 max-size-buffers=8 max-size-bytes=0 max-size-time=0 ! "
                 "videoconvert ! video/x-raw,format=BGR ! "
                 "appsink name=vsink emit-signals=true sync=false max-buffers=8 drop=true "
                 // 音声
-                "dec. ! queue max-size-buffers=100 max-size-bytes=0 max-size-time=0 ! "
+                "dec. ! queue name=q_audio max-size-buffers=100 max-size-bytes=0 max-size-time=0 ! "
                 "audioconvert ! audioresample ! audio/x-raw,format=S16LE,rate=" + std::to_string(SAMPLE_RATE) + ",channels=" + std::to_string(CHANNELS) + " ! "
                 "appsink name=asink emit-signals=true sync=false max-buffers=100 drop=false";
 
@@ -322,6 +528,8 @@ int main(int argc, char* argv[]) {
             GstBus* bus = gst_element_get_bus(pipeline2);
             BusCtx bus_ctx; bus_ctx.loop = loop; bus_ctx.pipeline = pipeline2; bus_ctx.auto_restart = false; bus_ctx.request_restart = false;
             gst_bus_add_watch(bus, (GstBusFunc)on_bus_message, &bus_ctx);
+            QueueReport queue_report;
+            const guint report_id = prepare_pipeline(pipeline2, queue_report);
 
             gst_element_set_state(pipeline2, GST_STATE_PLAYING);
 
@@ -333,6 +541,7 @@ int main(int argc, char* argv[]) {
             g_main_loop_run(loop);
 
             if (stopper.joinable()) stopper.join();
+            g_source_remove(report_id);
             gst_element_set_state(pipeline2, GST_STATE_NULL);
             gst_object_unref(bus);
             gst_object_unref(vsink_el);
@@ -429,6 +638,8 @@ int main(int argc, char* argv[]) {
     bus_ctx.auto_restart = enable_restart;
         bus_ctx.request_restart = false;
         gst_bus_add_watch(bus, (GstBusFunc)on_bus_message, &bus_ctx);
+        QueueReport queue_report;
+        const guint report_id = prepare_pipeline(pipeline, queue_report);
 
         gst_element_set_state(pipeline, GST_STATE_PLAYING);
 
@@ -443,6 +654,7 @@ int main(int argc, char* argv[]) {
 
         if (stopper.joinable()) stopper.join();
 
+        g_source_remove(report_id);
         gst_element_set_state(pipeline, GST_STATE_NULL);
         gst_object_unref(bus);
         gst_object_unref(vsink_el);
@@ -459,8 +671,9 @@ int main(int argc, char* argv[]) {
 
     if (vthr.joinable()) vthr.join();
 
-    close(i2c_fd);
+    if (i2c_fd >= 0) close(i2c_fd);
     audio_cleanup();
+    metrics::stop_metrics_server();
 
     std::cout << "\nプログラムを終了します。" << std::endl;
     return 0;
@@ -5,6 +5,12 @@
 #include "video.h" // ★★★ 'frame_to_grid' のために必要 ★★★
 #include "file_audio_gst.h"
 #include "audio.h"
+#include "metrics.h"
+#include "live_config.h"
+#include "display_client.h"
+#include "frame_scheduler.h"
+#include "seg_dither.h"
+#include "local_dimming.h"
 #include <opencv2/opencv.hpp> // ★★★ 'cv::' 関連 ★★★
 #include <opencv2/core/ocl.hpp> // ★★★ GPU/OpenCLサポート用 ★★★
 #include <iostream>
@@ -16,6 +22,7 @@
 #include <unistd.h>
 #include <fcntl.h>
 #include <atomic>             // std::atomic のために念のため
+#include <cmath>
 
 // Python版と同じ比率・スケール・オフセットでセグメント座標を計算
 // グローバル定数
@@ -214,7 +221,6 @@ CachedDisplayLayout create_cached_layout(const DisplayConfig& config) {
 }
 
 std::atomic<bool>* g_current_stop_flag = nullptr;
-//std::map<std::pair<int, int>, int> g_error_counts;
 
 /*
 void handle_signal(int signal) {
@@ -233,26 +239,132 @@ void display_text_emulator(const std::vector<uint8_t>& grid, const DisplayConfig
     // この関数は削除されました
 }
 
+// 入力フレームをスケーリングモードに従って表示領域へ合わせ、白黒2値化する
+// （実機再生・エミュレータ再生・ベンチマークで共通）
+void prepare_gray_frame(const cv::Mat& frame, const DisplayConfig& config, ScalingMode scaling_mode,
+                        cv::Mat& gray_frame, bool debug, const char* debug_tag) {
+    cv::Mat cropped_frame;
+    float source_aspect = static_cast<float>(frame.cols) / frame.rows;
+    const float target_aspect = static_cast<float>(config.total_width * CHAR_WIDTH_MM) / (config.total_height * CHAR_HEIGHT_MM);
+
+    if (scaling_mode == ScalingMode::CROP) {
+        // アスペクト比を維持してトリミング
+        if (source_aspect > target_aspect) {
+            int new_width = static_cast<int>(frame.rows * target_aspect);
+            int x = (frame.cols - new_width) / 2;
+            cv::Rect crop_region(x, 0, new_width, frame.rows);
+            cropped_frame = frame(crop_region);
+        } else {
+            int new_height = static_cast<int>(frame.cols / target_aspect);
+            int y = (frame.rows - new_height) / 2;
+            cv::Rect crop_region(0, y, frame.cols, new_height);
+            cropped_frame = frame(crop_region);
+        }
+    } else if (scaling_mode == ScalingMode::STRETCH) {
+        // アスペクト比を無視してディスプレイ領域いっぱいに表示する
+        // display の物理アスペクト比に合わせた ROI サイズを計算し、
+        // そのサイズに対して動画を非保持アスペクトでリサイズ（ストレッチ）して渡す。
+        const double display_aspect = (config.total_width * CHAR_WIDTH_MM) / (config.total_height * CHAR_HEIGHT_MM);
+        int roi_w, roi_h, roi_x, roi_y;
+        if (static_cast<double>(W) / static_cast<double>(H) > display_aspect) {
+            roi_h = H;
+            roi_w = std::max(1, static_cast<int>(std::round(roi_h * display_aspect)));
+            roi_x = (W - roi_w) / 2;
+            roi_y = 0;
+        } else {
+            roi_w = W;
+            roi_h = std::max(1, static_cast<int>(std::round(roi_w / display_aspect)));
+            roi_x = 0;
+            roi_y = (H - roi_h) / 2;
+        }
+        if (debug) std::cerr << "[STRETCH" << debug_tag << "] source_aspect=" << source_aspect << " display_aspect=" << display_aspect
+                  << " roi=("<<roi_x<<","<<roi_y<<","<<roi_w<<","<<roi_h<<")\n";
+        cv::Mat stretched;
+        // 非アスペクト保持でリサイズ -> 結果は display の領域サイズ (roi_w x roi_h)
+        cv::resize(frame, stretched, cv::Size(roi_w, roi_h));
+        cropped_frame = stretched;
+    } else { // FIT
+        // アスペクト比を維持して全体を表示（余白可能）
+        // display の物理アスペクト比に合わせた ROI を W x H キャンバス上に作り、
+        // その ROI 内に動画をアスペクト比を保って FIT して中央に貼り付ける。
+        // 最後に ROI 部分だけを抜き出して次段に渡す（frame_to_grid が正しい割合で動作するようにする）。
+        const double display_aspect = (config.total_width * CHAR_WIDTH_MM) / (config.total_height * CHAR_HEIGHT_MM);
+
+        // W x H のキャンバス
+        cv::Mat fit_canvas = cv::Mat::zeros(H, W, frame.type());
+
+        // キャンバス上の ROI を決定
+        int roi_w, roi_h, roi_x, roi_y;
+        if (static_cast<double>(W) / static_cast<double>(H) > display_aspect) {
+            // キャンバスは表示より横長 -> ROI の高さを H に合わせる
+            roi_h = H;
+            roi_w = std::max(1, static_cast<int>(std::round(roi_h * display_aspect)));
+            roi_x = (W - roi_w) / 2;
+            roi_y = 0;
+        } else {
+            // キャンバスは表示より縦長 -> ROI の幅を W に合わせる
+            roi_w = W;
+            roi_h = std::max(1, static_cast<int>(std::round(roi_w / display_aspect)));
+            roi_x = 0;
+            roi_y = (H - roi_h) / 2;
+        }
+
+        // ROI 内に動画を FIT（縮小）して中央寄せ
+        double scale2 = std::min(static_cast<double>(roi_w) / frame.cols, static_cast<double>(roi_h) / frame.rows);
+        int dst_w = std::max(1, static_cast<int>(frame.cols * scale2 + 0.5));
+        int dst_h = std::max(1, static_cast<int>(frame.rows * scale2 + 0.5));
+        if (debug) std::cerr << "[FIT" << debug_tag << "] source_aspect=" << source_aspect << " display_aspect=" << display_aspect
+                  << " roi=("<<roi_x<<","<<roi_y<<","<<roi_w<<","<<roi_h<<") dst=("<<dst_w<<","<<dst_h<<")\n";
+
+        cv::Mat scaled_frame;
+        cv::resize(frame, scaled_frame, cv::Size(dst_w, dst_h));
+        int paste_x = roi_x + (roi_w - dst_w) / 2;
+        int paste_y = roi_y + (roi_h - dst_h) / 2;
+        scaled_frame.copyTo(fit_canvas(cv::Rect(paste_x, paste_y, dst_w, dst_h)));
+
+        // 重要: ROI 部分だけを抜き出して渡す。これで frame_to_grid が期待通りの領域を扱う。
+        cropped_frame = fit_canvas(cv::Rect(roi_x, roi_y, roi_w, roi_h)).clone();
+    }
+
+    // FIT/CROP/STRETCH は既にアスペクトを display に合わせた ROI になっているため、
+    // ここで W x H にリサイズせず、切り出した画像をそのままグレースケールにする。
+    cv::cvtColor(cropped_frame, gray_frame, cv::COLOR_BGR2GRAY);
+}
+
+void prepare_bw_frame(const cv::Mat& frame, const DisplayConfig& config, ScalingMode scaling_mode,
+                      int min_threshold, int max_threshold, cv::Mat& bw_frame, bool debug, const char* debug_tag) {
+    cv::Mat gray_frame;
+    prepare_gray_frame(frame, config, scaling_mode, gray_frame, debug, debug_tag);
+    cv::threshold(gray_frame, bw_frame, min_threshold, max_threshold, cv::THRESH_BINARY);
+}
+
 // 共通の動画再生ロジック
 int play_video_stream(const std::string& video_path, const DisplayConfig& config, std::atomic<bool>& stop_flag, 
                      ScalingMode scaling_mode, int min_threshold, int max_threshold, bool debug) {
     g_current_stop_flag = &stop_flag;
     stop_flag = false;
 
-    int i2c_fd = open_i2c_auto(config);
-    if (i2c_fd < 0) {
-        std::cerr << "I2C communication failed: No I2C devices found or access denied." << std::endl;
-        std::cerr << "Please check:" << std::endl;
-        std::cerr << "  - I2C hardware is connected and powered" << std::endl;
-        std::cerr << "  - You have permission to access I2C devices" << std::endl;
-        std::cerr << "  - Use emulator mode if you don't have hardware: ./7seg-http-player <path> emulator-<width>x<height>" << std::endl;
-        return -1;
-    }
+    // 表示構成と2値化パラメータは再生中にも差し替わる（live_config.h）。フレームごとに読み直す
+    std::shared_ptr<const LiveSettings> live = live_settings_or(config, scaling_mode, min_threshold, max_threshold);
+    // 7seg-displayd に送る場合（SEG_DISPLAYD_PRIORITY）は I2C を開かない
+    DisplayClient* output = displayd_output();
+    int i2c_fd = -1;
+    if (!output) {
+        i2c_fd = open_i2c_auto(*live->display);
+        if (i2c_fd < 0) {
+            std::cerr << "I2C communication failed: No I2C devices found or access denied." << std::endl;
+            std::cerr << "Please check:" << std::endl;
+            std::cerr << "  - I2C hardware is connected and powered" << std::endl;
+            std::cerr << "  - You have permission to access I2C devices" << std::endl;
+            std::cerr << "  - Use emulator mode if you don't have hardware: ./7seg-http-player <path> emulator-<width>x<height>" << std::endl;
+            return -1;
+        }
 
-    if (!initialize_displays(i2c_fd, config)) {
-        std::cerr << "Failed to initialize display modules." << std::endl;
-        close(i2c_fd);
-        return -1;
+        if (!initialize_displays(i2c_fd, *live->display)) {
+            std::cerr << "Failed to initialize display modules." << std::endl;
+            close(i2c_fd);
+            return -1;
+        }
     }
 
     cv::VideoCapture cap;
@@ -270,7 +382,7 @@ int play_video_stream(const std::string& video_path, const DisplayConfig& config
 
     if (!cap.isOpened()) {
         std::cerr << "動画ソースを開けません: " << video_path << std::endl;
-        close(i2c_fd);
+        if (i2c_fd >= 0) close(i2c_fd);
         return -1;
     }
 
@@ -298,126 +410,120 @@ int play_video_stream(const std::string& video_path, const DisplayConfig& config
 
     double fps = cap.get(cv::CAP_PROP_FPS);
     if (fps <= 0) fps = 30.0;
-    auto frame_duration = std::chrono::microseconds(static_cast<long long>(1000000.0 / fps));
     std::cout << "再生開始: " << video_path << " (" << fps << " FPS)" << std::endl;
 
-    auto next_frame_time = std::chrono::steady_clock::now();
+    // SEG_GRAY_SUBFRAMES: 2値化の代わりに、1映像フレームを最大 N 枚のサブフレームに分けて擬似階調で出す
+    // サブフレームは映像の N 倍の周期で書くので、I2C に直接書くときだけ使う（7seg-displayd は自分の周期で書く）
+    int max_subframes = gray_subframes_from_env();
+    if (max_subframes > 0 && output) {
+        std::cerr << "[gray] SEG_GRAY_SUBFRAMES is ignored when sending to 7seg-displayd" << std::endl;
+        max_subframes = 0;
+    }
+    int subframes = std::max(1, max_subframes);
+    // サブフレームの周期がスケジューラの上限を超えないようにする（超えると締め切りは上限で刻まれ、fps * subframes とずれる）
+    if (max_subframes > 0) {
+        subframes = std::max(1, std::min(subframes, static_cast<int>(FrameScheduler::kMaxFps / fps)));
+        max_subframes = subframes;
+    }
+
+    // 動画の fps（グレースケールではその subframes 倍）で締め切りを刻む。バスが追いつかなければ RateController が
+    // 表示周期（グレースケールではサブフレーム数）を下げる
+    // 表示するフレームは締め切りの時刻から決め、間のフレーム（遅れて飛ばした締め切りの分も）は読み捨てて音声と揃える
+    FrameScheduler scheduler(fps * subframes);
+    // RateController はスケジューラが実際に刻む周期（範囲に切った後）から始める
+    RateController rate(scheduler.fps(), scheduler.fps());
+    TemporalDither dither;
+    std::vector<uint8_t> levels;
+    // SEG_LOCAL_DIMMING: モジュールごとの輝度を映像の明るさに合わせる（輝度コマンドも I2C に直接書くときだけ）
+    const bool dimming = local_dimming_from_env() && !output;
+    LocalDimming local_dimming;
+    if (dimming) std::cout << "[dimming] per-module brightness from image luminance" << std::endl;
+    if (max_subframes > 0) {
+        metrics::gray_subframes().set(subframes);
+        std::cout << "[gray] " << subframes << " sub-frames per frame (" << scheduler.fps() << " Hz)" << std::endl;
+    }
+    const auto play_start = scheduler.deadline();
+    const auto source_period = std::chrono::nanoseconds(std::llround(1e9 / fps));
+    int64_t next_index = 0; // 次に読む動画のフレーム番号
+    set_output_thread_realtime_from_env("playback");
     cv::Mat frame;
+    std::vector<uint8_t> grid;
 
     // g_should_exit (Ctrl+C) と stop_flag (ロジックによる停止) の両方をチェック
-    while (!g_should_exit && !stop_flag && cap.read(frame)) {
-        cv::Mat cropped_frame;
-        float source_aspect = static_cast<float>(frame.cols) / frame.rows;
-        const float target_aspect = static_cast<float>(config.total_width * CHAR_WIDTH_MM) / (config.total_height * CHAR_HEIGHT_MM);
-
-            if (scaling_mode == ScalingMode::CROP) {
-            // アスペクト比を維持してトリミング
-            if (source_aspect > target_aspect) {
-                int new_width = static_cast<int>(frame.rows * target_aspect);
-                int x = (frame.cols - new_width) / 2;
-                cv::Rect crop_region(x, 0, new_width, frame.rows);
-                cropped_frame = frame(crop_region);
-            } else {
-                int new_height = static_cast<int>(frame.cols / target_aspect);
-                int y = (frame.rows - new_height) / 2;
-                cv::Rect crop_region(0, y, frame.cols, new_height);
-                cropped_frame = frame(crop_region);
+    while (!g_should_exit && !stop_flag) {
+        scheduler.wait_next();
+        // サブフレームの間は同じ映像フレームを使い続ける
+        const int64_t due_index = (scheduler.deadline() - play_start) / source_period - 1;
+        if (due_index >= next_index || grid.empty()) {
+            for (; next_index < due_index && cap.grab(); ++next_index) metrics::frames_dropped().inc();
+            ++next_index;
+            {
+                metrics::ScopedTimer timer(metrics::decode_latency());
+                if (!cap.read(frame)) break;
             }
-        } else if (scaling_mode == ScalingMode::STRETCH) {
-            // アスペクト比を無視してディスプレイ領域いっぱいに表示する
-            // display の物理アスペクト比に合わせた ROI サイズを計算し、
-            // そのサイズに対して動画を非保持アスペクトでリサイズ（ストレッチ）して渡す。
-            const double display_aspect = (config.total_width * CHAR_WIDTH_MM) / (config.total_height * CHAR_HEIGHT_MM);
-            int roi_w, roi_h, roi_x, roi_y;
-            if (static_cast<double>(W) / static_cast<double>(H) > display_aspect) {
-                roi_h = H;
-                roi_w = std::max(1, static_cast<int>(std::round(roi_h * display_aspect)));
-                roi_x = (W - roi_w) / 2;
-                roi_y = 0;
-            } else {
-                roi_w = W;
-                roi_h = std::max(1, static_cast<int>(std::round(roi_w / display_aspect)));
-                roi_x = 0;
-                roi_y = (H - roi_h) / 2;
+            if (auto next = live_config().current(); next && next != live) {
+                if (!output && next->display != live->display) apply_layout_change(i2c_fd, *live->display, *next->display);
+                live = std::move(next);
             }
-            if (debug) std::cerr << "[STRETCH] source_aspect=" << source_aspect << " display_aspect=" << display_aspect
-                      << " roi=("<<roi_x<<","<<roi_y<<","<<roi_w<<","<<roi_h<<")\n";
-            cv::Mat stretched;
-            // 非アスペクト保持でリサイズ -> 結果は display の領域サイズ (roi_w x roi_h)
-            cv::resize(frame, stretched, cv::Size(roi_w, roi_h));
-            cropped_frame = stretched;
-            } else { // FIT
-            // アスペクト比を維持して全体を表示（余白可能）
-            // display の物理アスペクト比に合わせた ROI を W x H キャンバス上に作り、
-            // その ROI 内に動画をアスペクト比を保って FIT して中央に貼り付ける。
-            // 最後に ROI 部分だけを抜き出して次段に渡す（frame_to_grid が正しい割合で動作するようにする）。
-            const double display_aspect = (config.total_width * CHAR_WIDTH_MM) / (config.total_height * CHAR_HEIGHT_MM);
-
-            // W x H のキャンバス
-            cv::Mat fit_canvas = cv::Mat::zeros(H, W, frame.type());
-
-            // キャンバス上の ROI を決定
-            int roi_w, roi_h, roi_x, roi_y;
-            if (static_cast<double>(W) / static_cast<double>(H) > display_aspect) {
-                // キャンバスは表示より横長 -> ROI の高さを H に合わせる
-                roi_h = H;
-                roi_w = std::max(1, static_cast<int>(std::round(roi_h * display_aspect)));
-                roi_x = (W - roi_w) / 2;
-                roi_y = 0;
+            if (max_subframes > 0) {
+                cv::Mat gray_frame;
+                prepare_gray_frame(frame, *live->display, live->scaling_mode, gray_frame, debug, "");
+                frame_to_levels(gray_frame, *live->display, live->min_threshold, live->max_threshold, levels);
+                if (dimming && live->display->routing) local_dimming.update(*live->display->routing, levels, true);
+                dither.set_levels(levels);
+            } else if (dimming && live->display->routing) {
+                // 2値化はそのまま、明るさは同じ位置のグレースケール値から取る
+                cv::Mat gray_frame, bw_frame;
+                prepare_gray_frame(frame, *live->display, live->scaling_mode, gray_frame, debug, "");
+                cv::threshold(gray_frame, bw_frame, live->min_threshold, live->max_threshold, cv::THRESH_BINARY);
+                frame_to_grid(bw_frame, *live->display, grid);
+                frame_to_levels(gray_frame, *live->display, live->min_threshold, live->max_threshold, levels);
+                local_dimming.update(*live->display->routing, levels, false);
             } else {
-                // キャンバスは表示より縦長 -> ROI の幅を W に合わせる
-                roi_w = W;
-                roi_h = std::max(1, static_cast<int>(std::round(roi_w / display_aspect)));
-                roi_x = 0;
-                roi_y = (H - roi_h) / 2;
+                cv::Mat bw_frame;
+                prepare_bw_frame(frame, *live->display, live->scaling_mode, live->min_threshold, live->max_threshold, bw_frame, debug, "");
+                frame_to_grid(bw_frame, *live->display, grid);
             }
-
-            // ROI 内に動画を FIT（縮小）して中央寄せ
-            double scale2 = std::min(static_cast<double>(roi_w) / frame.cols, static_cast<double>(roi_h) / frame.rows);
-            int dst_w = std::max(1, static_cast<int>(frame.cols * scale2 + 0.5));
-            int dst_h = std::max(1, static_cast<int>(frame.rows * scale2 + 0.5));
-            if (debug) std::cerr << "[FIT] source_aspect=" << source_aspect << " display_aspect=" << display_aspect
-                      << " roi=("<<roi_x<<","<<roi_y<<","<<roi_w<<","<<roi_h<<") dst=("<<dst_w<<","<<dst_h<<")\n";
-
-            cv::Mat scaled_frame;
-            cv::resize(frame, scaled_frame, cv::Size(dst_w, dst_h));
-            int paste_x = roi_x + (roi_w - dst_w) / 2;
-            int paste_y = roi_y + (roi_h - dst_h) / 2;
-            scaled_frame.copyTo(fit_canvas(cv::Rect(paste_x, paste_y, dst_w, dst_h)));
-
-            // 重要: ROI 部分だけを抜き出して渡す。これで frame_to_grid が期待通りの領域を扱う。
-            cropped_frame = fit_canvas(cv::Rect(roi_x, roi_y, roi_w, roi_h)).clone();
-        }
-
-        cv::Mat resized_frame, gray_frame, bw_frame;
-        // FIT/CROP は既にアスペクトを display に合わせた ROI を渡しているため、
-        // ここで無理に W x H にリサイズするとアスペクト比が崩れて潰れた表示になる。
-        // そのため FIT と CROP の場合はリサイズをスキップして、切り出した画像をそのまま渡す。
-        if (scaling_mode == ScalingMode::FIT || scaling_mode == ScalingMode::CROP || scaling_mode == ScalingMode::STRETCH) {
-            resized_frame = cropped_frame;
-        } else {
-            cv::resize(cropped_frame, resized_frame, cv::Size(W, H));
         }
-        cv::cvtColor(resized_frame, gray_frame, cv::COLOR_BGR2GRAY);
-        cv::threshold(gray_frame, bw_frame, min_threshold, max_threshold, cv::THRESH_BINARY);
-
-        std::vector<uint8_t> grid;
-        frame_to_grid(bw_frame, config, grid);
+        if (max_subframes > 0) dither.next(grid);
+        const DisplayConfig& cfg = *live->display;
+        scheduler.wait_commit();
    
         I2CErrorInfo error_info;
 
-        if (!update_flexible_display(i2c_fd, config, grid, error_info)) {
-               if (error_info.error_occurred) {
-                //g_error_counts[{error_info.channel, error_info.address}]++;
+        if (output) {
+            if (output->submit_grid(grid, cfg.total_width, cfg.total_height)) metrics::frames_displayed().inc();
+            scheduler.commit_done();
+        } else if (update_flexible_display(i2c_fd, cfg, grid, local_dimming.brightness(), error_info)) {
+            metrics::frames_displayed().inc();
+            scheduler.commit_done();
+            if (rate.observe(scheduler, last_update_stats())) {
+                if (max_subframes == 0) {
+                    scheduler.set_fps(rate.fps());
+                } else if (const int n = std::max(1, static_cast<int>(rate.fps() / fps + 1e-6)); n != subframes) {
+                    // サブフレームは映像フレームの整数倍で刻む（バスが映像の fps にも追いつかなければ 1 枚で締め切りを飛ばす）
+                    std::cout << "[gray] " << subframes << " -> " << n << " sub-frames per frame" << std::endl;
+                    subframes = n;
+                    scheduler.set_fps(fps * subframes);
+                    metrics::gray_subframes().set(subframes);
+                }
             }
-            if (!attempt_i2c_recovery(i2c_fd, config)) {
+        } else {
+            // モジュール単位の失敗は led.cpp 側で g_error_counts に集計済み
+            if (!attempt_i2c_recovery(i2c_fd, cfg)) {
             // 全ての復旧に失敗した場合、長めに待つ
             std::cerr << "Recovery failed. Pausing before next attempt..." << std::endl;
             sleep(2);    
             }   
         }
-        next_frame_time += frame_duration;
-        std::this_thread::sleep_until(next_frame_time);
+    }
+    if (debug) {
+        const auto st = scheduler.stats();
+        std::cerr << "[playback] frames " << st.frames << ", missed deadlines " << st.missed << ", jitter mean "
+                  << st.mean_abs_jitter_us << " us / max " << st.max_abs_jitter_us << " us, lead " << st.lead_us << " us (commit " << st.commit_lead_us << " us)"
+                  << ", output " << rate.fps() << " fps";
+        if (max_subframes > 0) std::cerr << " (" << subframes << " gray sub-frames)";
+        std::cerr << std::endl;
     }
 
     if (video_path != "-") {
@@ -429,7 +535,9 @@ int play_video_stream(const std::string& video_path, const DisplayConfig& config
         }
     }
     cap.release();
-    close(i2c_fd);
+    if (i2c_fd >= 0) close(i2c_fd);
+    // 次のソースが表示されるように、hold_ms を待たずに表示を手放す
+    if (output) output->release();
 
     if (stop_flag) {
         std::cout << "再生中止: " << video_path << std::endl;
@@ -461,8 +569,9 @@ int play_video_stream_emulator(const std::string& video_path, const DisplayConfi
         }
     }
 
-    // 起動時に全桁分のセグメントレイアウトを計算してキャッシュ
-    CachedDisplayLayout cache = create_cached_layout(config);
+    // 起動時に全桁分のセグメントレイアウトを計算してキャッシュ（構成が差し替わったら作り直す）
+    std::shared_ptr<const LiveSettings> live = live_settings_or(config, scaling_mode, min_threshold, max_threshold);
+    CachedDisplayLayout cache = create_cached_layout(*live->display);
 
     cv::VideoCapture cap;
     if (video_path == "-") {
@@ -505,129 +614,38 @@ int play_video_stream_emulator(const std::string& video_path, const DisplayConfi
 
     double fps = cap.get(cv::CAP_PROP_FPS);
     if (fps <= 0) fps = 30.0;
-    auto frame_duration = std::chrono::microseconds(static_cast<long long>(1000000.0 / fps));
     std::cout << "エミュレータ再生開始: " << video_path << " (" << fps << " FPS)" << std::endl;
 
-    auto next_frame_time = std::chrono::steady_clock::now();
+    // 実機と同じスケジューラで刻む（遅れた分は読み捨てて音声と揃える）
+    FrameScheduler scheduler(fps);
     cv::Mat frame;
 
-    // 音声同期のための変数
-    auto start_time = std::chrono::steady_clock::now();
-    long long frame_count = 0;
-
     // g_should_exit (Ctrl+C) と stop_flag (ロジックによる停止) の両方をチェック
-    while (!g_should_exit && !stop_flag && cap.read(frame)) {
-        // 音声同期: 現在の再生時間を計算
-        auto current_time_sync = std::chrono::steady_clock::now();
-        auto elapsed = current_time_sync - start_time;
-        double expected_frame_time = frame_count / fps;
-        double actual_elapsed = std::chrono::duration<double>(elapsed).count();
-        
-        // 動画が音声より遅れている場合、フレームをスキップして追いつく
-        if (actual_elapsed > expected_frame_time + 0.1) { // 100ms以上の遅れ
-            frame_count++;
-            continue; // 次のフレームを処理
+    while (!g_should_exit && !stop_flag) {
+        const int skipped = scheduler.wait_next();
+        for (int i = 0; i < skipped && cap.grab(); ++i) metrics::frames_dropped().inc();
+        {
+            metrics::ScopedTimer timer(metrics::decode_latency());
+            if (!cap.read(frame)) break;
         }
-        
-        cv::Mat cropped_frame;
-        float source_aspect = static_cast<float>(frame.cols) / frame.rows;
-        const float target_aspect = static_cast<float>(config.total_width * CHAR_WIDTH_MM) / (config.total_height * CHAR_HEIGHT_MM);
-
-            if (scaling_mode == ScalingMode::CROP) {
-            // アスペクト比を維持してトリミング
-            if (source_aspect > target_aspect) {
-                int new_width = static_cast<int>(frame.rows * target_aspect);
-                int x = (frame.cols - new_width) / 2;
-                cv::Rect crop_region(x, 0, new_width, frame.rows);
-                cropped_frame = frame(crop_region);
-            } else {
-                int new_height = static_cast<int>(frame.cols / target_aspect);
-                int y = (frame.rows - new_height) / 2;
-                cv::Rect crop_region(0, y, frame.cols, new_height);
-                cropped_frame = frame(crop_region);
-            }
-        } else if (scaling_mode == ScalingMode::STRETCH) {
-            // エミュレータ側でもストレッチは display の物理アスペクトに合わせて
-            const double display_aspect = (config.total_width * CHAR_WIDTH_MM) / (config.total_height * CHAR_HEIGHT_MM);
-            int roi_w, roi_h, roi_x, roi_y;
-            if (static_cast<double>(W) / static_cast<double>(H) > display_aspect) {
-                roi_h = H;
-                roi_w = std::max(1, static_cast<int>(std::round(roi_h * display_aspect)));
-                roi_x = (W - roi_w) / 2;
-                roi_y = 0;
-            } else {
-                roi_w = W;
-                roi_h = std::max(1, static_cast<int>(std::round(roi_w / display_aspect)));
-                roi_x = 0;
-                roi_y = (H - roi_h) / 2;
-            }
-            if (debug) std::cerr << "[STRETCH-emu] source_aspect=" << source_aspect << " display_aspect=" << display_aspect
-                      << " roi=("<<roi_x<<","<<roi_y<<","<<roi_w<<","<<roi_h<<")\n";
-            cv::Mat stretched;
-            cv::resize(frame, stretched, cv::Size(roi_w, roi_h));
-            cropped_frame = stretched;
-            } else { // FIT
-            // アスペクト比を維持して全体を表示（余白可能）
-            // display の物理アスペクト比に合わせた ROI を W x H キャンバス上に作り、
-            // その ROI 内に動画をアスペクト比を保って FIT して中央に貼り付ける。
-            const double display_aspect = (config.total_width * CHAR_WIDTH_MM) / (config.total_height * CHAR_HEIGHT_MM);
-
-            // W x H のキャンバス
-            cv::Mat fit_canvas = cv::Mat::zeros(H, W, frame.type());
-
-            // キャンバス上の ROI を決定
-            int roi_w, roi_h, roi_x, roi_y;
-            if (static_cast<double>(W) / static_cast<double>(H) > display_aspect) {
-                // キャンバスは表示より横長 -> ROI の高さを H に合わせる
-                roi_h = H;
-                roi_w = std::max(1, static_cast<int>(std::round(roi_h * display_aspect)));
-                roi_x = (W - roi_w) / 2;
-                roi_y = 0;
-            } else {
-                // キャンバスは表示より縦長 -> ROI の幅を W に合わせる
-                roi_w = W;
-                roi_h = std::max(1, static_cast<int>(std::round(roi_w / display_aspect)));
-                roi_x = 0;
-                roi_y = (H - roi_h) / 2;
-            }
-
-            // ROI 内に動画を FIT（縮小）して中央寄せ
-            double scale2 = std::min(static_cast<double>(roi_w) / frame.cols, static_cast<double>(roi_h) / frame.rows);
-            int dst_w = std::max(1, static_cast<int>(frame.cols * scale2 + 0.5));
-            int dst_h = std::max(1, static_cast<int>(frame.rows * scale2 + 0.5));
-            if (debug) std::cerr << "[FIT-emu] source_aspect=" << source_aspect << " display_aspect=" << display_aspect
-                      << " roi=("<<roi_x<<","<<roi_y<<","<<roi_w<<","<<roi_h<<") dst=("<<dst_w<<","<<dst_h<<")\n";
-            if (debug) std::cerr << "[FIT] source_aspect=" << source_aspect << " display_aspect=" << display_aspect
-                      << " roi=("<<roi_x<<","<<roi_y<<","<<roi_w<<","<<roi_h<<") dst=("<<dst_w<<","<<dst_h<<")\n";
-            cv::Mat scaled_frame;
-            cv::resize(frame, scaled_frame, cv::Size(dst_w, dst_h));
-            int paste_x = roi_x + (roi_w - dst_w) / 2;
-            int paste_y = roi_y + (roi_h - dst_h) / 2;
-            scaled_frame.copyTo(fit_canvas(cv::Rect(paste_x, paste_y, dst_w, dst_h)));
-
-            // 重要: ROI 部分だけを抜き出して渡す。これで frame_to_grid が期待通りの領域を扱う。
-            cropped_frame = fit_canvas(cv::Rect(roi_x, roi_y, roi_w, roi_h)).clone();
+        if (auto next = live_config().current(); next && next != live) {
+            if (next->display != live->display) cache = create_cached_layout(*next->display);
+            live = std::move(next);
         }
+        const DisplayConfig& cfg = *live->display;
 
-        cv::Mat resized_frame, gray_frame, bw_frame;
-        // エミュレータ側も同様: FIT と CROP の場合は ROI のまま渡す
-        if (scaling_mode == ScalingMode::FIT || scaling_mode == ScalingMode::CROP || scaling_mode == ScalingMode::STRETCH) {
-            resized_frame = cropped_frame;
-        } else {
-            cv::resize(cropped_frame, resized_frame, cv::Size(W, H));
-        }
-        cv::cvtColor(resized_frame, gray_frame, cv::COLOR_BGR2GRAY);
-        cv::threshold(gray_frame, bw_frame, min_threshold, max_threshold, cv::THRESH_BINARY);
+        cv::Mat bw_frame;
+        prepare_bw_frame(frame, cfg, live->scaling_mode, live->min_threshold, live->max_threshold, bw_frame, debug, "-emu");
 
         std::vector<uint8_t> grid;
-        frame_to_grid(bw_frame, config, grid);
+        frame_to_grid(bw_frame, cfg, grid);
 
         // エミュレータ表示 (キャッシュされたレイアウトを使用)
         cv::Mat display_frame = cv::Mat::zeros(cache.window_height, cache.window_width, CV_8UC3);
 
-        for (int r = 0; r < config.total_height; ++r) {
-            for (int c = 0; c < config.total_width; ++c) {
-                int idx = r * config.total_width + c;
+        for (int r = 0; r < cfg.total_height; ++r) {
+            for (int c = 0; c < cfg.total_width; ++c) {
+                int idx = r * cfg.total_width + c;
                 if (idx >= static_cast<int>(grid.size())) continue;
                 
                 uint8_t seg = grid[idx];
@@ -644,21 +662,11 @@ int play_video_stream_emulator(const std::string& video_path, const DisplayConfi
             }
         }
         // エミュレータ表示 (macOSでもGUIウィンドウを表示)
+        scheduler.wait_commit();
         cv::imshow("7seg-emulator", display_frame);
+        metrics::frames_displayed().inc();
         if (cv::waitKey(1) == 27) break; // ESCで終了
-
-        // 音声同期: 理想的なフレームタイミングを計算
-        frame_count++;
-        auto ideal_time = start_time + frame_count * frame_duration;
-        auto current_time_frame = std::chrono::steady_clock::now();
-        
-        if (current_time_frame < ideal_time) {
-            // まだ時間が余っている場合は待つ
-            std::this_thread::sleep_until(ideal_time);
-        } else {
-            // 遅れている場合は、次のフレームに進む（ドロップしない）
-            next_frame_time = current_time_frame + frame_duration;
-        }
+        scheduler.commit_done();
     }
 
     if (video_path != "-") {
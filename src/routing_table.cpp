@@ -0,0 +1,652 @@
+// src/routing_table.cpp
+#include "routing_table.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <limits>
+#include <set>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+uint64_t routing_checksum(const void* data, size_t size, uint64_t seed) {
+    const uint8_t* p = static_cast<const uint8_t*>(data);
+    uint64_t h = seed;
+    for (size_t i = 0; i < size; ++i) {
+        h ^= p[i];
+        h *= 1099511628211ull;
+    }
+    return h;
+}
+
+namespace {
+
+// cell[] が「W 桁 x H 行で、行ごとに grid 上で連続」になっているか（Reversed なら行の中の物理桁が逆順）
+template <int W, int H, bool Reversed>
+bool has_shape(const RoutingModule& m, int total_width) {
+    if (m.digit_count != W * H) return false;
+    const int top_left = m.cell[Reversed ? W - 1 : 0];
+    for (int r = 0; r < H; ++r) {
+        for (int c = 0; c < W; ++c) {
+            const int physical = r * W + (Reversed ? W - 1 - c : c);
+            if (m.cell[physical] != top_left + r * total_width + c) return false;
+        }
+    }
+    return true;
+}
+
+uint8_t classify_shape(const RoutingModule& m, int total_width) {
+    if (has_shape<4, 4, false>(m, total_width)) return ROUTING_SHAPE_4X4;
+    if (has_shape<4, 4, true>(m, total_width)) return ROUTING_SHAPE_4X4_REVERSED;
+    if (has_shape<8, 2, false>(m, total_width)) return ROUTING_SHAPE_8X2;
+    if (has_shape<8, 2, true>(m, total_width)) return ROUTING_SHAPE_8X2_REVERSED;
+    return ROUTING_SHAPE_GENERIC;
+}
+
+std::string hex(int v) {
+    char buf[16];
+    snprintf(buf, sizeof(buf), "0x%02X", v);
+    return buf;
+}
+
+// addr = -1 はチャンネル全体
+std::string module_name(int bus, int tca, int channel, int addr) {
+    std::string s = "bus " + std::to_string(bus);
+    if (tca >= 0) s += " TCA " + hex(tca) + " CH" + std::to_string(channel);
+    return addr < 0 ? s : s + " module " + hex(addr);
+}
+
+// layout 節は double を int32 2語にそのまま入れる（IEEE 754 の 64bit でなければキャッシュの形式が成り立たない）
+static_assert(std::numeric_limits<double>::is_iec559 && sizeof(double) == 2 * sizeof(int32_t),
+              "routing cache stores doubles as two raw int32 words");
+
+// ファイルを書いたときの構造体の大きさ（パディングの違うコンパイラや ABI で作ったファイルを弾く）
+static uint32_t routing_abi() {
+    return static_cast<uint32_t>(sizeof(RoutingFileHeader) << 16 | sizeof(RoutingGroup) << 8 | sizeof(RoutingModule));
+}
+
+// --- layout 節 (int32 の並び) ---
+class LayoutWriter {
+public:
+    void put(int v) { words.push_back(static_cast<int32_t>(v)); }
+    void put_double(double v) {
+        int32_t w[2];
+        memcpy(w, &v, sizeof(w));
+        words.push_back(w[0]);
+        words.push_back(w[1]);
+    }
+    void put_string(const std::string& s) {
+        put(static_cast<int>(s.size()));
+        const size_t start = words.size();
+        words.resize(start + (s.size() + 3) / 4, 0);
+        if (!s.empty()) memcpy(words.data() + start, s.data(), s.size());
+    }
+    std::vector<int32_t> words;
+};
+
+class LayoutReader {
+public:
+    LayoutReader(const int32_t* words, size_t count) : words_(words), count_(count) {}
+    bool ok() const { return ok_; }
+    int get() {
+        if (pos_ >= count_) { ok_ = false; return 0; }
+        return words_[pos_++];
+    }
+    // 要素数の読み出し。残りの語数より多ければ壊れている
+    int get_count() {
+        int n = get();
+        if (n < 0 || static_cast<size_t>(n) > count_ - pos_) { ok_ = false; return 0; }
+        return n;
+    }
+    double get_double() {
+        if (pos_ + 2 > count_) { ok_ = false; return 0.0; }
+        double v;
+        memcpy(&v, words_ + pos_, sizeof(v));
+        pos_ += 2;
+        return v;
+    }
+    std::string get_string() {
+        int len = get();
+        size_t n_words = (static_cast<size_t>(len) + 3) / 4;
+        if (len < 0 || pos_ + n_words > count_) { ok_ = false; return {}; }
+        std::string s(reinterpret_cast<const char*>(words_ + pos_), static_cast<size_t>(len));
+        pos_ += n_words;
+        return s;
+    }
+
+private:
+    const int32_t* words_;
+    size_t count_;
+    size_t pos_ = 0;
+    bool ok_ = true;
+};
+
+void write_layout(const DisplayConfig& config, LayoutWriter& w) {
+    w.put_string(config.name);
+    w.put_string(config.type);
+    w.put(config.module_digits_width);
+    w.put(config.module_digits_height);
+    w.put(config.total_width);
+    w.put(config.total_height);
+    w.put_double(CHAR_WIDTH_MM);
+    w.put_double(CHAR_HEIGHT_MM);
+    w.put(static_cast<int>(config.buses.size()));
+    for (const auto& [bus_id, bus] : config.buses) {
+        w.put(bus_id);
+        w.put(static_cast<int>(bus.tca9548as.size()));
+        for (const auto& tca : bus.tca9548as) {
+            w.put(tca.address);
+            w.put(static_cast<int>(tca.channels.size()));
+            for (const auto& [channel, grid] : tca.channels) {
+                w.put(channel);
+                w.put(static_cast<int>(grid.size()));
+                for (const auto& row : grid) {
+                    w.put(static_cast<int>(row.size()));
+                    for (int addr : row) w.put(addr);
+                }
+            }
+            w.put(static_cast<int>(tca.origins.size()));
+            for (const auto& [channel, origin] : tca.origins) {
+                w.put(channel);
+                w.put(origin.first);
+                w.put(origin.second);
+            }
+        }
+    }
+    w.put(static_cast<int>(config.module_sizes_by_address.size()));
+    for (const auto& [addr, size] : config.module_sizes_by_address) {
+        w.put(addr);
+        w.put(size.first);
+        w.put(size.second);
+    }
+    w.put(static_cast<int>(config.module_column_reverse.size()));
+    for (const auto& [addr, rev] : config.module_column_reverse) {
+        w.put(addr);
+        w.put(rev ? 1 : 0);
+    }
+    w.put(static_cast<int>(config.module_index_map.size()));
+    for (const auto& [addr, map] : config.module_index_map) {
+        w.put(addr);
+        w.put(static_cast<int>(map.size()));
+        for (int v : map) w.put(v);
+    }
+}
+
+// --- 検証 ---
+void validate(const DisplayConfig& config, std::vector<std::string>& errors) {
+    auto err = [&errors](const std::string& s) { errors.push_back(s); };
+
+    if (config.total_width <= 0 || config.total_height <= 0) {
+        err("total_width / total_height must be positive (got " + std::to_string(config.total_width) +
+            "x" + std::to_string(config.total_height) + ")");
+    } else if (config.total_digits() >= ROUTING_NO_CELL) {
+        err("panel is too large (" + std::to_string(config.total_digits()) + " digits, max " +
+            std::to_string(ROUTING_NO_CELL - 1) + ")");
+    }
+    if (config.buses.empty()) return; // エミュレータ専用の構成
+
+    auto check_size = [&](const std::string& what, int w, int h) {
+        if (w <= 0 || h <= 0 || w * h > ROUTING_MAX_DIGITS) {
+            err(what + ": module size " + std::to_string(w) + "x" + std::to_string(h) +
+                " is invalid (HT16K33 drives at most " + std::to_string(ROUTING_MAX_DIGITS) + " digits)");
+            return false;
+        }
+        return true;
+    };
+    check_size("module_digits_width/height", config.module_digits_width, config.module_digits_height);
+    for (const auto& [addr, size] : config.module_sizes_by_address) {
+        check_size("module_sizes[" + hex(addr) + "]", size.first, size.second);
+    }
+    for (const auto& [addr, map] : config.module_index_map) {
+        auto [mw, mh] = config.module_size_for_address(addr);
+        const std::string what = "module_index_map[" + hex(addr) + "]";
+        if (static_cast<int>(map.size()) != mw * mh) {
+            err(what + " has " + std::to_string(map.size()) + " entries, module is " +
+                std::to_string(mw) + "x" + std::to_string(mh) + " = " + std::to_string(mw * mh) + " digits");
+            continue;
+        }
+        std::set<int> seen;
+        for (int v : map) {
+            if (v < 0 || v >= mw * mh) {
+                err(what + " contains " + std::to_string(v) + ", outside 0.." + std::to_string(mw * mh - 1));
+            } else if (!seen.insert(v).second) {
+                err(what + " maps two digits to physical digit " + std::to_string(v));
+            }
+        }
+    }
+
+    for (const auto& [bus_id, bus] : config.buses) {
+        std::set<int> tca_addrs;
+        for (const auto& tca : bus.tca9548as) {
+            if (tca.address >= 0) {
+                if (tca.address > 0x7F) err("bus " + std::to_string(bus_id) + ": TCA address " + hex(tca.address) + " is not a 7-bit address");
+                if (!tca_addrs.insert(tca.address).second) err("bus " + std::to_string(bus_id) + ": TCA " + hex(tca.address) + " is listed twice");
+            }
+        }
+        std::set<int> direct_addrs;
+        for (const auto& tca : bus.tca9548as) {
+            for (const auto& [channel, grid] : tca.channels) {
+                const std::string where = "bus " + std::to_string(bus_id) +
+                    (tca.address >= 0 ? " TCA " + hex(tca.address) + " CH" + std::to_string(channel) : " (direct)");
+                if (tca.address >= 0 && (channel < 0 || channel > 7)) {
+                    err(where + ": TCA9548A channel must be 0..7");
+                }
+                if (grid.empty() || grid[0].empty()) {
+                    err(where + ": empty module grid");
+                    continue;
+                }
+                std::set<int> channel_addrs;
+                for (const auto& row : grid) {
+                    if (row.size() != grid[0].size()) {
+                        err(where + ": module grid rows have different lengths (" + std::to_string(grid[0].size()) +
+                            " vs " + std::to_string(row.size()) + ")");
+                    }
+                    for (int addr : row) {
+                        if (addr < 0 || addr > 0x7F) {
+                            err(where + ": module address " + hex(addr) + " is not a 7-bit address");
+                        } else if (!channel_addrs.insert(addr).second) {
+                            err(where + ": module address " + hex(addr) + " is used twice on the same channel");
+                        } else if (tca_addrs.count(addr)) {
+                            err(where + ": module address " + hex(addr) + " collides with a TCA9548A on the same bus");
+                        } else if (tca.address < 0 && !direct_addrs.insert(addr).second) {
+                            err(where + ": module address " + hex(addr) + " is used twice on the bus");
+                        }
+                    }
+                }
+            }
+            for (const auto& [channel, origin] : tca.origins) {
+                if (!tca.channels.count(channel)) {
+                    err("bus " + std::to_string(bus_id) + ": origins refers to channel " +
+                        std::to_string(channel) + " which has no module grid");
+                }
+                if (origin.first < 0 || origin.second < 0) {
+                    err("bus " + std::to_string(bus_id) + ": origin of channel " + std::to_string(channel) +
+                        " must not be negative");
+                }
+            }
+        }
+    }
+}
+
+// --- 配置 ---
+// origins で位置を指定されたチャンネルはその位置へ置き、それ以外のチャンネルは
+// バスごとに左から右へ詰め、パネル幅に達したら下の段へ折り返す（従来の自動配置）。
+class Placer {
+public:
+    Placer(const DisplayConfig& config, std::vector<std::string>& errors)
+        : config_(config), errors_(errors), owner_(static_cast<size_t>(std::max(0, config.total_digits())), -1),
+          debug_(std::getenv("DEBUG_LED") != nullptr) {}
+
+    void run() {
+        int global_row_offset = 0;
+        int global_col_offset = 0;
+        for (const auto& [bus_id, bus_config] : config_.buses) {
+            // Bus ごとにオフセットをリセット
+            int bus_row_offset = 0;
+            int bus_col_offset = 0;
+            for (const auto& tca : bus_config.tca9548as) {
+                for (const auto& [channel, address_grid] : tca.channels) {
+                    auto origin = tca.origins.find(channel);
+                    if (origin != tca.origins.end()) {
+                        // 明示配置（パネル上の絶対座標）。自動配置の詰め位置は進めない
+                        place_grid(bus_id, tca.address, channel, address_grid, origin->second.first, origin->second.second);
+                        continue;
+                    }
+                    place_grid(bus_id, tca.address, channel, address_grid,
+                               global_row_offset + bus_row_offset, global_col_offset + bus_col_offset);
+
+                    auto [channel_width_in_digits, channel_height_in_digits] = grid_extent(address_grid);
+                    if ((bus_col_offset + channel_width_in_digits) < config_.total_width) {
+                        bus_col_offset += channel_width_in_digits;
+                    } else {
+                        bus_col_offset = 0;
+                        bus_row_offset += channel_height_in_digits;
+                    }
+                }
+            }
+            // Bus のオフセットをグローバルに反映
+            // （バス内で折り返していれば、次のバスはその下から始める）
+            if (bus_row_offset > 0) {
+                global_col_offset = 0;
+                global_row_offset += bus_row_offset;
+            } else if ((global_col_offset + bus_col_offset) < config_.total_width) {
+                global_col_offset += bus_col_offset;
+            } else {
+                global_col_offset = 0;
+                global_row_offset += bus_row_offset;
+            }
+        }
+    }
+
+    int uncovered() const {
+        int n = 0;
+        for (int o : owner_) n += (o < 0);
+        return n;
+    }
+
+    std::vector<RoutingGroup> groups;
+    std::vector<RoutingModule> modules;
+
+private:
+    // モジュール格子が占める幅 / 高さ（桁）。行ごとの幅の和・列ごとの高さの和の最大
+    std::pair<int, int> grid_extent(const std::vector<std::vector<int>>& grid) const {
+        int width = 0;
+        int height = 0;
+        for (const auto& row : grid) {
+            int w = 0;
+            for (int addr : row) w += config_.module_size_for_address(addr).first;
+            width = std::max(width, w);
+        }
+        for (size_t c = 0; c < grid[0].size(); ++c) {
+            int h = 0;
+            for (const auto& row : grid) h += config_.module_size_for_address(row[c]).second;
+            height = std::max(height, h);
+        }
+        return {width, height};
+    }
+
+    void place_grid(int bus_id, int tca_address, int channel, const std::vector<std::vector<int>>& grid,
+                    int origin_row, int origin_col) {
+        RoutingGroup g{};
+        g.bus = static_cast<int16_t>(bus_id);
+        g.tca_address = static_cast<int16_t>(tca_address);
+        g.channel = static_cast<int16_t>(channel);
+        g.first_module = static_cast<uint16_t>(modules.size());
+        if (debug_) {
+            fprintf(stderr, "DEBUG: %s -> origin row=%d col=%d\n",
+                    module_name(bus_id, tca_address, channel, -1).c_str(), origin_row, origin_col);
+        }
+        for (size_t grid_r = 0; grid_r < grid.size(); ++grid_r) {
+            for (size_t grid_c = 0; grid_c < grid[grid_r].size(); ++grid_c) {
+                // 同じ行の左側のモジュール幅の和 / 同じ列の上側のモジュール高さの和
+                int col_sum = 0;
+                for (size_t pc = 0; pc < grid_c; ++pc) col_sum += config_.module_size_for_address(grid[grid_r][pc]).first;
+                int row_sum = 0;
+                for (size_t pr = 0; pr < grid_r; ++pr) row_sum += config_.module_size_for_address(grid[pr][grid_c]).second;
+                place_module(bus_id, tca_address, channel, grid[grid_r][grid_c], origin_row + row_sum, origin_col + col_sum);
+            }
+        }
+        g.module_count = static_cast<uint16_t>(modules.size() - g.first_module);
+        groups.push_back(g);
+    }
+
+    void place_module(int bus_id, int tca_address, int channel, int addr, int start_row, int start_col) {
+        auto [mw, mh] = config_.module_size_for_address(addr);
+        const std::vector<int>* idx_map = config_.module_index_map_for_address(addr);
+        const bool reverse_cols = config_.module_columns_reversed(addr);
+        RoutingModule m{};
+        m.address = static_cast<uint8_t>(addr);
+        m.digit_count = static_cast<uint8_t>(mw * mh);
+        for (uint16_t& c : m.cell) c = ROUTING_NO_CELL;
+
+        const int module_id = static_cast<int>(modules.size());
+        for (int r_in_mod = 0; r_in_mod < mh; ++r_in_mod) {
+            for (int c_in_mod = 0; c_in_mod < mw; ++c_in_mod) {
+                const int row = start_row + r_in_mod;
+                const int col = start_col + c_in_mod;
+                const int logical_idx = r_in_mod * mw + c_in_mod;
+                int physical = idx_map ? (*idx_map)[logical_idx]
+                                       : r_in_mod * mw + (reverse_cols ? (mw - 1 - c_in_mod) : c_in_mod);
+                if (row < 0 || row >= config_.total_height || col < 0 || col >= config_.total_width) {
+                    errors_.push_back(module_name(bus_id, tca_address, channel, addr) + ": digit (" +
+                                      std::to_string(row) + "," + std::to_string(col) + ") is outside the " +
+                                      std::to_string(config_.total_width) + "x" + std::to_string(config_.total_height) + " panel");
+                    return;
+                }
+                const int index = row * config_.total_width + col;
+                if (owner_[index] >= 0) {
+                    const RoutingModule& other = modules[owner_[index]];
+                    errors_.push_back(module_name(bus_id, tca_address, channel, addr) + ": digit (" +
+                                      std::to_string(row) + "," + std::to_string(col) + ") is already driven by module " +
+                                      hex(other.address));
+                    return;
+                }
+                owner_[index] = module_id;
+                m.cell[physical] = static_cast<uint16_t>(index);
+            }
+        }
+        m.shape = classify_shape(m, config_.total_width);
+        modules.push_back(m);
+    }
+
+    const DisplayConfig& config_;
+    std::vector<std::string>& errors_;
+    std::vector<int> owner_; // grid セル → modules のインデックス
+    bool debug_;
+};
+
+// キャッシュから読んだ経路表が、compile() が作りうる形になっているか（validate() と同じ条件）
+// encode_panel_ram は cell[] と shape を信じて grid を読み、update_flexible_display はアドレスをそのまま I2C に出すので、
+// チェックサムが合っていても（ファイル自身が持っている値なので）中身は確かめる。問題があれば why に理由を入れて false
+bool structure_ok(const RoutingFileHeader& h, const RoutingGroup* groups, const RoutingModule* modules,
+                  std::string& why) {
+    const uint64_t cells = static_cast<uint64_t>(h.total_width) * h.total_height;
+    if (h.total_width == 0 || h.total_height == 0 || cells >= ROUTING_NO_CELL) {
+        why = "panel size " + std::to_string(h.total_width) + "x" + std::to_string(h.total_height);
+        return false;
+    }
+    if (h.group_count > UINT16_MAX || h.module_count > UINT16_MAX) {
+        why = "too many groups / modules";
+        return false;
+    }
+    // グループは modules を先頭から隙間なく分ける
+    uint32_t next = 0;
+    for (uint32_t gi = 0; gi < h.group_count; ++gi) {
+        const RoutingGroup& g = groups[gi];
+        if (g.first_module != next || g.module_count > h.module_count - next || g.tca_address < -1 ||
+            g.tca_address > 0x7F || (g.tca_address >= 0 && (g.channel < 0 || g.channel > 7))) {
+            why = "group " + std::to_string(gi);
+            return false;
+        }
+        next += g.module_count;
+    }
+    if (next != h.module_count) {
+        why = "groups cover " + std::to_string(next) + " of " + std::to_string(h.module_count) + " modules";
+        return false;
+    }
+    for (uint32_t mi = 0; mi < h.module_count; ++mi) {
+        const RoutingModule& m = modules[mi];
+        bool ok = m.address <= 0x7F && m.digit_count <= ROUTING_MAX_DIGITS && m.shape <= ROUTING_SHAPE_8X2_REVERSED;
+        for (int d = 0; ok && d < ROUTING_MAX_DIGITS; ++d) {
+            ok = m.cell[d] == ROUTING_NO_CELL || m.cell[d] < cells;
+        }
+        // 専用の変換は cell[0] などから行ごとに読むので、cell[] が本当にその並びか確かめる
+        ok = ok && (m.shape == ROUTING_SHAPE_GENERIC || classify_shape(m, static_cast<int>(h.total_width)) == m.shape);
+        if (!ok) {
+            why = "module " + std::to_string(mi);
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+RoutingTable::~RoutingTable() {
+    if (mapping_) munmap(mapping_, mapping_size_);
+}
+
+void RoutingTable::bind(const uint8_t* data) {
+    data_ = data;
+    const RoutingFileHeader* h = header();
+    layout_ = reinterpret_cast<const int32_t*>(data + sizeof(RoutingFileHeader));
+    groups_ = reinterpret_cast<const RoutingGroup*>(layout_ + h->layout_words);
+    modules_ = reinterpret_cast<const RoutingModule*>(groups_ + h->group_count);
+}
+
+std::shared_ptr<RoutingTable> RoutingTable::compile(const DisplayConfig& config, uint64_t source_checksum,
+                                                    std::vector<std::string>& errors,
+                                                    std::vector<std::string>& warnings) {
+    const size_t first_error = errors.size();
+    validate(config, errors);
+    if (errors.size() > first_error) return nullptr;
+
+    Placer placer(config, errors);
+    placer.run();
+    if (errors.size() > first_error) return nullptr;
+    if (!config.buses.empty()) {
+        if (int n = placer.uncovered()) {
+            warnings.push_back(std::to_string(n) + " of " + std::to_string(config.total_digits()) +
+                               " digits are not driven by any module");
+        }
+    }
+
+    LayoutWriter layout;
+    write_layout(config, layout);
+
+    RoutingFileHeader h{};
+    h.magic = ROUTING_MAGIC;
+    h.version = ROUTING_VERSION;
+    h.byte_order = ROUTING_BYTE_ORDER;
+    h.abi = routing_abi();
+    h.source_checksum = source_checksum;
+    h.total_width = static_cast<uint32_t>(config.total_width);
+    h.total_height = static_cast<uint32_t>(config.total_height);
+    h.layout_words = static_cast<uint32_t>(layout.words.size());
+    h.group_count = static_cast<uint32_t>(placer.groups.size());
+    h.module_count = static_cast<uint32_t>(placer.modules.size());
+
+    auto table = std::make_shared<RoutingTable>();
+    std::vector<uint8_t>& img = table->owned_;
+    const size_t layout_bytes = layout.words.size() * sizeof(int32_t);
+    const size_t group_bytes = placer.groups.size() * sizeof(RoutingGroup);
+    const size_t module_bytes = placer.modules.size() * sizeof(RoutingModule);
+    img.resize(sizeof(h) + layout_bytes + group_bytes + module_bytes);
+    uint8_t* p = img.data() + sizeof(h);
+    if (layout_bytes) memcpy(p, layout.words.data(), layout_bytes);
+    p += layout_bytes;
+    if (group_bytes) memcpy(p, placer.groups.data(), group_bytes);
+    p += group_bytes;
+    if (module_bytes) memcpy(p, placer.modules.data(), module_bytes);
+    h.payload_checksum = routing_checksum(img.data() + sizeof(h), img.size() - sizeof(h));
+    memcpy(img.data(), &h, sizeof(h));
+    table->bind(img.data());
+    return table;
+}
+
+std::shared_ptr<RoutingTable> RoutingTable::map_file(const std::string& path, uint64_t source_checksum) {
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return nullptr;
+    struct stat st {};
+    if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(RoutingFileHeader)) {
+        close(fd);
+        return nullptr;
+    }
+    // 自分以外が書き換えられるファイルは使わない（読んで確かめた後に中身を差し替えられる）
+    if (st.st_uid != geteuid() || (st.st_mode & (S_IWGRP | S_IWOTH))) {
+        fprintf(stderr, "[config] routing cache %s is not owned by this user or is writable by others, ignoring\n",
+                path.c_str());
+        close(fd);
+        return nullptr;
+    }
+    const size_t size = static_cast<size_t>(st.st_size);
+    void* map = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) return nullptr;
+
+    auto table = std::make_shared<RoutingTable>();
+    table->mapping_ = map;
+    table->mapping_size_ = size;
+    const auto* h = static_cast<const RoutingFileHeader*>(map);
+    if (h->magic == __builtin_bswap32(ROUTING_MAGIC) || (h->magic == ROUTING_MAGIC && h->byte_order != ROUTING_BYTE_ORDER)) {
+        fprintf(stderr, "[config] routing cache %s was written with a different byte order, rebuilding\n", path.c_str());
+        return nullptr;
+    }
+    if (h->magic != ROUTING_MAGIC || h->version != ROUTING_VERSION || h->abi != routing_abi()) return nullptr;
+    const size_t expected = sizeof(RoutingFileHeader) + static_cast<size_t>(h->layout_words) * sizeof(int32_t) +
+                            static_cast<size_t>(h->group_count) * sizeof(RoutingGroup) +
+                            static_cast<size_t>(h->module_count) * sizeof(RoutingModule);
+    if (h->source_checksum != source_checksum || expected != size) {
+        return nullptr;
+    }
+    const uint8_t* bytes = static_cast<const uint8_t*>(map);
+    if (routing_checksum(bytes + sizeof(RoutingFileHeader), size - sizeof(RoutingFileHeader)) != h->payload_checksum) {
+        fprintf(stderr, "[config] routing cache %s is corrupted, rebuilding\n", path.c_str());
+        return nullptr;
+    }
+    table->bind(bytes);
+    std::string why;
+    if (!structure_ok(*h, table->groups_, table->modules_, why)) {
+        fprintf(stderr, "[config] routing cache %s is invalid (%s), rebuilding\n", path.c_str(), why.c_str());
+        return nullptr;
+    }
+    return table;
+}
+
+bool RoutingTable::save(const std::string& path) const {
+    const RoutingFileHeader* h = header();
+    const size_t size = sizeof(RoutingFileHeader) + static_cast<size_t>(h->layout_words) * sizeof(int32_t) +
+                        group_count() * sizeof(RoutingGroup) + module_count() * sizeof(RoutingModule);
+    const std::string tmp = path + ".tmp." + std::to_string(getpid());
+    FILE* f = fopen(tmp.c_str(), "wb");
+    if (!f) return false;
+    const bool ok = fwrite(data_, 1, size, f) == size;
+    if (fclose(f) != 0 || !ok || rename(tmp.c_str(), path.c_str()) != 0) {
+        unlink(tmp.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool RoutingTable::restore_config(DisplayConfig& config) const {
+    LayoutReader r(layout_, header()->layout_words);
+    config = DisplayConfig{};
+    config.name = r.get_string();
+    config.type = r.get_string();
+    config.module_digits_width = r.get();
+    config.module_digits_height = r.get();
+    config.total_width = r.get();
+    config.total_height = r.get();
+    const double char_w = r.get_double();
+    const double char_h = r.get_double();
+    int n_bus = r.get_count();
+    for (int b = 0; b < n_bus && r.ok(); ++b) {
+        BusConfig& bus = config.buses[r.get()];
+        int n_tca = r.get_count();
+        for (int t = 0; t < n_tca && r.ok(); ++t) {
+            TCA9548AConfig tca;
+            tca.address = r.get();
+            int n_ch = r.get_count();
+            for (int c = 0; c < n_ch && r.ok(); ++c) {
+                auto& grid = tca.channels[r.get()];
+                grid.resize(r.get_count());
+                for (auto& row : grid) {
+                    row.resize(r.get_count());
+                    for (int& addr : row) addr = r.get();
+                }
+            }
+            int n_origins = r.get_count();
+            for (int i = 0; i < n_origins && r.ok(); ++i) {
+                int ch = r.get();
+                int row = r.get();
+                int col = r.get();
+                tca.origins[ch] = {row, col};
+            }
+            bus.tca9548as.push_back(std::move(tca));
+        }
+    }
+    int n_sizes = r.get_count();
+    for (int i = 0; i < n_sizes && r.ok(); ++i) {
+        int addr = r.get();
+        int w = r.get();
+        int h = r.get();
+        config.module_sizes_by_address[addr] = {w, h};
+    }
+    int n_rev = r.get_count();
+    for (int i = 0; i < n_rev && r.ok(); ++i) {
+        int addr = r.get();
+        config.module_column_reverse[addr] = r.get() != 0;
+    }
+    int n_maps = r.get_count();
+    for (int i = 0; i < n_maps && r.ok(); ++i) {
+        auto& map = config.module_index_map[r.get()];
+        map.resize(r.get_count());
+        for (int& v : map) v = r.get();
+    }
+    if (!r.ok()) return false;
+    CHAR_WIDTH_MM = char_w;
+    CHAR_HEIGHT_MM = char_h;
+    return true;
+}
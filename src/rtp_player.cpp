@@ -4,6 +4,10 @@
 #include "led.h"
 #include "video.h"
 #include "audio.h"
+#include "metrics.h"
+#include "trace.h"
+#include "live_config.h"
+#include "display_client.h"
 
 #include <gst/gst.h>
 #include <gst/app/gstappsink.h>
@@ -22,7 +26,11 @@ static std::atomic<int> video_frame_count{0};
 
 //------------- appsink callbacks -------------
 static GstFlowReturn on_new_sample_video(GstAppSink* sink, gpointer) {
+    trace::set_thread_name("appsink_video");
+    trace::Scope trace_scope("on_new_sample_video");
     GstSample* sample = gst_app_sink_pull_sample(sink);
+    // パイプラインが JPEG にしたフレームを受け取った時刻
+    const auto received_at = std::chrono::steady_clock::now();
     if (!sample) return GST_FLOW_OK;
 
     GstBuffer* buffer = gst_sample_get_buffer(sample);
@@ -39,6 +47,8 @@ static GstFlowReturn on_new_sample_video(GstAppSink* sink, gpointer) {
             {
                 std::lock_guard<std::mutex> lk(frame_mtx);
                 latest_frame = std::move(jpg);
+                ++latest_frame_seq;
+                latest_frame_received_at = received_at;
                 last_pts_ms = pts_ms;
             }
 
@@ -56,6 +66,8 @@ static GstFlowReturn on_new_sample_video(GstAppSink* sink, gpointer) {
 }
 
 static GstFlowReturn on_new_sample_audio(GstAppSink* sink, gpointer) {
+    trace::set_thread_name("appsink_audio");
+    trace::Scope trace_scope("on_new_sample_audio");
     GstSample* sample = gst_app_sink_pull_sample(sink);
     if (!sample) return GST_FLOW_OK;
 
@@ -278,15 +290,27 @@ int main(int argc, char* argv[]) {
         return 1;
     }
 
-    int i2c_fd = open_i2c_auto(active_config);
-    if (i2c_fd < 0) { perror("Failed to open I2C device"); return 1; }
-    if (!initialize_displays(i2c_fd, active_config)) {
-        std::cerr << "Failed to initialize display modules." << std::endl;
-        close(i2c_fd); return 1;
+    // SEG_DISPLAYD_PRIORITY が設定されていれば I2C は開かず、7seg-displayd にフレームを送る
+    int i2c_fd = -1;
+    if (!connect_displayd_output_from_env("rtp-player")) {
+        i2c_fd = open_i2c_auto(active_config);
+        if (i2c_fd < 0) { perror("Failed to open I2C device"); return 1; }
+        if (!initialize_displays(i2c_fd, active_config)) {
+            std::cerr << "Failed to initialize display modules." << std::endl;
+            close(i2c_fd); return 1;
+        }
     }
 
     setup_signal_handlers();
 
+    // config.json の保存 / SIGHUP で構成を再起動なしに差し替える（映像スレッドがフレームごとに拾う）
+    live_config().publish_initial(active_config, ScalingMode::FIT, 64, 255, config_name);
+    live_config().start_watcher();
+
+    // METRICS_PORT が設定されていれば /metrics を公開する
+    metrics::set_panel_info(config_name);
+    metrics::start_metrics_server_from_env();
+
     if (!audio_init(SAMPLE_RATE, CHANNELS)) {
         std::cerr << "Audio init failed" << std::endl;
     }
@@ -306,7 +330,8 @@ int main(int argc, char* argv[]) {
         if (apipe) gst_object_unref(apipe);
         stop_flag = true;
         if (vthr.joinable()) vthr.join();
-        close(i2c_fd); audio_cleanup();
+        if (i2c_fd >= 0) close(i2c_fd);
+        audio_cleanup();
         return 1;
     }
 
@@ -345,8 +370,9 @@ int main(int argc, char* argv[]) {
 
     if (vthr.joinable()) vthr.join();
 
-    close(i2c_fd);
+    if (i2c_fd >= 0) close(i2c_fd);
     audio_cleanup();
+    metrics::stop_metrics_server();
 
     std::cout << "\nプログラムを終了します。" << std::endl;
     return 0;
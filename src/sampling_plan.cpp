@@ -0,0 +1,97 @@
+// src/sampling_plan.cpp
+#include "sampling_plan.h"
+
+#include <algorithm>
+
+namespace {
+
+// 7セグ1文字内のピクセルサンプリング位置（5x5 の格子、bit0=a ... bit7=dp）
+constexpr int SEG_MAP[8][2] = {
+    {1, 0}, {3, 1}, {3, 3}, {1, 4}, {0, 3}, {0, 1}, {1, 2}, {4, 4},
+};
+
+} // namespace
+
+bool SamplingPlan::prepare(const DisplayConfig& config, int width, int height, int pixel_step, size_t stride) {
+    if (width == width_ && height == height_ && pixel_step == pixel_step_ && stride == stride_ &&
+        config.total_width == panel_width_ && config.total_height == panel_height_ &&
+        CHAR_WIDTH_MM == char_width_mm_ && CHAR_HEIGHT_MM == char_height_mm_ && !offsets_.empty()) {
+        return false;
+    }
+    width_ = width;
+    height_ = height;
+    pixel_step_ = pixel_step;
+    stride_ = stride;
+    panel_width_ = config.total_width;
+    panel_height_ = config.total_height;
+    char_width_mm_ = CHAR_WIDTH_MM;
+    char_height_mm_ = CHAR_HEIGHT_MM;
+    offsets_.assign(static_cast<size_t>(config.total_digits()) * 8, kNone);
+    if (width <= 0 || height <= 0 || panel_width_ <= 0 || panel_height_ <= 0) return true;
+
+    // ディスプレイの物理アスペクト比を元に、画像からサンプリングする領域(ROI)を計算
+    const double display_aspect_ratio = (panel_width_ * CHAR_WIDTH_MM) / (panel_height_ * CHAR_HEIGHT_MM);
+    const double frame_aspect_ratio = (double)width / (double)height;
+    int roi_x, roi_y, roi_w, roi_h;
+    if (frame_aspect_ratio > display_aspect_ratio) {
+        // 映像がディスプレイより「横長」の場合 -> 左右をクロップ
+        roi_w = std::min(width - 1, static_cast<int>(height * display_aspect_ratio));
+        roi_h = height - 1;
+        roi_x = (width - roi_w) / 2;
+        roi_y = 0;
+    } else {
+        // 映像がディスプレイより「縦長」の場合 -> 上下をクロップ
+        roi_w = width - 1;
+        roi_h = std::min(height - 1, static_cast<int>(width / display_aspect_ratio));
+        roi_x = 0;
+        roi_y = (height - roi_h) / 2;
+    }
+
+    // ROI 内での「1文字分」のセルの大きさ
+    const double cell_width_in_roi = (double)roi_w / panel_width_;
+    const double cell_height_in_roi = (double)roi_h / panel_height_;
+    for (int char_r = 0; char_r < panel_height_; ++char_r) {
+        for (int char_c = 0; char_c < panel_width_; ++char_c) {
+            const double base_x = roi_x + char_c * cell_width_in_roi;
+            const double base_y = roi_y + char_r * cell_height_in_roi;
+            uint32_t* out = &offsets_[(static_cast<size_t>(char_r) * panel_width_ + char_c) * 8];
+            for (int bit = 0; bit < 8; ++bit) {
+                // 抽象的な 5x5 の座標を、物理的な縦横比を持つセルの大きさに合わせてスケーリング
+                const int px = static_cast<int>(base_x) + static_cast<int>((SEG_MAP[bit][0] / 4.0) * cell_width_in_roi);
+                const int py = static_cast<int>(base_y) + static_cast<int>((SEG_MAP[bit][1] / 4.0) * cell_height_in_roi);
+                if (px >= 0 && px < width && py >= 0 && py < height) {
+                    out[bit] = static_cast<uint32_t>(static_cast<size_t>(py) * stride + static_cast<size_t>(px) * pixel_step);
+                }
+            }
+        }
+    }
+    return true;
+}
+
+void SamplingPlan::sample_grid(const uint8_t* pixels, std::vector<uint8_t>& grid, uint8_t threshold) const {
+    const size_t n = digits();
+    grid.assign(n, 0);
+    const uint32_t* offset = offsets_.data();
+    for (size_t d = 0; d < n; ++d, offset += 8) {
+        uint8_t seg = 0;
+        for (int bit = 0; bit < 8; ++bit) {
+            if (offset[bit] != kNone && pixels[offset[bit]] > threshold) seg |= static_cast<uint8_t>(1 << bit);
+        }
+        grid[d] = seg;
+    }
+}
+
+void SamplingPlan::sample_levels(const uint8_t* pixels, int min_threshold, int max_threshold,
+                                 std::vector<uint8_t>& levels) const {
+    // min_threshold 以下は消灯 (0)、max_threshold 以上は常時点灯 (15)、間は線形
+    const int lo = std::max(0, std::min(254, min_threshold));
+    const int span = std::max(1, std::min(255, max_threshold) - lo);
+    uint8_t level_of[256];
+    for (int v = 0; v < 256; ++v) {
+        level_of[v] = static_cast<uint8_t>(std::max(0, std::min(15, ((v - lo) * 15 + span / 2) / span)));
+    }
+    levels.assign(offsets_.size(), 0);
+    for (size_t i = 0; i < offsets_.size(); ++i) {
+        if (offsets_[i] != kNone) levels[i] = level_of[pixels[offsets_[i]]];
+    }
+}
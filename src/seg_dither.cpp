@@ -0,0 +1,41 @@
+// src/seg_dither.cpp
+#include "seg_dither.h"
+
+#include <algorithm>
+#include <cstdlib>
+
+void TemporalDither::set_levels(const std::vector<uint8_t>& levels) {
+    if (levels.size() != acc_.size()) {
+        acc_.resize(levels.size());
+        // 隣り合うセグメントで位相が大きく違うようにずらす（7 と 15 は互いに素なので 0-14 を一巡する）
+        for (size_t i = 0; i < acc_.size(); ++i) acc_[i] = static_cast<uint8_t>((i * 7) % kMaxLevel);
+    }
+    levels_ = levels;
+}
+
+void TemporalDither::next(std::vector<uint8_t>& grid) {
+    const size_t digits = levels_.size() / 8;
+    grid.assign(digits, 0);
+    const uint8_t* level = levels_.data();
+    uint8_t* acc = acc_.data();
+    for (size_t d = 0; d < digits; ++d) {
+        uint8_t seg = 0;
+        for (int b = 0; b < 8; ++b) {
+            uint8_t a = static_cast<uint8_t>(acc[b] + level[b]);
+            if (a >= kMaxLevel) {
+                a = static_cast<uint8_t>(a - kMaxLevel);
+                seg |= static_cast<uint8_t>(1 << b);
+            }
+            acc[b] = a;
+        }
+        grid[d] = seg;
+        level += 8;
+        acc += 8;
+    }
+}
+
+int gray_subframes_from_env() {
+    const char* v = std::getenv("SEG_GRAY_SUBFRAMES");
+    if (!v || !*v) return 0;
+    return std::max(0, std::min(TemporalDither::kMaxLevel, std::atoi(v)));
+}
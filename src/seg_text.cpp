@@ -0,0 +1,238 @@
+// src/seg_text.cpp
+#include "seg_text.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+
+namespace {
+
+// セグメントのビット（grid と同じ）
+constexpr uint8_t SA = 0x01, SB = 0x02, SC = 0x04, SD = 0x08, SE = 0x10, SF = 0x20, SG = 0x40, DP = 0x80;
+
+constexpr uint8_t DIGITS[10] = {0x3F, 0x06, 0x5B, 0x4F, 0x66, 0x6D, 0x7D, 0x07, 0x7F, 0x6F};
+
+// 英字は大文字・小文字それぞれ読みやすい形を選ぶ（7セグで作れない形は近いものを使う）
+constexpr uint8_t UPPER[26] = {
+    0x77, 0x7C, 0x39, 0x5E, 0x79, 0x71, 0x3D, 0x76, 0x30, 0x1E, 0x75, 0x38, 0x37, // A-M
+    0x54, 0x3F, 0x73, 0x67, 0x50, 0x6D, 0x78, 0x3E, 0x3E, 0x2A, 0x76, 0x6E, 0x5B, // N-Z
+};
+constexpr uint8_t LOWER[26] = {
+    0x5F, 0x7C, 0x58, 0x5E, 0x7B, 0x71, 0x6F, 0x74, 0x04, 0x0E, 0x75, 0x30, 0x54, // a-m
+    0x54, 0x5C, 0x73, 0x67, 0x50, 0x6D, 0x78, 0x1C, 0x1C, 0x2A, 0x76, 0x6E, 0x5B, // n-z
+};
+
+uint8_t ascii_glyph(char32_t ch) {
+    if (ch >= '0' && ch <= '9') return DIGITS[ch - '0'];
+    if (ch >= 'A' && ch <= 'Z') return UPPER[ch - 'A'];
+    if (ch >= 'a' && ch <= 'z') return LOWER[ch - 'a'];
+    switch (ch) {
+        case '-': return SG;
+        case '_': return SD;
+        case '=': return SG | SD;
+        case '"': return SB | SF;
+        case '\'': return SB;
+        case '`': return SF;
+        case '[': case '(': case '{': case '<': return SA | SD | SE | SF;
+        case ']': case ')': case '}': case '>': return SA | SB | SC | SD;
+        case '?': return SA | SB | SE | SG;
+        case '!': return SB | SC | DP;
+        case '/': return SB | SE | SG;
+        case '\\': return SC | SF | SG;
+        case '|': return SB | SC;
+        case '^': return SA | SB | SF;
+        case '~': return SA;
+        case '*': case '#': case '@': return 0x7F; // tetris.py / screensaver.py と同じく全点灯
+        case '+': return SE | SF | SG;
+        case '%': return SB | SE | SG;
+        default: return 0;
+    }
+}
+
+// カタカナ等は形の近いものだけ（読めない文字は空白になる）
+uint8_t kana_glyph(char32_t ch) {
+    switch (ch) {
+        case U'ー': case U'ｰ': case U'－': return SG;
+        case U'ロ': case U'口': return SA | SB | SC | SD | SE | SF;
+        case U'コ': return SA | SB | SC | SD;
+        case U'ユ': return SB | SC | SD;
+        case U'エ': case U'ヨ': return SA | SD | SG;
+        case U'ニ': return SA | SD;
+        case U'ヒ': return SD | SE | SF | SG;
+        case U'ト': return SE | SF | SG;
+        case U'ハ': return SC | SE;
+        case U'ル': return SC | SD | SE | SF;
+        case U'レ': return SD | SE | SF;
+        case U'「': return SA | SE | SF;
+        case U'」': return SB | SC | SD;
+        case U'°': case U'℃': return SA | SB | SF | SG;
+        default: return 0;
+    }
+}
+
+// 全角英数字・全角空白は半角と同じに扱う
+char32_t normalize(char32_t ch) {
+    if (ch >= 0xFF01 && ch <= 0xFF5E) return ch - 0xFEE0;
+    if (ch == 0x3000) return ' ';
+    return ch;
+}
+
+// 直前の桁の dp にまとめる文字
+bool is_dp_char(char32_t ch) {
+    return ch == '.' || ch == ',' || ch == ':' || ch == U'。' || ch == U'、' || ch == U'・' || ch == U'｡' ||
+           ch == U'､' || ch == U'･';
+}
+
+// UTF-8 を1文字ずつ取り出す（壊れたバイトは U+FFFD）
+char32_t next_codepoint(const std::string& s, size_t& i) {
+    const auto b0 = static_cast<unsigned char>(s[i++]);
+    if (b0 < 0x80) return b0;
+    int extra = (b0 >= 0xF0) ? 3 : (b0 >= 0xE0) ? 2 : (b0 >= 0xC0) ? 1 : -1;
+    if (extra < 0) return 0xFFFD;
+    char32_t cp = b0 & (0x3F >> extra);
+    for (int k = 0; k < extra; ++k) {
+        if (i >= s.size() || (static_cast<unsigned char>(s[i]) & 0xC0) != 0x80) return 0xFFFD;
+        cp = (cp << 6) | (static_cast<unsigned char>(s[i++]) & 0x3F);
+    }
+    return cp;
+}
+
+// 半桁ずらすための変換表
+//   out: 右半分の縦線 (b, c) を左半分 (f, e) へ（左の桁から半分はみ出してくる部分）
+//   in : 左半分の縦線 (f, e) を右半分 (b, c) へ、横線はそのまま（右の桁から半分入ってくる部分）
+// 横線は入ってくる文字の側に付け、dp は落とす
+struct ShiftTables {
+    std::array<uint8_t, 256> out{};
+    std::array<uint8_t, 256> in{};
+    ShiftTables() {
+        for (int v = 0; v < 256; ++v) {
+            uint8_t o = 0, n = 0;
+            if (v & SB) o |= SF;
+            if (v & SC) o |= SE;
+            if (v & SF) n |= SB;
+            if (v & SE) n |= SC;
+            n |= static_cast<uint8_t>(v & (SA | SG | SD));
+            out[v] = o;
+            in[v] = n;
+        }
+    }
+};
+
+const ShiftTables& shift_tables() {
+    static const ShiftTables t;
+    return t;
+}
+
+int64_t floor_mod(int64_t a, int64_t b) {
+    int64_t r = a % b;
+    return (r < 0) ? r + b : r;
+}
+
+} // namespace
+
+uint8_t seg_glyph(char32_t ch) {
+    ch = normalize(ch);
+    if (ch < 0x80) return ascii_glyph(ch);
+    return kana_glyph(ch);
+}
+
+std::vector<uint8_t> seg_encode(const std::string& utf8) {
+    std::vector<uint8_t> cells;
+    cells.reserve(utf8.size());
+    // 直前の桁が文字（空白でも dp 付きでもない）なら dp を足せる
+    bool can_merge = false;
+    for (size_t i = 0; i < utf8.size();) {
+        const char32_t ch = normalize(next_codepoint(utf8, i));
+        if (is_dp_char(ch)) {
+            if (can_merge) {
+                cells.back() |= DP;
+            } else {
+                cells.push_back(DP);
+            }
+            can_merge = false;
+            continue;
+        }
+        const uint8_t g = seg_glyph(ch);
+        cells.push_back(g);
+        can_merge = (g != 0 && !(g & DP));
+    }
+    return cells;
+}
+
+void seg_draw(std::vector<uint8_t>& grid, int panel_width, int panel_height, int x, int y, int width,
+              const std::vector<uint8_t>& cells, SegAlign align) {
+    if (y < 0 || y >= panel_height || width <= 0) return;
+    const size_t need = static_cast<size_t>(panel_width) * panel_height;
+    if (grid.size() < need) grid.resize(need, 0);
+    const int n = static_cast<int>(cells.size());
+    const int off = (align == SegAlign::LEFT) ? 0 : (align == SegAlign::RIGHT) ? width - n : (width - n) / 2;
+    uint8_t* row = grid.data() + static_cast<size_t>(y) * panel_width;
+    for (int i = 0; i < width; ++i) {
+        const int px = x + i;
+        if (px < 0 || px >= panel_width) continue;
+        const int j = i - off;
+        row[px] = (j >= 0 && j < n) ? cells[j] : 0;
+    }
+}
+
+void seg_draw_text(std::vector<uint8_t>& grid, const DisplayConfig& cfg, int row, const std::string& utf8,
+                   SegAlign align) {
+    seg_draw(grid, cfg.total_width, cfg.total_height, 0, row, cfg.total_width, seg_encode(utf8), align);
+}
+
+SegTicker::SegTicker(const std::string& utf8, double digits_per_second, int gap)
+    : cells_(seg_encode(utf8)), steps_per_second_(digits_per_second * 2.0), gap_(gap) {
+    shift_tables(); // 表を先に作っておく（最初のフレームで作らない）
+}
+
+int64_t SegTicker::step_at(uint64_t elapsed_ns) const {
+    return static_cast<int64_t>(std::floor(static_cast<double>(elapsed_ns) * 1e-9 * steps_per_second_));
+}
+
+int64_t SegTicker::period_steps(int width) const {
+    const int gap = (gap_ < 0) ? width : gap_;
+    return 2 * (static_cast<int64_t>(cells_.size()) + gap);
+}
+
+void SegTicker::render(int64_t step, uint8_t* out, int width) const {
+    if (cells_.empty() || width <= 0) {
+        for (int i = 0; i < width; ++i) out[i] = 0;
+        return;
+    }
+    // 流す列は先頭に gap 桁の空白を置いた文字列（空白から始めるので、文字は右端から入ってくる）
+    const int64_t gap = (gap_ < 0) ? width : gap_;
+    const int64_t len = static_cast<int64_t>(cells_.size()) + gap;
+    const int64_t s = floor_mod(step, 2 * len);
+    int64_t j = s / 2;
+    auto next = [&]() -> uint8_t {
+        const uint8_t v = (j < gap) ? 0 : cells_[static_cast<size_t>(j - gap)];
+        if (++j == len) j = 0;
+        return v;
+    };
+    if ((s & 1) == 0) {
+        for (int i = 0; i < width; ++i) out[i] = next();
+        return;
+    }
+    const ShiftTables& t = shift_tables();
+    uint8_t left = next();
+    for (int i = 0; i < width; ++i) {
+        const uint8_t right = next();
+        out[i] = static_cast<uint8_t>(t.out[left] | t.in[right]);
+        left = right;
+    }
+}
+
+void SegTicker::render_at(uint64_t elapsed_ns, std::vector<uint8_t>& grid, int panel_width, int panel_height, int x,
+                          int y, int width) const {
+    if (y < 0 || y >= panel_height || width <= 0) return;
+    const size_t need = static_cast<size_t>(panel_width) * panel_height;
+    if (grid.size() < need) grid.resize(need, 0);
+    if (x >= 0 && x + width <= panel_width) {
+        render(step_at(elapsed_ns), grid.data() + static_cast<size_t>(y) * panel_width + x, width);
+        return;
+    }
+    // パネルからはみ出す窓は一度別に描いてから切り取る
+    std::vector<uint8_t> row(static_cast<size_t>(width));
+    render(step_at(elapsed_ns), row.data(), width);
+    seg_draw(grid, panel_width, panel_height, x, y, width, row);
+}
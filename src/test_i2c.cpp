@@ -1,34 +1,333 @@
 // src/test_i2c.cpp
+// 7seg-test-i2c: 配線の確認と I2C バスの計測
+//   ./7seg-test-i2c 24x4                 全点灯 → 消灯（配線の確認）
+//   ./7seg-test-i2c 24x4 --bench         実機でモジュールの書き込み時間・チャンネルの切り替え時間・
+//                                        持続できる全面 / 差分フレームの fps・連続書き込み中のエラー率を測る
+//   ./7seg-test-i2c --model              実機なしで config.json の全レイアウトの fps を 100kHz / 400kHz / 1MHz で見積もる
+// バスは設定の bus 番号の /dev/i2c-N を開く（開けなければ /dev/i2c-0, -1）。
 #include "common.h"
 #include "config_loader.hpp"
 #include "led.h"
+#include "i2c_transport.h"
+#include "metrics.h"
+#include "routing_table.h"
 #include <fcntl.h>
 #include <unistd.h>
+#include <algorithm>
+#include <cstdio>
 #include <iostream>
+#include <random>
 #include <vector>
 #include <string>
 #include <chrono>
+#include <cstdlib>
 #include <thread>
 
-static int try_open_i2c_auto() {
-    const char* candidates[] = {"/dev/i2c-0", "/dev/i2c-1"};
-    for (auto dev : candidates) {
-        int fd = open(dev, O_RDWR);
-        if (fd >= 0) {
-            std::cout << "Opened I2C device: " << dev << std::endl;
-            return fd;
+namespace {
+
+using test_clock = std::chrono::steady_clock;
+
+struct TestOptions {
+    std::string config = "24x4";
+    bool config_given = false;
+    bool bench = false;
+    bool model = false;
+    double seconds = 5.0;               // 持続 fps の計測時間
+    int iterations = 200;               // モジュール / チャンネル切り替えごとの計測回数
+    unsigned int bus_hz = 400000;       // 実機の SCL 周波数（バス以外の時間の見積もりに使う）
+    double overhead_us = 0.0;           // --model: 1トランザクションごとのバス以外の時間
+};
+
+void print_usage(const char* prog) {
+    std::cerr << "Usage: " << prog << " [config] [options]\n"
+              << "  (no option)          write ALL-ON then ALL-OFF to check the wiring\n"
+              << "  --bench              measure the bus on hardware (module writes, channel switches, fps, errors)\n"
+              << "  --seconds N          duration of each sustained-rate run (default 5)\n"
+              << "  --iterations N       samples per module / channel pair (default 200)\n"
+              << "  --bus-hz HZ          SCL frequency of the bus, used to split wire time from overhead (default 400000)\n"
+              << "  --model              predict fps without hardware at 100 kHz / 400 kHz / 1 MHz\n"
+              << "                       (all layouts in config.json unless a config is given)\n"
+              << "  --overhead-us N      per-transaction software overhead for --model (see --bench output)\n";
+}
+
+double percentile(std::vector<double> v, double q) {
+    if (v.empty()) return 0;
+    const size_t k = std::min(v.size() - 1, static_cast<size_t>(q * static_cast<double>(v.size())));
+    std::nth_element(v.begin(), v.begin() + static_cast<std::ptrdiff_t>(k), v.end());
+    return v[k];
+}
+
+double elapsed_us(test_clock::time_point t0) {
+    return std::chrono::duration<double, std::micro>(test_clock::now() - t0).count();
+}
+
+// 17バイト（アドレス + RAM 16バイト）の書き込みがバスを占める時間
+double wire_us(unsigned int bus_hz, size_t len) {
+    return (9.0 * static_cast<double>(len + 1) + 2) * 1e6 / bus_hz;
+}
+
+std::vector<uint8_t> random_grid(size_t n, uint32_t seed) {
+    std::mt19937 rng(seed);
+    std::vector<uint8_t> g(n);
+    for (auto& v : g) v = static_cast<uint8_t>(rng());
+    return g;
+}
+
+// 経路表の全モジュールと TCA の切り替えで数えたエラーの合計（metrics の module_write_errors）
+uint64_t error_total(const RoutingTable& routing) {
+    uint64_t total = 0;
+    for (size_t gi = 0; gi < routing.group_count(); ++gi) {
+        const RoutingGroup& group = routing.group(gi);
+        if (group.tca_address >= 0) total += metrics::module_write_errors(group.bus, group.tca_address, group.channel, -1).value();
+        for (size_t mi = group.first_module; mi < group.first_module + group.module_count; ++mi) {
+            total += metrics::module_write_errors(group.bus, group.tca_address, group.channel, routing.module(mi).address).value();
+        }
+    }
+    return total;
+}
+
+// 従来の配線確認: 全点灯 → 消灯
+int run_check(int i2c_fd, const DisplayConfig& dc) {
+    std::cout << "Writing ALL-ON pattern..." << std::endl;
+    std::vector<uint8_t> grid_on(dc.total_digits(), 0xFF);
+    I2CErrorInfo err;
+    if (!update_flexible_display(i2c_fd, dc, grid_on, err)) {
+        std::cerr << "ERROR: update_flexible_display (ALL-ON) failed at ch=" << err.channel
+                  << " addr=0x" << std::hex << err.address << std::dec << std::endl;
+        return 3;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(800));
+
+    std::cout << "Clearing (ALL-OFF)..." << std::endl;
+    std::vector<uint8_t> grid_off(dc.total_digits(), 0x00);
+    if (!update_flexible_display(i2c_fd, dc, grid_off, err)) {
+        std::cerr << "ERROR: update_flexible_display (ALL-OFF) failed at ch=" << err.channel
+                  << " addr=0x" << std::hex << err.address << std::dec << std::endl;
+        return 4;
+    }
+    std::cout << "Done." << std::endl;
+    return 0;
+}
+
+// モジュールごとの書き込み時間（チャンネルを選んだ後の 17 バイトの書き込みだけ）
+void bench_module_writes(int i2c_fd, const RoutingTable& routing, const TestOptions& opt) {
+    std::cout << "\n[bench] module write latency (" << opt.iterations << " writes each)\n";
+    std::printf("  %-6s %-4s %-6s %9s %9s %9s %9s %7s\n", "tca", "ch", "addr", "p50_us", "p95_us", "p99_us", "max_us", "errors");
+    std::vector<double> all;
+    uint8_t on[ROUTING_MAX_DIGITS], off[ROUTING_MAX_DIGITS] = {};
+    std::fill(std::begin(on), std::end(on), 0xFF);
+    for (size_t gi = 0; gi < routing.group_count(); ++gi) {
+        const RoutingGroup& group = routing.group(gi);
+        I2CErrorInfo err;
+        if (!select_i2c_channel(i2c_fd, group.tca_address, group.channel, err)) {
+            std::printf("  0x%02X   %-4d (channel select failed)\n", group.tca_address, group.channel);
+            continue;
+        }
+        for (size_t mi = group.first_module; mi < group.first_module + group.module_count; ++mi) {
+            const RoutingModule& m = routing.module(mi);
+            std::vector<double> samples;
+            samples.reserve(static_cast<size_t>(opt.iterations));
+            int errors = 0;
+            for (int i = 0; i < opt.iterations; ++i) {
+                const auto t0 = test_clock::now();
+                if (!update_module_from_digits(i2c_fd, m.address, (i & 1) ? on : off, m.digit_count, err)) {
+                    ++errors;
+                    continue;
+                }
+                samples.push_back(elapsed_us(t0));
+            }
+            all.insert(all.end(), samples.begin(), samples.end());
+            char tca[8] = "-";
+            if (group.tca_address >= 0) std::snprintf(tca, sizeof(tca), "0x%02X", group.tca_address);
+            std::printf("  %-6s %-4d 0x%02X   %9.1f %9.1f %9.1f %9.1f %7d\n", tca, group.channel, m.address,
+                        percentile(samples, 0.5), percentile(samples, 0.95), percentile(samples, 0.99),
+                        samples.empty() ? 0.0 : *std::max_element(samples.begin(), samples.end()), errors);
+        }
+    }
+    if (all.empty()) return;
+    const double wire = wire_us(opt.bus_hz, 17);
+    const double p50 = percentile(all, 0.5);
+    std::printf("  all modules: p50 %.1f us, p99 %.1f us; wire time at %u Hz %.1f us -> overhead ~%.0f us per transaction\n",
+                p50, percentile(all, 0.99), opt.bus_hz, wire, std::max(0.0, p50 - wire));
+    std::printf("  (use --model --overhead-us %.0f to predict other layouts on this host)\n", std::max(0.0, p50 - wire));
+}
+
+// TCA9548A のチャンネル切り替え1回の時間（2つのマスクを交互に書く。チャンネルが1つなら全無効と交互）
+void bench_channel_switch(int i2c_fd, const DisplayConfig& dc, const TestOptions& opt) {
+    bool any = false;
+    for (const auto& [bus_id, bus] : dc.buses) {
+        (void)bus_id;
+        for (const auto& tca : bus.tca9548as) {
+            if (tca.address < 0 || tca.channels.empty()) continue;
+            if (!any) {
+                std::cout << "\n[bench] channel switch latency (" << opt.iterations << " switches each)\n";
+                std::printf("  %-6s %-9s %9s %9s %9s %7s\n", "tca", "channels", "p50_us", "p99_us", "max_us", "errors");
+                any = true;
+            }
+            const int first = tca.channels.begin()->first;
+            const int second = (tca.channels.size() > 1) ? std::next(tca.channels.begin())->first : -1;
+            const uint8_t masks[2] = {static_cast<uint8_t>(1 << first),
+                                      static_cast<uint8_t>(second >= 0 ? (1 << second) : 0)};
+            std::vector<double> samples;
+            int errors = 0;
+            for (int i = 0; i < opt.iterations; ++i) {
+                I2CErrorInfo err;
+                const auto t0 = test_clock::now();
+                if (!select_i2c_channels(i2c_fd, tca.address, masks[i & 1], err)) {
+                    ++errors;
+                    continue;
+                }
+                samples.push_back(elapsed_us(t0));
+            }
+            char pair[16];
+            if (second >= 0) {
+                std::snprintf(pair, sizeof(pair), "%d<->%d", first, second);
+            } else {
+                std::snprintf(pair, sizeof(pair), "%d<->off", first);
+            }
+            std::printf("  0x%02X   %-9s %9.1f %9.1f %9.1f %7d\n", tca.address, pair, percentile(samples, 0.5),
+                        percentile(samples, 0.99), samples.empty() ? 0.0 : *std::max_element(samples.begin(), samples.end()),
+                        errors);
+        }
+    }
+    reset_i2c_channel_cache();
+}
+
+// 持続できるフレームレート: full は毎フレーム全モジュールが変わる、diff は毎フレーム1桁だけ変わる
+void bench_sustained(int i2c_fd, const DisplayConfig& dc, const TestOptions& opt, bool full) {
+    const RoutingTable& routing = *dc.routing;
+    std::vector<uint8_t> grid = random_grid(static_cast<size_t>(dc.total_digits()), 1);
+    I2CErrorInfo err;
+    update_flexible_display(i2c_fd, dc, grid, err); // 変化のないモジュールの記録をこの grid に揃える
+
+    const uint64_t errors_before = error_total(routing);
+    std::vector<double> frame_us;
+    uint64_t frames = 0, failures = 0, modules = 0;
+    size_t cursor = 0;
+    const auto start = test_clock::now();
+    while (std::chrono::duration<double>(test_clock::now() - start).count() < opt.seconds) {
+        if (full) {
+            for (auto& v : grid) v = static_cast<uint8_t>(~v);
         } else {
-            perror(dev);
+            grid[cursor] ^= 0xFF;
+            cursor = (cursor + 1) % grid.size();
         }
+        I2CErrorInfo frame_err;
+        const auto t0 = test_clock::now();
+        if (!update_flexible_display(i2c_fd, dc, grid, frame_err)) ++failures;
+        frame_us.push_back(elapsed_us(t0));
+        modules += static_cast<uint64_t>(last_update_stats().modules_written);
+        ++frames;
     }
-    return -1;
+    const double seconds = std::chrono::duration<double>(test_clock::now() - start).count();
+    const uint64_t errors = error_total(routing) - errors_before;
+    std::printf("  %-5s %8.1f fps  frame p50 %8.1f us  p99 %8.1f us  %6.1f modules/frame  "
+                "errors %llu (%.4f%% of writes)  failed frames %llu\n",
+                full ? "full" : "diff", static_cast<double>(frames) / seconds, percentile(frame_us, 0.5),
+                percentile(frame_us, 0.99), frames ? static_cast<double>(modules) / static_cast<double>(frames) : 0.0,
+                static_cast<unsigned long long>(errors),
+                (modules + errors) ? 100.0 * static_cast<double>(errors) / static_cast<double>(modules + errors) : 0.0,
+                static_cast<unsigned long long>(failures));
+}
+
+int run_bench(int i2c_fd, const DisplayConfig& dc, const TestOptions& opt) {
+    if (!dc.routing || dc.routing->module_count() == 0) {
+        std::cerr << "ERROR: " << dc.name << " has no modules to measure." << std::endl;
+        return 1;
+    }
+    bench_module_writes(i2c_fd, *dc.routing, opt);
+    bench_channel_switch(i2c_fd, dc, opt);
+    std::cout << "\n[bench] sustained rate (" << opt.seconds << " s each)\n";
+    bench_sustained(i2c_fd, dc, opt, true);
+    bench_sustained(i2c_fd, dc, opt, false);
+    std::vector<uint8_t> blank(dc.total_digits(), 0x00);
+    I2CErrorInfo err;
+    update_flexible_display(i2c_fd, dc, blank, err);
+    return 0;
+}
+
+// 実機なしの見積もり: FakeI2CTransport で update_flexible_display を通し、バス時間から fps を出す
+// 全面は全モジュールが変わるフレーム、diff は1桁だけ変わるフレーム（チャンネル切り替え・settle 待ちを含む）
+int run_model(const TestOptions& opt) {
+    std::vector<std::string> names;
+    try {
+        names = opt.config_given ? std::vector<std::string>{opt.config} : list_config_names();
+    } catch (const std::exception& e) {
+        std::cerr << "Failed to load config: " << e.what() << std::endl;
+        return 1;
+    }
+    std::printf("timing model: 17-byte RAM write per module, %.0f us overhead per transaction\n", opt.overhead_us);
+    std::printf("%-20s %7s %8s | %8s %9s %8s | %8s %9s %8s\n", "layout", "modules", "bus", "full_tx", "full_ms",
+                "full_fps", "diff_tx", "diff_ms", "diff_fps");
+    const unsigned int speeds[] = {100000, 400000, 1000000};
+    for (const auto& name : names) {
+        DisplayConfig dc;
+        try {
+            dc = load_config_from_json(name);
+        } catch (const std::exception& e) {
+            std::cerr << "skip " << name << ": " << e.what() << std::endl;
+            continue;
+        }
+        if (!dc.routing || dc.routing->module_count() == 0) continue;
+        for (unsigned int hz : speeds) {
+            FakeI2CTransport fake(hz);
+            fake.set_transaction_overhead_ns(static_cast<uint64_t>(opt.overhead_us * 1000));
+            set_i2c_transport(&fake);
+            reset_i2c_channel_cache();
+            std::vector<uint8_t> grid = random_grid(static_cast<size_t>(dc.total_digits()), 1);
+            I2CErrorInfo err;
+            update_flexible_display(-1, dc, grid, err);
+
+            for (auto& v : grid) v = static_cast<uint8_t>(~v);
+            fake.reset();
+            update_flexible_display(-1, dc, grid, err);
+            const uint64_t full_tx = fake.transactions();
+            const double full_ms = static_cast<double>(fake.simulated_ns()) / 1e6;
+
+            grid[grid.size() / 2] ^= 0xFF;
+            fake.reset();
+            update_flexible_display(-1, dc, grid, err);
+            const uint64_t diff_tx = fake.transactions();
+            const double diff_ms = static_cast<double>(fake.simulated_ns()) / 1e6;
+
+            char bus[16];
+            std::snprintf(bus, sizeof(bus), hz >= 1000000 ? "%uMHz" : "%ukHz", hz >= 1000000 ? hz / 1000000 : hz / 1000);
+            std::printf("%-20s %7zu %8s | %8llu %9.2f %8.1f | %8llu %9.2f %8.1f\n", name.c_str(),
+                        dc.routing->module_count(), bus, static_cast<unsigned long long>(full_tx), full_ms,
+                        full_ms > 0 ? 1000.0 / full_ms : 0.0, static_cast<unsigned long long>(diff_tx), diff_ms,
+                        diff_ms > 0 ? 1000.0 / diff_ms : 0.0);
+        }
+        set_i2c_transport(nullptr);
+    }
+    reset_i2c_channel_cache();
+    return 0;
 }
 
+} // namespace
+
 int main(int argc, char* argv[]) {
-    std::string cfg = (argc > 1) ? argv[1] : "24x4";
+    TestOptions opt;
+    for (int i = 1; i < argc; ++i) {
+        const std::string a = argv[i];
+        const bool has_value = (i + 1 < argc);
+        if (a == "--bench") opt.bench = true;
+        else if (a == "--model") opt.model = true;
+        else if (a == "--seconds" && has_value) opt.seconds = std::max(0.1, std::atof(argv[++i]));
+        else if (a == "--iterations" && has_value) opt.iterations = std::max(1, std::atoi(argv[++i]));
+        else if (a == "--bus-hz" && has_value) opt.bus_hz = static_cast<unsigned int>(std::max(1000, std::atoi(argv[++i])));
+        else if (a == "--overhead-us" && has_value) opt.overhead_us = std::max(0.0, std::atof(argv[++i]));
+        else if (a == "-h" || a == "--help") { print_usage(argv[0]); return 0; }
+        else if (!a.empty() && a[0] == '-') { print_usage(argv[0]); return 2; }
+        else { opt.config = a; opt.config_given = true; }
+    }
+    if (opt.model) return run_model(opt);
+
+    // 配線の確認なので、モジュールごとに応答を見る（複数チャンネルへの同時書き込みは、1つでも応答すると成功に見える）
+    // 計測では実際の運用と同じく同時書き込みを使う
+    if (!opt.bench) setenv("SEG_I2C_BROADCAST", "0", 0);
     DisplayConfig dc;
     try {
-        dc = load_config_from_json(cfg);
+        dc = load_config_from_json(opt.config);
         std::cout << "Config: " << dc.name << " (TCA addresses: ";
         for (const auto& [bus_id, bus_config] : dc.buses) {
             for (const auto& tca : bus_config.tca9548as) {
@@ -48,9 +347,10 @@ int main(int argc, char* argv[]) {
         return 1;
     }
 
-    int i2c_fd = try_open_i2c_auto();
+    // 設定の bus 番号のデバイスを開く
+    int i2c_fd = open_i2c_auto(dc);
     if (i2c_fd < 0) {
-        std::cerr << "ERROR: Failed to open any I2C device (/dev/i2c-0 or /dev/i2c-1)." << std::endl;
+        std::cerr << "ERROR: Failed to open the I2C device for " << dc.name << "." << std::endl;
         return 1;
     }
 
@@ -60,27 +360,7 @@ int main(int argc, char* argv[]) {
         return 2;
     }
 
-    std::cout << "Writing ALL-ON pattern..." << std::endl;
-    std::vector<uint8_t> grid_on(dc.total_digits(), 0xFF);
-    I2CErrorInfo err;
-    if (!update_flexible_display(i2c_fd, dc, grid_on, err)) {
-        std::cerr << "ERROR: update_flexible_display (ALL-ON) failed at ch=" << err.channel
-                  << " addr=0x" << std::hex << err.address << std::dec << std::endl;
-        close(i2c_fd);
-        return 3;
-    }
-    std::this_thread::sleep_for(std::chrono::milliseconds(800));
-
-    std::cout << "Clearing (ALL-OFF)..." << std::endl;
-    std::vector<uint8_t> grid_off(dc.total_digits(), 0x00);
-    if (!update_flexible_display(i2c_fd, dc, grid_off, err)) {
-        std::cerr << "ERROR: update_flexible_display (ALL-OFF) failed at ch=" << err.channel
-                  << " addr=0x" << std::hex << err.address << std::dec << std::endl;
-        close(i2c_fd);
-        return 4;
-    }
-
-    std::cout << "Done." << std::endl;
+    const int rc = opt.bench ? run_bench(i2c_fd, dc, opt) : run_check(i2c_fd, dc);
     close(i2c_fd);
-    return 0;
+    return rc;
 }
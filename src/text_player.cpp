@@ -0,0 +1,194 @@
+// src/text_player.cpp
+// 7seg-text-player: 文字・時計・カウントダウン・テロップを 7seg-displayd へ送る
+//   ./7seg-text-player "HELLO"                          1行目に表示
+//   ./7seg-text-player --ticker --speed 6 "ようこそ 7SEG PANEL"   右から左へ流す（半桁ずつ）
+//   ./7seg-text-player --clock "%H:%M:%S" --align right --layer 10   映像の上に時計を重ねる
+//   ./7seg-text-player --countdown 300 --row 1
+// 映像を作らずに seg_text.h で grid を直接作るので、CPU はほとんど使わない。
+// フレームはパネルの fps（WELCOME）ごとに開始時刻からの経過時間で描くので、遅れたフレームがあっても位置はずれない。
+#include "display_client.h"
+#include "seg_text.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+std::atomic<bool> g_stop{false};
+
+void on_signal(int) {
+    g_stop = true;
+}
+
+void print_usage(const char* prog) {
+    std::cerr << "Usage: " << prog << " [options] [text]\n"
+              << "  --ticker              scroll the text from right to left\n"
+              << "  --speed N             ticker speed in digits per second (default 4)\n"
+              << "  --clock FORMAT        show the local time with strftime FORMAT (e.g. %H:%M:%S)\n"
+              << "  --countdown SECONDS   count down to zero (text is shown after it ends)\n"
+              << "  --row N               panel row to draw on (default 0)\n"
+              << "  --align left|center|right\n"
+              << "  --priority N          source priority (default: SEG_DISPLAYD_PRIORITY or 0)\n"
+              << "  --hold MS             hold time after the last frame (default 500)\n"
+              << "  --layer Z             draw over the current source as a layer instead of competing with it\n"
+              << std::endl;
+}
+
+std::string format_countdown(long remaining) {
+    char buf[32];
+    if (remaining >= 3600) {
+        std::snprintf(buf, sizeof(buf), "%ld:%02ld:%02ld", remaining / 3600, (remaining / 60) % 60, remaining % 60);
+    } else {
+        std::snprintf(buf, sizeof(buf), "%ld:%02ld", remaining / 60, remaining % 60);
+    }
+    return buf;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    std::string text;
+    std::string clock_format;
+    long countdown = -1;
+    bool ticker = false;
+    double speed = 4.0;
+    int row = 0;
+    SegAlign align = SegAlign::LEFT;
+    int priority = 0;
+    if (const char* v = std::getenv("SEG_DISPLAYD_PRIORITY")) priority = std::atoi(v);
+    int hold_ms = 500;
+    bool as_layer = false;
+    int layer_z = 0;
+
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        const bool has_value = (i + 1 < argc);
+        if (arg == "--ticker") {
+            ticker = true;
+        } else if (arg == "--speed" && has_value) {
+            speed = std::atof(argv[++i]);
+        } else if (arg == "--clock" && has_value) {
+            clock_format = argv[++i];
+        } else if (arg == "--countdown" && has_value) {
+            countdown = std::atol(argv[++i]);
+        } else if (arg == "--row" && has_value) {
+            row = std::atoi(argv[++i]);
+        } else if (arg == "--align" && has_value) {
+            const std::string a = argv[++i];
+            align = (a == "right") ? SegAlign::RIGHT : (a == "center") ? SegAlign::CENTER : SegAlign::LEFT;
+        } else if (arg == "--priority" && has_value) {
+            priority = std::atoi(argv[++i]);
+        } else if (arg == "--hold" && has_value) {
+            hold_ms = std::atoi(argv[++i]);
+        } else if (arg == "--layer" && has_value) {
+            as_layer = true;
+            layer_z = std::atoi(argv[++i]);
+        } else if (arg == "-h" || arg == "--help") {
+            print_usage(argv[0]);
+            return 0;
+        } else if (!arg.empty() && arg[0] == '-') {
+            print_usage(argv[0]);
+            return 2;
+        } else {
+            text = arg;
+        }
+    }
+    if (text.empty() && clock_format.empty() && countdown < 0) {
+        print_usage(argv[0]);
+        return 2;
+    }
+
+    std::signal(SIGINT, on_signal);
+    std::signal(SIGTERM, on_signal);
+    std::signal(SIGPIPE, SIG_IGN);
+
+    DisplayClient client;
+    if (!client.connect("text", priority, hold_ms)) {
+        std::cerr << "[text] 7seg-displayd is not running at " << displayd_socket_path()
+                  << " (will keep retrying)" << std::endl;
+    }
+
+    const SegTicker scroller(text, speed);
+    const bool scrolling = ticker && clock_format.empty() && countdown < 0;
+    const auto start = std::chrono::steady_clock::now();
+    std::vector<uint8_t> grid;
+    GridLayer layer;
+    int64_t frame = 0;
+
+    while (!g_stop) {
+        // パネルの大きさと fps は WELCOME で知る（構成が変わると変わる）
+        client.refresh();
+        const int w = client.panel_width();
+        const int h = client.panel_height();
+        const int fps = std::max(1, client.panel_fps());
+        const auto period = std::chrono::nanoseconds(1000000000LL / fps);
+        if (w <= 0 || h <= 0) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(200));
+            continue;
+        }
+
+        // 描くのはフレーム番号から決まる時刻（実際の起床が遅れても位置は変わらない）
+        auto due = start + frame * period;
+        const auto now = std::chrono::steady_clock::now();
+        if (due + period < now) {
+            frame = (now - start) / period; // 大きく遅れたら今のフレームへ飛ぶ
+            due = start + frame * period;
+        }
+        std::this_thread::sleep_until(due);
+        const uint64_t elapsed_ns = static_cast<uint64_t>(std::chrono::nanoseconds(due - start).count());
+        ++frame;
+
+        std::string line = text;
+        if (!clock_format.empty()) {
+            const std::time_t t = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
+            std::tm tm{};
+            localtime_r(&t, &tm);
+            char buf[128];
+            line = (std::strftime(buf, sizeof(buf), clock_format.c_str(), &tm) > 0) ? buf : "";
+        } else if (countdown >= 0) {
+            const long remaining = countdown - static_cast<long>(elapsed_ns / 1000000000ULL);
+            line = (remaining > 0 || text.empty()) ? format_countdown(std::max(0L, remaining)) : text;
+        }
+
+        const int y = std::max(0, std::min(row, h - 1));
+        if (as_layer) {
+            // テロップは1行全体、文字は文字のある桁だけを置き換える（他は下のソースのまま）
+            layer.z = layer_z;
+            layer.y = y;
+            layer.height = 1;
+            if (scrolling) {
+                layer.x = 0;
+                layer.width = w;
+                layer.cells.assign(static_cast<size_t>(w), 0);
+                scroller.render_at(elapsed_ns, layer.cells, w, 1, 0, 0, w);
+            } else {
+                const std::vector<uint8_t> cells = seg_encode(line);
+                layer.width = std::min(w, static_cast<int>(cells.size()));
+                layer.x = (align == SegAlign::LEFT) ? 0 : (align == SegAlign::RIGHT) ? w - layer.width : (w - layer.width) / 2;
+                layer.cells.assign(static_cast<size_t>(layer.width), 0);
+                seg_draw(layer.cells, layer.width, 1, 0, 0, layer.width, cells, align);
+            }
+            client.submit_layer(layer);
+        } else {
+            grid.assign(static_cast<size_t>(w) * h, 0);
+            if (scrolling) {
+                scroller.render_at(elapsed_ns, grid, w, h, 0, y, w);
+            } else {
+                seg_draw(grid, w, h, 0, y, w, seg_encode(line), align);
+            }
+            client.submit_grid(grid, w, h);
+        }
+    }
+
+    client.release();
+    return 0;
+}
@@ -0,0 +1,182 @@
+// src/trace.cpp
+#include "trace.h"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+namespace trace {
+
+namespace {
+
+struct Event {
+    const char* name;
+    const char* arg0_name;
+    const char* arg1_name;
+    int64_t arg0;
+    int64_t arg1;
+    uint64_t ts_ns;
+    uint64_t dur_ns;
+};
+
+// スレッドごとのリングバッファ。書き込みは所有スレッドのみ、読み出しは flush 時のみ。
+// ring は使った分だけ伸ばし、g_capacity に達したら古いものから上書きする（イベントの少ないスレッドは小さいまま）。
+// 終了時の flush は他のスレッドがまだ書いているうちに走りうるので、1件の書き込みと flush の写し取りは mtx で分ける
+// （取り合うのは flush の間だけなので、普段の書き込みでは待たない）。
+struct ThreadBuffer {
+    int tid = 0;
+    std::string name;
+    std::mutex mtx;
+    std::vector<Event> ring;
+    uint64_t written = 0;
+};
+
+std::mutex g_registry_mtx;
+std::vector<std::unique_ptr<ThreadBuffer>> g_buffers; // スレッド終了後も flush まで保持
+std::string g_path;
+size_t g_capacity = 65536;
+std::atomic<bool> g_flushed{false}; // flush の後に終わったイベントは記録しない
+
+uint64_t now_ns() {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+bool init_from_env() {
+    const char* path = std::getenv("SEG_TRACE");
+    if (!path || !*path) return false;
+    g_path = path;
+    if (const char* n = std::getenv("SEG_TRACE_EVENTS")) {
+        long v = std::atol(n);
+        if (v > 0) g_capacity = static_cast<size_t>(v);
+    }
+    std::atexit([] { flush(); });
+    std::cerr << "[trace] recording to " << g_path << " (" << g_capacity << " events/thread)" << std::endl;
+    return true;
+}
+
+ThreadBuffer* this_thread_buffer() {
+    thread_local ThreadBuffer* buf = nullptr;
+    if (!buf) {
+        auto b = std::make_unique<ThreadBuffer>();
+        std::lock_guard<std::mutex> lk(g_registry_mtx);
+        b->tid = static_cast<int>(g_buffers.size()) + 1;
+        buf = b.get();
+        g_buffers.push_back(std::move(b));
+    }
+    return buf;
+}
+
+void write_escaped(FILE* f, const std::string& s) {
+    for (char c : s) {
+        if (c == '"' || c == '\\') fputc('\\', f);
+        if (static_cast<unsigned char>(c) >= 0x20) fputc(c, f);
+    }
+}
+
+void write_arg(FILE* f, const char* name, int64_t v) {
+    // アドレス系はログと同じ 0x 表記にする
+    if (strstr(name, "addr") && v >= 0) {
+        fprintf(f, "\"%s\":\"0x%02llX\"", name, static_cast<long long>(v));
+    } else {
+        fprintf(f, "\"%s\":%lld", name, static_cast<long long>(v));
+    }
+}
+
+} // namespace
+
+bool enabled() {
+    static const bool on = init_from_env();
+    return on;
+}
+
+void set_thread_name(const char* name) {
+    if (!enabled()) return;
+    ThreadBuffer* b = this_thread_buffer();
+    // コールバックから毎回呼ばれても良いように、同じ名前なら何もしない（name を書くのは所有スレッドだけ）
+    if (b->name == name) return;
+    std::lock_guard<std::mutex> lk(g_registry_mtx);
+    b->name = name;
+}
+
+Scope::Scope(const char* name, const char* arg0_name, int64_t arg0, const char* arg1_name, int64_t arg1)
+    : name_(name), arg0_name_(arg0_name), arg1_name_(arg1_name), arg0_(arg0), arg1_(arg1),
+      start_ns_(enabled() ? now_ns() : 0) {}
+
+Scope::~Scope() {
+    if (start_ns_ == 0 || g_flushed.load(std::memory_order_relaxed)) return;
+    const uint64_t end = now_ns();
+    ThreadBuffer* b = this_thread_buffer();
+    const Event e{name_, arg0_name_, arg1_name_, arg0_, arg1_, start_ns_, end - start_ns_};
+    std::lock_guard<std::mutex> lk(b->mtx);
+    if (b->ring.size() < g_capacity) {
+        b->ring.push_back(e);
+    } else {
+        b->ring[b->written % g_capacity] = e;
+    }
+    ++b->written;
+}
+
+void flush() {
+    if (!enabled() || g_flushed.exchange(true)) return;
+    FILE* f = fopen(g_path.c_str(), "w");
+    if (!f) {
+        perror("[trace] fopen");
+        return;
+    }
+    const int pid = static_cast<int>(getpid());
+    size_t total = 0, lost = 0;
+    std::lock_guard<std::mutex> lk(g_registry_mtx);
+    fprintf(f, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    bool first = true;
+    std::vector<Event> events;
+    for (const auto& b : g_buffers) {
+        if (!b->name.empty()) {
+            fprintf(f, "%s{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":%d,\"tid\":%d,\"args\":{\"name\":\"",
+                    first ? "" : ",\n", pid, b->tid);
+            write_escaped(f, b->name);
+            fprintf(f, "\"}}");
+            first = false;
+        }
+        // まだ動いているスレッドのリングは、ロックの間に古い順に写し取ってから書き出す
+        uint64_t begin = 0;
+        {
+            std::lock_guard<std::mutex> ring_lk(b->mtx);
+            const size_t cap = b->ring.size();
+            begin = b->written > cap ? b->written - cap : 0;
+            events.clear();
+            for (uint64_t i = begin; i < b->written; ++i) events.push_back(b->ring[i % cap]);
+        }
+        lost += begin;
+        for (const Event& e : events) {
+            fprintf(f, "%s{\"ph\":\"X\",\"name\":\"%s\",\"pid\":%d,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f",
+                    first ? "" : ",\n", e.name, pid, b->tid, e.ts_ns / 1000.0, e.dur_ns / 1000.0);
+            if (e.arg0_name) {
+                fprintf(f, ",\"args\":{");
+                write_arg(f, e.arg0_name, e.arg0);
+                if (e.arg1_name) {
+                    fputc(',', f);
+                    write_arg(f, e.arg1_name, e.arg1);
+                }
+                fputc('}', f);
+            }
+            fputc('}', f);
+            first = false;
+            ++total;
+        }
+    }
+    fprintf(f, "\n]}\n");
+    fclose(f);
+    std::cerr << "[trace] wrote " << total << " events to " << g_path;
+    if (lost > 0) std::cerr << " (" << lost << " older events overwritten)";
+    std::cerr << std::endl;
+}
+
+} // namespace trace
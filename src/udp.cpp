@@ -58,6 +58,8 @@ void udp_loop(int i2c_fd, int sockfd, const DisplayConfig& config, std::atomic<b
                 std::lock_guard<std::mutex> lock(frame_mtx);
                 if (!frame_vec.empty()) {
                     latest_frame = frame_vec;
+                    ++latest_frame_seq;
+                    latest_frame_received_at = std::chrono::steady_clock::now();
                 }
                 last_pts_ms = pts;
             }
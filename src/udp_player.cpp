@@ -5,6 +5,7 @@
 #include "main_common.hpp"
 #include "udp.h"
 #include "led.h"
+#include "display_client.h"
 #include "config_loader.hpp" // ★★★ JSONを読み込むために必須 ★★★
 #include <iostream>
 #include <string>
@@ -66,20 +67,28 @@ int main(int argc, char* argv[]) {
         return 1;
     }
     
-    int i2c_fd = open("/dev/i2c-0", O_RDWR);
-    if (i2c_fd < 0) {
-        perror("Failed to open /dev/i2c-0");
-        return 1;
-    }
+    // SEG_DISPLAYD_PRIORITY が設定されていれば I2C は開かず、7seg-displayd にフレームを送る
+    int i2c_fd = -1;
+    if (!connect_displayd_output_from_env("udp-player")) {
+        i2c_fd = open("/dev/i2c-0", O_RDWR);
+        if (i2c_fd < 0) {
+            perror("Failed to open /dev/i2c-0");
+            return 1;
+        }
 
-    if (!initialize_displays(i2c_fd, active_config)) {
-        std::cerr << "Failed to initialize display modules." << std::endl;
-        close(i2c_fd);
-        return 1;
+        if (!initialize_displays(i2c_fd, active_config)) {
+            std::cerr << "Failed to initialize display modules." << std::endl;
+            close(i2c_fd);
+            return 1;
+        }
     }
 
     setup_signal_handlers(); 
 
+    // config.json の保存 / SIGHUP で構成を再起動なしに差し替える（映像スレッドがフレームごとに拾う）
+    live_config().publish_initial(active_config, scaling_mode, min_threshold, max_threshold, config_name);
+    live_config().start_watcher();
+
     std::atomic<bool> stop_flag(false);
     std::thread watch_dog([&stop_flag] {
         while(!g_should_exit) {
@@ -90,7 +99,7 @@ int main(int argc, char* argv[]) {
 
     start_udp_server(i2c_fd, port, active_config, stop_flag);
     
-    close(i2c_fd);
+    if (i2c_fd >= 0) close(i2c_fd);
     
     if(watch_dog.joinable()) {
         watch_dog.join();
@@ -0,0 +1,292 @@
+// src/v4l2_capture.cpp
+#include "v4l2_capture.h"
+
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#ifndef __APPLE__
+#include <fcntl.h>
+#include <linux/videodev2.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+V4L2Capture::~V4L2Capture() {
+    close();
+}
+
+#ifdef __APPLE__
+
+bool V4L2Capture::open(const std::string& device, int, int, int) {
+    std::cerr << "[v4l2] " << device << ": V4L2 is not available on macOS" << std::endl;
+    return false;
+}
+
+void V4L2Capture::close() {}
+
+bool V4L2Capture::dequeue(Frame&, int, uint64_t&) {
+    return false;
+}
+
+void V4L2Capture::release(const Frame&) {}
+
+bool V4L2Capture::dequeue_one(Frame&) {
+    return false;
+}
+
+bool V4L2Capture::queue(int) {
+    return false;
+}
+
+#else
+
+namespace {
+
+int xioctl(int fd, unsigned long request, void* arg) {
+    int r;
+    do {
+        r = ioctl(fd, request, arg);
+    } while (r < 0 && errno == EINTR);
+    return r;
+}
+
+std::string fourcc_name(uint32_t f) {
+    const char s[5] = {static_cast<char>(f & 0xFF), static_cast<char>((f >> 8) & 0xFF),
+                       static_cast<char>((f >> 16) & 0xFF), static_cast<char>((f >> 24) & 0xFF), 0};
+    return s;
+}
+
+// Y を読める形式と、隣の画素までのバイト数（0 は読めない形式）
+int luma_step(uint32_t pixelformat) {
+    switch (pixelformat) {
+        case V4L2_PIX_FMT_YUYV:
+        case V4L2_PIX_FMT_YVYU:
+            return 2;
+        case V4L2_PIX_FMT_NV12:
+        case V4L2_PIX_FMT_NV21:
+        case V4L2_PIX_FMT_GREY:
+        case V4L2_PIX_FMT_YUV420:
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+} // namespace
+
+bool V4L2Capture::open(const std::string& device, int width, int height, int fps) {
+    close();
+    fd_ = ::open(device.c_str(), O_RDWR | O_NONBLOCK | O_CLOEXEC);
+    if (fd_ < 0) {
+        std::cerr << "[v4l2] " << device << ": open failed: " << std::strerror(errno) << std::endl;
+        return false;
+    }
+    v4l2_capability cap{};
+    if (xioctl(fd_, VIDIOC_QUERYCAP, &cap) < 0) {
+        std::cerr << "[v4l2] " << device << ": not a V4L2 device" << std::endl;
+        close();
+        return false;
+    }
+    const uint32_t caps = (cap.capabilities & V4L2_CAP_DEVICE_CAPS) ? cap.device_caps : cap.capabilities;
+    if (!(caps & V4L2_CAP_STREAMING) || !(caps & (V4L2_CAP_VIDEO_CAPTURE | V4L2_CAP_VIDEO_CAPTURE_MPLANE))) {
+        std::cerr << "[v4l2] " << device << ": no streaming video capture" << std::endl;
+        close();
+        return false;
+    }
+    mplane_ = !(caps & V4L2_CAP_VIDEO_CAPTURE);
+    const auto type = mplane_ ? V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE : V4L2_BUF_TYPE_VIDEO_CAPTURE;
+
+    // 小さい解像度の YUYV を頼み、断られたら NV12 を頼む（パネルは数十桁なので QVGA でも十分）
+    v4l2_format fmt{};
+    bool negotiated = false;
+    for (uint32_t want : {V4L2_PIX_FMT_YUYV, V4L2_PIX_FMT_NV12}) {
+        fmt = v4l2_format{};
+        fmt.type = type;
+        if (mplane_) {
+            fmt.fmt.pix_mp.width = static_cast<uint32_t>(width);
+            fmt.fmt.pix_mp.height = static_cast<uint32_t>(height);
+            fmt.fmt.pix_mp.pixelformat = want;
+            fmt.fmt.pix_mp.field = V4L2_FIELD_NONE;
+        } else {
+            fmt.fmt.pix.width = static_cast<uint32_t>(width);
+            fmt.fmt.pix.height = static_cast<uint32_t>(height);
+            fmt.fmt.pix.pixelformat = want;
+            fmt.fmt.pix.field = V4L2_FIELD_NONE;
+        }
+        if (xioctl(fd_, VIDIOC_S_FMT, &fmt) < 0) continue;
+        const uint32_t got = mplane_ ? fmt.fmt.pix_mp.pixelformat : fmt.fmt.pix.pixelformat;
+        if (luma_step(got) > 0) {
+            negotiated = true;
+            break;
+        }
+    }
+    if (!negotiated) {
+        std::cerr << "[v4l2] " << device << ": neither YUYV nor NV12 is supported" << std::endl;
+        close();
+        return false;
+    }
+    uint32_t pixelformat;
+    if (mplane_) {
+        width_ = static_cast<int>(fmt.fmt.pix_mp.width);
+        height_ = static_cast<int>(fmt.fmt.pix_mp.height);
+        pixelformat = fmt.fmt.pix_mp.pixelformat;
+        stride_ = fmt.fmt.pix_mp.plane_fmt[0].bytesperline;
+    } else {
+        width_ = static_cast<int>(fmt.fmt.pix.width);
+        height_ = static_cast<int>(fmt.fmt.pix.height);
+        pixelformat = fmt.fmt.pix.pixelformat;
+        stride_ = fmt.fmt.pix.bytesperline;
+    }
+    pixel_step_ = luma_step(pixelformat);
+    if (stride_ == 0) stride_ = static_cast<size_t>(width_) * pixel_step_;
+    format_name_ = fourcc_name(pixelformat);
+
+    // fps は頼むだけ（対応しないドライバもある）
+    if (fps > 0) {
+        v4l2_streamparm parm{};
+        parm.type = type;
+        parm.parm.capture.timeperframe.numerator = 1;
+        parm.parm.capture.timeperframe.denominator = static_cast<uint32_t>(fps);
+        xioctl(fd_, VIDIOC_S_PARM, &parm);
+    }
+
+    // バッファは少なめに（多いとドライバの中で古いフレームが溜まる）
+    v4l2_requestbuffers req{};
+    req.count = 3;
+    req.type = type;
+    req.memory = V4L2_MEMORY_MMAP;
+    if (xioctl(fd_, VIDIOC_REQBUFS, &req) < 0 || req.count < 2) {
+        std::cerr << "[v4l2] " << device << ": mmap buffers are not available: " << std::strerror(errno) << std::endl;
+        close();
+        return false;
+    }
+    buffers_.resize(req.count);
+    for (uint32_t i = 0; i < req.count; ++i) {
+        v4l2_buffer buf{};
+        v4l2_plane planes[VIDEO_MAX_PLANES]{};
+        buf.type = type;
+        buf.memory = V4L2_MEMORY_MMAP;
+        buf.index = i;
+        if (mplane_) {
+            buf.m.planes = planes;
+            buf.length = VIDEO_MAX_PLANES;
+        }
+        if (xioctl(fd_, VIDIOC_QUERYBUF, &buf) < 0) {
+            std::cerr << "[v4l2] " << device << ": QUERYBUF failed: " << std::strerror(errno) << std::endl;
+            close();
+            return false;
+        }
+        // 多平面でも Y は平面 0 にある（NV12 の UV は別の平面か、同じ平面の後ろ）
+        const size_t length = mplane_ ? planes[0].length : buf.length;
+        const off_t offset = mplane_ ? planes[0].m.mem_offset : buf.m.offset;
+        void* p = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, offset);
+        if (p == MAP_FAILED) {
+            std::cerr << "[v4l2] " << device << ": mmap failed: " << std::strerror(errno) << std::endl;
+            close();
+            return false;
+        }
+        buffers_[i].start = p;
+        buffers_[i].length = length;
+        if (!queue(static_cast<int>(i))) {
+            close();
+            return false;
+        }
+    }
+
+    int stream_type = type;
+    if (xioctl(fd_, VIDIOC_STREAMON, &stream_type) < 0) {
+        std::cerr << "[v4l2] " << device << ": STREAMON failed: " << std::strerror(errno) << std::endl;
+        close();
+        return false;
+    }
+    streaming_ = true;
+    std::cout << "[v4l2] " << device << ": " << width_ << "x" << height_ << " " << format_name_ << " ("
+              << buffers_.size() << " mmap buffers" << (mplane_ ? ", multi-planar" : "") << ")" << std::endl;
+    return true;
+}
+
+void V4L2Capture::close() {
+    if (fd_ < 0) return;
+    if (streaming_) {
+        int type = mplane_ ? V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE : V4L2_BUF_TYPE_VIDEO_CAPTURE;
+        xioctl(fd_, VIDIOC_STREAMOFF, &type);
+        streaming_ = false;
+    }
+    for (auto& b : buffers_) {
+        if (b.start) munmap(b.start, b.length);
+    }
+    buffers_.clear();
+    ::close(fd_);
+    fd_ = -1;
+}
+
+bool V4L2Capture::queue(int index) {
+    v4l2_buffer buf{};
+    v4l2_plane planes[VIDEO_MAX_PLANES]{};
+    buf.type = mplane_ ? V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE : V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    buf.memory = V4L2_MEMORY_MMAP;
+    buf.index = static_cast<uint32_t>(index);
+    if (mplane_) {
+        buf.m.planes = planes;
+        buf.length = VIDEO_MAX_PLANES;
+    }
+    if (xioctl(fd_, VIDIOC_QBUF, &buf) < 0) {
+        std::cerr << "[v4l2] QBUF " << index << " failed: " << std::strerror(errno) << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool V4L2Capture::dequeue_one(Frame& frame) {
+    v4l2_buffer buf{};
+    v4l2_plane planes[VIDEO_MAX_PLANES]{};
+    buf.type = mplane_ ? V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE : V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    buf.memory = V4L2_MEMORY_MMAP;
+    if (mplane_) {
+        buf.m.planes = planes;
+        buf.length = VIDEO_MAX_PLANES;
+    }
+    if (xioctl(fd_, VIDIOC_DQBUF, &buf) < 0) {
+        if (errno != EAGAIN) std::cerr << "[v4l2] DQBUF failed: " << std::strerror(errno) << std::endl;
+        return false;
+    }
+    frame.luma = static_cast<const uint8_t*>(buffers_[buf.index].start);
+    frame.width = width_;
+    frame.height = height_;
+    frame.pixel_step = pixel_step_;
+    frame.stride = stride_;
+    frame.sequence = buf.sequence;
+    frame.index = static_cast<int>(buf.index);
+    // 多くのドライバは CLOCK_MONOTONIC の時刻を付ける（steady_clock と同じ時計）。そうでなければ受け取った時刻
+    if ((buf.flags & V4L2_BUF_FLAG_TIMESTAMP_MASK) == V4L2_BUF_FLAG_TIMESTAMP_MONOTONIC) {
+        frame.captured_at = std::chrono::steady_clock::time_point(
+            std::chrono::seconds(buf.timestamp.tv_sec) + std::chrono::microseconds(buf.timestamp.tv_usec));
+    } else {
+        frame.captured_at = std::chrono::steady_clock::now();
+    }
+    return true;
+}
+
+bool V4L2Capture::dequeue(Frame& frame, int timeout_ms, uint64_t& dropped) {
+    if (fd_ < 0) return false;
+    pollfd pfd{fd_, POLLIN, 0};
+    const int r = poll(&pfd, 1, timeout_ms);
+    if (r <= 0 || !(pfd.revents & POLLIN)) return false;
+    if (!dequeue_one(frame)) return false;
+    // 溜まっていた古いフレームはすぐ返し、最新の1枚だけを表示する
+    Frame newer;
+    while (dequeue_one(newer)) {
+        release(frame);
+        frame = newer;
+        ++dropped;
+    }
+    return true;
+}
+
+void V4L2Capture::release(const Frame& frame) {
+    if (fd_ >= 0 && frame.index >= 0) queue(frame.index);
+}
+
+#endif
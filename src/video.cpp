@@ -2,9 +2,16 @@
 #include "common.h"
 #include "led.h"
 #include "video.h"
+#include "metrics.h"
+#include "trace.h"
+#include "live_config.h"
+#include "display_client.h"
+#include "frame_scheduler.h"
+#include "local_dimming.h"
+#include "sampling_plan.h"
+#include "latency_probe.h"
 #include <thread>
 #include <chrono>
-#include <map>
 #ifndef __APPLE__
 #include <opencv2/opencv.hpp>
 #include <opencv2/imgcodecs.hpp> // imdecode 用を明示
@@ -12,67 +19,29 @@
 #include <fcntl.h>  // open() と O_RDWR のために必要
 #include <unistd.h> // close(), usleep() のために必要
 
-// 7セグ1文字内のピクセルサンプリング位置 (変更なし)
-const std::map<int, std::pair<int, int>> SEG_MAP = {
-    {0, {1, 0}}, {1, {3, 1}}, {2, {3, 3}}, {3, {1, 4}},
-    {4, {0, 3}}, {5, {0, 1}}, {6, {1, 2}}, {7, {4, 4}}
-};
-
-
 #include <iostream> 
 
 
-void frame_to_grid(const cv::Mat& bw, const DisplayConfig& config, std::vector<uint8_t>& grid) {
-    // --- ステップ1: ディスプレイの物理アスペクト比を元に、高解像度フレームから切り取るべき領域(ROI)を計算 ---
-    const double display_aspect_ratio = 
-        (config.total_width * CHAR_WIDTH_MM) / (config.total_height * CHAR_HEIGHT_MM);
-    const double frame_aspect_ratio = (double)bw.cols / (double)bw.rows;
-
-    cv::Rect roi; // サンプリング領域 (x, y, width, height)
-    if (frame_aspect_ratio > display_aspect_ratio) {
-        // 映像がディスプレイより「横長」の場合 -> 左右をクロップ
-        int new_width = std::min(bw.cols - 1, static_cast<int>(bw.rows * display_aspect_ratio));
-        roi = cv::Rect((bw.cols - new_width) / 2, 0, new_width, bw.rows - 1);
-    } else {
-        // 映像がディスプレイより「縦長」の場合 -> 上下をクロップ
-        int new_height = std::min(bw.rows - 1, static_cast<int>(bw.cols / display_aspect_ratio));
-        roi = cv::Rect(0, (bw.rows - new_height) / 2, bw.cols - 1, new_height);
-    }
-
-    // --- ステップ2: 算出したROIを基準に、各文字・各セグメントのサンプリング座標を計算 ---
-    const int TOTAL_WIDTH = config.total_width;
-    const int TOTAL_HEIGHT = config.total_height;
-    grid.assign(config.total_digits(), 0);
+// サンプリング位置の表（sampling_plan.h）は画像とパネルの大きさが変わったときだけ作り直す
+static const SamplingPlan& sampling_plan_for(const cv::Mat& gray, const DisplayConfig& config) {
+    thread_local SamplingPlan plan;
+    plan.prepare(config, gray.cols, gray.rows, 1, gray.step);
+    return plan;
+}
 
-    // ROI（サンプリング領域）内での「1文字分」のセルの大きさをピクセル単位で計算
-    const double cell_width_in_roi = (double)roi.width / TOTAL_WIDTH;
-    const double cell_height_in_roi = (double)roi.height / TOTAL_HEIGHT;
+void frame_to_grid(const cv::Mat& bw, const DisplayConfig& config, std::vector<uint8_t>& grid) {
+    metrics::ScopedTimer timer(metrics::frame_to_grid_latency());
+    trace::Scope trace_scope("frame_to_grid");
+    // ディスプレイの物理アスペクト比に合わせて切り取った領域の、各文字・各セグメントの位置を読む
+    sampling_plan_for(bw, config).sample_grid(bw.data, grid);
+}
 
-    for (int char_r = 0; char_r < TOTAL_HEIGHT; ++char_r) {
-        for (int char_c = 0; char_c < TOTAL_WIDTH; ++char_c) {
-            
-            // この文字の左上の基準座標を、元の高解像度フレーム上の絶対座標として計算
-            const double base_x = roi.x + char_c * cell_width_in_roi;
-            const double base_y = roi.y + char_r * cell_height_in_roi;
-
-            uint8_t seg = 0;
-            for (auto const& [bit, pos] : SEG_MAP) {
-                auto [dx, dy] = pos; // SEG_MAP内の抽象的な座標(0-4)
-
-                // 抽象的な5x5グリッド座標を、物理的な縦横比を持つcellの大きさに合わせてスケーリング
-                int px_offset = static_cast<int>((dx / 4.0) * cell_width_in_roi);
-                int py_offset = static_cast<int>((dy / 4.0) * cell_height_in_roi);
-                
-                int px = static_cast<int>(base_x) + px_offset;
-                int py = static_cast<int>(base_y) + py_offset;
-                
-                if (px >= 0 && px < bw.cols && py >= 0 && py < bw.rows && bw.at<uint8_t>(py, px) > 128) {
-                    seg |= (1 << bit);
-                }
-            }
-            grid[char_r * TOTAL_WIDTH + char_c] = seg;
-        }
-    }
+void frame_to_levels(const cv::Mat& gray, const DisplayConfig& config, int min_threshold, int max_threshold,
+                     std::vector<uint8_t>& levels) {
+    metrics::ScopedTimer timer(metrics::frame_to_grid_latency());
+    trace::Scope trace_scope("frame_to_levels");
+    // サンプリング位置は frame_to_grid と同じ
+    sampling_plan_for(gray, config).sample_levels(gray.data, min_threshold, max_threshold, levels);
 }
 
 
@@ -90,52 +59,126 @@ void video_thread(int& i2c_fd, const DisplayConfig& config, std::atomic<bool>& s
         std::this_thread::sleep_for(std::chrono::milliseconds(100));
     }
 #else
+    // 表示構成は再生中にも差し替わる（live_config.h）。フレームごとに読み直す
+    std::shared_ptr<const LiveSettings> live = live_settings_or(config, ScalingMode::FIT, 64, 255);
     std::vector<uint8_t> grid(config.total_digits(), 0);
-    auto frame_duration = std::chrono::milliseconds(1000 / FPS);
+    // 表示の周期は SEG_OUTPUT_FPS（既定 FPS）。締め切りに合わせて書き込みを終えるよう早めに起きる
+    // バスに余裕があれば SEG_OUTPUT_MAX_FPS まで上げ、追いつかなければ下げる（RateController）
+    FrameScheduler scheduler(output_fps_from_env(FPS));
+    RateController rate(scheduler.fps(), output_max_fps_from_env(60));
+    // SEG_LOCAL_DIMMING: モジュールごとの輝度をデコードした映像の明るさに合わせる（I2C に直接書くときだけ）
+    const bool dimming = local_dimming_from_env();
+    LocalDimming local_dimming;
+    std::vector<uint8_t> levels;
+    // SEG_LATENCY_PROBE=1: 7seg-latency-source の時刻のパターンを読み、送り手から表示までの遅れを測る
+    const bool probe = []{ const char* v = std::getenv("SEG_LATENCY_PROBE"); return v && std::atoi(v) != 0; }();
+    latency_probe::Report probe_report;
+    bool probe_pending = false;     // grid に描いたフレームがパターンで、まだ遅れを数えていない
+    uint32_t probe_ms24 = 0;
+    std::chrono::steady_clock::time_point received_at{};
+    // パターンのフレームを書き終えたら、送り手の時刻から受け取り・書き込み終了までの遅れを記録する
+    auto note_probe_commit = [&]() {
+        if (!probe_pending) return;
+        probe_pending = false;
+        const int64_t total_ms = latency_probe::elapsed_ms(probe_ms24, std::chrono::steady_clock::now());
+        const int64_t receive_ms = latency_probe::elapsed_ms(probe_ms24, received_at);
+        if (total_ms < 0 || receive_ms < 0) return;
+        metrics::probe_source_to_receive_latency().observe_us(static_cast<uint64_t>(receive_ms) * 1000);
+        metrics::probe_source_to_commit_latency().observe_us(static_cast<uint64_t>(total_ms) * 1000);
+        probe_report.add(receive_ms, std::max<int64_t>(0, total_ms - receive_ms));
+    };
 
     static int dbg_count = 0;
+    uint64_t shown_seq = 0;
+    uint64_t drawn_seq = 0; // grid に描いてあるフレーム
+    trace::set_thread_name("video_thread");
+    set_output_thread_realtime_from_env("video_thread");
 
     while (!stop_flag) {
-        auto start_time = std::chrono::steady_clock::now();
-        
+        scheduler.wait_next();
+        if (probe) probe_report.print_if_due(std::chrono::seconds(5));
+
         std::vector<uint8_t> frame_data;
+        uint64_t seq = 0;
+        std::shared_ptr<const LiveSettings> next = live_config().current();
+        const bool layout_changed = next && next->display != live->display;
 
         {
             std::lock_guard<std::mutex> lock(frame_mtx);
-            if (!latest_frame.empty()) {
+            seq = latest_frame_seq;
+            received_at = latest_frame_received_at;
+            // 新しいフレームがなければ前の grid をもう一度書く（デコードしない）
+            if (!latest_frame.empty() && (seq != drawn_seq || layout_changed)) {
                 frame_data = latest_frame; // JPEG バイト列
             }
         }
+        // 前回表示してから2枚以上進んでいれば、その間のフレームは表示されずに上書きされた
+        if (shown_seq != 0 && seq > shown_seq + 1) {
+            metrics::frames_dropped().inc(seq - shown_seq - 1);
+        }
+        if (seq != 0) shown_seq = seq;
 
+        if (frame_data.empty() && (drawn_seq == 0 || seq != drawn_seq)) continue;
+
+        // デコードから I2C 書き込みまで（待ち時間は含めない）
+        trace::Scope frame_scope("video_frame", "seq", static_cast<int64_t>(seq));
         if (!frame_data.empty()) {
             // JPEG をグレースケールにデコード
-            cv::Mat decoded = cv::imdecode(frame_data, cv::IMREAD_GRAYSCALE);
+            cv::Mat decoded;
+            {
+                metrics::ScopedTimer timer(metrics::decode_latency());
+                trace::Scope decode_scope("imdecode", "bytes", static_cast<int64_t>(frame_data.size()));
+                decoded = cv::imdecode(frame_data, cv::IMREAD_GRAYSCALE);
+            }
             if (decoded.empty()) {
                 std::cerr << "[video] JPEG decode failed (size=" << frame_data.size() << " bytes)" << std::endl;
-            } else {
-                if (++dbg_count <= 3) {
-                    std::cout << "[video] decoded frame: " << decoded.cols << "x" << decoded.rows << " ("
-                              << frame_data.size() << " bytes)" << std::endl;
-                }
-                frame_to_grid(decoded, config, grid);
-                I2CErrorInfo error_info; 
-
-                if (!update_flexible_display(i2c_fd, config, grid, error_info)) {
-                    if (!attempt_i2c_recovery(i2c_fd, config)) {
-                        // 全ての復旧に失敗した場合、長めに待つ
-                        std::cerr << "Recovery failed in video_thread. Pausing before next attempt..." << std::endl;
-                        sleep(2);
-                    }                                  
-                }     
+                continue;
             }
+            if (++dbg_count <= 3) {
+                std::cout << "[video] decoded frame: " << decoded.cols << "x" << decoded.rows << " ("
+                          << frame_data.size() << " bytes)" << std::endl;
+            }
+            if (layout_changed) {
+                // 7seg-displayd に送っている場合、モジュールの初期化はデーモンが行う
+                if (!displayd_output()) apply_layout_change(i2c_fd, *live->display, *next->display);
+                live = std::move(next);
+            }
+            frame_to_grid(decoded, *live->display, grid);
+            if (probe) {
+                probe_pending = latency_probe::decode(decoded.data, decoded.cols, decoded.rows, 1, decoded.step, probe_ms24);
+            }
+            if (dimming && live->display->routing && !displayd_output()) {
+                // frame_to_grid の2値化と同じく 128 を超えた明るさだけを数える
+                frame_to_levels(decoded, *live->display, 128, 255, levels);
+                local_dimming.update(*live->display->routing, levels, false);
+            }
+            drawn_seq = seq;
         }
 
-        // sleep_until と sleep_for の混在をやめ、シンプルな形でフレームレートを維持する
-        auto end_time = std::chrono::steady_clock::now();
-        auto elapsed_time = std::chrono::duration_cast<std::chrono::milliseconds>(end_time - start_time);
-        auto wait_time = frame_duration - elapsed_time;
-        if (wait_time.count() > 0) {
-            std::this_thread::sleep_for(wait_time);
+        DisplayClient* output = displayd_output();
+        const DisplayConfig& cfg = *live->display;
+        scheduler.wait_commit();
+        if (output) {
+            if (output->submit_grid(grid, cfg.total_width, cfg.total_height)) {
+                metrics::frames_displayed().inc();
+                note_probe_commit();
+            }
+            scheduler.commit_done();
+        } else {
+            I2CErrorInfo error_info;
+            if (update_flexible_display(i2c_fd, cfg, grid, local_dimming.brightness(), error_info)) {
+                metrics::frames_displayed().inc();
+                scheduler.commit_done();
+                note_probe_commit();
+                // 7seg-displayd に送る場合の周期はデーモン側で決まるので、直接書き込むときだけ調整する
+                if (rate.observe(scheduler, last_update_stats())) scheduler.set_fps(rate.fps());
+            } else {
+                if (!attempt_i2c_recovery(i2c_fd, cfg)) {
+                    // 全ての復旧に失敗した場合、長めに待つ
+                    std::cerr << "Recovery failed in video_thread. Pausing before next attempt..." << std::endl;
+                    sleep(2);
+                }
+            }
         }
     }
 #endif
@@ -8,6 +8,7 @@ import random
 import curses
 import json
 from smbus2 import SMBus
+from grid_ring import GridRing
 
 # -----------------------------------------------------------------------------
 # Gravity / auto-drop timing constants (Moon gravity tweak)
@@ -173,6 +174,10 @@ def update_display_module(bus, ht16k33_addr, text_list):
 		print(f"I2C Write Error on Address {hex(ht16k33_addr)}: {e}", file=sys.stderr)
 
 def update_flexible_display(bus, config, full_text):
+	# --shm: I2C は 7seg-displayd に任せ、共有メモリのリングへ grid を渡す
+	if isinstance(bus, GridRing):
+		bus.submit_text(full_text, digit_map)
+		return
 	TCA_ADDR = config.get("tca9548a_address")
 	MOD_DIGITS_W, MOD_DIGITS_H = config["module_digits_width"], config["module_digits_height"]
 	TOTAL_WIDTH = config["total_width"]
@@ -389,6 +394,8 @@ def main():
 						help='Display configuration name defined in config.json (e.g., 16x12, 12x8).')
 	parser.add_argument('--test', action='store_true', 
 						help='Run test display instead of game.')
+	parser.add_argument('--shm', action='store_true',
+						help='Send frames to 7seg-displayd through its shared-memory grid ring instead of driving I2C.')
 	args = parser.parse_args()
 
 	# ★★★ JSONファイルから設定を読み込む ★★★
@@ -397,12 +404,17 @@ def main():
 	bus = None
 	try:
 		bus_number = active_config.get("bus_number", 0)
-		bus = SMBus(bus_number) 
-		print(f"Using configuration: {active_config['name']}")
-		print("Initializing modules...")
+		if args.shm:
+			# モジュールの初期化は 7seg-displayd が済ませている
+			bus = GridRing()
+			print(f"Using configuration: {active_config['name']} (7seg-displayd grid ring {bus.width}x{bus.height})")
+		else:
+			bus = SMBus(bus_number)
+			print(f"Using configuration: {active_config['name']}")
+			print("Initializing modules...")
 		
 		TCA_ADDR = active_config.get("tca9548a_address")
-		for channel, address_grid in active_config["channel_grids"].items():
+		for channel, address_grid in ({} if args.shm else active_config["channel_grids"]).items():
 			tca_select_channel(bus, TCA_ADDR, channel)
 			time.sleep(0.01)
 			for row in address_grid:
@@ -416,7 +428,7 @@ def main():
 						print(f"Failed to initialize CH{channel} addr {hex(addr)}: {e}", file=sys.stderr)
 						return
 		
-		if TCA_ADDR is not None:
+		if TCA_ADDR is not None and not args.shm:
 			tca_select_channel(bus, TCA_ADDR, -1)
 		
 		if args.test: